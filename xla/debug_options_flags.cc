@@ -91,6 +91,17 @@ DebugOptions DefaultDebugOptionsIgnoringFlags() {
 
   // By default, copy TF's Eigen style min_max behavior with nans.
   opts.set_xla_cpu_enable_fast_min_max(true);
+  opts.set_xla_cpu_use_temp_slab(false);
+  opts.set_xla_cpu_parallel_codegen_threads(1);
+  opts.set_xla_cpu_compilation_cache_dir("");
+  opts.set_xla_cpu_compilation_cache_max_bytes(int64_t{1} << 30);
+  opts.set_xla_cpu_use_native_scatter(true);
+  opts.set_xla_cpu_enable_float_scatter_atomics(false);
+  opts.set_xla_cpu_enable_inter_op_parallelism(false);
+  opts.set_xla_cpu_parallel_task_profile_path("");
+  opts.set_xla_cpu_enable_onednn_rewriter(false);
+  opts.set_xla_cpu_use_runtime_transpose(true);
+  opts.set_xla_cpu_enable_multi_output_fusion(true);
 
   opts.set_xla_gpu_enable_cudnn_frontend(true);
 
@@ -496,6 +507,75 @@ void MakeDebugOptionsFlags(std::vector<tsl::Flag>* flag_list,
       debug_options->xla_cpu_enable_fast_min_max(),
       "Enable fast floating point min/max lowering that always propagates "
       "NaNs."));
+  flag_list->push_back(tsl::Flag(
+      "xla_cpu_use_temp_slab",
+      bool_setter_for(&DebugOptions::set_xla_cpu_use_temp_slab),
+      debug_options->xla_cpu_use_temp_slab(),
+      "Keep the temporary buffers of CPU executables in huge-page aligned "
+      "slabs that are reused across executions."));
+  flag_list->push_back(tsl::Flag(
+      "xla_cpu_parallel_codegen_threads",
+      int32_setter_for(&DebugOptions::set_xla_cpu_parallel_codegen_threads),
+      debug_options->xla_cpu_parallel_codegen_threads(),
+      "Number of threads used to optimize and compile the LLVM IR of CPU "
+      "executables. Above one, the LLVM module is split into up to as many "
+      "parts that are compiled concurrently."));
+  flag_list->push_back(tsl::Flag(
+      "xla_cpu_compilation_cache_dir",
+      string_setter_for(&DebugOptions::set_xla_cpu_compilation_cache_dir),
+      debug_options->xla_cpu_compilation_cache_dir(),
+      "Directory of a persistent cache of compiled CPU executables, shared "
+      "across processes. Caching is disabled if empty."));
+  flag_list->push_back(tsl::Flag(
+      "xla_cpu_compilation_cache_max_bytes",
+      int64_setter_for(&DebugOptions::set_xla_cpu_compilation_cache_max_bytes),
+      debug_options->xla_cpu_compilation_cache_max_bytes(),
+      "Size limit of the CPU compilation cache directory. The oldest entries "
+      "are evicted once it is exceeded."));
+  flag_list->push_back(tsl::Flag(
+      "xla_cpu_use_native_scatter",
+      bool_setter_for(&DebugOptions::set_xla_cpu_use_native_scatter),
+      debug_options->xla_cpu_use_native_scatter(),
+      "Emit scatters directly on CPU instead of expanding them into while "
+      "loops."));
+  flag_list->push_back(tsl::Flag(
+      "xla_cpu_enable_float_scatter_atomics",
+      bool_setter_for(
+          &DebugOptions::set_xla_cpu_enable_float_scatter_atomics),
+      debug_options->xla_cpu_enable_float_scatter_atomics(),
+      "Parallelize floating-point scatter-adds with non-unique indices on CPU "
+      "with atomic additions, whose results aren't reproducible."));
+  flag_list->push_back(tsl::Flag(
+      "xla_cpu_enable_inter_op_parallelism",
+      bool_setter_for(&DebugOptions::set_xla_cpu_enable_inter_op_parallelism),
+      debug_options->xla_cpu_enable_inter_op_parallelism(),
+      "Run independent ops of the entry computation concurrently on the "
+      "intra-op thread pool."));
+  flag_list->push_back(tsl::Flag(
+      "xla_cpu_parallel_task_profile_path",
+      string_setter_for(&DebugOptions::set_xla_cpu_parallel_task_profile_path),
+      debug_options->xla_cpu_parallel_task_profile_path(),
+      "Profile of measured instruction latencies, recorded by "
+      "cpu_parallel_task_profiler, used to choose the number of parallel "
+      "tasks of CPU instructions."));
+  flag_list->push_back(tsl::Flag(
+      "xla_cpu_enable_onednn_rewriter",
+      bool_setter_for(&DebugOptions::set_xla_cpu_enable_onednn_rewriter),
+      debug_options->xla_cpu_enable_onednn_rewriter(),
+      "Rewrite dots and their fused epilogues into oneDNN matmul calls on "
+      "CPU. Only has an effect in builds with oneDNN."));
+  flag_list->push_back(tsl::Flag(
+      "xla_cpu_use_runtime_transpose",
+      bool_setter_for(&DebugOptions::set_xla_cpu_use_runtime_transpose),
+      debug_options->xla_cpu_use_runtime_transpose(),
+      "Transpose large arrays on CPU with a tiled, vectorized runtime "
+      "function instead of elementwise loops."));
+  flag_list->push_back(tsl::Flag(
+      "xla_cpu_enable_multi_output_fusion",
+      bool_setter_for(&DebugOptions::set_xla_cpu_enable_multi_output_fusion),
+      debug_options->xla_cpu_enable_multi_output_fusion(),
+      "Fuse sibling ops on CPU that read the same operands into multi-output "
+      "fusions."));
   flag_list->push_back(tsl::Flag(
       "xla_gpu_enable_fast_min_max",
       bool_setter_for(&DebugOptions::set_xla_gpu_enable_fast_min_max),
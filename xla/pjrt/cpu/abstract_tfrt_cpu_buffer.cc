@@ -133,12 +133,15 @@ ShapedBuffer AsShapedBuffer(
 
 }  //  namespace
 
-UnpinnedHostMemorySpace::UnpinnedHostMemorySpace(int id, PjRtClient* client)
-    : id_(id), client_(client) {
-  debug_string_ = absl::StrFormat(
-      "UnpinnedHostMemorySpace(id=%i, process_index=%i, client=%s)", id_,
-      client_->process_index(), client_->platform_name());
-  to_string_ = absl::StrFormat("UNPINNED_HOST_%i", id_);
+CpuMemorySpace::CpuMemorySpace(int id, PjRtClient* client,
+                               absl::string_view kind,
+                               absl::string_view class_name,
+                               absl::string_view prefix)
+    : id_(id), client_(client), kind_(kind) {
+  debug_string_ = absl::StrFormat("%s(id=%i, process_index=%i, client=%s)",
+                                  class_name, id_, client_->process_index(),
+                                  client_->platform_name());
+  to_string_ = absl::StrFormat("%s_%i", prefix, id_);
 }
 
 AbstractTfrtCpuBuffer::AbstractTfrtCpuBuffer(
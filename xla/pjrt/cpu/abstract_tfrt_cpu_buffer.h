@@ -90,12 +90,12 @@ class AsyncWorkRunner {
       absl::AnyInvocable<void()> work) = 0;
 };
 
-// Represents the unpinned host memory accessible to a PjRtDevice.
-class UnpinnedHostMemorySpace : public PjRtMemorySpace {
+// A memory space of CPU devices. All of them are backed by host memory; they
+// only differ in how frameworks and programs treat the arrays they hold.
+class CpuMemorySpace : public PjRtMemorySpace {
  public:
-  static constexpr absl::string_view kMemorySpaceKind = "unpinned_host";
-
-  UnpinnedHostMemorySpace(int id, PjRtClient* client);
+  CpuMemorySpace(int id, PjRtClient* client, absl::string_view kind,
+                 absl::string_view class_name, absl::string_view prefix);
 
   PjRtClient* client() const override { return client_; }
 
@@ -103,9 +103,7 @@ class UnpinnedHostMemorySpace : public PjRtMemorySpace {
 
   int id() const override { return id_; }
 
-  absl::string_view memory_space_kind() const override {
-    return kMemorySpaceKind;
-  }
+  absl::string_view memory_space_kind() const override { return kind_; }
 
   absl::string_view DebugString() const override { return debug_string_; }
 
@@ -116,11 +114,43 @@ class UnpinnedHostMemorySpace : public PjRtMemorySpace {
  private:
   int id_;
   PjRtClient* client_;
+  absl::string_view kind_;
   std::vector<PjRtDevice*> devices_;
   std::string debug_string_;
   std::string to_string_;
 };
 
+// Represents the memory that programs of a PjRtDevice run on.
+class CpuDeviceMemorySpace : public CpuMemorySpace {
+ public:
+  static constexpr absl::string_view kMemorySpaceKind = "device";
+
+  CpuDeviceMemorySpace(int id, PjRtClient* client)
+      : CpuMemorySpace(id, client, kMemorySpaceKind, "CpuDeviceMemorySpace",
+                       "CPU_DEVICE") {}
+};
+
+// Represents the pinned host memory accessible to a PjRtDevice, which holds
+// the arrays that programs offload to Layout::kHostMemorySpace.
+class PinnedHostMemorySpace : public CpuMemorySpace {
+ public:
+  static constexpr absl::string_view kMemorySpaceKind = "pinned_host";
+
+  PinnedHostMemorySpace(int id, PjRtClient* client)
+      : CpuMemorySpace(id, client, kMemorySpaceKind, "PinnedHostMemorySpace",
+                       "PINNED_HOST") {}
+};
+
+// Represents the unpinned host memory accessible to a PjRtDevice.
+class UnpinnedHostMemorySpace : public CpuMemorySpace {
+ public:
+  static constexpr absl::string_view kMemorySpaceKind = "unpinned_host";
+
+  UnpinnedHostMemorySpace(int id, PjRtClient* client)
+      : CpuMemorySpace(id, client, kMemorySpaceKind, "UnpinnedHostMemorySpace",
+                       "UNPINNED_HOST") {}
+};
+
 class AbstractTfrtCpuBuffer : public PjRtBuffer {
  public:
   AbstractTfrtCpuBuffer(
@@ -0,0 +1,171 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/pjrt/cpu/cpu_buffer_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/log/check.h"
+#include "absl/numeric/bits.h"
+#include "absl/synchronization/mutex.h"
+#include "xla/cpu_function_runtime.h"
+#include "xla/pjrt/metrics.h"
+#include "xla/util.h"
+#include "tsl/platform/mem.h"
+
+namespace xla {
+
+// Smallest size class; also the granularity of small allocations.
+static constexpr size_t kMinSizeClass = 64;
+
+bool CpuBufferPoolBudget::TryReserve(size_t size) {
+  size_t retained = retained_bytes_.load();
+  do {
+    if (retained + size > max_retained_bytes_) return false;
+  } while (!retained_bytes_.compare_exchange_weak(retained, retained + size));
+  return true;
+}
+
+void CpuBufferPoolBudget::Release(size_t size) { retained_bytes_ -= size; }
+
+std::shared_ptr<CpuBufferPool> CpuBufferPool::Create(
+    std::string name, size_t max_pooled_size, size_t max_retained_bytes,
+    std::shared_ptr<CpuBufferPoolBudget> budget) {
+  return std::shared_ptr<CpuBufferPool>(new CpuBufferPool(
+      std::move(name), max_pooled_size, max_retained_bytes, std::move(budget)));
+}
+
+CpuBufferPool::CpuBufferPool(std::string name, size_t max_pooled_size,
+                             size_t max_retained_bytes,
+                             std::shared_ptr<CpuBufferPoolBudget> budget)
+    : name_(std::move(name)),
+      max_pooled_size_(max_pooled_size),
+      max_retained_bytes_(max_retained_bytes),
+      budget_(std::move(budget)) {}
+
+CpuBufferPool::~CpuBufferPool() {
+  absl::MutexLock lock(&mu_);
+  if (budget_ != nullptr) budget_->Release(retained_bytes_);
+  metrics::UpdateCpuBufferPoolRetainedBytes(
+      name_, -static_cast<int64_t>(retained_bytes_));
+}
+
+size_t CpuBufferPool::SizeClass(size_t size) {
+  if (size <= kMinSizeClass) return kMinSizeClass;
+  // With size - 1 in [2^k, 2^(k+1)), rounding to a multiple of 2^(k-2) yields
+  // four classes per power of two.
+  size_t step = size_t{1} << (absl::bit_width(size - 1) - 3);
+  return (size + step - 1) & ~(step - 1);
+}
+
+StatusOr<std::shared_ptr<MaybeOwningCpuMemory>> CpuBufferPool::Allocate(
+    size_t size) {
+  if (size == 0 || size > max_pooled_size_ || max_retained_bytes_ == 0) {
+    return MaybeOwningCpuMemory::AllocateShared(size);
+  }
+
+  size_t size_class = SizeClass(size);
+  MaybeOwningCpuMemory::OwnedDataPtr data{nullptr, tsl::port::AlignedFree};
+  {
+    absl::MutexLock lock(&mu_);
+    auto it = free_buffers_.find(size_class);
+    if (it != free_buffers_.end() && !it->second.empty()) {
+      data = std::move(it->second.back());
+      it->second.pop_back();
+      retained_bytes_ -= size_class;
+      if (budget_ != nullptr) budget_->Release(size_class);
+    }
+  }
+
+  metrics::RecordCpuBufferPoolAllocation(name_, /*hit=*/data != nullptr);
+  if (data != nullptr) {
+    metrics::UpdateCpuBufferPoolRetainedBytes(
+        name_, -static_cast<int64_t>(size_class));
+  } else {
+    data.reset(static_cast<uint8_t*>(tsl::port::AlignedMalloc(
+        size_class, cpu_function_runtime::MinAlign())));
+    if (data == nullptr) {
+      return ResourceExhausted("Out of memory allocating %d bytes.",
+                               size_class);
+    }
+  }
+
+  return std::shared_ptr<MaybeOwningCpuMemory>(
+      new MaybeOwningCpuMemory(std::move(data), size),
+      [pool = shared_from_this(), size_class](MaybeOwningCpuMemory* memory) {
+        pool->Release(memory->ReleaseOwnedData(), size_class);
+        delete memory;
+      });
+}
+
+void CpuBufferPool::Release(MaybeOwningCpuMemory::OwnedDataPtr data,
+                            size_t size_class) {
+  {
+    absl::MutexLock lock(&mu_);
+    if (retained_bytes_ + size_class > max_retained_bytes_) return;
+    if (budget_ != nullptr && !budget_->TryReserve(size_class)) return;
+    free_buffers_[size_class].push_back(std::move(data));
+    retained_bytes_ += size_class;
+  }
+  metrics::UpdateCpuBufferPoolRetainedBytes(name_, size_class);
+}
+
+size_t CpuBufferPool::retained_bytes() const {
+  absl::MutexLock lock(&mu_);
+  return retained_bytes_;
+}
+
+CpuTempArena::CpuTempArena(const BufferAssignment& assignment,
+                           int max_retained_slabs,
+                           std::shared_ptr<CpuBufferPoolBudget> budget)
+    : offsets_(assignment.Allocations().size(), -1),
+      sizes_(assignment.Allocations().size(), 0) {
+  for (const BufferAllocation& allocation : assignment.Allocations()) {
+    if (!IsTempAllocation(allocation)) continue;
+    offsets_[allocation.index()] = slab_size_;
+    sizes_[allocation.index()] = allocation.size();
+    slab_size_ += RoundUpTo<size_t>(allocation.size(),
+                                    cpu_function_runtime::Align());
+  }
+  pool_ = CpuBufferPool::Create(
+      "temp", /*max_pooled_size=*/slab_size_,
+      /*max_retained_bytes=*/CpuBufferPool::SizeClass(slab_size_) *
+          max_retained_slabs,
+      std::move(budget));
+}
+
+bool CpuTempArena::IsTempAllocation(const BufferAllocation& allocation) {
+  return !allocation.is_entry_computation_parameter() &&
+         !allocation.is_constant() && !allocation.is_thread_local() &&
+         !allocation.maybe_live_out() && allocation.size() > 0;
+}
+
+StatusOr<std::shared_ptr<MaybeOwningCpuMemory>> CpuTempArena::AcquireSlab() {
+  return pool_->Allocate(slab_size_);
+}
+
+std::shared_ptr<MaybeOwningCpuMemory> CpuTempArena::Slice(
+    const MaybeOwningCpuMemory& slab, BufferAllocation::Index index) const {
+  DCHECK_GE(offsets_[index], 0) << "Allocation " << index << " is not a temp";
+  return std::make_shared<MaybeOwningCpuMemory>(
+      static_cast<uint8_t*>(slab.data()) + offsets_[index], sizes_[index]);
+}
+
+}  // namespace xla
@@ -0,0 +1,141 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_PJRT_CPU_CPU_BUFFER_POOL_H_
+#define XLA_PJRT_CPU_CPU_BUFFER_POOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "xla/pjrt/cpu/tracked_tfrt_cpu_device_buffer.h"
+#include "xla/service/buffer_assignment.h"
+#include "xla/statusor.h"
+
+namespace xla {
+
+// Bounds the free memory retained by a group of CpuBufferPools, e.g. all pools
+// of one client, on top of their own limits. This class is thread-safe.
+class CpuBufferPoolBudget {
+ public:
+  explicit CpuBufferPoolBudget(size_t max_retained_bytes)
+      : max_retained_bytes_(max_retained_bytes) {}
+
+  // Accounts `size` more retained bytes; returns false without accounting
+  // them if that would exceed the budget.
+  bool TryReserve(size_t size);
+
+  // Accounts `size` fewer retained bytes.
+  void Release(size_t size);
+
+  // Number of bytes retained by all pools sharing the budget.
+  size_t retained_bytes() const { return retained_bytes_.load(); }
+
+ private:
+  const size_t max_retained_bytes_;
+  std::atomic<size_t> retained_bytes_{0};
+};
+
+// A pool of owning CPU buffers bucketed by size class. Buffers returned by
+// Allocate() hand their memory back to the pool when the last reference to
+// them is dropped, so that buffers allocated on every execution don't go
+// through the allocator and fault in fresh pages on every call.
+//
+// Hits, misses and retained bytes are reported through xla/pjrt/metrics.h
+// under the pool's `name`. This class is thread-safe; outstanding buffers keep
+// the pool alive.
+class CpuBufferPool : public std::enable_shared_from_this<CpuBufferPool> {
+ public:
+  // Requests larger than `max_pooled_size` bytes bypass the pool. At most
+  // `max_retained_bytes` of free memory is kept for reuse, and no more than
+  // `budget` allows if set; memory returned beyond that is freed.
+  static std::shared_ptr<CpuBufferPool> Create(
+      std::string name, size_t max_pooled_size, size_t max_retained_bytes,
+      std::shared_ptr<CpuBufferPoolBudget> budget = nullptr);
+
+  ~CpuBufferPool();
+
+  // Returns an owning buffer of exactly `size` bytes, whose backing memory may
+  // be reused from a previously released buffer of the same size class.
+  StatusOr<std::shared_ptr<MaybeOwningCpuMemory>> Allocate(size_t size);
+
+  // Number of bytes of free memory currently kept for reuse.
+  size_t retained_bytes() const;
+
+  // Rounds `size` up to its size class. There are four size classes per power
+  // of two, which bounds the memory wasted by rounding to 25%.
+  static size_t SizeClass(size_t size);
+
+ private:
+  CpuBufferPool(std::string name, size_t max_pooled_size,
+                size_t max_retained_bytes,
+                std::shared_ptr<CpuBufferPoolBudget> budget);
+
+  void Release(MaybeOwningCpuMemory::OwnedDataPtr data, size_t size_class);
+
+  const std::string name_;
+  const size_t max_pooled_size_;
+  const size_t max_retained_bytes_;
+  const std::shared_ptr<CpuBufferPoolBudget> budget_;
+
+  mutable absl::Mutex mu_;
+  absl::flat_hash_map<size_t, std::vector<MaybeOwningCpuMemory::OwnedDataPtr>>
+      free_buffers_ ABSL_GUARDED_BY(mu_);
+  size_t retained_bytes_ ABSL_GUARDED_BY(mu_) = 0;
+};
+
+// Reusable memory for the temporary allocations of a BufferAssignment. All
+// temporaries of one run are carved out of a single slab, and slabs are
+// recycled once the run no longer references them.
+class CpuTempArena {
+ public:
+  // Keeps up to `max_retained_slabs` free slabs for reuse, within `budget`
+  // if set.
+  CpuTempArena(const BufferAssignment& assignment, int max_retained_slabs,
+               std::shared_ptr<CpuBufferPoolBudget> budget = nullptr);
+
+  // Whether `allocation` is served from the arena: i.e. it is neither an
+  // entry parameter, a constant, thread-local nor live out of the
+  // computation.
+  static bool IsTempAllocation(const BufferAllocation& allocation);
+
+  // Size of a slab holding all temporaries; zero if there are none.
+  size_t slab_size() const { return slab_size_; }
+
+  // Acquires a slab holding all temporary allocations. The slab must be kept
+  // alive for as long as the buffers returned by Slice() are in use.
+  StatusOr<std::shared_ptr<MaybeOwningCpuMemory>> AcquireSlab();
+
+  // Returns a non-owning view of temporary allocation `index` within `slab`.
+  std::shared_ptr<MaybeOwningCpuMemory> Slice(
+      const MaybeOwningCpuMemory& slab, BufferAllocation::Index index) const;
+
+ private:
+  // Offset of each allocation within a slab, or -1 if it is not a temporary.
+  std::vector<int64_t> offsets_;
+  std::vector<int64_t> sizes_;
+  size_t slab_size_ = 0;
+  std::shared_ptr<CpuBufferPool> pool_;
+};
+
+}  // namespace xla
+
+#endif  // XLA_PJRT_CPU_CPU_BUFFER_POOL_H_
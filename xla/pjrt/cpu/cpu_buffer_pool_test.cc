@@ -0,0 +1,122 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/pjrt/cpu/cpu_buffer_pool.h"
+
+#include <cstdint>
+#include <memory>
+
+#include <gtest/gtest.h>
+#include "xla/pjrt/cpu/tracked_tfrt_cpu_device_buffer.h"
+#include "xla/pjrt/metrics.h"
+#include "tsl/platform/statusor.h"
+
+namespace xla {
+namespace {
+
+TEST(CpuBufferPoolTest, SizeClasses) {
+  EXPECT_EQ(CpuBufferPool::SizeClass(1), 64);
+  EXPECT_EQ(CpuBufferPool::SizeClass(64), 64);
+  EXPECT_EQ(CpuBufferPool::SizeClass(65), 80);
+  EXPECT_EQ(CpuBufferPool::SizeClass(128), 128);
+  EXPECT_EQ(CpuBufferPool::SizeClass(129), 160);
+  EXPECT_EQ(CpuBufferPool::SizeClass(1000), 1024);
+  EXPECT_EQ(CpuBufferPool::SizeClass(1025), 1280);
+  EXPECT_EQ(CpuBufferPool::SizeClass(4096), 4096);
+}
+
+TEST(CpuBufferPoolTest, ReusesReleasedBuffers) {
+  auto pool = CpuBufferPool::Create("test_reuse", /*max_pooled_size=*/1 << 20,
+                                    /*max_retained_bytes=*/1 << 20);
+  int64_t hits = metrics::GetCpuBufferPoolHits("test_reuse");
+  int64_t misses = metrics::GetCpuBufferPoolMisses("test_reuse");
+
+  TF_ASSERT_OK_AND_ASSIGN(auto buffer, pool->Allocate(1000));
+  EXPECT_EQ(buffer->size(), 1000);
+  EXPECT_TRUE(buffer->owns_data());
+  void* data = buffer->data();
+  buffer.reset();
+  EXPECT_EQ(pool->retained_bytes(), 1024);
+  EXPECT_EQ(metrics::GetCpuBufferPoolRetainedBytes("test_reuse"), 1024);
+
+  // Same size class, different size.
+  TF_ASSERT_OK_AND_ASSIGN(buffer, pool->Allocate(900));
+  EXPECT_EQ(buffer->size(), 900);
+  EXPECT_EQ(buffer->data(), data);
+  EXPECT_EQ(pool->retained_bytes(), 0);
+  EXPECT_EQ(metrics::GetCpuBufferPoolHits("test_reuse"), hits + 1);
+  EXPECT_EQ(metrics::GetCpuBufferPoolMisses("test_reuse"), misses + 1);
+
+  // Different size class.
+  TF_ASSERT_OK_AND_ASSIGN(auto other, pool->Allocate(2000));
+  EXPECT_EQ(metrics::GetCpuBufferPoolMisses("test_reuse"), misses + 2);
+}
+
+TEST(CpuBufferPoolTest, RespectsRetentionLimit) {
+  auto pool = CpuBufferPool::Create("test_limit", /*max_pooled_size=*/4096,
+                                    /*max_retained_bytes=*/4096);
+  TF_ASSERT_OK_AND_ASSIGN(auto a, pool->Allocate(4096));
+  TF_ASSERT_OK_AND_ASSIGN(auto b, pool->Allocate(4096));
+  a.reset();
+  b.reset();
+  EXPECT_EQ(pool->retained_bytes(), 4096);
+
+  // Too large to be pooled.
+  TF_ASSERT_OK_AND_ASSIGN(auto c, pool->Allocate(8192));
+  c.reset();
+  EXPECT_EQ(pool->retained_bytes(), 4096);
+
+  pool.reset();
+  EXPECT_EQ(metrics::GetCpuBufferPoolRetainedBytes("test_limit"), 0);
+}
+
+TEST(CpuBufferPoolTest, PoolsShareBudget) {
+  auto budget =
+      std::make_shared<CpuBufferPoolBudget>(/*max_retained_bytes=*/4096);
+  auto a = CpuBufferPool::Create("test_budget_a", /*max_pooled_size=*/4096,
+                                 /*max_retained_bytes=*/4096, budget);
+  auto b = CpuBufferPool::Create("test_budget_b", /*max_pooled_size=*/4096,
+                                 /*max_retained_bytes=*/4096, budget);
+  TF_ASSERT_OK_AND_ASSIGN(auto from_a, a->Allocate(3000));
+  TF_ASSERT_OK_AND_ASSIGN(auto from_b, b->Allocate(3000));
+  from_a.reset();
+  EXPECT_EQ(a->retained_bytes(), 3072);
+  EXPECT_EQ(budget->retained_bytes(), 3072);
+
+  // Within the limit of `b` but not of the budget, so it is freed.
+  from_b.reset();
+  EXPECT_EQ(b->retained_bytes(), 0);
+  EXPECT_EQ(budget->retained_bytes(), 3072);
+
+  // Reusing a buffer or destroying the pool returns its bytes to the budget.
+  TF_ASSERT_OK_AND_ASSIGN(from_a, a->Allocate(3000));
+  EXPECT_EQ(budget->retained_bytes(), 0);
+  from_a.reset();
+  a.reset();
+  EXPECT_EQ(budget->retained_bytes(), 0);
+}
+
+TEST(CpuBufferPoolTest, BuffersOutliveThePool) {
+  auto pool = CpuBufferPool::Create("test_lifetime", /*max_pooled_size=*/4096,
+                                    /*max_retained_bytes=*/4096);
+  TF_ASSERT_OK_AND_ASSIGN(auto buffer, pool->Allocate(100));
+  pool.reset();
+  static_cast<uint8_t*>(buffer->data())[99] = 42;
+  buffer.reset();
+  EXPECT_EQ(metrics::GetCpuBufferPoolRetainedBytes("test_lifetime"), 0);
+}
+
+}  // namespace
+}  // namespace xla
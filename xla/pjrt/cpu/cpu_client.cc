@@ -53,13 +53,18 @@ limitations under the License.
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_instruction.h"
 #include "xla/hlo/ir/hlo_module.h"
+#include "xla/hlo/ir/hlo_module_group.h"
+#include "xla/hlo/utils/hlo_query.h"
+#include "xla/layout.h"
 #include "xla/layout_util.h"
 #include "xla/literal.h"
 #include "xla/literal_util.h"
 #include "xla/pjrt/compile_options.pb.h"
 #include "xla/pjrt/cpu/abstract_tfrt_cpu_buffer.h"
+#include "xla/pjrt/cpu/cpu_buffer_pool.h"
 #include "xla/pjrt/cpu/tracked_tfrt_cpu_device_buffer.h"
 #include "xla/pjrt/distributed/topology_util.h"
+#include "xla/pjrt/metrics.h"
 #include "xla/pjrt/mlir_to_hlo.h"
 #include "xla/pjrt/pjrt_client.h"
 #include "xla/pjrt/pjrt_executable.h"
@@ -74,6 +79,7 @@ limitations under the License.
 #include "xla/service/cpu/buffer_desc.h"
 #include "xla/service/cpu/cpu_compiler.h"
 #include "xla/service/cpu/cpu_executable.h"
+#include "xla/service/cpu/cpu_executable_run_options.h"
 #include "xla/service/cpu/cpu_xfeed.h"
 #include "xla/service/custom_call_status.h"
 #include "xla/service/dump.h"
@@ -93,13 +99,18 @@ limitations under the License.
 #include "tsl/concurrency/async_value.h"
 #include "tsl/concurrency/async_value_ref.h"
 #include "tsl/concurrency/ref_count.h"
+#include "tsl/lib/strings/proto_serialization.h"
 #include "tsl/platform/casts.h"
+#include "tsl/platform/cpu_info.h"
 #include "tsl/platform/denormal.h"
 #include "tsl/platform/env.h"
 #include "tsl/platform/errors.h"
+#include "tsl/platform/fingerprint.h"
+#include "tsl/platform/numa.h"
 #include "tsl/platform/setround.h"
 #include "tsl/platform/statusor.h"
 #include "tsl/platform/threadpool.h"
+#include "tsl/platform/unbounded_work_queue.h"
 #include "tsl/profiler/lib/connected_traceme.h"
 #include "tsl/profiler/lib/context_types.h"
 #include "tsl/profiler/lib/traceme.h"
@@ -109,29 +120,75 @@ namespace {
 
 using ::xla::runtime::CpuEvent;
 
+// Returns the kind of the memory space that programs keep arrays of `shape`
+// in.
+absl::string_view MemoryKindOfShape(const Shape& shape) {
+  if (shape.has_layout() &&
+      shape.layout().memory_space() == Layout::kHostMemorySpace) {
+    return PinnedHostMemorySpace::kMemorySpaceKind;
+  }
+  return CpuDeviceMemorySpace::kMemorySpaceKind;
+}
+
+// Returns `shape` with the layouts of its arrays in the memory space that
+// programs use for arrays in `memory_space`.
+Shape ShapeInMemorySpace(Shape shape, const PjRtMemorySpace* memory_space) {
+  const int64_t layout_memory_space =
+      memory_space->memory_space_kind() ==
+              CpuDeviceMemorySpace::kMemorySpaceKind
+          ? Layout::kDefaultMemorySpace
+          : Layout::kHostMemorySpace;
+  ShapeUtil::ForEachMutableSubshape(
+      &shape, [&](Shape* subshape, const ShapeIndex& index) {
+        if (subshape->IsArray() && subshape->has_layout()) {
+          subshape->mutable_layout()->set_memory_space(layout_memory_space);
+        }
+      });
+  return shape;
+}
+
+// Returns the device that `memory_space` of `client` is attached to.
+StatusOr<TfrtCpuDevice*> DeviceOfMemorySpace(PjRtMemorySpace* memory_space,
+                                             const TfrtCpuClient* client) {
+  if (memory_space->client() != client) {
+    return InvalidArgument("Memory space %s does not belong to this client",
+                           memory_space->DebugString());
+  }
+  if (memory_space->devices().size() != 1) {
+    return InvalidArgument(
+        "Memory space %s must be attached to exactly one device, but is "
+        "attached to %d",
+        memory_space->DebugString(), memory_space->devices().size());
+  }
+  return tensorflow::down_cast<TfrtCpuDevice*>(memory_space->devices()[0]);
+}
+
 StatusOr<std::unique_ptr<TfrtCpuBuffer>> AllocateDestinationBuffer(
     const Shape& on_device_shape,
     absl::InlinedVector<tsl::AsyncValueRef<CpuEvent>, 4> definition_events,
-    TfrtCpuDevice* device, TfrtCpuClient* client) {
+    TfrtCpuDevice* device, TfrtCpuClient* client,
+    PjRtMemorySpace* memory_space = nullptr) {
   TF_ASSIGN_OR_RETURN(
       std::unique_ptr<TrackedTfrtCpuDeviceBuffer> tracked_device_buffer,
       AbstractTfrtCpuBuffer::AllocateTrackedDeviceBuffer(
           on_device_shape, std::move(definition_events)));
-  return std::make_unique<TfrtCpuBuffer>(
-      on_device_shape, std::move(tracked_device_buffer), client, device);
+  return std::make_unique<TfrtCpuBuffer>(on_device_shape,
+                                         std::move(tracked_device_buffer),
+                                         client, device, memory_space);
 }
 
 StatusOr<std::unique_ptr<TfrtCpuBuffer>> AllocateDestinationBufferAndAvs(
     const Shape& shape,
     absl::InlinedVector<tsl::RCReference<tsl::AsyncValue>, 4>* avs,
-    TfrtCpuDevice* device, TfrtCpuClient* client) {
+    TfrtCpuDevice* device, TfrtCpuClient* client,
+    PjRtMemorySpace* memory_space = nullptr) {
   // Add a placeholder definition event for each leaf buffer when creating the
   // buffer.
   absl::InlinedVector<tsl::AsyncValueRef<CpuEvent>, 4> definition_events;
   AbstractTfrtCpuBuffer::AllocateAvsAndEvents(shape, avs, &definition_events);
   return AllocateDestinationBuffer(
       shape, std::move(definition_events),
-      tensorflow::down_cast<TfrtCpuDevice*>(device), client);
+      tensorflow::down_cast<TfrtCpuDevice*>(device), client, memory_space);
 }
 
 const char kCpuPlatformName[] = "cpu";
@@ -146,10 +203,18 @@ void EnqueueWork(tsl::thread::ThreadPool* pool,
   });
 }
 
-// Enqueue to PjRtClient pool when all `values` are ready.
+void EnqueueWork(tsl::UnboundedWorkQueue* queue,
+                 absl::AnyInvocable<void()> callee) {
+  queue->Schedule([ptr = new absl::AnyInvocable<void()>(std::move(callee))]() {
+    (*ptr)();
+    delete ptr;
+  });
+}
+
+// Enqueue to `pool` when all `values` are ready.
+template <typename Pool>
 void EnqueueWorkWhenReady(
-    tsl::thread::ThreadPool* pool,
-    absl::Span<const tsl::RCReference<tsl::AsyncValue>> values,
+    Pool* pool, absl::Span<const tsl::RCReference<tsl::AsyncValue>> values,
     absl::AnyInvocable<void()> callee) {
   RunWhenReady(values, [pool, callee = std::move(callee)]() mutable {
     EnqueueWork(pool, std::move(callee));
@@ -180,7 +245,7 @@ class TfrtCpuAsyncHostToDeviceTransferManager
  public:
   static StatusOr<std::unique_ptr<TfrtCpuAsyncHostToDeviceTransferManager>>
   Create(absl::Span<const Shape> shapes, TfrtCpuDevice* device,
-         TfrtCpuClient* client) {
+         TfrtCpuClient* client, PjRtMemorySpace* memory_space = nullptr) {
     absl::InlinedVector<std::unique_ptr<AbstractTfrtCpuBuffer>, 4> buffers;
     buffers.reserve(shapes.size());
     absl::InlinedVector<tsl::RCReference<tsl::AsyncValue>, 4> avs;
@@ -192,8 +257,9 @@ class TfrtCpuAsyncHostToDeviceTransferManager
             "TfrtCpuAsyncHostToDeviceTransferManager");
       }
       absl::InlinedVector<tsl::RCReference<tsl::AsyncValue>, 4> local_avs;
-      TF_ASSIGN_OR_RETURN(auto buffer, AllocateDestinationBufferAndAvs(
-                                           shape, &local_avs, device, client));
+      TF_ASSIGN_OR_RETURN(
+          auto buffer, AllocateDestinationBufferAndAvs(
+                           shape, &local_avs, device, client, memory_space));
       CHECK_EQ(local_avs.size(), 1);
       avs.push_back(std::move(local_avs[0]));
       buffers.push_back(std::move(buffer));
@@ -212,7 +278,7 @@ class TfrtCpuAsyncHostToDeviceTransferManager
     return absl::WrapUnique(new TfrtCpuAsyncHostToDeviceTransferManager(
         std::move(avs), std::move(buffers), std::move(device_buffers),
         std::move(buffer_sizes), std::move(buffer_transfers_in_flight),
-        std::move(last_transfer_finished), client->async_work_runner(),
+        std::move(last_transfer_finished), client->async_work_runner(*device),
         device));
   }
 
@@ -236,15 +302,40 @@ class TfrtCpuAsyncHostToDeviceTransferManager
   TfrtCpuDevice* device_;
 };
 
+// Binds the calling thread to a NUMA node and restores the thread's previous
+// affinity when it goes out of scope, so that a pool thread shared by devices
+// of different nodes is not left bound to the node of its last task.
+class ScopedNUMAThreadNodeAffinity {
+ public:
+  explicit ScopedNUMAThreadNodeAffinity(int node)
+      : previous_node_(tsl::port::NUMAGetThreadNodeAffinity()) {
+    tsl::port::NUMASetThreadNodeAffinity(node);
+  }
+  ~ScopedNUMAThreadNodeAffinity() {
+    tsl::port::NUMASetThreadNodeAffinity(previous_node_);
+  }
+
+  ScopedNUMAThreadNodeAffinity(const ScopedNUMAThreadNodeAffinity&) = delete;
+  ScopedNUMAThreadNodeAffinity& operator=(
+      const ScopedNUMAThreadNodeAffinity&) = delete;
+
+ private:
+  const int previous_node_;
+};
+
 }  // namespace
 
 TfrtCpuDeviceDescription::TfrtCpuDeviceDescription(int id, int process_index,
-                                                   int local_hardware_id)
+                                                   int local_hardware_id,
+                                                   int numa_node)
     : id_(id),
       process_index_(process_index),
       local_hardware_id_(local_hardware_id) {
   debug_string_ = absl::StrCat("TFRT_CPU_", id);
   to_string_ = absl::StrCat("CpuDevice(id=", id, ")");
+  if (numa_node != tsl::port::kNUMANoAffinity) {
+    attributes_["numa_node"] = static_cast<int64_t>(numa_node);
+  }
 }
 
 absl::string_view TfrtCpuDeviceDescription::device_kind() const {
@@ -260,8 +351,9 @@ absl::string_view TfrtCpuDeviceDescription::ToString() const {
 }
 
 TfrtCpuDevice::TfrtCpuDevice(int id, int process_index, int local_hardware_id,
-                             int max_inflight_computations)
-    : description_(id, process_index, local_hardware_id),
+                             int max_inflight_computations, int numa_node)
+    : description_(id, process_index, local_hardware_id, numa_node),
+      numa_node_(numa_node),
       max_inflight_computations_semaphore_(
           /*capacity=*/max_inflight_computations) {}
 
@@ -274,11 +366,26 @@ Status TfrtCpuDevice::TransferFromOutfeed(MutableBorrowingLiteral literal) {
 }
 
 absl::Span<PjRtMemorySpace* const> TfrtCpuDevice::memory_spaces() const {
-  return {};
+  return memory_spaces_;
 }
 
 StatusOr<PjRtMemorySpace*> TfrtCpuDevice::default_memory_space() const {
-  return Unimplemented("default_memory_space is not supported");
+  if (memory_spaces_.empty()) {
+    return InvalidArgument("No memory spaces are attached to device %s",
+                           DebugString());
+  }
+  return memory_spaces_.front();
+}
+
+absl::StatusOr<PjRtMemorySpace*> TfrtCpuDevice::memory_space_by_kind(
+    absl::string_view memory_space_kind) const {
+  for (PjRtMemorySpace* memory_space : memory_spaces_) {
+    if (memory_space->memory_space_kind() == memory_space_kind) {
+      return memory_space;
+    }
+  }
+  return InvalidArgument("No memory space of kind %s is attached to device %s",
+                         memory_space_kind, DebugString());
 }
 
 static int CpuDeviceCount() {
@@ -316,24 +423,35 @@ StatusOr<std::unique_ptr<PjRtClient>> GetTfrtCpuClient(
                          absl::Minutes(2), absl::Minutes(5), options.kv_get,
                          options.kv_put, local_topology, &global_topology));
 
+  // Devices are bound to NUMA nodes by their ordinal, which spreads them
+  // evenly across the nodes of the host.
+  const int numa_node_count =
+      options.numa_aware && tsl::port::NUMAEnabled() ? tsl::port::NUMANumNodes()
+                                                     : 0;
   std::vector<std::unique_ptr<TfrtCpuDevice>> devices;
   for (const LocalTopologyProto& node : global_topology.nodes()) {
     for (const DeviceProto& device_proto : node.devices()) {
+      int numa_node = tsl::port::kNUMANoAffinity;
+      if (numa_node_count > 0 && node.node_id() == options.node_id) {
+        numa_node = device_proto.local_device_ordinal() % numa_node_count;
+      }
       auto device = std::make_unique<TfrtCpuDevice>(
           /*id=*/device_proto.global_device_id(), node.node_id(),
           device_proto.local_device_ordinal(),
-          options.max_inflight_computations_per_device);
+          options.max_inflight_computations_per_device, numa_node);
       devices.push_back(std::move(device));
     }
   }
 
   return std::unique_ptr<PjRtClient>(std::make_unique<TfrtCpuClient>(
-      /*process_index=*/options.node_id, std::move(devices), num_threads));
+      /*process_index=*/options.node_id, std::move(devices),
+      options.collectives, options.output_buffer_pool_bytes, num_threads));
 }
 
 TfrtCpuClient::TfrtCpuClient(
     int process_index, std::vector<std::unique_ptr<TfrtCpuDevice>> devices,
-    size_t num_threads)
+    std::shared_ptr<cpu::CollectivesInterface> collectives,
+    size_t output_buffer_pool_bytes, size_t num_threads)
     : process_index_(process_index),
       owned_devices_(std::move(devices)),
       computation_placer_(std::make_unique<ComputationPlacer>()),
@@ -341,14 +459,24 @@ TfrtCpuClient::TfrtCpuClient(
           tsl::Env::Default(), "XLATfrtCpuClient", num_threads)),
       async_work_runner_(std::make_unique<ThreadPoolAsyncWorkRunner>(
           pjrt_client_thread_pool_.get())),
+      async_execute_queue_(std::make_unique<tsl::UnboundedWorkQueue>(
+          tsl::Env::Default(), "XLATfrtCpuCollectives")),
       eigen_intraop_pool_(new tsl::thread::ThreadPool(
           tsl::Env::Default(), "XLAEigen", DefaultThreadPoolSize())),
       eigen_intraop_device_(
           new Eigen::ThreadPoolDevice(eigen_intraop_pool_->AsEigenThreadPool(),
                                       eigen_intraop_pool_->NumThreads())),
-      last_collective_launch_event_(
-          tsl::MakeAvailableAsyncValueRef<CpuEvent>()),
-      transpose_cache_(1024) {
+      transpose_cache_(1024),
+      collectives_(std::move(collectives)),
+      // Larger buffers would take up much of the budget on their own, and
+      // their allocation cost is dominated by the computation writing them.
+      buffer_pool_budget_(
+          std::make_shared<CpuBufferPoolBudget>(output_buffer_pool_bytes)),
+      output_buffer_pool_(CpuBufferPool::Create(
+          "output", /*max_pooled_size=*/output_buffer_pool_bytes / 4,
+          /*max_retained_bytes=*/output_buffer_pool_bytes,
+          buffer_pool_budget_)) {
+  cpu_run_options_.set_collectives(collectives_.get());
   for (const std::unique_ptr<TfrtCpuDevice>& device : owned_devices_) {
     devices_.push_back(device.get());
     CHECK(id_to_device_.insert({device->id(), device.get()}).second)
@@ -367,11 +495,90 @@ TfrtCpuClient::TfrtCpuClient(
   for (int idx = 0; idx < addressable_devices_.size(); ++idx) {
     CHECK(addressable_devices_[idx] != nullptr) << idx;
   }
+  for (PjRtDevice* device : addressable_devices_) {
+    auto* cpu_device = tensorflow::down_cast<TfrtCpuDevice*>(device);
+    const int first_id = owned_memory_spaces_.size();
+    owned_memory_spaces_.push_back(
+        std::make_unique<CpuDeviceMemorySpace>(first_id, this));
+    owned_memory_spaces_.push_back(
+        std::make_unique<PinnedHostMemorySpace>(first_id + 1, this));
+    owned_memory_spaces_.push_back(
+        std::make_unique<UnpinnedHostMemorySpace>(first_id + 2, this));
+    for (int i = first_id; i < owned_memory_spaces_.size(); ++i) {
+      CpuMemorySpace* memory_space = owned_memory_spaces_[i].get();
+      memory_space->AttachDevice(cpu_device);
+      cpu_device->AttachMemorySpace(memory_space);
+      memory_spaces_.push_back(memory_space);
+    }
+  }
+  for (PjRtDevice* device : addressable_devices_) {
+    const int node = tensorflow::down_cast<TfrtCpuDevice*>(device)->numa_node();
+    if (node != tsl::port::kNUMANoAffinity) {
+      numa_nodes_.try_emplace(node, nullptr);
+    }
+  }
+  for (auto& [node, numa_node] : numa_nodes_) {
+    tsl::ThreadOptions thread_options;
+    thread_options.numa_node = node;
+    const int node_threads = std::max(1, tsl::port::MaxParallelism(node));
+    numa_node = std::make_unique<NumaNode>();
+    numa_node->thread_pool = std::make_unique<tsl::thread::ThreadPool>(
+        tsl::Env::Default(), thread_options,
+        absl::StrCat("XLATfrtCpuClientNuma", node),
+        std::max<int>(node_threads, num_threads / numa_nodes_.size()));
+    numa_node->async_work_runner = std::make_unique<ThreadPoolAsyncWorkRunner>(
+        numa_node->thread_pool.get());
+    numa_node->eigen_intraop_pool = std::make_unique<tsl::thread::ThreadPool>(
+        tsl::Env::Default(), thread_options, absl::StrCat("XLAEigenNuma", node),
+        node_threads);
+    numa_node->eigen_intraop_device = std::make_unique<Eigen::ThreadPoolDevice>(
+        numa_node->eigen_intraop_pool->AsEigenThreadPool(),
+        numa_node->eigen_intraop_pool->NumThreads());
+    // The nodes share the budget of the output buffer pool.
+    const size_t pool_bytes = output_buffer_pool_bytes / numa_nodes_.size();
+    numa_node->output_buffer_pool = CpuBufferPool::Create(
+        absl::StrCat("output_numa", node), /*max_pooled_size=*/pool_bytes / 4,
+        /*max_retained_bytes=*/pool_bytes, buffer_pool_budget_);
+    LOG(INFO) << "TfrtCpuClient bound devices to NUMA node " << node << " with "
+              << node_threads << " intra-op threads.";
+  }
   LOG(INFO) << "TfrtCpuClient created.";
 }
 
 TfrtCpuClient::~TfrtCpuClient() { LOG(INFO) << "TfrtCpuClient destroyed."; }
 
+const TfrtCpuClient::NumaNode* TfrtCpuClient::GetNumaNode(
+    const TfrtCpuDevice& device) const {
+  if (device.numa_node() == tsl::port::kNUMANoAffinity) return nullptr;
+  auto it = numa_nodes_.find(device.numa_node());
+  return it == numa_nodes_.end() ? nullptr : it->second.get();
+}
+
+tsl::thread::ThreadPool* TfrtCpuClient::pjrt_client_thread_pool(
+    const TfrtCpuDevice& device) const {
+  const NumaNode* numa_node = GetNumaNode(device);
+  return numa_node ? numa_node->thread_pool.get() : pjrt_client_thread_pool();
+}
+
+AsyncWorkRunner* TfrtCpuClient::async_work_runner(
+    const TfrtCpuDevice& device) const {
+  const NumaNode* numa_node = GetNumaNode(device);
+  return numa_node ? numa_node->async_work_runner.get() : async_work_runner();
+}
+
+Eigen::ThreadPoolDevice* TfrtCpuClient::eigen_intraop_device(
+    const TfrtCpuDevice& device) const {
+  const NumaNode* numa_node = GetNumaNode(device);
+  return numa_node ? numa_node->eigen_intraop_device.get()
+                   : eigen_intraop_device();
+}
+
+CpuBufferPool& TfrtCpuClient::output_buffer_pool(
+    const TfrtCpuDevice& device) const {
+  const NumaNode* numa_node = GetNumaNode(device);
+  return numa_node ? *numa_node->output_buffer_pool : output_buffer_pool();
+}
+
 StatusOr<PjRtDevice*> TfrtCpuClient::LookupDevice(int device_id) const {
   auto it = id_to_device_.find(device_id);
   if (it != id_to_device_.end()) {
@@ -393,7 +600,7 @@ StatusOr<PjRtDevice*> TfrtCpuClient::LookupAddressableDevice(
 }
 
 absl::Span<PjRtMemorySpace* const> TfrtCpuClient::memory_spaces() const {
-  return {};
+  return memory_spaces_;
 }
 
 StatusOr<DeviceAssignment> TfrtCpuClient::GetDefaultDeviceAssignment(
@@ -473,6 +680,52 @@ StatusOr<std::string> TfrtCpuExecutable::SerializeExecutable() const {
   return proto.SerializeAsString();
 }
 
+static std::string FingerprintToString(tsl::Fprint128 fingerprint) {
+  return absl::StrCat(absl::Hex(fingerprint.high64, absl::kZeroPad16),
+                      absl::Hex(fingerprint.low64, absl::kZeroPad16));
+}
+
+StatusOr<std::string> TfrtCpuExecutable::FingerprintExecutable() const {
+  // Print constants and backend configs, which the compiled code depends on,
+  // unlike the module's default fingerprint.
+  std::string module_fingerprint = cpu_executable_->module().GetFingerprint128(
+      HloPrintOptions::Canonical()
+          .set_print_large_constants(true)
+          .set_print_backend_config(true));
+  TF_ASSIGN_OR_RETURN(CompileOptionsProto compile_options,
+                      compile_options_.ToProto());
+  std::string serialized_options;
+  if (!tsl::SerializeToStringDeterministic(compile_options,
+                                           &serialized_options)) {
+    return Internal("Failed to serialize the compile options of %s", name());
+  }
+  return FingerprintToString(tsl::Fingerprint128(
+      absl::StrCat(module_fingerprint, "\n", serialized_options)));
+}
+
+std::shared_ptr<Executable> TfrtCpuClient::LookupCompiledExecutable(
+    absl::string_view key) {
+  absl::MutexLock lock(&compiled_executables_mu_);
+  auto it = compiled_executables_.find(key);
+  if (it == compiled_executables_.end()) return nullptr;
+  return it->second.lock();
+}
+
+void TfrtCpuClient::StoreCompiledExecutable(
+    std::string key, std::shared_ptr<Executable> executable) {
+  absl::MutexLock lock(&compiled_executables_mu_);
+  // Forget the executables that have been destroyed since the last store.
+  for (auto it = compiled_executables_.begin();
+       it != compiled_executables_.end();) {
+    if (it->second.expired()) {
+      compiled_executables_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+  compiled_executables_[std::move(key)] = std::move(executable);
+}
+
 StatusOr<std::unique_ptr<PjRtLoadedExecutable>>
 TfrtCpuClient::DeserializeExecutable(absl::string_view serialized,
                                      std::optional<CompileOptions> options) {
@@ -493,14 +746,19 @@ TfrtCpuClient::DeserializeExecutable(absl::string_view serialized,
                         CompileOptions::FromProto(proto.compile_options()));
   }
   auto input_options = compile_options;
-  // Load a CpuExecutable
-  cpu::CpuCompiler compiler;
+  // Load a CpuExecutable, unless one loaded from the same bytes is alive.
   std::string str = std::move(*proto.mutable_serialized_executable());
-  TF_ASSIGN_OR_RETURN(std::unique_ptr<AotCompilationResult> aot_result,
-                      compiler.LoadAotCompilationResult(str));
-  TF_ASSIGN_OR_RETURN(
-      std::unique_ptr<Executable> executable,
-      aot_result->LoadExecutable(&compiler, /*executor=*/nullptr));
+  const std::string key = absl::StrCat(
+      "serialized:", FingerprintToString(tsl::Fingerprint128(str)));
+  std::shared_ptr<Executable> executable = LookupCompiledExecutable(key);
+  if (executable == nullptr) {
+    cpu::CpuCompiler compiler;
+    TF_ASSIGN_OR_RETURN(std::unique_ptr<AotCompilationResult> aot_result,
+                        compiler.LoadAotCompilationResult(str));
+    TF_ASSIGN_OR_RETURN(executable, aot_result->LoadExecutable(
+                                        &compiler, /*executor=*/nullptr));
+    StoreCompiledExecutable(key, executable);
+  }
 
   // Set up other arguments for TfrtCpuExecutable
   // TODO(b/232263665): Remove duplicated code in DeserializeExecutable and
@@ -605,18 +863,41 @@ static StatusOr<std::unique_ptr<xla::Executable>> JitCompile(
   static constexpr char kBeforeOptimizationsDumpName[] = "before_optimizations";
   DumpHloModuleIfEnabled(*hlo_module, kBeforeOptimizationsDumpName);
 
-  // Run Hlo Passes
+  // Run Hlo Passes and the backend, unless the executable is found in the
+  // compilation cache.
   bool allow_sparse_shapes =
       hlo_module->config().debug_options().xla_cpu_use_xla_runtime();
   cpu::CpuCompiler compiler(allow_sparse_shapes);
   xla::Compiler::CompileOptions dummy;
-  TF_ASSIGN_OR_RETURN(hlo_module,
-                      compiler.RunHloPasses(std::move(hlo_module),
-                                            /*stream_exec=*/nullptr, dummy));
+  TF_ASSIGN_OR_RETURN(
+      std::vector<std::unique_ptr<Executable>> executables,
+      compiler.Compile(std::make_unique<HloModuleGroup>(std::move(hlo_module)),
+                       /*stream_execs=*/{{nullptr}}, dummy));
+  return std::move(executables[0]);
+}
 
-  // Run backend.
-  return compiler.RunBackend(std::move(hlo_module), /*stream_exec=*/nullptr,
-                             dummy);
+// Returns the key of the executable compiled from `computation`, with
+// parameters of `argument_layouts` and `execution_options`, or std::nullopt if
+// they can't be serialized, e.g. because the computation is larger than 2GB.
+static std::optional<std::string> CompiledExecutableKey(
+    const XlaComputation& computation,
+    absl::Span<const Shape* const> argument_layouts,
+    const ExecutionOptions& execution_options) {
+  std::string serialized_computation;
+  std::string serialized_options;
+  if (!tsl::SerializeToStringDeterministic(computation.proto(),
+                                           &serialized_computation) ||
+      !tsl::SerializeToStringDeterministic(execution_options,
+                                           &serialized_options)) {
+    return std::nullopt;
+  }
+  std::string key = absl::StrCat(serialized_computation, "\n",
+                                 serialized_options, "\n");
+  for (const Shape* shape : argument_layouts) {
+    absl::StrAppend(&key, shape->ToString(/*print_layout=*/true), ";");
+  }
+  return absl::StrCat("compiled:",
+                      FingerprintToString(tsl::Fingerprint128(key)));
 }
 
 StatusOr<std::unique_ptr<PjRtLoadedExecutable>> TfrtCpuClient::Compile(
@@ -698,9 +979,24 @@ StatusOr<std::unique_ptr<PjRtLoadedExecutable>> TfrtCpuClient::Compile(
                       computation.GetProgramShape());
   ExecutionOptions execution_options =
       CreateExecutionOptions(build_options, &program_shape);
-  TF_ASSIGN_OR_RETURN(std::unique_ptr<Executable> cpu_executable,
-                      JitCompile(computation, argument_layout_pointers,
-                                 build_options, execution_options));
+  // Computations without a key aren't shared with other compiles.
+  const std::optional<std::string> key = CompiledExecutableKey(
+      computation, argument_layout_pointers, execution_options);
+  std::shared_ptr<Executable> cpu_executable;
+  if (key.has_value()) {
+    cpu_executable = LookupCompiledExecutable(*key);
+  } else {
+    VLOG(1) << "Not caching the executable of " << computation.name()
+            << ", which can't be serialized.";
+  }
+  if (cpu_executable == nullptr) {
+    TF_ASSIGN_OR_RETURN(cpu_executable,
+                        JitCompile(computation, argument_layout_pointers,
+                                   build_options, execution_options));
+    if (key.has_value()) {
+      StoreCompiledExecutable(*key, cpu_executable);
+    }
+  }
   auto cpu_executable_ptr =
       tensorflow::down_cast<cpu::CpuExecutable*>(cpu_executable.get());
 
@@ -795,47 +1091,93 @@ TfrtCpuClient::CreateBuffersForAsyncHostToDevice(absl::Span<const Shape> shapes,
                                                          this);
 }
 
+absl::StatusOr<std::unique_ptr<PjRtClient::AsyncHostToDeviceTransferManager>>
+TfrtCpuClient::CreateBuffersForAsyncHostToDevice(
+    absl::Span<const Shape> shapes, PjRtMemorySpace* memory_space) {
+  TF_ASSIGN_OR_RETURN(TfrtCpuDevice * device,
+                      DeviceOfMemorySpace(memory_space, this));
+  std::vector<Shape> on_device_shapes;
+  on_device_shapes.reserve(shapes.size());
+  for (const Shape& shape : shapes) {
+    on_device_shapes.push_back(ShapeInMemorySpace(shape, memory_space));
+  }
+  return TfrtCpuAsyncHostToDeviceTransferManager::Create(
+      on_device_shapes, device, this, memory_space);
+}
+
 StatusOr<std::unique_ptr<PjRtBuffer>> TfrtCpuClient::BufferFromHostBuffer(
     const void* data, PrimitiveType type, absl::Span<int64_t const> dims,
     std::optional<absl::Span<int64_t const>> byte_strides,
     HostBufferSemantics host_buffer_semantics,
     std::function<void()> on_done_with_host_buffer, PjRtDevice* device) {
-  tsl::profiler::TraceMe traceme("TfrtCpuClient::BufferFromHostBuffer");
-  Shape shape = ShapeUtil::MakeShape(type, dims);
-  VLOG(2) << "TfrtCpuClient::BufferFromHostBuffer: shape: " << shape.ToString()
-          << " device: " << device->DebugString();
-
   if (!device->IsAddressable()) {
     return InvalidArgument("Cannot copy array to non-addressable device %s",
                            device->DebugString());
   }
+  TF_ASSIGN_OR_RETURN(PjRtMemorySpace * memory_space,
+                      device->default_memory_space());
+  return BufferFromHostBuffer(data, type, dims, byte_strides,
+                              host_buffer_semantics,
+                              std::move(on_done_with_host_buffer), memory_space,
+                              /*device_layout=*/nullptr);
+}
+
+StatusOr<std::unique_ptr<PjRtBuffer>> TfrtCpuClient::BufferFromHostBuffer(
+    const void* data, PrimitiveType type, absl::Span<int64_t const> dims,
+    std::optional<absl::Span<int64_t const>> byte_strides,
+    HostBufferSemantics host_buffer_semantics,
+    std::function<void()> on_done_with_host_buffer,
+    PjRtMemorySpace* memory_space, const Layout* device_layout) {
+  tsl::profiler::TraceMe traceme("TfrtCpuClient::BufferFromHostBuffer");
+  if (device_layout != nullptr) {
+    return Unimplemented(
+        "BufferFromHostBuffer with a device layout is not implemented on "
+        "platform: %s",
+        platform_name());
+  }
+  TF_ASSIGN_OR_RETURN(TfrtCpuDevice * device,
+                      DeviceOfMemorySpace(memory_space, this));
+  Shape shape =
+      ShapeInMemorySpace(ShapeUtil::MakeShape(type, dims), memory_space);
+  VLOG(2) << "TfrtCpuClient::BufferFromHostBuffer: shape: " << shape.ToString()
+          << " memory space: " << memory_space->DebugString();
+
   TF_ASSIGN_OR_RETURN(
       std::unique_ptr<TrackedTfrtCpuDeviceBuffer> tracked_device_buffer,
       AbstractTfrtCpuBuffer::BufferFromHostBufferHelper(
           data, type, dims, byte_strides, host_buffer_semantics,
-          std::move(on_done_with_host_buffer), shape, async_work_runner(),
-          &transpose_mu_, &transpose_cache_));
+          std::move(on_done_with_host_buffer), shape,
+          async_work_runner(*device), &transpose_mu_, &transpose_cache_));
 
-  return std::unique_ptr<PjRtBuffer>(std::make_unique<TfrtCpuBuffer>(
-      shape, std::move(tracked_device_buffer), this,
-      tensorflow::down_cast<TfrtCpuDevice*>(device)));
+  return std::unique_ptr<PjRtBuffer>(
+      std::make_unique<TfrtCpuBuffer>(shape, std::move(tracked_device_buffer),
+                                      this, device, memory_space));
 }
 
 StatusOr<std::unique_ptr<PjRtBuffer>> TfrtCpuClient::BufferFromHostLiteral(
     const LiteralSlice& literal, PjRtDevice* device) {
+  TF_ASSIGN_OR_RETURN(PjRtMemorySpace * memory_space,
+                      device->default_memory_space());
+  return BufferFromHostLiteral(literal, memory_space);
+}
+
+StatusOr<std::unique_ptr<PjRtBuffer>> TfrtCpuClient::BufferFromHostLiteral(
+    const LiteralSlice& literal, PjRtMemorySpace* memory_space) {
   tsl::profiler::TraceMe traceme("TfrtCpuClient::BufferFromHostLiteral");
   VLOG(1) << "TfrtCpuClient::BufferFromHostLiteral: shape: "
           << literal.shape().DebugString()
-          << " device: " << device->DebugString();
-  const Shape& shape = literal.shape();
+          << " memory space: " << memory_space->DebugString();
+  TF_ASSIGN_OR_RETURN(TfrtCpuDevice * device,
+                      DeviceOfMemorySpace(memory_space, this));
+  const Shape shape = ShapeInMemorySpace(literal.shape(), memory_space);
 
   absl::InlinedVector<tsl::RCReference<tsl::AsyncValue>, 4> avs;
-  TF_ASSIGN_OR_RETURN(
-      std::unique_ptr<TfrtCpuBuffer> output_buffer,
-      AllocateDestinationBufferAndAvs(
-          shape, &avs, tensorflow::down_cast<TfrtCpuDevice*>(device), this));
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<TfrtCpuBuffer> output_buffer,
+                      AllocateDestinationBufferAndAvs(shape, &avs, device,
+                                                      this, memory_space));
 
-  output_buffer->CopyFromLiteral(literal, shape, &avs, async_work_runner());
+  output_buffer->CopyFromLiteral(literal, shape, &avs,
+                                 async_work_runner(*device));
 
   return std::unique_ptr<PjRtBuffer>(std::move(output_buffer));
 }
@@ -843,11 +1185,17 @@ StatusOr<std::unique_ptr<PjRtBuffer>> TfrtCpuClient::BufferFromHostLiteral(
 TfrtCpuBuffer::TfrtCpuBuffer(
     Shape on_device_shape,
     std::unique_ptr<TrackedTfrtCpuDeviceBuffer> tracked_device_buffer,
-    TfrtCpuClient* client, TfrtCpuDevice* device)
+    TfrtCpuClient* client, TfrtCpuDevice* device,
+    PjRtMemorySpace* memory_space)
     : AbstractTfrtCpuBuffer(std::move(on_device_shape),
                             std::move(tracked_device_buffer)),
       client_(client),
-      device_(device) {}
+      device_(device),
+      memory_space_(memory_space != nullptr || device == nullptr
+                        ? memory_space
+                        : device->memory_space_by_kind(
+                                    MemoryKindOfShape(on_device_shape_))
+                              .value_or(nullptr)) {}
 
 static std::vector<tsl::RCReference<tsl::AsyncValue>> CopyAsyncValues(
     absl::Span<const tsl::RCReference<tsl::AsyncValue>> events) {
@@ -860,7 +1208,7 @@ static std::vector<tsl::RCReference<tsl::AsyncValue>> CopyAsyncValues(
 }
 
 PjRtFuture<Status> TfrtCpuBuffer::ToLiteral(MutableLiteralBase* literal) {
-  return ToLiteralHelper(literal, client()->async_work_runner());
+  return ToLiteralHelper(literal, client()->async_work_runner(*device_));
 }
 
 // TODO(zhangqiaorjc): Consider disallowing multiple CPU devices and assign
@@ -885,20 +1233,89 @@ StatusOr<std::unique_ptr<PjRtBuffer>> TfrtCpuBuffer::CopyToDevice(
                            dst_device->DebugString());
   }
 
+  auto* dst_cpu_device = tensorflow::down_cast<TfrtCpuDevice*>(dst_device);
+  // The copy runs on the threads of the destination device, which places the
+  // new buffer in its NUMA node.
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<TrackedTfrtCpuDeviceBuffer> tracked_device_buffer,
+      CopyToDeviceHelper(client()->async_work_runner(*dst_cpu_device)));
+
+  return std::unique_ptr<PjRtBuffer>(
+      std::make_unique<TfrtCpuBuffer>(on_device_shape_,
+                                      std::move(tracked_device_buffer),
+                                      client(), dst_cpu_device));
+}
+
+StatusOr<std::unique_ptr<PjRtBuffer>> TfrtCpuBuffer::CopyToMemorySpace(
+    PjRtMemorySpace* dst_memory_space) {
+  tsl::profiler::TraceMe traceme("TfrtCpuBuffer::CopyToMemorySpace");
+  if (dst_memory_space == memory_space_) {
+    return InvalidArgument(
+        "CopyToMemorySpace cannot accept the same source and destination "
+        "memory spaces");
+  }
+  TF_ASSIGN_OR_RETURN(TfrtCpuDevice * dst_device,
+                      DeviceOfMemorySpace(dst_memory_space, client_));
+
+  // All memory spaces are host memory, so the copy only differs from
+  // CopyToDevice in the memory space of the layout of the new buffer.
   TF_ASSIGN_OR_RETURN(
       std::unique_ptr<TrackedTfrtCpuDeviceBuffer> tracked_device_buffer,
-      CopyToDeviceHelper(client()->async_work_runner()));
+      CopyToDeviceHelper(client()->async_work_runner(*dst_device)));
 
   return std::unique_ptr<PjRtBuffer>(std::make_unique<TfrtCpuBuffer>(
-      on_device_shape_, std::move(tracked_device_buffer), client(),
-      tensorflow::down_cast<TfrtCpuDevice*>(dst_device)));
+      ShapeInMemorySpace(on_device_shape_, dst_memory_space),
+      std::move(tracked_device_buffer), client(), dst_device,
+      dst_memory_space));
+}
+
+CpuExecuteDispatchPolicy::CpuExecuteDispatchPolicy(
+    absl::Duration estimated_run_time)
+    : expected_run_time_ns_(absl::ToInt64Nanoseconds(estimated_run_time)) {}
+
+absl::Duration CpuExecuteDispatchPolicy::EstimateRunTime(
+    const HloCostAnalysis& cost_analysis) {
+  // Rough throughputs of a single core. The FLOP rate is calibrated so that
+  // 1000 FLOPs take about as long as a thread context switch (~5us), which
+  // matches the crude heuristic this estimate replaces.
+  constexpr double kFlopsPerNanosecond = 0.2;
+  constexpr double kBytesPerNanosecond = 10.0;
+  return absl::Nanoseconds(
+      std::max(cost_analysis.flop_count() / kFlopsPerNanosecond,
+               cost_analysis.bytes_accessed() / kBytesPerNanosecond));
+}
+
+void CpuExecuteDispatchPolicy::RecordRunTime(absl::Duration run_time) {
+  // Weight of the history in the moving average; a change in run time is
+  // followed after a handful of executions.
+  constexpr int64_t kHistoryWeight = 8;
+  const int64_t sample = absl::ToInt64Nanoseconds(run_time);
+  if (!measured_.exchange(true, std::memory_order_relaxed)) {
+    expected_run_time_ns_.store(sample, std::memory_order_relaxed);
+    return;
+  }
+  // Concurrent runs may overwrite each other's update, which only slows down
+  // the adaptation a little.
+  const int64_t average = expected_run_time_ns_.load(std::memory_order_relaxed);
+  expected_run_time_ns_.store(average + (sample - average) / kHistoryWeight,
+                              std::memory_order_relaxed);
+}
+
+// Feeds the run time of an execution that started at `start` to `policy` and
+// to the execution metrics.
+static void RecordExecution(CpuExecuteDispatchPolicy& policy,
+                            bool inline_execution, absl::Time start) {
+  const absl::Duration run_time = absl::Now() - start;
+  policy.RecordRunTime(run_time);
+  metrics::RecordCpuExecution(inline_execution,
+                              absl::ToInt64Microseconds(run_time));
 }
 
 TfrtCpuExecutable::TfrtCpuExecutable(
     int num_replicas, int num_partitions,
     std::shared_ptr<DeviceAssignment> device_assignment,
     bool parameter_is_tupled_arguments, CompileOptions compile_options,
-    std::unique_ptr<Executable> cpu_executable,
+    std::shared_ptr<Executable> cpu_executable,
     BufferAllocation::Index result_buffer_index,
     absl::InlinedVector<BufferAllocation::Index, 4> result_buffer_indices,
     std::vector<LogicalDeviceIds> addressable_device_logical_ids,
@@ -915,13 +1332,40 @@ TfrtCpuExecutable::TfrtCpuExecutable(
       addressable_device_logical_ids_(
           std::move(addressable_device_logical_ids)),
       addressable_devices_(std::move(addressable_devices)) {
-  auto hlo_cost_analysis =
-      std::make_unique<HloCostAnalysis>(cpu::CpuExecutable::ShapeSizeBytes);
-  // Cache to avoid std::map lookup in flop_count() on critical path.
-  // The magic constant 1000 is determined by correlating computation with flop
-  // estimate. It is a crude heuristic to find computation less than the thread
-  // context switch time (~5us).
-  cheap_computation_ = hlo_cost_analysis->flop_count() < 1000;
+  HloCostAnalysis hlo_cost_analysis(cpu::CpuExecutable::ShapeSizeBytes);
+  absl::Duration estimated_run_time =
+      CpuExecuteDispatchPolicy::kInlineThreshold;
+  Status cost_status = cpu_executable_->module().entry_computation()->Accept(
+      &hlo_cost_analysis);
+  if (cost_status.ok()) {
+    estimated_run_time =
+        CpuExecuteDispatchPolicy::EstimateRunTime(hlo_cost_analysis);
+  } else {
+    // Start asynchronous; the first measured run corrects the estimate.
+    VLOG(1) << "Failed to estimate the cost of " << name() << ": "
+            << cost_status;
+  }
+  dispatch_policy_ =
+      std::make_shared<CpuExecuteDispatchPolicy>(estimated_run_time);
+
+  has_collectives_ = false;
+  for (const HloComputation* computation :
+       cpu_executable_->module().computations()) {
+    for (const HloInstruction* instruction : computation->instructions()) {
+      if (hlo_query::IsCollectiveCommunicationOp(instruction->opcode())) {
+        has_collectives_ = true;
+      }
+    }
+  }
+
+  // Retain a slab per device so that back-to-back runs on every device reuse
+  // their temporaries. The client's budget bounds the slabs retained by all of
+  // its executables together.
+  temp_arena_ = std::make_unique<CpuTempArena>(
+      tensorflow::down_cast<cpu::CpuExecutable*>(cpu_executable_.get())
+          ->buffer_assignment(),
+      /*max_retained_slabs=*/std::max<int>(2, addressable_devices_.size()),
+      client_->buffer_pool_budget());
 
   const auto& computation_layout =
       cpu_executable_->module().entry_computation_layout();
@@ -952,6 +1396,19 @@ void TfrtCpuExecutable::Delete() {}
 
 bool TfrtCpuExecutable::IsDeleted() { return false; }
 
+StatusOr<std::vector<std::vector<absl::string_view>>>
+TfrtCpuExecutable::GetOutputMemoryKinds() const {
+  std::vector<absl::string_view> memory_kinds;
+  ShapeUtil::ForEachSubshape(
+      cpu_executable_->result_shape(),
+      [&](const Shape& subshape, const ShapeIndex& index) {
+        if (subshape.IsArray()) {
+          memory_kinds.push_back(MemoryKindOfShape(subshape));
+        }
+      });
+  return std::vector<std::vector<absl::string_view>>{std::move(memory_kinds)};
+}
+
 StatusOr<std::optional<std::string>> TfrtCpuExecutable::Fingerprint() const {
   return std::optional<std::string>();
 }
@@ -965,9 +1422,14 @@ Status TfrtCpuExecutable::SetUpDonation(bool tuple_inputs) {
 
 // The following few helpers are adapted from XLA:CPU to create a buffer table
 // and assemble the buffer pointers in order to call into CpuExecutable.
+//
+// Temporary buffers are views into `temp_slab`, which was acquired from
+// `temp_arena`; output buffers are allocated from `output_pool`.
 static StatusOr<std::shared_ptr<MaybeOwningCpuMemory>> MemoryForAllocation(
     const BufferAllocation& allocation,
-    absl::Span<std::pair<bool, TrackedTfrtCpuDeviceBuffer*> const> arguments) {
+    absl::Span<std::pair<bool, TrackedTfrtCpuDeviceBuffer*> const> arguments,
+    CpuBufferPool& output_pool, const CpuTempArena& temp_arena,
+    const MaybeOwningCpuMemory* temp_slab) {
   if (allocation.is_entry_computation_parameter()) {
     auto [can_donate, arg] = arguments[allocation.parameter_number()];
     std::shared_ptr<MaybeOwningCpuMemory> out =
@@ -980,8 +1442,7 @@ static StatusOr<std::shared_ptr<MaybeOwningCpuMemory>> MemoryForAllocation(
     // example we might be pointing to a buffer owned by the client whose
     // lifetime will not extend past the lifetime of the donated input buffer.
     if ((!can_donate || !out->owns_data()) && !allocation.is_readonly()) {
-      TF_ASSIGN_OR_RETURN(
-          auto copy, MaybeOwningCpuMemory::AllocateShared(allocation.size()));
+      TF_ASSIGN_OR_RETURN(auto copy, output_pool.Allocate(allocation.size()));
       std::memcpy(copy->data(), out->data(), allocation.size());
       return copy;
     }
@@ -993,8 +1454,12 @@ static StatusOr<std::shared_ptr<MaybeOwningCpuMemory>> MemoryForAllocation(
   }
 
   // Output and temporary buffer.
-  TF_ASSIGN_OR_RETURN(auto out,
-                      MaybeOwningCpuMemory::AllocateShared(allocation.size()));
+  std::shared_ptr<MaybeOwningCpuMemory> out;
+  if (CpuTempArena::IsTempAllocation(allocation)) {
+    out = temp_arena.Slice(*temp_slab, allocation.index());
+  } else {
+    TF_ASSIGN_OR_RETURN(out, output_pool.Allocate(allocation.size()));
+  }
 
   // Since the output buffer and all the temporary buffers were written into
   // by the JITed code, msan has no way of knowing their memory was
@@ -1007,13 +1472,17 @@ static StatusOr<std::shared_ptr<MaybeOwningCpuMemory>> MemoryForAllocation(
 static StatusOr<std::vector<std::shared_ptr<MaybeOwningCpuMemory>>>
 CreateBufferTable(
     const BufferAssignment& assignment,
-    absl::Span<std::pair<bool, TrackedTfrtCpuDeviceBuffer*> const> arguments) {
+    absl::Span<std::pair<bool, TrackedTfrtCpuDeviceBuffer*> const> arguments,
+    CpuBufferPool& output_pool, const CpuTempArena& temp_arena,
+    const MaybeOwningCpuMemory* temp_slab) {
   std::vector<std::shared_ptr<MaybeOwningCpuMemory>> buffers(
       assignment.Allocations().size());
   for (BufferAllocation::Index i = 0; i < assignment.Allocations().size();
        ++i) {
     const BufferAllocation& allocation = assignment.GetAllocation(i);
-    TF_ASSIGN_OR_RETURN(buffers[i], MemoryForAllocation(allocation, arguments));
+    TF_ASSIGN_OR_RETURN(buffers[i],
+                        MemoryForAllocation(allocation, arguments, output_pool,
+                                            temp_arena, temp_slab));
   }
   return std::move(buffers);
 }
@@ -1065,7 +1534,7 @@ static std::vector<xla::cpu::BufferDesc> MakeXLARuntimeDescriptorTable(
 StatusOr<PjRtLoadedExecutable::Result> TfrtCpuExecutable::ExecuteHelper(
     absl::Span<PjRtBuffer* const> argument_handles, int replica, int partition,
     const RunId& run_id, const ExecuteOptions& options,
-    tsl::AsyncValueRef<CpuEvent> last_collective_launch_event, bool fill_future,
+    bool fill_future,
     TfrtCpuDevice* device) {
   tsl::profiler::TraceMe traceme("TfrtCpuExecutable::ExecuteHelper");
 
@@ -1205,11 +1674,25 @@ StatusOr<PjRtLoadedExecutable::Result> TfrtCpuExecutable::ExecuteHelper(
     tracked_buffers.emplace_back(false, tuplized_arg.get());
   }
 
+  // The temporaries live in one slab of the executable's arena, which is
+  // recycled once the computation is done with it.
+  std::shared_ptr<MaybeOwningCpuMemory> temp_slab;
+  if (temp_arena_->slab_size() > 0) {
+    TF_ASSIGN_OR_RETURN(temp_slab, temp_arena_->AcquireSlab());
+  }
+
   auto* cpu_executable =
       tensorflow::down_cast<cpu::CpuExecutable*>(cpu_executable_.get());
   TF_ASSIGN_OR_RETURN(
       std::vector<std::shared_ptr<MaybeOwningCpuMemory>> buffer_table,
-      CreateBufferTable(cpu_executable->buffer_assignment(), tracked_buffers));
+      CreateBufferTable(cpu_executable->buffer_assignment(), tracked_buffers,
+                        client_->output_buffer_pool(*device), *temp_arena_,
+                        temp_slab.get()));
+  // Keep the slab alive until the execution completes. On the error paths
+  // above it goes straight back to the arena instead.
+  if (temp_slab != nullptr) {
+    execute_event.AndThen([temp_slab]() {});
+  }
   auto result_buffers =
       CreateResultShapedBuffer(result_buffer_indices_, buffer_table);
 
@@ -1234,15 +1717,15 @@ StatusOr<PjRtLoadedExecutable::Result> TfrtCpuExecutable::ExecuteHelper(
   run_options.set_device_ordinal(device->id());
   // Need to keep device_assignment alive until execution completes.
   run_options.set_device_assignment(device_assignment.get());
-  run_options.set_intra_op_thread_pool(client_->eigen_intraop_device());
-
-  // Schedule only one collective at a time.
-  bool is_a_collective_launch = !!last_collective_launch_event;
-  if (is_a_collective_launch) {
-    input_deps.push_back(std::move(last_collective_launch_event));
-  }
+  run_options.set_intra_op_thread_pool(client_->eigen_intraop_device(*device));
+  run_options.set_cpu_executable_run_options(client_->cpu_run_options());
 
-  bool execute_inline = cheap_computation_;
+  // Programs of devices bound to a NUMA node run on the node's threads, so
+  // that their outputs are first touched there, unless the caller asks for a
+  // synchronous execution.
+  const int numa_node = device->numa_node();
+  bool execute_inline = dispatch_policy_->ShouldExecuteInline() &&
+                        numa_node == tsl::port::kNUMANoAffinity;
 
   // Overwrite `execute_inline` if it is specified in the ExecuteOptions.
   if (options.execution_mode == ExecuteOptions::ExecutionMode::kAsynchronous) {
@@ -1251,6 +1734,12 @@ StatusOr<PjRtLoadedExecutable::Result> TfrtCpuExecutable::ExecuteHelper(
              ExecuteOptions::ExecutionMode::kSynchronous) {
     execute_inline = true;
   }
+  // Participants of collectives block in a rendezvous, which must not happen
+  // on the caller's thread: Execute launches the participants of all devices
+  // from the fixed-size client pool.
+  if (has_collectives_) {
+    execute_inline = false;
+  }
 
   if (input_deps.empty() && execute_inline) {
     // Synchronously call generated function.
@@ -1263,6 +1752,7 @@ StatusOr<PjRtLoadedExecutable::Result> TfrtCpuExecutable::ExecuteHelper(
     XlaCustomCallStatus status;
 
     // Call generated function.
+    const absl::Time start = absl::Now();
     if (cpu_executable->IsXlaRuntime()) {
       Status status = cpu_executable->ExecuteXlaRuntime(
           MakeXLARuntimeDescriptorTable(buffer_table), &run_options);
@@ -1272,6 +1762,7 @@ StatusOr<PjRtLoadedExecutable::Result> TfrtCpuExecutable::ExecuteHelper(
                                          buffer_pointers.data(), &status,
                                          nullptr);
     }
+    RecordExecution(*dispatch_policy_, /*inline_execution=*/true, start);
 
     for (auto& donation_transaction : donation_transactions) {
       std::move(donation_transaction).Commit();
@@ -1284,31 +1775,31 @@ StatusOr<PjRtLoadedExecutable::Result> TfrtCpuExecutable::ExecuteHelper(
     }
 
   } else {
-    // TODO(zhangqiaorjc): Only async launch expensive computations. Need
-    // heuristics to decide what computation is expensive.
     // Asynchronously call generated function.
 
-    // We only created enough threads for one collective to complete.
-    // The next collective launch will not be scheduled onto threadpool until
-    // this one completes.
-    if (is_a_collective_launch) {
-      client_->SetLastCollectiveLaunchEvent(execute_event.CopyRef());
-    }
     std::vector<tsl::RCReference<tsl::AsyncValue>> input_deps_avs_copy =
         CopyAsyncValues(input_deps);
-    EnqueueWorkWhenReady(
-        client()->pjrt_client_thread_pool(), input_deps,
+    auto execute =
         [cpu_executable, result_buffer,
          buffer_pointers = std::move(buffer_pointers),
          buffer_table = std::move(buffer_table),
          run_options = std::move(run_options),
          cpu_executable_copy = cpu_executable_,
+         dispatch_policy = dispatch_policy_,
          device_assignment = std::move(device_assignment),
          compute_reservation = std::move(compute_reservation),
          tuplized_arg = std::move(tuplized_arg),
          donation_transactions = std::move(donation_transactions),
          execute_event = std::move(ready_on_exit).Release(),
-         input_deps_avs = std::move(input_deps_avs_copy)]() mutable {
+         input_deps_avs = std::move(input_deps_avs_copy),
+         has_collectives = has_collectives_, numa_node]() mutable {
+          // The threads of the collective queue are shared by all nodes, so
+          // they are bound to the node of the device they run for while they
+          // run this execution.
+          std::optional<ScopedNUMAThreadNodeAffinity> numa_affinity;
+          if (has_collectives && numa_node != tsl::port::kNUMANoAffinity) {
+            numa_affinity.emplace(numa_node);
+          }
           for (const auto& av : input_deps_avs) {
             if (auto* error = av->GetErrorIfPresent()) {
               execute_event.SetError(absl::StrCat(
@@ -1323,6 +1814,7 @@ StatusOr<PjRtLoadedExecutable::Result> TfrtCpuExecutable::ExecuteHelper(
           tsl::port::ScopedSetRound round(FE_TONEAREST);
 
           // Call generated function.
+          const absl::Time start = absl::Now();
           std::optional<absl::string_view> error_message;
           if (cpu_executable->IsXlaRuntime()) {
             Status s = cpu_executable->ExecuteXlaRuntime(
@@ -1338,6 +1830,7 @@ StatusOr<PjRtLoadedExecutable::Result> TfrtCpuExecutable::ExecuteHelper(
                                                &status, nullptr);
             error_message = xla::CustomCallStatusGetMessage(&status);
           }
+          RecordExecution(*dispatch_policy, /*inline_execution=*/false, start);
 
           for (auto& donation_transaction : donation_transactions) {
             std::move(donation_transaction).Commit();
@@ -1352,7 +1845,14 @@ StatusOr<PjRtLoadedExecutable::Result> TfrtCpuExecutable::ExecuteHelper(
 
           // CPU computation completes.
           execute_event.SetStateConcrete();
-        });
+        };
+    if (has_collectives_) {
+      EnqueueWorkWhenReady(client()->async_execute_queue(), input_deps,
+                           std::move(execute));
+    } else {
+      EnqueueWorkWhenReady(client()->pjrt_client_thread_pool(*device),
+                           input_deps, std::move(execute));
+    }
   }
 
   // Create output TFRT buffers.
@@ -1478,10 +1978,9 @@ TfrtCpuExecutable::Execute(
     // Dump once before running, in case there's a crash.
     MaybeDumpHloSnapshot(cpu_executable_->module(), run_id, argument_handles[0],
                          {});
-    auto statusor = ExecuteHelper(
-        argument_handles[0], replica, partition, run_id, options,
-        /*last_collective_launch_event=*/tsl::AsyncValueRef<CpuEvent>(),
-        returned_futures.has_value());
+    auto statusor =
+        ExecuteHelper(argument_handles[0], replica, partition, run_id, options,
+                      returned_futures.has_value());
 
     if (!statusor.ok()) {
       return std::move(statusor).status();
@@ -1495,13 +1994,6 @@ TfrtCpuExecutable::Execute(
     MaybeDumpHloSnapshot(cpu_executable_->module(), run_id, argument_handles[0],
                          wrapped_results[0]);
   } else {
-    // Gang schedule collectives to ensure that collectives with the same RunId
-    // are run at the same time. We conservatively run only one collective at a
-    // time, because we may not have enough threads to run arbitrary number of
-    // collectives concurrently.
-    tsl::AsyncValueRef<CpuEvent> last_collective_launch_event =
-        client_->GetLastCollectiveLaunchEvent();
-
     absl::Mutex mu;
     int running = num_addressable_devices;
     int failed = 0;
@@ -1511,12 +2003,10 @@ TfrtCpuExecutable::Execute(
       const int replica = addressable_device_logical_ids_[i].replica;
       const int partition = addressable_device_logical_ids_[i].partition;
 
-      auto* thread_pool = client()->pjrt_client_thread_pool();
-      EnqueueWork(thread_pool, [&, replica, partition, i] {
+      auto launch = [&, replica, partition, i] {
         auto statusor =
             ExecuteHelper(argument_handles[i], replica, partition, run_id,
-                          options, last_collective_launch_event.CopyRef(),
-                          returned_futures.has_value());
+                          options, returned_futures.has_value());
         if (statusor.ok()) {
           wrapped_results[i] = std::move(statusor->buffers);
           if (returned_futures.has_value()) {
@@ -1538,7 +2028,10 @@ TfrtCpuExecutable::Execute(
           }
           ++failed;
         }
-      });
+      };
+      // ExecuteHelper never runs programs with collectives inline, so the
+      // launch only enqueues their execution and doesn't block.
+      EnqueueWork(client()->pjrt_client_thread_pool(), std::move(launch));
     }
 
     {
@@ -1576,8 +2069,7 @@ TfrtCpuExecutable::ExecuteSharded(
           ExecuteHelper(
               argument_handles, addressable_device_logical_ids_[i].replica,
               addressable_device_logical_ids_[i].partition, RunId(), options,
-              /*last_collective_launch_event=*/
-              tsl::AsyncValueRef<CpuEvent>(), fill_future));
+              fill_future));
       returned_future = std::move(result.future);
       return std::move(result.buffers);
     }
@@ -1613,9 +2105,8 @@ TfrtCpuExecutable::ExecutePortable(
       ExecuteHelper(
           argument_handles,
           /*replica=*/0,
-          /*partition=*/0, RunId(), options,
-          /*last_collective_launch_event=*/tsl::AsyncValueRef<CpuEvent>(),
-          fill_future, tensorflow::down_cast<TfrtCpuDevice*>(device)));
+          /*partition=*/0, RunId(), options, fill_future,
+          tensorflow::down_cast<TfrtCpuDevice*>(device)));
   returned_future = std::move(result.future);
   return std::move(result.buffers);
 }
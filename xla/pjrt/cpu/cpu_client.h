@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef XLA_PJRT_CPU_CPU_CLIENT_H_
 #define XLA_PJRT_CPU_CPU_CLIENT_H_
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
@@ -30,6 +31,7 @@ limitations under the License.
 #include "absl/container/inlined_vector.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 #include "absl/types/span.h"
 #include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
 #include "mlir/IR/BuiltinOps.h"  // from @llvm-project
@@ -38,6 +40,7 @@ limitations under the License.
 #include "xla/hlo/ir/hlo_module.h"
 #include "xla/literal.h"
 #include "xla/pjrt/cpu/abstract_tfrt_cpu_buffer.h"
+#include "xla/pjrt/cpu/cpu_buffer_pool.h"
 #include "xla/pjrt/cpu/tracked_tfrt_cpu_device_buffer.h"
 #include "xla/pjrt/pjrt_client.h"
 #include "xla/pjrt/pjrt_executable.h"
@@ -47,6 +50,8 @@ limitations under the License.
 #include "xla/runtime/cpu_event.h"
 #include "xla/service/buffer_assignment.h"
 #include "xla/service/computation_placer.h"
+#include "xla/service/cpu/collectives_interface.h"
+#include "xla/service/cpu/cpu_executable_run_options.h"
 #include "xla/service/executable.h"
 #include "xla/service/hlo.pb.h"
 #include "xla/service/hlo_cost_analysis.h"
@@ -57,13 +62,18 @@ limitations under the License.
 #include "tsl/concurrency/async_value_ref.h"
 #include "tsl/platform/errors.h"
 #include "tsl/platform/fingerprint.h"
+#include "tsl/platform/numa.h"
 #include "tsl/platform/threadpool.h"
+#include "tsl/platform/unbounded_work_queue.h"
 
 namespace xla {
 
 class TfrtCpuDeviceDescription final : public PjRtDeviceDescription {
  public:
-  TfrtCpuDeviceDescription(int id, int process_index, int local_hardware_id);
+  // If `numa_node` is not tsl::port::kNUMANoAffinity, it is reported as the
+  // "numa_node" attribute.
+  TfrtCpuDeviceDescription(int id, int process_index, int local_hardware_id,
+                           int numa_node = tsl::port::kNUMANoAffinity);
 
   int id() const override { return id_; }
 
@@ -93,8 +103,11 @@ class TfrtCpuDeviceDescription final : public PjRtDeviceDescription {
 
 class TfrtCpuDevice final : public PjRtDevice {
  public:
+  // A device with a `numa_node` runs its programs on threads bound to that
+  // NUMA node, and allocates its buffers from the node's memory.
   explicit TfrtCpuDevice(int id, int process_index, int local_hardware_id,
-                         int max_inflight_computations = 32);
+                         int max_inflight_computations = 32,
+                         int numa_node = tsl::port::kNUMANoAffinity);
 
   const TfrtCpuDeviceDescription& description() const override {
     return description_;
@@ -115,6 +128,9 @@ class TfrtCpuDevice final : public PjRtDevice {
     return description_.local_hardware_id();
   }
 
+  // The NUMA node this device is bound to, or tsl::port::kNUMANoAffinity.
+  int numa_node() const { return numa_node_; }
+
   Status TransferToInfeed(const LiteralSlice& literal) override;
 
   Status TransferFromOutfeed(MutableBorrowingLiteral literal) override;
@@ -123,6 +139,15 @@ class TfrtCpuDevice final : public PjRtDevice {
 
   StatusOr<PjRtMemorySpace*> default_memory_space() const override;
 
+  absl::StatusOr<PjRtMemorySpace*> memory_space_by_kind(
+      absl::string_view memory_space_kind) const override;
+
+  // Adds `memory_space` to the memory spaces of this device. The first one
+  // attached is the default memory space.
+  void AttachMemorySpace(PjRtMemorySpace* memory_space) {
+    memory_spaces_.push_back(memory_space);
+  }
+
   // Returns a semaphore for admission control on inflight computations.
   Semaphore& max_inflight_computations_semaphore() {
     return max_inflight_computations_semaphore_;
@@ -136,6 +161,8 @@ class TfrtCpuDevice final : public PjRtDevice {
  private:
   PjRtClient* client_ = nullptr;
   TfrtCpuDeviceDescription description_;
+  std::vector<PjRtMemorySpace*> memory_spaces_;
+  int numa_node_;
 
   // TODO(zhangqiaorjc): Optimize semaphore related overhead.
   // Semaphore used to limit how many programs can be enqueued by the host
@@ -147,7 +174,8 @@ class TfrtCpuClient final : public PjRtClient {
  public:
   TfrtCpuClient(int process_index,
                 std::vector<std::unique_ptr<TfrtCpuDevice>> devices,
-                size_t num_threads);
+                std::shared_ptr<cpu::CollectivesInterface> collectives,
+                size_t output_buffer_pool_bytes, size_t num_threads);
   ~TfrtCpuClient() override;
 
   int process_index() const override { return process_index_; }
@@ -211,10 +239,7 @@ class TfrtCpuClient final : public PjRtClient {
 
   absl::StatusOr<std::unique_ptr<PjRtClient::AsyncHostToDeviceTransferManager>>
   CreateBuffersForAsyncHostToDevice(absl::Span<const Shape> shapes,
-                                    PjRtMemorySpace* memory_space) override {
-    return Unimplemented(
-        "CreateBuffersForAsyncHostToDevice with memory_space not implemented.");
-  }
+                                    PjRtMemorySpace* memory_space) override;
 
   StatusOr<std::unique_ptr<PjRtBuffer>> BufferFromHostBuffer(
       const void* data, PrimitiveType type, absl::Span<int64_t const> dims,
@@ -223,9 +248,19 @@ class TfrtCpuClient final : public PjRtClient {
       std::function<void()> on_done_with_host_buffer,
       PjRtDevice* device) override;
 
+  StatusOr<std::unique_ptr<PjRtBuffer>> BufferFromHostBuffer(
+      const void* data, PrimitiveType type, absl::Span<int64_t const> dims,
+      std::optional<absl::Span<int64_t const>> byte_strides,
+      HostBufferSemantics host_buffer_semantics,
+      std::function<void()> on_done_with_host_buffer,
+      PjRtMemorySpace* memory_space, const Layout* device_layout) override;
+
   StatusOr<std::unique_ptr<PjRtBuffer>> BufferFromHostLiteral(
       const LiteralSlice& literal, PjRtDevice* device) override;
 
+  StatusOr<std::unique_ptr<PjRtBuffer>> BufferFromHostLiteral(
+      const LiteralSlice& literal, PjRtMemorySpace* memory_space) override;
+
   StatusOr<std::vector<std::unique_ptr<PjRtBuffer>>>
   MakeCrossHostReceiveBuffers(absl::Span<const Shape> shapes,
                               PjRtDevice* device,
@@ -272,17 +307,39 @@ class TfrtCpuClient final : public PjRtClient {
     return eigen_intraop_device_.get();
   }
 
-  tsl::AsyncValueRef<runtime::CpuEvent> GetLastCollectiveLaunchEvent() {
-    absl::MutexLock lock(&mu_);
-    return last_collective_launch_event_.CopyRef();
+  tsl::UnboundedWorkQueue* async_execute_queue() const {
+    return async_execute_queue_.get();
   }
 
-  void SetLastCollectiveLaunchEvent(
-      tsl::AsyncValueRef<runtime::CpuEvent> event) {
-    absl::MutexLock lock(&mu_);
-    last_collective_launch_event_ = std::move(event);
+  // Collectives used by executables of this client, or nullptr to use the
+  // in-process implementation.
+  cpu::CollectivesInterface* collectives() const { return collectives_.get(); }
+
+  // Run options shared by all executions of this client's executables.
+  const cpu::CpuExecutableRunOptions* cpu_run_options() const {
+    return &cpu_run_options_;
   }
 
+  // Pool from which executables allocate their output buffers.
+  CpuBufferPool& output_buffer_pool() const { return *output_buffer_pool_; }
+
+  // Budget shared by the output buffer pools and the temporary arenas of the
+  // client's executables.
+  const std::shared_ptr<CpuBufferPoolBudget>& buffer_pool_budget() const {
+    return buffer_pool_budget_;
+  }
+
+  // The following return the resources of the NUMA node that `device` is
+  // bound to, whose threads run on the node's cores and so place the memory
+  // they first touch on it. They return the resources shared by all devices
+  // above if `device` is not bound to a NUMA node.
+  tsl::thread::ThreadPool* pjrt_client_thread_pool(
+      const TfrtCpuDevice& device) const;
+  AsyncWorkRunner* async_work_runner(const TfrtCpuDevice& device) const;
+  Eigen::ThreadPoolDevice* eigen_intraop_device(
+      const TfrtCpuDevice& device) const;
+  CpuBufferPool& output_buffer_pool(const TfrtCpuDevice& device) const;
+
  private:
   int process_index_;
   // Includes all devices, including non-addressable devices.
@@ -295,33 +352,72 @@ class TfrtCpuClient final : public PjRtClient {
   std::vector<PjRtDevice*> addressable_devices_;
   std::unique_ptr<ComputationPlacer> computation_placer_;
 
+  // The device, pinned host and unpinned host memory spaces of each
+  // addressable device, in that order.
+  std::vector<std::unique_ptr<CpuMemorySpace>> owned_memory_spaces_;
+  // Pointers to `owned_memory_spaces_`.
+  std::vector<PjRtMemorySpace*> memory_spaces_;
+
   // Thread pool for running PjRtClient tasks.
   std::unique_ptr<tsl::thread::ThreadPool> pjrt_client_thread_pool_;
   std::unique_ptr<AsyncWorkRunner> async_work_runner_;
 
+  // Runs the asynchronous executions of programs with collectives; they are
+  // still launched from `pjrt_client_thread_pool_`. Each participant of a
+  // collective blocks in a rendezvous until all of them arrive, so running
+  // them on the fixed-size `pjrt_client_thread_pool_` would deadlock once
+  // enough collective programs are in flight to occupy all of its threads.
+  // The queue instead grows a thread for every blocked participant, up to one
+  // per participant in flight, and keeps idle threads for later executions.
+  std::unique_ptr<tsl::UnboundedWorkQueue> async_execute_queue_;
+
   // TODO(zhangqiaorjc): Use tsl::compat::EigenHostContextThreadPool.
   std::unique_ptr<tsl::thread::ThreadPool> eigen_intraop_pool_;
   std::unique_ptr<Eigen::ThreadPoolDevice> eigen_intraop_device_;
 
-  // Launching collectives are prone to deadlock when we use fixed-sized
-  // threadpools since ExecuteHelper will block until all replicas reach the
-  // barrier. We ensure that
-  // 1. Threadpool size is at least as large as device_count so one collective
-  //    launch over all devices can succeed.
-  // 2. Gang-schedule each collective by conservatively ensuring a total order
-  //    of collectives and launching only one collective at a time to avoid
-  //    having no active threads to make progress
-  // TODO(zhangqiaorjc): Explore alternatives that allow multiple concurrent
-  // collectives.
-  mutable absl::Mutex mu_;
-  tsl::AsyncValueRef<runtime::CpuEvent> last_collective_launch_event_
-      ABSL_GUARDED_BY(mu_);
-
   // A cache for transpose plans. We use transposes to convert
   // (possibly strided) buffers provided to BufferFromHostBuffer into dense
   // major-to-minor layout.
   absl::Mutex transpose_mu_;
   TransposePlanCache transpose_cache_ ABSL_GUARDED_BY(transpose_mu_);
+
+  std::shared_ptr<cpu::CollectivesInterface> collectives_;
+  cpu::CpuExecutableRunOptions cpu_run_options_;
+
+  std::shared_ptr<CpuBufferPoolBudget> buffer_pool_budget_;
+  std::shared_ptr<CpuBufferPool> output_buffer_pool_;
+
+  // Threads and memory of a NUMA node that devices are bound to.
+  struct NumaNode {
+    // Runs asynchronous executions and host transfers.
+    std::unique_ptr<tsl::thread::ThreadPool> thread_pool;
+    std::unique_ptr<AsyncWorkRunner> async_work_runner;
+    std::unique_ptr<tsl::thread::ThreadPool> eigen_intraop_pool;
+    std::unique_ptr<Eigen::ThreadPoolDevice> eigen_intraop_device;
+    // Keeps freed output buffers on the node for its devices to reuse.
+    std::shared_ptr<CpuBufferPool> output_buffer_pool;
+  };
+
+  // Returns the NUMA node `device` is bound to, or nullptr.
+  const NumaNode* GetNumaNode(const TfrtCpuDevice& device) const;
+
+  // NUMA nodes that addressable devices are bound to, keyed on node number.
+  absl::flat_hash_map<int, std::unique_ptr<NumaNode>> numa_nodes_;
+
+  // Returns the live executable stored under `key`, or nullptr.
+  std::shared_ptr<Executable> LookupCompiledExecutable(absl::string_view key);
+
+  void StoreCompiledExecutable(std::string key,
+                               std::shared_ptr<Executable> executable);
+
+  // Executables compiled or deserialized by this client, keyed on their
+  // inputs. Compiling or deserializing the same program again while an
+  // executable of it is alive shares it instead of running the compiler or
+  // the linker; the persistent xla_cpu_compilation_cache_dir cache covers
+  // programs that are no longer loaded.
+  absl::Mutex compiled_executables_mu_;
+  absl::flat_hash_map<std::string, std::weak_ptr<Executable>>
+      compiled_executables_ ABSL_GUARDED_BY(compiled_executables_mu_);
 };
 
 class TfrtCpuBuffer final : public AbstractTfrtCpuBuffer {
@@ -329,14 +425,15 @@ class TfrtCpuBuffer final : public AbstractTfrtCpuBuffer {
   TfrtCpuBuffer(
       Shape on_device_shape,
       std::unique_ptr<TrackedTfrtCpuDeviceBuffer> tracked_device_buffer,
-      TfrtCpuClient* client, TfrtCpuDevice* device);
+      TfrtCpuClient* client, TfrtCpuDevice* device,
+      PjRtMemorySpace* memory_space = nullptr);
 
   TfrtCpuBuffer(const TfrtCpuBuffer&) = delete;
   TfrtCpuBuffer(TfrtCpuBuffer&&) = delete;
   TfrtCpuBuffer& operator=(const TfrtCpuBuffer&) = delete;
   TfrtCpuBuffer& operator=(TfrtCpuBuffer&&) = delete;
 
-  PjRtMemorySpace* memory_space() const override { return nullptr; }
+  PjRtMemorySpace* memory_space() const override { return memory_space_; }
   TfrtCpuDevice* device() const override { return device_; }
   TfrtCpuClient* client() const override { return client_; }
 
@@ -346,11 +443,56 @@ class TfrtCpuBuffer final : public AbstractTfrtCpuBuffer {
   StatusOr<std::unique_ptr<PjRtBuffer>> CopyToDevice(
       PjRtDevice* dst_device) override;
 
+  StatusOr<std::unique_ptr<PjRtBuffer>> CopyToMemorySpace(
+      PjRtMemorySpace* dst_memory_space) override;
+
  private:
   absl::string_view buffer_name() const override { return "TfrtCpuBuffer"; }
 
   TfrtCpuClient* client_;
   TfrtCpuDevice* const device_;
+  // If not given at construction, the memory space of `device_` of the kind
+  // that the layout of the on-device shape is in.
+  PjRtMemorySpace* const memory_space_;
+};
+
+// Decides whether TfrtCpuExecutable runs a computation inline on the thread
+// that launches it or asynchronously on a client thread. Running inline saves
+// the thread hop and the AsyncValue bookkeeping, which cost a few
+// microseconds, but blocks the caller for the whole run, so it only pays off
+// for computations that are about as fast as the hop.
+//
+// The decision starts from a static estimate of the run time and then follows
+// an exponentially weighted moving average of the measured run times. All
+// methods are thread-safe.
+class CpuExecuteDispatchPolicy {
+ public:
+  // Computations whose expected run time is below this run inline.
+  static constexpr absl::Duration kInlineThreshold = absl::Microseconds(5);
+
+  explicit CpuExecuteDispatchPolicy(absl::Duration estimated_run_time);
+
+  // Estimates the run time of a computation from its FLOP count and the
+  // number of bytes it accesses.
+  static absl::Duration EstimateRunTime(const HloCostAnalysis& cost_analysis);
+
+  bool ShouldExecuteInline() const {
+    return expected_run_time_ns_.load(std::memory_order_relaxed) <
+           absl::ToInt64Nanoseconds(kInlineThreshold);
+  }
+
+  // Folds the measured run time of one execution into the average. The first
+  // measurement replaces the static estimate.
+  void RecordRunTime(absl::Duration run_time);
+
+  absl::Duration expected_run_time() const {
+    return absl::Nanoseconds(
+        expected_run_time_ns_.load(std::memory_order_relaxed));
+  }
+
+ private:
+  std::atomic<int64_t> expected_run_time_ns_;
+  std::atomic<bool> measured_{false};
 };
 
 class TfrtCpuExecutable final : public PjRtLoadedExecutable {
@@ -359,7 +501,7 @@ class TfrtCpuExecutable final : public PjRtLoadedExecutable {
       int num_replicas, int num_partitions,
       std::shared_ptr<DeviceAssignment> device_assignment,
       bool parameter_is_tupled_arguments, CompileOptions compile_options,
-      std::unique_ptr<Executable> cpu_executable,
+      std::shared_ptr<Executable> cpu_executable,
       BufferAllocation::Index result_buffer_index,
       absl::InlinedVector<BufferAllocation::Index, 4> result_buffer_indices,
       std::vector<LogicalDeviceIds> addressable_device_logical_ids,
@@ -400,10 +542,10 @@ class TfrtCpuExecutable final : public PjRtLoadedExecutable {
         cpu_executable_->shared_module()};
   }
 
+  // Outputs in Layout::kHostMemorySpace are in "pinned_host" memory, all
+  // others in "device" memory.
   StatusOr<std::vector<std::vector<absl::string_view>>> GetOutputMemoryKinds()
-      const override {
-    return Unimplemented("GetOutputMemoryKinds is not supported.");
-  }
+      const override;
 
   StatusOr<CompiledMemoryStats> GetCompiledMemoryStats() const override {
     CompiledMemoryStats memory_stats = CompiledMemoryStats();
@@ -450,9 +592,10 @@ class TfrtCpuExecutable final : public PjRtLoadedExecutable {
 
   std::shared_ptr<Executable> cpu_executable() const { return cpu_executable_; }
 
-  StatusOr<std::string> FingerprintExecutable() const override {
-    return Unimplemented("Fingerprinting executable is not supported.");
-  }
+  // Returns a fingerprint of the optimized module, including its constants,
+  // and of the compile options. It is stable across processes and
+  // serialization, so it can key caches of executables.
+  StatusOr<std::string> FingerprintExecutable() const override;
 
  private:
   friend class TfrtCpuClient;
@@ -468,7 +611,6 @@ class TfrtCpuExecutable final : public PjRtLoadedExecutable {
   StatusOr<Result> ExecuteHelper(
       absl::Span<PjRtBuffer* const> argument_handles, int replica,
       int partition, const RunId& run_id, const ExecuteOptions& options,
-      tsl::AsyncValueRef<runtime::CpuEvent> last_collective_launch_event,
       bool fill_future, TfrtCpuDevice* device = nullptr);
 
   TfrtCpuClient* client_;
@@ -510,9 +652,17 @@ class TfrtCpuExecutable final : public PjRtLoadedExecutable {
   // unique_ptrs to play well with the Python bindings (see xla.cc).
   std::vector<PjRtDevice*> addressable_devices_;
 
-  // Cached result of comparing HloCostAnalysis FLOP estimate for execute
-  // critical path.
-  bool cheap_computation_;
+  // Whether to run the computation inline when neither `ExecuteOptions` nor
+  // pending inputs decide. Shared with asynchronous runs, which record their
+  // run time after the executable may have been destroyed.
+  std::shared_ptr<CpuExecuteDispatchPolicy> dispatch_policy_;
+
+  // Whether the program contains collectives, whose executions must not run
+  // on the fixed-size client thread pool.
+  bool has_collectives_;
+
+  // Memory for the temporary buffers of the computation, reused across runs.
+  std::unique_ptr<CpuTempArena> temp_arena_;
 };
 
 struct CpuClientOptions {
@@ -535,6 +685,28 @@ struct CpuClientOptions {
   // KV store primitives for sharing topology information.
   PjRtClient::KeyValueGetCallback kv_get = nullptr;
   PjRtClient::KeyValuePutCallback kv_put = nullptr;
+
+  // Distributed collectives implementation. Optional. If not provided, an
+  // in-process collectives implementation will be used, which only supports
+  // collectives between the devices of this process.
+  std::shared_ptr<cpu::CollectivesInterface> collectives;
+
+  // Upper bound on the memory of freed executable output buffers and
+  // temporary slabs that the client keeps for reuse by later executions, over
+  // all of its executables. Zero disables pooling.
+  size_t output_buffer_pool_bytes = size_t{256} << 20;
+
+  // Whether to bind the CPU devices of this process to the NUMA nodes of the
+  // host, round robin. The devices of a node then run their programs and
+  // host transfers on threads bound to its cores, with a separate intra-op
+  // thread pool and output buffer pool per node, so that their buffers are
+  // placed in its memory. Cheap programs that would otherwise run inline on
+  // the caller's thread run on the node's threads too, and programs with
+  // collectives bind the thread they run on to the node. Only executions of
+  // programs without collectives that request ExecutionMode::kSynchronous
+  // still run on the caller's thread, wherever it is. Has no effect on hosts
+  // with a single NUMA node or in builds without NUMA support.
+  bool numa_aware = false;
 };
 StatusOr<std::unique_ptr<PjRtClient>> GetTfrtCpuClient(
     const CpuClientOptions& options);
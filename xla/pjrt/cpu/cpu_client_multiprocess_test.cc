@@ -0,0 +1,227 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Runs TfrtCpuClients in separate processes that run collectives over
+// TcpCollectives. The test binary invokes itself once per node.
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_replace.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "xla/pjrt/cpu/cpu_client.h"
+#include "xla/pjrt/cpu/tcp_collectives.h"
+#include "xla/pjrt/pjrt_client.h"
+#include "xla/service/hlo_parser.h"
+#include "xla/shape_util.h"
+#include "xla/status.h"
+#include "xla/statusor.h"
+#include "xla/util.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/logging.h"
+#include "tsl/platform/path.h"
+#include "tsl/platform/statusor.h"
+#include "tsl/platform/subprocess.h"
+#include "tsl/platform/test.h"
+#include "tsl/util/command_line_flags.h"
+
+namespace xla {
+namespace {
+
+const char* binary_name;
+
+constexpr int kNumNodes = 3;
+
+// Stands in for the key-value store of the distributed runtime. Every key is
+// a file in `directory`, which is shared by all nodes.
+class FileKeyValueStore {
+ public:
+  explicit FileKeyValueStore(std::string directory)
+      : directory_(std::move(directory)) {}
+
+  StatusOr<std::string> Get(std::string_view key, absl::Duration timeout) {
+    std::string path = Path(key);
+    absl::Time deadline = absl::Now() + timeout;
+    while (!tsl::Env::Default()->FileExists(path).ok()) {
+      if (absl::Now() >= deadline) {
+        return tsl::errors::DeadlineExceeded("Key not found: ", key);
+      }
+      absl::SleepFor(absl::Milliseconds(10));
+    }
+    std::string value;
+    TF_RETURN_IF_ERROR(
+        tsl::ReadFileToString(tsl::Env::Default(), path, &value));
+    return value;
+  }
+
+  // Writes the value under a temporary name first so that readers never see
+  // a partially written value.
+  Status Put(std::string_view key, std::string_view value) {
+    std::string path = Path(key);
+    std::string tmp_path = absl::StrCat(path, ".tmp.", getpid());
+    TF_RETURN_IF_ERROR(
+        tsl::WriteStringToFile(tsl::Env::Default(), tmp_path, value));
+    return tsl::Env::Default()->RenameFile(tmp_path, path);
+  }
+
+ private:
+  std::string Path(std::string_view key) const {
+    return tsl::io::JoinPath(directory_,
+                             absl::StrReplaceAll(key, {{"/", "%"}}));
+  }
+
+  std::string directory_;
+};
+
+// Body of the node processes: all-reduces the node id plus one across the
+// nodes, so that every node must receive the value of every other node.
+Status RunNode(int node_id, int num_nodes, const std::string& kv_dir) {
+  constexpr char kProgram[] = R"(
+    HloModule all_reduce
+
+    add {
+      x = f32[] parameter(0)
+      y = f32[] parameter(1)
+      ROOT add = f32[] add(x, y)
+    }
+
+    ENTRY all_reduce {
+      p = f32[1024] parameter(0)
+      ROOT ar = f32[1024] all-reduce(p), replica_groups={}, to_apply=add
+    })";
+
+  auto store = std::make_shared<FileKeyValueStore>(kv_dir);
+  CpuClientOptions options;
+  options.cpu_device_count = 1;
+  options.node_id = node_id;
+  options.num_nodes = num_nodes;
+  options.kv_get = [store](std::string_view key, absl::Duration timeout) {
+    return store->Get(key, timeout);
+  };
+  options.kv_put = [store](std::string_view key, std::string_view value) {
+    return store->Put(key, value);
+  };
+  cpu::TcpCollectives::Options tcp_options;
+  tcp_options.hostname = "localhost";
+  tcp_options.connect_timeout = absl::Seconds(60);
+  options.collectives = std::make_shared<cpu::TcpCollectives>(
+      options.kv_get, options.kv_put, tcp_options);
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<PjRtClient> client,
+                      GetTfrtCpuClient(options));
+  TF_RET_CHECK(client->device_count() == num_nodes);
+  TF_RET_CHECK(client->addressable_device_count() == 1);
+
+  TF_ASSIGN_OR_RETURN(auto hlo_module,
+                      ParseAndReturnUnverifiedModule(kProgram, {}));
+  XlaComputation xla_computation(hlo_module->ToProto());
+  CompileOptions compile_options;
+  compile_options.executable_build_options.set_num_replicas(num_nodes);
+  TF_ASSIGN_OR_RETURN(auto executable,
+                      client->Compile(xla_computation, compile_options));
+
+  Shape shape = ShapeUtil::MakeShape(F32, {1024});
+  std::vector<float> data(1024, node_id + 1);
+  const float expected = num_nodes * (num_nodes + 1) / 2;
+  // Runs several times so that later executions reuse the communicator.
+  for (int run = 0; run < 3; ++run) {
+    TF_ASSIGN_OR_RETURN(
+        auto buffer,
+        client->BufferFromHostBuffer(
+            data.data(), shape.element_type(), shape.dimensions(),
+            /*byte_strides=*/std::nullopt,
+            PjRtClient::HostBufferSemantics::kImmutableOnlyDuringCall,
+            nullptr, client->addressable_devices()[0]));
+    TF_ASSIGN_OR_RETURN(auto result,
+                        executable->Execute({{buffer.get()}}, ExecuteOptions()));
+    TF_RET_CHECK(result.size() == 1 && result[0].size() == 1);
+    TF_ASSIGN_OR_RETURN(auto literal, result[0][0]->ToLiteralSync());
+    for (float value : literal->data<float>()) {
+      if (value != expected) {
+        return Internal("Node %d run %d: expected %f, got %f", node_id, run,
+                        expected, value);
+      }
+    }
+  }
+  return OkStatus();
+}
+
+TEST(TfrtCpuClientMultiProcessTest, AllReduceAcrossProcesses) {
+  std::string kv_dir =
+      tsl::io::JoinPath(testing::TmpDir(), absl::StrCat("kv_", getpid()));
+  TF_ASSERT_OK(tsl::Env::Default()->RecursivelyCreateDir(kv_dir));
+
+  std::vector<std::unique_ptr<tsl::SubProcess>> nodes;
+  for (int node_id = 0; node_id < kNumNodes; ++node_id) {
+    auto node = std::make_unique<tsl::SubProcess>();
+    node->SetProgram(binary_name,
+                     {binary_name, absl::StrCat("--node_id=", node_id),
+                      absl::StrCat("--num_nodes=", kNumNodes),
+                      absl::StrCat("--kv_dir=", kv_dir)});
+    node->SetChannelAction(tsl::CHAN_STDOUT, tsl::ACTION_PIPE);
+    node->SetChannelAction(tsl::CHAN_STDERR, tsl::ACTION_PIPE);
+    ASSERT_TRUE(node->Start()) << "node " << node_id;
+    nodes.push_back(std::move(node));
+  }
+  for (int node_id = 0; node_id < kNumNodes; ++node_id) {
+    std::string stdout_str;
+    std::string stderr_str;
+    int status =
+        nodes[node_id]->Communicate(nullptr, &stdout_str, &stderr_str);
+    EXPECT_EQ(status, 0) << "node " << node_id << "\nstdout\n"
+                         << stdout_str << "\nstderr\n"
+                         << stderr_str;
+  }
+}
+
+}  // namespace
+}  // namespace xla
+
+int main(int argc, char* argv[]) {
+  // Save name of binary so that it may invoke itself.
+  xla::binary_name = argv[0];
+  int32_t node_id = -1;
+  int32_t num_nodes = 1;
+  std::string kv_dir;
+  const std::vector<tsl::Flag> flag_list = {
+      tsl::Flag("node_id", &node_id,
+                "Node to run as when the binary invokes itself."),
+      tsl::Flag("num_nodes", &num_nodes, "Number of nodes."),
+      tsl::Flag("kv_dir", &kv_dir, "Directory of the key-value store."),
+  };
+  std::string usage = tsl::Flags::Usage(argv[0], flag_list);
+  if (!tsl::Flags::Parse(&argc, argv, flag_list)) {
+    LOG(QFATAL) << usage;
+  }
+  if (node_id >= 0) {
+    xla::Status status = xla::RunNode(node_id, num_nodes, kv_dir);
+    if (!status.ok()) {
+      LOG(ERROR) << status;
+      return 1;
+    }
+    return 0;
+  }
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -18,15 +18,24 @@ limitations under the License.
 #include <unistd.h>
 
 #include <algorithm>
+#include <cstdint>
 #include <cstring>
+#include <memory>
 #include <string>
+#include <utility>
+#include <variant>
 #include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "absl/strings/str_cat.h"
 #include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+#include "xla/layout.h"
 #include "xla/literal.h"
 #include "xla/literal_util.h"
+#include "xla/pjrt/metrics.h"
+#include "xla/service/cpu/compilation_cache.h"
 #include "xla/service/custom_call_status.h"
 #include "xla/service/custom_call_target_registry.h"
 #include "xla/service/hlo_parser.h"
@@ -36,12 +45,17 @@ limitations under the License.
 #include "xla/tests/test_utils.h"
 #include "xla/util.h"
 #include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/casts.h"
 #include "tsl/platform/env.h"
 #include "tsl/platform/errors.h"
 #include "tsl/platform/file_system.h"
+#include "tsl/platform/numa.h"
+#include "tsl/platform/path.h"
 #include "tsl/platform/status_matchers.h"
 #include "tsl/platform/statusor.h"
 #include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
+#include "tsl/platform/threadpool.h"
 
 namespace xla {
 namespace {
@@ -50,6 +64,8 @@ using ::testing::Each;
 using ::testing::ElementsAreArray;
 using ::testing::HasSubstr;
 using ::testing::IsFalse;
+using ::testing::Not;
+using ::tsl::testing::IsOkAndHolds;
 
 void TestError(void* out, const void** in, XlaCustomCallStatus* status) {
   static constexpr char kError[] = "test error.";
@@ -164,6 +180,288 @@ TEST(TfrtCpuClientTest, HloSnapshot) {
       LiteralUtil::CreateR2<float>({{11.0, 22.0}, {33.0, 44.0}, {55.0, 66.0}}));
 }
 
+TEST(TfrtCpuClientTest, CompilationCache) {
+  constexpr char kProgram[] = R"(
+    HloModule cached
+    ENTRY cached {
+      x = f32[3,2] parameter(0)
+      c = f32[3,2] constant({{1, 2}, {3, 4}, {5, 6}})
+      t = f32[3,2] multiply(x, c)
+      ROOT out = (f32[3,2], f32[3,2]) tuple(t, c)
+    })";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(CpuClientOptions()));
+  TF_ASSERT_OK_AND_ASSIGN(auto hlo_module,
+                          ParseAndReturnUnverifiedModule(kProgram, {}));
+  XlaComputation xla_computation(hlo_module->ToProto());
+  xla::CompileOptions options;
+  options.executable_build_options.mutable_debug_options()
+      ->set_xla_cpu_compilation_cache_dir(
+          tsl::io::JoinPath(tsl::testing::TmpDir(), "compilation_cache"));
+
+  std::vector<float> data{1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+  Shape shape = ShapeUtil::MakeShape(F32, {3, 2});
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto buffer,
+      client->BufferFromHostBuffer(
+          data.data(), shape.element_type(), shape.dimensions(),
+          /*byte_strides=*/std::nullopt,
+          PjRtClient::HostBufferSemantics::kImmutableOnlyDuringCall, nullptr,
+          client->addressable_devices()[0]));
+  auto check_results = [&](PjRtLoadedExecutable* executable) {
+    TF_ASSERT_OK_AND_ASSIGN(
+        auto result,
+        executable->Execute(/*argument_handles=*/{{buffer.get()}},
+                            /*options=*/{}));
+    ASSERT_EQ(result[0].size(), 2);
+    TF_ASSERT_OK_AND_ASSIGN(auto product, result[0][0]->ToLiteralSync());
+    EXPECT_EQ(*product, LiteralUtil::CreateR2<float>(
+                            {{1.0, 4.0}, {9.0, 16.0}, {25.0, 36.0}}));
+    TF_ASSERT_OK_AND_ASSIGN(auto constant, result[0][1]->ToLiteralSync());
+    EXPECT_EQ(*constant, LiteralUtil::CreateR2<float>(
+                             {{1.0, 2.0}, {3.0, 4.0}, {5.0, 6.0}}));
+  };
+
+  int64_t hits = cpu::GetCompilationCacheHits();
+  TF_ASSERT_OK_AND_ASSIGN(auto compiled,
+                          client->Compile(xla_computation, options));
+  EXPECT_EQ(cpu::GetCompilationCacheHits(), hits);
+  check_results(compiled.get());
+
+  // Destroy the executable, so that the client doesn't share it with the next
+  // compilation.
+  compiled.reset();
+  TF_ASSERT_OK_AND_ASSIGN(auto cached,
+                          client->Compile(xla_computation, options));
+  EXPECT_EQ(cpu::GetCompilationCacheHits(), hits + 1);
+  check_results(cached.get());
+}
+
+TEST(TfrtCpuClientTest, SharesLiveExecutables) {
+  constexpr char kProgram[] = R"(
+    HloModule add
+    ENTRY add {
+      x = f32[4] parameter(0)
+      ROOT add = f32[4] add(x, x)
+    })";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(CpuClientOptions()));
+  TF_ASSERT_OK_AND_ASSIGN(auto hlo_module,
+                          ParseAndReturnUnverifiedModule(kProgram, {}));
+  XlaComputation xla_computation(hlo_module->ToProto());
+  auto cpu_executable = [](const PjRtLoadedExecutable& executable) {
+    return tensorflow::down_cast<const TfrtCpuExecutable*>(&executable)
+        ->cpu_executable();
+  };
+
+  TF_ASSERT_OK_AND_ASSIGN(auto first, client->Compile(xla_computation, {}));
+  TF_ASSERT_OK_AND_ASSIGN(auto second, client->Compile(xla_computation, {}));
+  EXPECT_EQ(cpu_executable(*first), cpu_executable(*second));
+
+  xla::CompileOptions other_options;
+  other_options.executable_build_options.mutable_debug_options()
+      ->set_xla_cpu_enable_fast_math(true);
+  TF_ASSERT_OK_AND_ASSIGN(auto other,
+                          client->Compile(xla_computation, other_options));
+  EXPECT_NE(cpu_executable(*first), cpu_executable(*other));
+
+  TF_ASSERT_OK_AND_ASSIGN(std::string serialized, first->SerializeExecutable());
+  TF_ASSERT_OK_AND_ASSIGN(auto deserialized,
+                          client->DeserializeExecutable(serialized, {}));
+  TF_ASSERT_OK_AND_ASSIGN(auto deserialized_again,
+                          client->DeserializeExecutable(serialized, {}));
+  EXPECT_EQ(cpu_executable(*deserialized), cpu_executable(*deserialized_again));
+}
+
+TEST(TfrtCpuClientTest, FingerprintExecutable) {
+  constexpr char kProgram[] = R"(
+    HloModule add
+    ENTRY add {
+      x = f32[4] parameter(0)
+      c = f32[4] constant({1, 2, 3, 4})
+      ROOT add = f32[4] add(x, c)
+    })";
+  constexpr char kOtherProgram[] = R"(
+    HloModule add
+    ENTRY add {
+      x = f32[4] parameter(0)
+      c = f32[4] constant({1, 2, 3, 5})
+      ROOT add = f32[4] add(x, c)
+    })";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(CpuClientOptions()));
+  auto compile = [&](const char* program) {
+    auto hlo_module = ParseAndReturnUnverifiedModule(program, {}).value();
+    return client->Compile(XlaComputation(hlo_module->ToProto()), {}).value();
+  };
+  auto executable = compile(kProgram);
+  TF_ASSERT_OK_AND_ASSIGN(std::string fingerprint,
+                          executable->FingerprintExecutable());
+  EXPECT_FALSE(fingerprint.empty());
+
+  // Recompiling the program, even from another client, or reloading the
+  // executable gives the same fingerprint.
+  TF_ASSERT_OK_AND_ASSIGN(auto other_client,
+                          GetTfrtCpuClient(CpuClientOptions()));
+  auto hlo_module = ParseAndReturnUnverifiedModule(kProgram, {}).value();
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto recompiled,
+      other_client->Compile(XlaComputation(hlo_module->ToProto()), {}));
+  EXPECT_THAT(recompiled->FingerprintExecutable(), IsOkAndHolds(fingerprint));
+  TF_ASSERT_OK_AND_ASSIGN(std::string serialized,
+                          executable->SerializeExecutable());
+  TF_ASSERT_OK_AND_ASSIGN(auto deserialized,
+                          other_client->DeserializeExecutable(serialized, {}));
+  EXPECT_THAT(deserialized->FingerprintExecutable(), IsOkAndHolds(fingerprint));
+
+  // Programs differing only in a constant have different fingerprints.
+  EXPECT_THAT(compile(kOtherProgram)->FingerprintExecutable(),
+              Not(IsOkAndHolds(fingerprint)));
+}
+
+// Launches many all-reduce programs from several threads without waiting for
+// them, so that far more participants are blocked in rendezvous at once than
+// the client thread pool has threads.
+TEST(TfrtCpuClientTest, ConcurrentCollectiveExecutions) {
+  constexpr int kNumDevices = 4;
+  constexpr int kNumLaunchingThreads = 8;
+  constexpr int kLaunchesPerThread = 16;
+  constexpr char kProgram[] = R"(
+    HloModule all_reduce, replica_count=4
+
+    add {
+      x = f32[] parameter(0)
+      y = f32[] parameter(1)
+      ROOT add = f32[] add(x, y)
+    }
+
+    ENTRY all_reduce {
+      p = f32[8] parameter(0)
+      ROOT ar = f32[8] all-reduce(p), replica_groups={}, to_apply=add
+    })";
+
+  CpuClientOptions cpu_options;
+  cpu_options.cpu_device_count = kNumDevices;
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(cpu_options));
+  TF_ASSERT_OK_AND_ASSIGN(auto hlo_module,
+                          ParseAndReturnUnverifiedModule(kProgram, {}));
+  XlaComputation xla_computation(hlo_module->ToProto());
+  xla::CompileOptions compile_options;
+  compile_options.executable_build_options.set_num_replicas(kNumDevices);
+  TF_ASSERT_OK_AND_ASSIGN(auto executable,
+                          client->Compile(xla_computation, compile_options));
+
+  ExecuteOptions execute_options;
+  execute_options.execution_mode = ExecuteOptions::ExecutionMode::kAsynchronous;
+  Shape shape = ShapeUtil::MakeShape(F32, {8});
+
+  auto launch_and_check = [&](int thread_index) {
+    std::vector<std::unique_ptr<PjRtBuffer>> buffers;
+    std::vector<std::vector<std::vector<std::unique_ptr<PjRtBuffer>>>> results;
+    for (int i = 0; i < kLaunchesPerThread; ++i) {
+      const float value = thread_index * kLaunchesPerThread + i;
+      std::vector<std::vector<PjRtBuffer*>> arguments;
+      for (int d = 0; d < kNumDevices; ++d) {
+        std::vector<float> data(8, value + d);
+        TF_ASSERT_OK_AND_ASSIGN(
+            auto buffer,
+            client->BufferFromHostBuffer(
+                data.data(), shape.element_type(), shape.dimensions(),
+                /*byte_strides=*/std::nullopt,
+                PjRtClient::HostBufferSemantics::kImmutableOnlyDuringCall,
+                nullptr, client->addressable_devices()[d]));
+        arguments.push_back({buffer.get()});
+        buffers.push_back(std::move(buffer));
+      }
+      TF_ASSERT_OK_AND_ASSIGN(auto result,
+                              executable->Execute(arguments, execute_options));
+      results.push_back(std::move(result));
+    }
+    for (int i = 0; i < kLaunchesPerThread; ++i) {
+      const float value = thread_index * kLaunchesPerThread + i;
+      const float sum =
+          kNumDevices * value + kNumDevices * (kNumDevices - 1) / 2;
+      ASSERT_EQ(results[i].size(), kNumDevices);
+      for (int d = 0; d < kNumDevices; ++d) {
+        TF_ASSERT_OK_AND_ASSIGN(auto literal,
+                                results[i][d][0]->ToLiteralSync());
+        EXPECT_THAT(literal->data<float>(), Each(sum));
+      }
+    }
+  };
+
+  {
+    tsl::thread::ThreadPool pool(tsl::Env::Default(), "launch",
+                                 kNumLaunchingThreads);
+    for (int t = 0; t < kNumLaunchingThreads; ++t) {
+      pool.Schedule([&, t] { launch_and_check(t); });
+    }
+  }
+}
+
+TEST(CpuExecuteDispatchPolicyTest, FollowsMeasuredRunTime) {
+  CpuExecuteDispatchPolicy policy(absl::Microseconds(1));
+  EXPECT_TRUE(policy.ShouldExecuteInline());
+
+  // The first measurement replaces the estimate.
+  policy.RecordRunTime(absl::Microseconds(100));
+  EXPECT_FALSE(policy.ShouldExecuteInline());
+  EXPECT_EQ(policy.expected_run_time(), absl::Microseconds(100));
+
+  // Later ones move the average towards them.
+  policy.RecordRunTime(absl::Microseconds(1));
+  EXPECT_FALSE(policy.ShouldExecuteInline());
+  for (int i = 0; i < 32; ++i) {
+    policy.RecordRunTime(absl::Microseconds(1));
+  }
+  EXPECT_TRUE(policy.ShouldExecuteInline());
+}
+
+// Returns a program adding a f32[n] parameter to itself `k` times.
+std::string AddProgram(int64_t n, int k) {
+  std::string program = absl::StrCat("HloModule add\nENTRY add {\n  x0 = f32[",
+                                     n, "] parameter(0)\n");
+  for (int i = 1; i <= k; ++i) {
+    absl::StrAppend(&program, "  x", i, " = f32[", n, "] add(x", i - 1,
+                    ", x0)\n");
+  }
+  absl::StrAppend(&program, "  ROOT out = f32[", n, "] copy(x", k, ")\n}\n");
+  return program;
+}
+
+TEST(TfrtCpuClientTest, DispatchesByCost) {
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(CpuClientOptions()));
+  for (int64_t n : {4, 1 << 20}) {
+    TF_ASSERT_OK_AND_ASSIGN(
+        auto hlo_module,
+        ParseAndReturnUnverifiedModule(AddProgram(n, /*k=*/4), {}));
+    XlaComputation xla_computation(hlo_module->ToProto());
+    TF_ASSERT_OK_AND_ASSIGN(auto executable,
+                            client->Compile(xla_computation, {}));
+
+    std::vector<float> data(n, 1.0);
+    Shape shape = ShapeUtil::MakeShape(F32, {n});
+    TF_ASSERT_OK_AND_ASSIGN(
+        auto buffer,
+        client->BufferFromHostBuffer(
+            data.data(), shape.element_type(), shape.dimensions(),
+            /*byte_strides=*/std::nullopt,
+            PjRtClient::HostBufferSemantics::kImmutableOnlyDuringCall, nullptr,
+            client->addressable_devices()[0]));
+    // Make sure the argument is ready, so that the launch is not deferred.
+    TF_ASSERT_OK(buffer->GetReadyFuture().Await());
+
+    const bool expect_inline = n == 4;
+    const int64_t executions = metrics::GetCpuExecutions(expect_inline);
+    TF_ASSERT_OK_AND_ASSIGN(
+        auto result, executable->Execute(/*argument_handles=*/{{buffer.get()}},
+                                         /*options=*/{}));
+    TF_ASSERT_OK_AND_ASSIGN(auto literal, result[0][0]->ToLiteralSync());
+    EXPECT_THAT(literal->data<float>(), Each(5.0));
+    EXPECT_EQ(metrics::GetCpuExecutions(expect_inline), executions + 1);
+  }
+}
+
 TEST(TfrtCpuClientTest, AsyncTransferRawData) {
   TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(CpuClientOptions()));
   xla::Shape shape = ShapeUtil::MakeShape(U32, {3, 2});
@@ -313,5 +611,235 @@ TEST(TfrtCpuClientTest, AsyncTransferRawDataToSubBuffer) {
   EXPECT_THAT(literal->data<uint32_t>(), Each(0x42424242));
 }
 
+TEST(TfrtCpuClientTest, MemorySpaces) {
+  CpuClientOptions options;
+  options.cpu_device_count = 2;
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(options));
+  EXPECT_EQ(client->memory_spaces().size(),
+            3 * client->addressable_device_count());
+
+  for (PjRtDevice* device : client->addressable_devices()) {
+    ASSERT_EQ(device->memory_spaces().size(), 3);
+    TF_ASSERT_OK_AND_ASSIGN(PjRtMemorySpace * default_memory_space,
+                            device->default_memory_space());
+    EXPECT_EQ(default_memory_space->memory_space_kind(), "device");
+    for (absl::string_view kind : {"device", "pinned_host", "unpinned_host"}) {
+      TF_ASSERT_OK_AND_ASSIGN(PjRtMemorySpace * memory_space,
+                              device->memory_space_by_kind(kind));
+      EXPECT_EQ(memory_space->memory_space_kind(), kind);
+      EXPECT_EQ(memory_space->client(), client.get());
+      EXPECT_THAT(memory_space->devices(), ElementsAreArray({device}));
+    }
+    EXPECT_FALSE(device->memory_space_by_kind("hbm").ok());
+  }
+}
+
+TEST(TfrtCpuClientTest, CopyBetweenMemorySpaces) {
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(CpuClientOptions()));
+  PjRtDevice* device = client->addressable_devices()[0];
+  TF_ASSERT_OK_AND_ASSIGN(PjRtMemorySpace * device_memory,
+                          device->default_memory_space());
+  TF_ASSERT_OK_AND_ASSIGN(PjRtMemorySpace * pinned_host,
+                          device->memory_space_by_kind("pinned_host"));
+
+  Literal literal = LiteralUtil::CreateR1<float>({1, 2, 3, 4});
+  TF_ASSERT_OK_AND_ASSIGN(auto host_buffer,
+                          client->BufferFromHostLiteral(literal, pinned_host));
+  EXPECT_EQ(host_buffer->memory_space(), pinned_host);
+  EXPECT_EQ(host_buffer->device(), device);
+  EXPECT_EQ(host_buffer->on_device_shape().layout().memory_space(),
+            Layout::kHostMemorySpace);
+
+  TF_ASSERT_OK_AND_ASSIGN(auto device_buffer,
+                          host_buffer->CopyToMemorySpace(device_memory));
+  EXPECT_EQ(device_buffer->memory_space(), device_memory);
+  EXPECT_EQ(device_buffer->on_device_shape().layout().memory_space(),
+            Layout::kDefaultMemorySpace);
+  TF_ASSERT_OK_AND_ASSIGN(auto result, device_buffer->ToLiteralSync());
+  EXPECT_THAT(result->data<float>(),
+              ElementsAreArray({1.0f, 2.0f, 3.0f, 4.0f}));
+
+  EXPECT_FALSE(device_buffer->CopyToMemorySpace(device_memory).ok());
+}
+
+TEST(TfrtCpuClientTest, OffloadsToPinnedHostMemory) {
+  // Takes its argument from and returns its result to host memory, the way
+  // programs rewritten by host offloading do.
+  constexpr char kProgram[] = R"(
+    HloModule offload, entry_computation_layout={(f32[4]{0:S(5)})->f32[4]{0:S(5)}}
+    ENTRY offload {
+      x = f32[4]{0:S(5)} parameter(0)
+      copy_in = f32[4]{0} copy(x)
+      add = f32[4]{0} add(copy_in, copy_in)
+      ROOT copy_out = f32[4]{0:S(5)} copy(add)
+    })";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(CpuClientOptions()));
+  TF_ASSERT_OK_AND_ASSIGN(auto hlo_module,
+                          ParseAndReturnUnverifiedModule(kProgram, {}));
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto executable,
+      client->Compile(XlaComputation(hlo_module->ToProto()), {}));
+  EXPECT_THAT(executable->GetOutputMemoryKinds(),
+              IsOkAndHolds(ElementsAreArray(
+                  {std::vector<absl::string_view>{"pinned_host"}})));
+
+  PjRtDevice* device = client->addressable_devices()[0];
+  TF_ASSERT_OK_AND_ASSIGN(PjRtMemorySpace * pinned_host,
+                          device->memory_space_by_kind("pinned_host"));
+  std::vector<float> data = {1, 2, 3, 4};
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto buffer,
+      client->BufferFromHostBuffer(
+          data.data(), F32, {4}, /*byte_strides=*/std::nullopt,
+          PjRtClient::HostBufferSemantics::kImmutableOnlyDuringCall, nullptr,
+          pinned_host, /*device_layout=*/nullptr));
+
+  TF_ASSERT_OK_AND_ASSIGN(auto results,
+                          executable->Execute({{buffer.get()}}, {}));
+  ASSERT_EQ(results.size(), 1);
+  ASSERT_EQ(results[0].size(), 1);
+  EXPECT_EQ(results[0][0]->memory_space(), pinned_host);
+  TF_ASSERT_OK_AND_ASSIGN(auto result, results[0][0]->ToLiteralSync());
+  EXPECT_THAT(result->data<float>(),
+              ElementsAreArray({2.0f, 4.0f, 6.0f, 8.0f}));
+}
+
+TEST(TfrtCpuClientTest, OutputsInDeviceMemory) {
+  constexpr char kProgram[] = R"(
+    HloModule add
+    ENTRY add {
+      x = f32[4] parameter(0)
+      ROOT add = (f32[4], f32[4]) tuple(x, x)
+    })";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(CpuClientOptions()));
+  TF_ASSERT_OK_AND_ASSIGN(auto hlo_module,
+                          ParseAndReturnUnverifiedModule(kProgram, {}));
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto executable,
+      client->Compile(XlaComputation(hlo_module->ToProto()), {}));
+  EXPECT_THAT(executable->GetOutputMemoryKinds(),
+              IsOkAndHolds(ElementsAreArray(
+                  {std::vector<absl::string_view>{"device", "device"}})));
+}
+
+TEST(TfrtCpuClientTest, AsyncTransferToMemorySpace) {
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(CpuClientOptions()));
+  TF_ASSERT_OK_AND_ASSIGN(
+      PjRtMemorySpace * unpinned_host,
+      client->addressable_devices()[0]->memory_space_by_kind("unpinned_host"));
+  xla::Shape shape = ShapeUtil::MakeShape(U32, {3, 2});
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto transfer_manager,
+      client->CreateBuffersForAsyncHostToDevice({shape}, unpinned_host));
+  EXPECT_EQ(transfer_manager->RetrieveBuffer(0)->memory_space(),
+            unpinned_host);
+}
+
+TEST(TfrtCpuClientTest, NumaNodeAttribute) {
+  TfrtCpuDevice unbound(/*id=*/0, /*process_index=*/0,
+                        /*local_hardware_id=*/0);
+  EXPECT_EQ(unbound.numa_node(), tsl::port::kNUMANoAffinity);
+  EXPECT_FALSE(unbound.Attributes().contains("numa_node"));
+
+  TfrtCpuDevice bound(/*id=*/1, /*process_index=*/0, /*local_hardware_id=*/1,
+                      /*max_inflight_computations=*/32, /*numa_node=*/1);
+  EXPECT_EQ(bound.numa_node(), 1);
+  ASSERT_TRUE(bound.Attributes().contains("numa_node"));
+  EXPECT_EQ(std::get<int64_t>(bound.Attributes().at("numa_node")), 1);
+}
+
+TEST(TfrtCpuClientTest, NumaAwareDevices) {
+  constexpr char kProgram[] = R"(
+    HloModule add
+    ENTRY add {
+      x = f32[4] parameter(0)
+      ROOT add = f32[4] add(x, x)
+    })";
+
+  CpuClientOptions options;
+  options.cpu_device_count = 4;
+  options.numa_aware = true;
+  TF_ASSERT_OK_AND_ASSIGN(auto client, GetTfrtCpuClient(options));
+  const int numa_node_count =
+      tsl::port::NUMAEnabled() ? tsl::port::NUMANumNodes() : 0;
+  for (PjRtDevice* device : client->addressable_devices()) {
+    auto* cpu_device = tensorflow::down_cast<TfrtCpuDevice*>(device);
+    EXPECT_EQ(cpu_device->numa_node(),
+              numa_node_count > 0
+                  ? device->local_hardware_id() % numa_node_count
+                  : tsl::port::kNUMANoAffinity);
+  }
+
+  // Programs and transfers run on the threads of each device's node.
+  TF_ASSERT_OK_AND_ASSIGN(auto hlo_module,
+                          ParseAndReturnUnverifiedModule(kProgram, {}));
+  CompileOptions compile_options;
+  compile_options.compile_portable_executable = true;
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto executable,
+      client->Compile(XlaComputation(hlo_module->ToProto()), compile_options));
+  std::vector<float> data = {1, 2, 3, 4};
+  for (PjRtDevice* device : client->addressable_devices()) {
+    TF_ASSERT_OK_AND_ASSIGN(
+        auto buffer,
+        client->BufferFromHostBuffer(
+            data.data(), F32, {4}, /*byte_strides=*/std::nullopt,
+            PjRtClient::HostBufferSemantics::kImmutableOnlyDuringCall,
+            nullptr, device));
+    TF_ASSERT_OK_AND_ASSIGN(
+        auto results, executable->ExecutePortable({buffer.get()}, device, {}));
+    TF_ASSERT_OK_AND_ASSIGN(auto result, results[0]->ToLiteralSync());
+    EXPECT_THAT(result->data<float>(),
+                ElementsAreArray({2.0f, 4.0f, 6.0f, 8.0f}));
+  }
+}
+
+// Measures the latency of launching a program adding f32[n] vectors and
+// waiting for its result. `mode` selects automatic dispatch (0), or forces
+// asynchronous (1) or inline (2) execution.
+void BM_ExecuteLatency(::testing::benchmark::State& state) {
+  const int64_t n = state.range(0);
+  ExecuteOptions options;
+  if (state.range(1) == 1) {
+    options.execution_mode = ExecuteOptions::ExecutionMode::kAsynchronous;
+  } else if (state.range(1) == 2) {
+    options.execution_mode = ExecuteOptions::ExecutionMode::kSynchronous;
+  }
+
+  auto client = GetTfrtCpuClient(CpuClientOptions()).value();
+  auto hlo_module =
+      ParseAndReturnUnverifiedModule(AddProgram(n, /*k=*/1), {}).value();
+  auto executable =
+      client->Compile(XlaComputation(hlo_module->ToProto()), {}).value();
+
+  std::vector<float> data(n, 1.0);
+  Shape shape = ShapeUtil::MakeShape(F32, {n});
+  auto buffer =
+      client
+          ->BufferFromHostBuffer(
+              data.data(), shape.element_type(), shape.dimensions(),
+              /*byte_strides=*/std::nullopt,
+              PjRtClient::HostBufferSemantics::kImmutableOnlyDuringCall,
+              nullptr, client->addressable_devices()[0])
+          .value();
+  CHECK_OK(buffer->GetReadyFuture().Await());
+
+  for (auto s : state) {
+    auto result = executable->Execute({{buffer.get()}}, options).value();
+    CHECK_OK(result[0][0]->GetReadyFuture().Await());
+  }
+}
+
+BENCHMARK(BM_ExecuteLatency)
+    ->ArgNames({"n", "mode"})
+    ->Args({16, 0})
+    ->Args({16, 1})
+    ->Args({16, 2})
+    ->Args({1 << 20, 0})
+    ->Args({1 << 20, 1})
+    ->Args({1 << 20, 2});
+
 }  // namespace
 }  // namespace xla
@@ -0,0 +1,860 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/pjrt/cpu/tcp_collectives.h"
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/base/call_once.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "xla/pjrt/pjrt_client.h"
+#include "xla/primitive_util.h"
+#include "xla/service/collective_ops_utils.h"
+#include "xla/service/cpu/collective_reduction.h"
+#include "xla/service/cpu/collectives_interface.h"
+#include "xla/service/global_device_id.h"
+#include "xla/status.h"
+#include "xla/status_macros.h"
+#include "xla/statusor.h"
+#include "xla/util.h"
+#include "xla/xla_data.pb.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/host_info.h"
+#include "tsl/platform/logging.h"
+#include "tsl/platform/statusor.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Sent by the connecting side of every connection so that the accepting side
+// learns the rank of its peer.
+struct HelloMessage {
+  uint32_t magic;
+  int32_t rank;
+};
+constexpr uint32_t kHelloMagic = 0x58435443;  // "XCTC"
+
+// Precedes every message so that ranks that disagree about the sequence of
+// collectives fail instead of silently exchanging the wrong data.
+struct MessageHeader {
+  int64_t op_id;
+  int64_t num_bytes;
+};
+
+Status ErrnoError(absl::string_view what) {
+  return Internal("%s failed: %s", what, strerror(errno));
+}
+
+// Owns a socket file descriptor.
+class Socket {
+ public:
+  Socket() = default;
+  explicit Socket(int fd) : fd_(fd) {}
+  Socket(Socket&& other) noexcept : fd_(std::exchange(other.fd_, -1)) {}
+  Socket& operator=(Socket&& other) noexcept {
+    std::swap(fd_, other.fd_);
+    return *this;
+  }
+  ~Socket() {
+    if (fd_ >= 0) close(fd_);
+  }
+
+  int fd() const { return fd_; }
+
+ private:
+  int fd_ = -1;
+};
+
+// Returns the number of milliseconds until `deadline` to pass to poll().
+StatusOr<int> PollTimeout(absl::Time deadline) {
+  absl::Duration remaining = deadline - absl::Now();
+  if (remaining <= absl::ZeroDuration()) {
+    return tsl::errors::DeadlineExceeded(
+        "Timed out waiting for collectives peers");
+  }
+  return static_cast<int>(std::min<int64_t>(
+      absl::ToInt64Milliseconds(absl::Ceil(remaining, absl::Milliseconds(1))),
+      std::numeric_limits<int>::max()));
+}
+
+Status SetNonBlocking(const Socket& socket) {
+  int flags = fcntl(socket.fd(), F_GETFL, 0);
+  if (flags < 0 || fcntl(socket.fd(), F_SETFL, flags | O_NONBLOCK) < 0) {
+    return ErrnoError("fcntl");
+  }
+  return OkStatus();
+}
+
+// Returns a listening socket bound to an ephemeral port on all interfaces and
+// the port number. Prefers a dual-stack IPv6 socket and falls back to IPv4.
+StatusOr<std::pair<Socket, int>> Listen() {
+  Socket socket(::socket(AF_INET6, SOCK_STREAM, 0));
+  if (socket.fd() >= 0) {
+    int v6only = 0;
+    setsockopt(socket.fd(), IPPROTO_IPV6, IPV6_V6ONLY, &v6only,
+               sizeof(v6only));
+    sockaddr_in6 addr = {};
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_any;
+    addr.sin6_port = 0;
+    if (bind(socket.fd(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) <
+        0) {
+      socket = Socket();
+    }
+  }
+  if (socket.fd() < 0) {
+    socket = Socket(::socket(AF_INET, SOCK_STREAM, 0));
+    if (socket.fd() < 0) return ErrnoError("socket");
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = 0;
+    if (bind(socket.fd(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) <
+        0) {
+      return ErrnoError("bind");
+    }
+  }
+  if (listen(socket.fd(), SOMAXCONN) < 0) return ErrnoError("listen");
+  TF_RETURN_IF_ERROR(SetNonBlocking(socket));
+
+  sockaddr_storage addr;
+  socklen_t addr_len = sizeof(addr);
+  if (getsockname(socket.fd(), reinterpret_cast<sockaddr*>(&addr),
+                  &addr_len) < 0) {
+    return ErrnoError("getsockname");
+  }
+  int port = addr.ss_family == AF_INET6
+                 ? ntohs(reinterpret_cast<sockaddr_in6*>(&addr)->sin6_port)
+                 : ntohs(reinterpret_cast<sockaddr_in*>(&addr)->sin_port);
+  return std::make_pair(std::move(socket), port);
+}
+
+// Waits until `socket` is ready for `events` or `deadline` passes.
+Status WaitFor(const Socket& socket, int16_t events, absl::Time deadline) {
+  while (true) {
+    TF_ASSIGN_OR_RETURN(int timeout_ms, PollTimeout(deadline));
+    pollfd pfd = {socket.fd(), events, 0};
+    int n = poll(&pfd, 1, timeout_ms);
+    if (n > 0) return OkStatus();
+    if (n < 0 && errno != EINTR) return ErrnoError("poll");
+  }
+}
+
+// Starts a non-blocking connect of `socket` to `ai` and waits at most until
+// `deadline` for it to complete, so that an unresponsive peer cannot block the
+// caller for the kernel's connect timeout.
+Status ConnectWithDeadline(const Socket& socket, const addrinfo* ai,
+                           absl::Time deadline) {
+  TF_RETURN_IF_ERROR(SetNonBlocking(socket));
+  if (connect(socket.fd(), ai->ai_addr, ai->ai_addrlen) == 0) {
+    return OkStatus();
+  }
+  if (errno != EINPROGRESS && errno != EINTR) return ErrnoError("connect");
+  TF_RETURN_IF_ERROR(WaitFor(socket, POLLOUT, deadline));
+  int error = 0;
+  socklen_t error_len = sizeof(error);
+  if (getsockopt(socket.fd(), SOL_SOCKET, SO_ERROR, &error, &error_len) < 0) {
+    return ErrnoError("getsockopt");
+  }
+  if (error != 0) {
+    errno = error;
+    return ErrnoError("connect");
+  }
+  return OkStatus();
+}
+
+// Connects to `address` of the form "host:port", retrying until `deadline`.
+// Returns a non-blocking socket.
+StatusOr<Socket> Connect(absl::string_view address, absl::Time deadline) {
+  size_t colon = address.rfind(':');
+  if (colon == absl::string_view::npos) {
+    return InvalidArgument("Invalid collectives address: %s", address);
+  }
+  std::string host(address.substr(0, colon));
+  std::string port(address.substr(colon + 1));
+
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* result = nullptr;
+  int error = getaddrinfo(host.c_str(), port.c_str(), &hints, &result);
+  if (error != 0) {
+    return InvalidArgument("Failed to resolve %s: %s", address,
+                           gai_strerror(error));
+  }
+  std::unique_ptr<addrinfo, decltype(&freeaddrinfo)> cleanup(result,
+                                                             &freeaddrinfo);
+
+  Status last_error = OkStatus();
+  while (true) {
+    for (addrinfo* ai = result; ai != nullptr; ai = ai->ai_next) {
+      Socket socket(::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol));
+      if (socket.fd() < 0) {
+        last_error = ErrnoError("socket");
+        continue;
+      }
+      last_error = ConnectWithDeadline(socket, ai, deadline);
+      if (last_error.ok()) return std::move(socket);
+    }
+    if (absl::Now() >= deadline) {
+      return tsl::errors::DeadlineExceeded(
+          "Failed to connect to collectives peer at ", address, ": ",
+          last_error.message());
+    }
+    absl::SleepFor(absl::Milliseconds(10));
+  }
+}
+
+// Sends or receives exactly `size` bytes on a non-blocking socket.
+Status SendAll(const Socket& socket, const void* data, size_t size,
+               absl::Time deadline) {
+  const char* ptr = static_cast<const char*>(data);
+  while (size > 0) {
+    ssize_t n = send(socket.fd(), ptr, size, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        TF_RETURN_IF_ERROR(WaitFor(socket, POLLOUT, deadline));
+        continue;
+      }
+      if (errno == EINTR) continue;
+      return ErrnoError("send");
+    }
+    ptr += n;
+    size -= n;
+  }
+  return OkStatus();
+}
+
+Status RecvAll(const Socket& socket, void* data, size_t size,
+               absl::Time deadline) {
+  char* ptr = static_cast<char*>(data);
+  while (size > 0) {
+    ssize_t n = recv(socket.fd(), ptr, size, 0);
+    if (n == 0) return Unavailable("Collectives peer closed the connection");
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        TF_RETURN_IF_ERROR(WaitFor(socket, POLLIN, deadline));
+        continue;
+      }
+      if (errno == EINTR) continue;
+      return ErrnoError("recv");
+    }
+    ptr += n;
+    size -= n;
+  }
+  return OkStatus();
+}
+
+// Data sent to or received from one peer.
+struct SendOp {
+  int peer;
+  const void* data;
+  int64_t num_bytes;
+};
+
+struct RecvOp {
+  int peer;
+  void* data;
+  int64_t num_bytes;
+};
+
+// Checks that the header received for `recv` announces the expected message.
+Status CheckHeader(int64_t op_id, const RecvOp& recv,
+                   const MessageHeader& header) {
+  if (header.op_id != op_id || header.num_bytes != recv.num_bytes) {
+    return Internal(
+        "Collectives mismatch with rank %d: expected op %d with %d bytes, "
+        "received op %d with %d bytes",
+        recv.peer, op_id, recv.num_bytes, header.op_id, header.num_bytes);
+  }
+  return OkStatus();
+}
+
+class TcpCommunicator : public CollectivesCommunicator {
+ public:
+  // `sockets[i]` is connected to rank i; `sockets[rank]` is unused.
+  TcpCommunicator(int rank, std::vector<Socket> sockets)
+      : rank_(rank), size_(sockets.size()), sockets_(std::move(sockets)) {}
+
+  Status AllReduce(const RendezvousKey& key, ReductionKind reduction_kind,
+                   absl::Span<const AllReduceBuffer> buffers,
+                   absl::Duration timeout) override;
+
+  Status CollectivePermute(const RendezvousKey& key, int64_t num_bytes,
+                           std::optional<int> source_rank,
+                           absl::Span<int const> target_ranks,
+                           const void* input_buffer, void* output_buffer,
+                           absl::Duration timeout) override;
+
+  Status AllToAll(const RendezvousKey& key, int64_t chunk_bytes,
+                  absl::Span<const void* const> input_buffers,
+                  absl::Span<void* const> output_buffers,
+                  absl::Duration timeout) override;
+
+  Status AllGather(const RendezvousKey& key, int64_t outer_count,
+                   int64_t chunk_bytes, const void* input_buffer,
+                   void* output_buffer, absl::Duration timeout) override;
+
+  Status ReduceScatter(const RendezvousKey& key, ReductionKind reduction_kind,
+                       PrimitiveType element_type, int64_t outer_count,
+                       int64_t chunk_elements, const void* input_buffer,
+                       void* output_buffer, absl::Duration timeout) override;
+
+ private:
+  // Performs all `sends` and `recvs` concurrently and returns once all of
+  // them are complete. Messages to or from the same peer are matched in
+  // order, so both sides must list them in the same order.
+  //
+  // A failed exchange leaves the connections in an unknown position within
+  // the message stream, so it marks the communicator as broken and all later
+  // exchanges fail instead of reading misaligned data. It also closes the
+  // connections so that peers waiting for this rank fail right away rather
+  // than at their deadline.
+  Status Exchange(int64_t op_id, absl::Span<const SendOp> sends,
+                  absl::Span<const RecvOp> recvs, absl::Time deadline)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  Status Transfer(int64_t op_id, absl::Span<const SendOp> sends,
+                  absl::Span<const RecvOp> recvs, absl::Time deadline)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const int rank_;
+  const int size_;
+
+  // Collectives on one communicator run one at a time so that the messages
+  // of different collectives do not interleave on a connection.
+  absl::Mutex mu_;
+  std::vector<Socket> sockets_ ABSL_GUARDED_BY(mu_);
+  Status broken_ ABSL_GUARDED_BY(mu_);
+};
+
+Status TcpCommunicator::Exchange(int64_t op_id,
+                                 absl::Span<const SendOp> sends,
+                                 absl::Span<const RecvOp> recvs,
+                                 absl::Time deadline) {
+  TF_RETURN_IF_ERROR(broken_);
+  Status status = Transfer(op_id, sends, recvs, deadline);
+  if (!status.ok()) {
+    broken_ = Unavailable(
+        "TCP collectives communicator of rank %d is unusable after an "
+        "earlier error: %s",
+        rank_, status.message());
+    sockets_ = std::vector<Socket>(size_);
+  }
+  return status;
+}
+
+Status TcpCommunicator::Transfer(int64_t op_id,
+                                 absl::Span<const SendOp> sends,
+                                 absl::Span<const RecvOp> recvs,
+                                 absl::Time deadline) {
+  // Per-peer queues of byte ranges that still have to be transferred. A
+  // received header is checked as soon as it is complete, before the payload
+  // that follows it is read, so that ranks that disagree about the collective
+  // fail immediately instead of after the timeout or with corrupted outputs.
+  struct Range {
+    char* data;
+    int64_t size;
+    // Index into `recvs` of the message whose header this is, or -1.
+    int64_t header_of = -1;
+  };
+  struct PeerQueue {
+    std::vector<Range> out;
+    size_t out_index = 0;
+    int64_t out_offset = 0;
+    std::vector<Range> in;
+    size_t in_index = 0;
+    int64_t in_offset = 0;
+  };
+
+  std::vector<MessageHeader> send_headers(sends.size());
+  std::vector<MessageHeader> recv_headers(recvs.size());
+  std::vector<PeerQueue> queues(size_);
+  for (size_t i = 0; i < sends.size(); ++i) {
+    const SendOp& op = sends[i];
+    CHECK(op.peer != rank_ && op.peer >= 0 && op.peer < size_);
+    send_headers[i] = {op_id, op.num_bytes};
+    std::vector<Range>& out = queues[op.peer].out;
+    out.push_back({reinterpret_cast<char*>(&send_headers[i]),
+                   sizeof(MessageHeader)});
+    if (op.num_bytes > 0) {
+      out.push_back(
+          {const_cast<char*>(static_cast<const char*>(op.data)), op.num_bytes});
+    }
+  }
+  for (size_t i = 0; i < recvs.size(); ++i) {
+    const RecvOp& op = recvs[i];
+    CHECK(op.peer != rank_ && op.peer >= 0 && op.peer < size_);
+    std::vector<Range>& in = queues[op.peer].in;
+    in.push_back({reinterpret_cast<char*>(&recv_headers[i]),
+                  sizeof(MessageHeader), static_cast<int64_t>(i)});
+    if (op.num_bytes > 0) {
+      in.push_back({static_cast<char*>(op.data), op.num_bytes});
+    }
+  }
+
+  std::vector<pollfd> pfds;
+  std::vector<int> pfd_peers;
+  while (true) {
+    pfds.clear();
+    pfd_peers.clear();
+    for (int peer = 0; peer < size_; ++peer) {
+      const PeerQueue& q = queues[peer];
+      int16_t events = 0;
+      if (q.out_index < q.out.size()) events |= POLLOUT;
+      if (q.in_index < q.in.size()) events |= POLLIN;
+      if (events != 0) {
+        pfds.push_back({sockets_[peer].fd(), events, 0});
+        pfd_peers.push_back(peer);
+      }
+    }
+    if (pfds.empty()) break;
+
+    TF_ASSIGN_OR_RETURN(int timeout_ms, PollTimeout(deadline));
+    int n = poll(pfds.data(), pfds.size(), timeout_ms);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return ErrnoError("poll");
+    }
+
+    for (size_t i = 0; i < pfds.size(); ++i) {
+      int16_t revents = pfds[i].revents;
+      int peer = pfd_peers[i];
+      PeerQueue& q = queues[peer];
+      if (revents & (POLLERR | POLLNVAL)) {
+        return Unavailable("Connection to collectives peer %d failed", peer);
+      }
+      // Read and write as much as the socket accepts without blocking.
+      if (revents & (POLLIN | POLLHUP)) {
+        while (q.in_index < q.in.size()) {
+          Range& r = q.in[q.in_index];
+          ssize_t got = recv(sockets_[peer].fd(), r.data + q.in_offset,
+                             r.size - q.in_offset, 0);
+          if (got == 0) {
+            return Unavailable("Collectives peer %d closed the connection",
+                               peer);
+          }
+          if (got < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+              break;
+            }
+            return ErrnoError("recv");
+          }
+          q.in_offset += got;
+          if (q.in_offset == r.size) {
+            if (r.header_of >= 0) {
+              TF_RETURN_IF_ERROR(CheckHeader(op_id, recvs[r.header_of],
+                                             recv_headers[r.header_of]));
+            }
+            ++q.in_index;
+            q.in_offset = 0;
+          }
+        }
+      }
+      if (revents & POLLOUT) {
+        while (q.out_index < q.out.size()) {
+          Range& r = q.out[q.out_index];
+          ssize_t sent = send(sockets_[peer].fd(), r.data + q.out_offset,
+                              r.size - q.out_offset, MSG_NOSIGNAL);
+          if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+              break;
+            }
+            return ErrnoError("send");
+          }
+          q.out_offset += sent;
+          if (q.out_offset == r.size) {
+            ++q.out_index;
+            q.out_offset = 0;
+          }
+        }
+      }
+    }
+  }
+  return OkStatus();
+}
+
+Status TcpCommunicator::AllReduce(const RendezvousKey& key,
+                                  ReductionKind reduction_kind,
+                                  absl::Span<const AllReduceBuffer> buffers,
+                                  absl::Duration timeout) {
+  if (size_ == 1) {
+    for (const AllReduceBuffer& buffer : buffers) {
+      if (buffer.input != buffer.output) {
+        std::memcpy(buffer.output, buffer.input,
+                    buffer.num_elements *
+                        primitive_util::ByteWidth(buffer.element_type));
+      }
+    }
+    return OkStatus();
+  }
+
+  absl::MutexLock lock(&mu_);
+  absl::Time deadline = absl::Now() + timeout;
+
+  // Every buffer is split into one shard per rank. The messages of all
+  // buffers are sent in a single exchange per phase, in buffer order.
+  struct Shards {
+    int64_t element_bytes;
+    std::vector<std::pair<int64_t, int64_t>> bounds;
+    int64_t shard_bytes;
+    std::vector<char> scratch;
+  };
+  std::vector<Shards> shards(buffers.size());
+  for (size_t b = 0; b < buffers.size(); ++b) {
+    Shards& s = shards[b];
+    s.element_bytes = primitive_util::ByteWidth(buffers[b].element_type);
+    s.bounds.resize(size_);
+    for (int r = 0; r < size_; ++r) {
+      s.bounds[r] = ReductionShardBounds(buffers[b].num_elements,
+                                         s.element_bytes, size_, r);
+    }
+    s.shard_bytes =
+        (s.bounds[rank_].second - s.bounds[rank_].first) * s.element_bytes;
+    s.scratch.resize(size_ * s.shard_bytes);
+  }
+
+  // Reduce-scatter: every rank receives its shards from all other ranks and
+  // reduces them, so the reduction work is spread evenly over the ranks.
+  std::vector<SendOp> sends;
+  std::vector<RecvOp> recvs;
+  for (size_t b = 0; b < buffers.size(); ++b) {
+    const char* input = static_cast<const char*>(buffers[b].input);
+    Shards& s = shards[b];
+    for (int peer = 0; peer < size_; ++peer) {
+      if (peer == rank_) continue;
+      auto [peer_begin, peer_end] = s.bounds[peer];
+      sends.push_back({peer, input + peer_begin * s.element_bytes,
+                       (peer_end - peer_begin) * s.element_bytes});
+      recvs.push_back(
+          {peer, s.scratch.data() + peer * s.shard_bytes, s.shard_bytes});
+    }
+  }
+  TF_RETURN_IF_ERROR(Exchange(key.op_id, sends, recvs, deadline));
+
+  std::vector<const void*> inputs(size_);
+  for (size_t b = 0; b < buffers.size(); ++b) {
+    const char* input = static_cast<const char*>(buffers[b].input);
+    char* output = static_cast<char*>(buffers[b].output);
+    Shards& s = shards[b];
+    auto [begin, end] = s.bounds[rank_];
+    for (int peer = 0; peer < size_; ++peer) {
+      inputs[peer] = peer == rank_ ? input + begin * s.element_bytes
+                                   : s.scratch.data() + peer * s.shard_bytes;
+    }
+    void* shard_output = output + begin * s.element_bytes;
+    ReduceAndBroadcast(reduction_kind, buffers[b].element_type, inputs,
+                       absl::Span<void* const>(&shard_output, 1), 0,
+                       end - begin);
+  }
+
+  // All-gather the reduced shards.
+  sends.clear();
+  recvs.clear();
+  for (size_t b = 0; b < buffers.size(); ++b) {
+    char* output = static_cast<char*>(buffers[b].output);
+    Shards& s = shards[b];
+    for (int peer = 0; peer < size_; ++peer) {
+      if (peer == rank_) continue;
+      auto [peer_begin, peer_end] = s.bounds[peer];
+      sends.push_back({peer, output + s.bounds[rank_].first * s.element_bytes,
+                       s.shard_bytes});
+      recvs.push_back({peer, output + peer_begin * s.element_bytes,
+                       (peer_end - peer_begin) * s.element_bytes});
+    }
+  }
+  return Exchange(key.op_id, sends, recvs, deadline);
+}
+
+Status TcpCommunicator::CollectivePermute(const RendezvousKey& key,
+                                          int64_t num_bytes,
+                                          std::optional<int> source_rank,
+                                          absl::Span<int const> target_ranks,
+                                          const void* input_buffer,
+                                          void* output_buffer,
+                                          absl::Duration timeout) {
+  absl::MutexLock lock(&mu_);
+  absl::Time deadline = absl::Now() + timeout;
+  std::vector<SendOp> sends;
+  std::vector<RecvOp> recvs;
+  for (int target : target_ranks) {
+    if (target != rank_) sends.push_back({target, input_buffer, num_bytes});
+  }
+  if (source_rank && *source_rank != rank_) {
+    recvs.push_back({*source_rank, output_buffer, num_bytes});
+  }
+  TF_RETURN_IF_ERROR(Exchange(key.op_id, sends, recvs, deadline));
+
+  if (!source_rank) {
+    std::memset(output_buffer, 0, num_bytes);
+  } else if (*source_rank == rank_ && input_buffer != output_buffer) {
+    std::memcpy(output_buffer, input_buffer, num_bytes);
+  }
+  return OkStatus();
+}
+
+Status TcpCommunicator::AllToAll(const RendezvousKey& key, int64_t chunk_bytes,
+                                 absl::Span<const void* const> input_buffers,
+                                 absl::Span<void* const> output_buffers,
+                                 absl::Duration timeout) {
+  TF_RET_CHECK(input_buffers.size() == size_);
+  TF_RET_CHECK(output_buffers.size() == size_);
+  absl::MutexLock lock(&mu_);
+  absl::Time deadline = absl::Now() + timeout;
+  std::vector<SendOp> sends;
+  std::vector<RecvOp> recvs;
+  for (int peer = 0; peer < size_; ++peer) {
+    if (peer == rank_) continue;
+    sends.push_back({peer, input_buffers[peer], chunk_bytes});
+    recvs.push_back({peer, output_buffers[peer], chunk_bytes});
+  }
+  TF_RETURN_IF_ERROR(Exchange(key.op_id, sends, recvs, deadline));
+  if (input_buffers[rank_] != output_buffers[rank_]) {
+    std::memcpy(output_buffers[rank_], input_buffers[rank_], chunk_bytes);
+  }
+  return OkStatus();
+}
+
+Status TcpCommunicator::AllGather(const RendezvousKey& key,
+                                  int64_t outer_count, int64_t chunk_bytes,
+                                  const void* input_buffer,
+                                  void* output_buffer,
+                                  absl::Duration timeout) {
+  absl::MutexLock lock(&mu_);
+  absl::Time deadline = absl::Now() + timeout;
+  const char* input = static_cast<const char*>(input_buffer);
+  char* output = static_cast<char*>(output_buffer);
+  int64_t input_bytes = outer_count * chunk_bytes;
+
+  // Peers send their whole input in one message. With a single outer chunk it
+  // is received in place, otherwise it is staged and interleaved afterwards.
+  std::vector<char> scratch(outer_count > 1 ? size_ * input_bytes : 0);
+  std::vector<SendOp> sends;
+  std::vector<RecvOp> recvs;
+  std::vector<const char*> sources(size_);
+  for (int peer = 0; peer < size_; ++peer) {
+    if (peer == rank_) {
+      sources[peer] = input;
+      continue;
+    }
+    sends.push_back({peer, input, input_bytes});
+    char* destination = outer_count > 1 ? scratch.data() + peer * input_bytes
+                                        : output + peer * chunk_bytes;
+    recvs.push_back({peer, destination, input_bytes});
+    sources[peer] = destination;
+  }
+  TF_RETURN_IF_ERROR(Exchange(key.op_id, sends, recvs, deadline));
+
+  if (outer_count == 1) {
+    std::memcpy(output + rank_ * chunk_bytes, input, chunk_bytes);
+    return OkStatus();
+  }
+  for (int64_t outer = 0; outer < outer_count; ++outer) {
+    for (const char* source : sources) {
+      std::memcpy(output, source + outer * chunk_bytes, chunk_bytes);
+      output += chunk_bytes;
+    }
+  }
+  return OkStatus();
+}
+
+Status TcpCommunicator::ReduceScatter(const RendezvousKey& key,
+                                      ReductionKind reduction_kind,
+                                      PrimitiveType element_type,
+                                      int64_t outer_count,
+                                      int64_t chunk_elements,
+                                      const void* input_buffer,
+                                      void* output_buffer,
+                                      absl::Duration timeout) {
+  absl::MutexLock lock(&mu_);
+  absl::Time deadline = absl::Now() + timeout;
+  const char* input = static_cast<const char*>(input_buffer);
+  char* output = static_cast<char*>(output_buffer);
+  int64_t chunk_bytes =
+      chunk_elements * primitive_util::ByteWidth(element_type);
+  int64_t slice_bytes = outer_count * chunk_bytes;
+
+  // Every peer receives slice `peer` of the middle dimension. With more than
+  // one outer chunk the slice is strided and is packed before it is sent.
+  std::vector<char> send_scratch(outer_count > 1 ? size_ * slice_bytes : 0);
+  std::vector<char> recv_scratch(size_ * slice_bytes);
+  std::vector<SendOp> sends;
+  std::vector<RecvOp> recvs;
+  for (int peer = 0; peer < size_; ++peer) {
+    if (peer == rank_) continue;
+    const char* slice = input + peer * chunk_bytes;
+    if (outer_count > 1) {
+      char* packed = send_scratch.data() + peer * slice_bytes;
+      for (int64_t outer = 0; outer < outer_count; ++outer) {
+        std::memcpy(packed + outer * chunk_bytes,
+                    input + (outer * size_ + peer) * chunk_bytes, chunk_bytes);
+      }
+      slice = packed;
+    }
+    sends.push_back({peer, slice, slice_bytes});
+    recvs.push_back({peer, recv_scratch.data() + peer * slice_bytes,
+                     slice_bytes});
+  }
+  TF_RETURN_IF_ERROR(Exchange(key.op_id, sends, recvs, deadline));
+
+  std::vector<const void*> inputs(size_);
+  for (int64_t outer = 0; outer < outer_count; ++outer) {
+    for (int peer = 0; peer < size_; ++peer) {
+      inputs[peer] =
+          peer == rank_
+              ? input + (outer * size_ + rank_) * chunk_bytes
+              : recv_scratch.data() + peer * slice_bytes + outer * chunk_bytes;
+    }
+    void* chunk_output = output + outer * chunk_bytes;
+    ReduceAndBroadcast(reduction_kind, element_type, inputs,
+                       absl::Span<void* const>(&chunk_output, 1), 0,
+                       chunk_elements);
+  }
+  return OkStatus();
+}
+
+}  // namespace
+
+struct TcpCollectives::CommunicatorEntry {
+  absl::once_flag once;
+  StatusOr<std::shared_ptr<CollectivesCommunicator>> communicator;
+};
+
+TcpCollectives::TcpCollectives(PjRtClient::KeyValueGetCallback kv_get,
+                               PjRtClient::KeyValuePutCallback kv_put,
+                               Options options)
+    : kv_get_(std::move(kv_get)),
+      kv_put_(std::move(kv_put)),
+      options_(std::move(options)) {
+  if (options_.hostname.empty()) {
+    options_.hostname = tsl::port::Hostname();
+  }
+}
+
+TcpCollectives::~TcpCollectives() = default;
+
+StatusOr<std::shared_ptr<CollectivesCommunicator>>
+TcpCollectives::GetCommunicator(absl::Span<GlobalDeviceId const> devices,
+                                int rank) {
+  std::shared_ptr<CommunicatorEntry> entry;
+  {
+    absl::MutexLock lock(&mu_);
+    auto& slot = communicators_[std::make_tuple(
+        std::vector<GlobalDeviceId>(devices.begin(), devices.end()), rank)];
+    if (slot == nullptr) {
+      slot = std::make_shared<CommunicatorEntry>();
+    }
+    entry = slot;
+  }
+  // Connections are set up outside of `mu_` because the ranks that live in
+  // this process connect to each other concurrently.
+  absl::call_once(entry->once, [&] {
+    entry->communicator = CreateCommunicator(devices, rank);
+  });
+  return entry->communicator;
+}
+
+StatusOr<std::shared_ptr<CollectivesCommunicator>>
+TcpCollectives::CreateCommunicator(absl::Span<GlobalDeviceId const> devices,
+                                   int rank) {
+  int size = devices.size();
+  TF_RET_CHECK(rank >= 0 && rank < size);
+  std::vector<Socket> sockets(size);
+  if (size == 1) {
+    return std::make_shared<TcpCommunicator>(rank, std::move(sockets));
+  }
+
+  absl::Time deadline = absl::Now() + options_.connect_timeout;
+  std::string key_prefix = absl::StrCat(
+      options_.key_prefix, "/",
+      absl::StrJoin(devices, ",",
+                    [](std::string* out, GlobalDeviceId id) {
+                      absl::StrAppend(out, id.value());
+                    }),
+      "/");
+
+  TF_ASSIGN_OR_RETURN(auto listener, Listen());
+  TF_RETURN_IF_ERROR(
+      kv_put_(absl::StrCat(key_prefix, rank),
+              absl::StrCat(options_.hostname, ":", listener.second)));
+
+  // Every rank connects to the ranks below it and accepts connections from
+  // the ranks above it, so that each pair shares exactly one connection.
+  // Connections to a rank that has not called accept() yet are queued by the
+  // kernel, so this cannot deadlock.
+  for (int peer = 0; peer < rank; ++peer) {
+    TF_ASSIGN_OR_RETURN(std::string address,
+                        kv_get_(absl::StrCat(key_prefix, peer),
+                                deadline - absl::Now()));
+    TF_ASSIGN_OR_RETURN(sockets[peer], Connect(address, deadline));
+    HelloMessage hello = {kHelloMagic, rank};
+    TF_RETURN_IF_ERROR(SendAll(sockets[peer], &hello, sizeof(hello), deadline));
+  }
+  for (int accepted = rank + 1; accepted < size; ++accepted) {
+    Socket socket;
+    while (socket.fd() < 0) {
+      TF_RETURN_IF_ERROR(WaitFor(listener.first, POLLIN, deadline));
+      socket = Socket(accept(listener.first.fd(), nullptr, nullptr));
+      if (socket.fd() < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+          errno != EINTR) {
+        return ErrnoError("accept");
+      }
+    }
+    TF_RETURN_IF_ERROR(SetNonBlocking(socket));
+    HelloMessage hello;
+    TF_RETURN_IF_ERROR(RecvAll(socket, &hello, sizeof(hello), deadline));
+    if (hello.magic != kHelloMagic || hello.rank <= rank ||
+        hello.rank >= size || sockets[hello.rank].fd() >= 0) {
+      return Internal("Unexpected connection to collectives rank %d", rank);
+    }
+    sockets[hello.rank] = std::move(socket);
+  }
+
+  for (const Socket& socket : sockets) {
+    if (socket.fd() < 0) continue;
+    int one = 1;
+    setsockopt(socket.fd(), IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+  VLOG(1) << "Connected TCP collectives rank " << rank << " of " << size
+          << " for " << key_prefix;
+  return std::make_shared<TcpCommunicator>(rank, std::move(sockets));
+}
+
+}  // namespace cpu
+}  // namespace xla
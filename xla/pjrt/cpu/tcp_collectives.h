@@ -0,0 +1,90 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_PJRT_CPU_TCP_COLLECTIVES_H_
+#define XLA_PJRT_CPU_TCP_COLLECTIVES_H_
+
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "xla/pjrt/pjrt_client.h"
+#include "xla/service/cpu/collectives_interface.h"
+#include "xla/service/global_device_id.h"
+#include "xla/statusor.h"
+
+namespace xla {
+namespace cpu {
+
+// Collectives between devices that live in different processes, e.g. the
+// nodes of a distributed CPU client. Processes find each other through the
+// key-value store of the distributed runtime and every pair of ranks of a
+// communicator exchanges data over its own TCP connection.
+//
+// Connections are not authenticated: the address published in the key-value
+// store must only be reachable by the processes of the job.
+class TcpCollectives : public CollectivesInterface {
+ public:
+  struct Options {
+    // Address other processes use to connect to this one. Defaults to the
+    // host name of the machine.
+    std::string hostname;
+
+    // Prefix of the keys written to the key-value store. Keys are otherwise
+    // derived from the device ids of a communicator only, so TcpCollectives
+    // of different clients that share one store must use different prefixes;
+    // all processes of one client must use the same prefix.
+    std::string key_prefix = "tcp_collectives";
+
+    // How long to wait for the other ranks while creating a communicator.
+    absl::Duration connect_timeout = absl::Minutes(5);
+  };
+
+  TcpCollectives(PjRtClient::KeyValueGetCallback kv_get,
+                 PjRtClient::KeyValuePutCallback kv_put, Options options);
+  ~TcpCollectives() override;
+
+  // Connects to the other ranks the first time it is called for `devices` and
+  // `rank`, blocking until all of them have called it too. Later calls return
+  // the same communicator.
+  StatusOr<std::shared_ptr<CollectivesCommunicator>> GetCommunicator(
+      absl::Span<GlobalDeviceId const> devices, int rank) override;
+
+ private:
+  struct CommunicatorEntry;
+
+  StatusOr<std::shared_ptr<CollectivesCommunicator>> CreateCommunicator(
+      absl::Span<GlobalDeviceId const> devices, int rank);
+
+  PjRtClient::KeyValueGetCallback kv_get_;
+  PjRtClient::KeyValuePutCallback kv_put_;
+  Options options_;
+
+  absl::Mutex mu_;
+  absl::flat_hash_map<std::tuple<std::vector<GlobalDeviceId>, int>,
+                      std::shared_ptr<CommunicatorEntry>>
+      communicators_ ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // XLA_PJRT_CPU_TCP_COLLECTIVES_H_
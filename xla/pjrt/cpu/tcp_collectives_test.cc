@@ -0,0 +1,288 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/pjrt/cpu/tcp_collectives.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "xla/executable_run_options.h"
+#include "xla/service/collective_ops_utils.h"
+#include "xla/service/cpu/collectives_interface.h"
+#include "xla/service/global_device_id.h"
+#include "xla/status.h"
+#include "xla/statusor.h"
+#include "xla/xla_data.pb.h"
+#include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/statusor.h"
+#include "tsl/platform/test.h"
+#include "tsl/platform/threadpool.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+constexpr absl::Duration kTimeout = absl::Seconds(60);
+
+// Stands in for the key-value store of the distributed runtime.
+class InMemoryKeyValueStore {
+ public:
+  StatusOr<std::string> Get(std::string_view key, absl::Duration timeout) {
+    std::string k(key);
+    absl::MutexLock lock(&mu_);
+    auto has_key = [&]() ABSL_SHARED_LOCKS_REQUIRED(mu_) {
+      return data_.contains(k);
+    };
+    if (!mu_.AwaitWithTimeout(absl::Condition(&has_key), timeout)) {
+      return tsl::errors::DeadlineExceeded("Key not found: ", k);
+    }
+    return data_.find(k)->second;
+  }
+
+  Status Put(std::string_view key, std::string_view value) {
+    absl::MutexLock lock(&mu_);
+    data_[std::string(key)] = std::string(value);
+    return OkStatus();
+  }
+
+ private:
+  absl::Mutex mu_;
+  absl::flat_hash_map<std::string, std::string> data_ ABSL_GUARDED_BY(mu_);
+};
+
+RendezvousKey MakeKey(int num_ranks, int64_t op_id) {
+  std::vector<GlobalDeviceId> devices;
+  for (int i = 0; i < num_ranks; ++i) {
+    devices.push_back(GlobalDeviceId(i));
+  }
+  return RendezvousKey(RunId(0), std::move(devices),
+                       /*num_local_participants=*/1,
+                       RendezvousKey::kCrossReplica, op_id);
+}
+
+// Runs `fn` for every rank on its own thread. Every rank has its own
+// TcpCollectives, as if it ran in a separate process.
+void RunRanks(int num_ranks,
+              std::function<void(int rank, CollectivesCommunicator&)> fn) {
+  InMemoryKeyValueStore store;
+  std::vector<std::unique_ptr<TcpCollectives>> collectives;
+  for (int rank = 0; rank < num_ranks; ++rank) {
+    TcpCollectives::Options options;
+    options.hostname = "localhost";
+    collectives.push_back(std::make_unique<TcpCollectives>(
+        [&store](std::string_view key, absl::Duration timeout) {
+          return store.Get(key, timeout);
+        },
+        [&store](std::string_view key, std::string_view value) {
+          return store.Put(key, value);
+        },
+        options));
+  }
+
+  std::vector<GlobalDeviceId> devices = MakeKey(num_ranks, 0).global_devices;
+  {
+    tsl::thread::ThreadPool pool(tsl::Env::Default(), "tcp_collectives_test",
+                                 num_ranks);
+    for (int rank = 0; rank < num_ranks; ++rank) {
+      pool.Schedule([&, rank] {
+        TF_ASSERT_OK_AND_ASSIGN(
+            std::shared_ptr<CollectivesCommunicator> communicator,
+            collectives[rank]->GetCommunicator(devices, rank));
+        fn(rank, *communicator);
+      });
+    }
+  }
+}
+
+TEST(TcpCollectivesTest, AllReduce) {
+  constexpr int kNumRanks = 3;
+  constexpr int64_t kNumElements = 1001;
+  std::vector<std::vector<float>> outputs(kNumRanks);
+  RunRanks(kNumRanks, [&](int rank, CollectivesCommunicator& communicator) {
+    std::vector<float> input(kNumElements);
+    for (int64_t i = 0; i < kNumElements; ++i) {
+      input[i] = rank * 1000 + i;
+    }
+    outputs[rank].resize(kNumElements);
+    AllReduceBuffer buffer = {F32, kNumElements, input.data(),
+                              outputs[rank].data()};
+    TF_ASSERT_OK(communicator.AllReduce(MakeKey(kNumRanks, 1),
+                                        ReductionKind::SUM, {buffer},
+                                        kTimeout));
+    // In place, and a second collective on the same connections.
+    AllReduceBuffer in_place = {F32, kNumElements, input.data(),
+                                input.data()};
+    TF_ASSERT_OK(communicator.AllReduce(MakeKey(kNumRanks, 2),
+                                        ReductionKind::MAX, {in_place},
+                                        kTimeout));
+    for (int64_t i = 0; i < kNumElements; ++i) {
+      ASSERT_EQ(input[i], (kNumRanks - 1) * 1000 + i);
+    }
+  });
+  for (int rank = 0; rank < kNumRanks; ++rank) {
+    for (int64_t i = 0; i < kNumElements; ++i) {
+      ASSERT_EQ(outputs[rank][i], 3000 + 3 * i);
+    }
+  }
+}
+
+TEST(TcpCollectivesTest, TupleAllReduce) {
+  constexpr int kNumRanks = 3;
+  std::vector<std::vector<float>> floats(kNumRanks);
+  std::vector<std::vector<int64_t>> ints(kNumRanks);
+  RunRanks(kNumRanks, [&](int rank, CollectivesCommunicator& communicator) {
+    floats[rank].assign(100, rank + 0.5f);
+    ints[rank].assign(5, rank + 1);
+    std::vector<AllReduceBuffer> buffers = {
+        {F32, 100, floats[rank].data(), floats[rank].data()},
+        {S64, 5, ints[rank].data(), ints[rank].data()}};
+    TF_ASSERT_OK(communicator.AllReduce(
+        MakeKey(kNumRanks, 1), ReductionKind::PRODUCT, buffers, kTimeout));
+  });
+  for (int rank = 0; rank < kNumRanks; ++rank) {
+    for (float value : floats[rank]) ASSERT_EQ(value, 0.5f * 1.5f * 2.5f);
+    for (int64_t value : ints[rank]) ASSERT_EQ(value, 6);
+  }
+}
+
+TEST(TcpCollectivesTest, AllGather) {
+  constexpr int kNumRanks = 4;
+  constexpr int64_t kOuterCount = 2;
+  constexpr int64_t kChunkElements = 3;
+  std::vector<std::vector<int32_t>> outputs(kNumRanks);
+  RunRanks(kNumRanks, [&](int rank, CollectivesCommunicator& communicator) {
+    std::vector<int32_t> input(kOuterCount * kChunkElements);
+    for (int64_t i = 0; i < input.size(); ++i) {
+      input[i] = rank * 100 + i;
+    }
+    outputs[rank].resize(kNumRanks * input.size());
+    TF_ASSERT_OK(communicator.AllGather(
+        MakeKey(kNumRanks, 1), kOuterCount, kChunkElements * sizeof(int32_t),
+        input.data(), outputs[rank].data(), kTimeout));
+  });
+  for (int rank = 0; rank < kNumRanks; ++rank) {
+    int64_t pos = 0;
+    for (int64_t outer = 0; outer < kOuterCount; ++outer) {
+      for (int source = 0; source < kNumRanks; ++source) {
+        for (int64_t i = 0; i < kChunkElements; ++i) {
+          ASSERT_EQ(outputs[rank][pos++],
+                    source * 100 + outer * kChunkElements + i);
+        }
+      }
+    }
+  }
+}
+
+TEST(TcpCollectivesTest, ReduceScatter) {
+  constexpr int kNumRanks = 3;
+  constexpr int64_t kOuterCount = 2;
+  constexpr int64_t kChunkElements = 5;
+  std::vector<std::vector<int32_t>> outputs(kNumRanks);
+  RunRanks(kNumRanks, [&](int rank, CollectivesCommunicator& communicator) {
+    std::vector<int32_t> input(kOuterCount * kNumRanks * kChunkElements);
+    for (int64_t i = 0; i < input.size(); ++i) {
+      input[i] = rank + i;
+    }
+    outputs[rank].resize(kOuterCount * kChunkElements);
+    TF_ASSERT_OK(communicator.ReduceScatter(
+        MakeKey(kNumRanks, 1), ReductionKind::SUM, S32, kOuterCount,
+        kChunkElements, input.data(), outputs[rank].data(), kTimeout));
+  });
+  for (int rank = 0; rank < kNumRanks; ++rank) {
+    for (int64_t outer = 0; outer < kOuterCount; ++outer) {
+      for (int64_t i = 0; i < kChunkElements; ++i) {
+        int64_t index = (outer * kNumRanks + rank) * kChunkElements + i;
+        // Sum over ranks r of (r + index).
+        ASSERT_EQ(outputs[rank][outer * kChunkElements + i], 3 + 3 * index);
+      }
+    }
+  }
+}
+
+TEST(TcpCollectivesTest, AllToAll) {
+  constexpr int kNumRanks = 3;
+  std::vector<std::vector<int32_t>> outputs(kNumRanks);
+  RunRanks(kNumRanks, [&](int rank, CollectivesCommunicator& communicator) {
+    std::vector<int32_t> inputs(kNumRanks);
+    std::vector<const void*> input_buffers;
+    std::vector<void*> output_buffers;
+    outputs[rank].resize(kNumRanks);
+    for (int i = 0; i < kNumRanks; ++i) {
+      inputs[i] = rank * 10 + i;
+      input_buffers.push_back(&inputs[i]);
+      output_buffers.push_back(&outputs[rank][i]);
+    }
+    TF_ASSERT_OK(communicator.AllToAll(MakeKey(kNumRanks, 1), sizeof(int32_t),
+                                       input_buffers, output_buffers,
+                                       kTimeout));
+  });
+  for (int rank = 0; rank < kNumRanks; ++rank) {
+    for (int source = 0; source < kNumRanks; ++source) {
+      ASSERT_EQ(outputs[rank][source], source * 10 + rank);
+    }
+  }
+}
+
+TEST(TcpCollectivesTest, CollectivePermute) {
+  constexpr int kNumRanks = 3;
+  std::vector<int32_t> outputs(kNumRanks, -1);
+  // 0 -> 1 -> 2; nothing is sent to rank 0.
+  RunRanks(kNumRanks, [&](int rank, CollectivesCommunicator& communicator) {
+    int32_t input = rank + 100;
+    std::optional<int> source_rank;
+    if (rank > 0) source_rank = rank - 1;
+    std::vector<int> target_ranks;
+    if (rank + 1 < kNumRanks) target_ranks.push_back(rank + 1);
+    TF_ASSERT_OK(communicator.CollectivePermute(
+        MakeKey(kNumRanks, 1), sizeof(int32_t), source_rank, target_ranks,
+        &input, &outputs[rank], kTimeout));
+  });
+  EXPECT_EQ(outputs[0], 0);
+  EXPECT_EQ(outputs[1], 100);
+  EXPECT_EQ(outputs[2], 101);
+}
+
+TEST(TcpCollectivesTest, MismatchedCollectivesFail) {
+  constexpr int kNumRanks = 2;
+  std::vector<Status> statuses(kNumRanks);
+  RunRanks(kNumRanks, [&](int rank, CollectivesCommunicator& communicator) {
+    int32_t value = rank;
+    AllReduceBuffer buffer = {S32, /*num_elements=*/1, &value, &value};
+    statuses[rank] =
+        communicator.AllReduce(MakeKey(kNumRanks, /*op_id=*/rank),
+                               ReductionKind::SUM, {buffer}, kTimeout);
+    // The connections are no longer in a known state, so matching collectives
+    // on the same communicator fail as well.
+    EXPECT_FALSE(communicator
+                     .AllReduce(MakeKey(kNumRanks, /*op_id=*/2),
+                                ReductionKind::SUM, {buffer}, kTimeout)
+                     .ok());
+  });
+  EXPECT_FALSE(statuses[0].ok());
+  EXPECT_FALSE(statuses[1].ok());
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -69,6 +69,10 @@ class MaybeOwningCpuMemory {
   size_t size() const { return size_; }
   bool owns_data() const { return data_ != nullptr; }
 
+  // Relinquishes ownership of the data to the caller. The object keeps
+  // pointing at the data but no longer owns it.
+  OwnedDataPtr ReleaseOwnedData() { return std::move(data_); }
+
  private:
   void* buf_ = nullptr;                  // Non-owning data pointer.
   OwnedDataPtr data_ = {nullptr, free};  // Owning data pointer;
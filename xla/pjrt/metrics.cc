@@ -16,9 +16,12 @@ limitations under the License.
 #include "xla/pjrt/metrics.h"
 
 #include <cstdint>
+#include <string>
 
 #include "absl/log/log.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "xla/stream_executor/gpu/gpu_init.h"
 #include "xla/stream_executor/platform.h"
 #include "xla/stream_executor/stream_executor.h"
@@ -50,6 +53,39 @@ auto* free_gpu_system_memory = tsl::monitoring::Gauge<int64_t, 1>::New(
     metrics::kPjrtCompilerFreeGpuSystemMemoryMetricName,
     "Record the free GPU system memory.", "gpu_id");
 
+auto* cpu_buffer_pool_hits = tsl::monitoring::Counter<1>::New(
+    metrics::kPjrtCpuBufferPoolHitsMetricName,
+    "The number of CPU buffer pool allocations served from retained memory.",
+    "pool");
+
+auto* cpu_buffer_pool_misses = tsl::monitoring::Counter<1>::New(
+    metrics::kPjrtCpuBufferPoolMissesMetricName,
+    "The number of CPU buffer pool allocations that needed fresh memory.",
+    "pool");
+
+auto* cpu_buffer_pool_retained_bytes = tsl::monitoring::Gauge<int64_t, 1>::New(
+    metrics::kPjrtCpuBufferPoolRetainedBytesMetricName,
+    "The number of bytes of free memory retained by CPU buffer pools.", "pool");
+
+auto* cpu_executions = tsl::monitoring::Counter<1>::New(
+    metrics::kPjrtCpuExecutionsMetricName,
+    "The number of runs of CPU executables, by how they were dispatched.",
+    "dispatch");
+
+auto* cpu_execution_time_usecs = tsl::monitoring::Counter<1>::New(
+    metrics::kPjrtCpuExecutionTimeUsecsMetricName,
+    "The total run time of CPU executables in microseconds, by how they were "
+    "dispatched.",
+    "dispatch");
+
+absl::string_view CpuDispatchLabel(bool inline_execution) {
+  return inline_execution ? "inline" : "async";
+}
+
+// Serializes read-modify-write updates of `cpu_buffer_pool_retained_bytes`.
+ABSL_CONST_INIT absl::Mutex cpu_buffer_pool_retained_bytes_mu(
+    absl::kConstInit);
+
 }  // namespace
 
 namespace metrics {
@@ -94,5 +130,48 @@ int64_t GetFreeGpuSystemMemory(int gpu_id) {
   return free_gpu_system_memory->GetCell(absl::StrCat(gpu_id))->value();
 }
 
+void RecordCpuBufferPoolAllocation(absl::string_view pool, bool hit) {
+  (hit ? cpu_buffer_pool_hits : cpu_buffer_pool_misses)
+      ->GetCell(std::string(pool))
+      ->IncrementBy(1);
+}
+
+void UpdateCpuBufferPoolRetainedBytes(absl::string_view pool, int64_t delta) {
+  absl::MutexLock lock(&cpu_buffer_pool_retained_bytes_mu);
+  auto* cell = cpu_buffer_pool_retained_bytes->GetCell(std::string(pool));
+  cell->Set(cell->value() + delta);
+}
+
+int64_t GetCpuBufferPoolHits(absl::string_view pool) {
+  return cpu_buffer_pool_hits->GetCell(std::string(pool))->value();
+}
+
+int64_t GetCpuBufferPoolMisses(absl::string_view pool) {
+  return cpu_buffer_pool_misses->GetCell(std::string(pool))->value();
+}
+
+int64_t GetCpuBufferPoolRetainedBytes(absl::string_view pool) {
+  absl::MutexLock lock(&cpu_buffer_pool_retained_bytes_mu);
+  return cpu_buffer_pool_retained_bytes->GetCell(std::string(pool))->value();
+}
+
+void RecordCpuExecution(bool inline_execution, uint64_t running_time_usecs) {
+  const std::string label(CpuDispatchLabel(inline_execution));
+  cpu_executions->GetCell(label)->IncrementBy(1);
+  cpu_execution_time_usecs->GetCell(label)->IncrementBy(running_time_usecs);
+}
+
+int64_t GetCpuExecutions(bool inline_execution) {
+  return cpu_executions
+      ->GetCell(std::string(CpuDispatchLabel(inline_execution)))
+      ->value();
+}
+
+int64_t GetCpuExecutionTimeUsecs(bool inline_execution) {
+  return cpu_execution_time_usecs
+      ->GetCell(std::string(CpuDispatchLabel(inline_execution)))
+      ->value();
+}
+
 }  // namespace metrics
 }  // namespace xla
@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef XLA_PJRT_METRICS_H_
 #define XLA_PJRT_METRICS_H_
 
+#include <cstdint>
+
 #include "absl/base/attributes.h"
 #include "absl/strings/string_view.h"
 #include "tsl/lib/monitoring/counter.h"
@@ -31,6 +33,16 @@ inline constexpr absl::string_view kPjrtCompilerCompileModuleMetricName =
     "/pjrt/compiler/is_compiling_module";
 inline constexpr absl::string_view kPjrtCompilerFreeGpuSystemMemoryMetricName =
     "/pjrt/compiler/free_gpu_system_memory";
+inline constexpr absl::string_view kPjrtCpuBufferPoolHitsMetricName =
+    "/pjrt/cpu/buffer_pool_hits";
+inline constexpr absl::string_view kPjrtCpuBufferPoolMissesMetricName =
+    "/pjrt/cpu/buffer_pool_misses";
+inline constexpr absl::string_view kPjrtCpuBufferPoolRetainedBytesMetricName =
+    "/pjrt/cpu/buffer_pool_retained_bytes";
+inline constexpr absl::string_view kPjrtCpuExecutionsMetricName =
+    "/pjrt/cpu/executions";
+inline constexpr absl::string_view kPjrtCpuExecutionTimeUsecsMetricName =
+    "/pjrt/cpu/execution_time_usecs";
 
 void ReportExecutableEnqueueTime(uint64_t running_time_usecs);
 
@@ -42,6 +54,27 @@ void RecordFreeGpuSystemMemory();
 
 int64_t GetFreeGpuSystemMemory(int gpu_id);
 
+// Records an allocation from the CPU buffer pool named `pool`, which was
+// served from retained memory if `hit`.
+void RecordCpuBufferPoolAllocation(absl::string_view pool, bool hit);
+
+// Adjusts the number of bytes retained by CPU buffer pools named `pool`.
+void UpdateCpuBufferPoolRetainedBytes(absl::string_view pool, int64_t delta);
+
+int64_t GetCpuBufferPoolHits(absl::string_view pool);
+
+int64_t GetCpuBufferPoolMisses(absl::string_view pool);
+
+int64_t GetCpuBufferPoolRetainedBytes(absl::string_view pool);
+
+// Records a run of a CPU executable that took `running_time_usecs`, either
+// inline on the thread that launched it or asynchronously on a client thread.
+void RecordCpuExecution(bool inline_execution, uint64_t running_time_usecs);
+
+int64_t GetCpuExecutions(bool inline_execution);
+
+int64_t GetCpuExecutionTimeUsecs(bool inline_execution);
+
 }  // namespace metrics
 }  // namespace xla
 
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "xla/python/xla.h"
 
+#include <atomic>
 #include <cstdint>
 #include <exception>
 #include <functional>
@@ -61,6 +62,7 @@ limitations under the License.
 #include "xla/pjrt/gpu/se_gpu_pjrt_client.h"
 #endif  // XLA_PYTHON_ENABLE_GPU
 #include "xla/pjrt/cpu/cpu_client.h"
+#include "xla/pjrt/cpu/tcp_collectives.h"
 #include "xla/pjrt/pjrt_api.h"
 #include "xla/pjrt/pjrt_c_api_client.h"
 #include "xla/pjrt/pjrt_client.h"
@@ -500,7 +502,12 @@ static void Init(py::module_& m) {
         py::gil_scoped_release gil_release;
         CpuClientOptions options;
         if (distributed_client != nullptr) {
-          std::string key_prefix = "cpu:";
+          // Every process of a job creates its distributed clients in the
+          // same order, so the index identifies the client across processes
+          // and keeps the keys of clients that share the store apart.
+          static std::atomic<int> next_distributed_client_id{0};
+          std::string key_prefix = absl::StrCat(
+              "cpu:", next_distributed_client_id.fetch_add(1), ":");
           options.kv_get =
               [distributed_client, key_prefix](
                   std::string_view k,
@@ -516,6 +523,10 @@ static void Init(py::module_& m) {
           };
           options.node_id = node_id;
           options.num_nodes = num_nodes;
+          if (num_nodes > 1) {
+            options.collectives = std::make_shared<cpu::TcpCollectives>(
+                options.kv_get, options.kv_put, cpu::TcpCollectives::Options());
+          }
         }
 
         options.asynchronous = asynchronous;
@@ -1035,6 +1035,9 @@ StatusOr<std::unique_ptr<BufferAssignment>> BufferAssignment::FromProto(
       allocation->set_entry_computation_parameter(
           alloc_proto.parameter_number(), shape_index, false);
     }
+    allocation->set_is_thread_local(alloc_proto.is_thread_local());
+    allocation->set_is_tuple(alloc_proto.is_tuple());
+    allocation->set_constant(alloc_proto.is_constant());
 
     // Process each logical buffer assigned to the current allocation and create
     // buffer assignment entries.
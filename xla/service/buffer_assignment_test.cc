@@ -591,6 +591,34 @@ TEST_F(BufferAssignmentTest, BasicToFromProto) {
   }
 }
 
+TEST_F(BufferAssignmentTest, ToFromProtoPreservesAllocationKinds) {
+  const char* hlo_text = R"(
+HloModule m
+
+ENTRY e {
+  p = f32[4] parameter(0)
+  c = f32[4] constant({1, 2, 3, 4})
+  add = f32[4] add(p, c)
+  ROOT t = (f32[4], f32[4]) tuple(add, c)
+})";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_text));
+  auto buffers_orig = RunBufferAssignment(module.get());
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<BufferAssignment> buffers_from_proto,
+      ConvertToProtoAndBack(buffers_orig.get(), module.get()));
+
+  ASSERT_EQ(buffers_orig->Allocations().size(),
+            buffers_from_proto->Allocations().size());
+  for (int i = 0; i < buffers_orig->Allocations().size(); ++i) {
+    const BufferAllocation& orig = buffers_orig->Allocations()[i];
+    const BufferAllocation& from_proto = buffers_from_proto->Allocations()[i];
+    EXPECT_EQ(orig.is_thread_local(), from_proto.is_thread_local());
+    EXPECT_EQ(orig.is_tuple(), from_proto.is_tuple());
+    EXPECT_EQ(orig.is_constant(), from_proto.is_constant());
+  }
+}
+
 TEST_F(BufferAssignmentTest, AliasedParamCanBeReused) {
   // If an input buffer and output buffer aliases, the input buffer can be
   // reused for other intermediate results.
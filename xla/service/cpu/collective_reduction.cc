@@ -0,0 +1,187 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/collective_reduction.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "absl/base/casts.h"
+#include "absl/types/span.h"
+#include "xla/primitive_util.h"
+#include "xla/service/collective_ops_utils.h"
+#include "xla/types.h"
+#include "xla/util.h"
+#include "xla/xla_data.pb.h"
+#include "tsl/platform/logging.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Elements are reduced in tiles of this many bytes so that the partial result
+// stays in L1 while the inputs of all participants are streamed through it.
+constexpr int64_t kReductionTileBytes = 16 * 1024;
+
+constexpr int64_t kShardAlignmentBytes = 64;
+
+template <typename T, bool kIsSignedIntegralType>
+struct SumProductTypeForReductionStep {
+  using type = T;
+};
+
+template <typename T>
+struct SumProductTypeForReductionStep<T, /*kIsSignedIntegralType=*/true> {
+  using type = typename std::make_unsigned_t<T>;
+};
+
+// Signed integers are added and multiplied as unsigned integers to get
+// well-defined wrap-around semantics on overflow.
+template <typename T>
+using SumProductType = typename SumProductTypeForReductionStep<
+    T, std::is_integral<T>::value && std::is_signed<T>::value>::type;
+
+// `reduce` is a template argument so that the inner loop is a straight-line
+// binary operation that the compiler vectorizes for each reduction kind and
+// element type.
+template <typename T, typename ReduceFn>
+void ReduceAndBroadcastImpl(ReduceFn reduce,
+                            absl::Span<const void* const> inputs,
+                            absl::Span<void* const> outputs, int64_t begin,
+                            int64_t end) {
+  constexpr int64_t kTileElements =
+      std::max<int64_t>(1, kReductionTileBytes / sizeof(T));
+  T acc[kTileElements];
+  for (int64_t tile_begin = begin; tile_begin < end;
+       tile_begin += kTileElements) {
+    int64_t n = std::min(kTileElements, end - tile_begin);
+    std::copy_n(static_cast<const T*>(inputs[0]) + tile_begin, n, acc);
+    for (size_t j = 1; j < inputs.size(); ++j) {
+      const T* in = static_cast<const T*>(inputs[j]) + tile_begin;
+      for (int64_t i = 0; i < n; ++i) {
+        acc[i] = reduce(acc[i], in[i]);
+      }
+    }
+    for (void* out : outputs) {
+      std::copy_n(acc, n, static_cast<T*>(out) + tile_begin);
+    }
+  }
+}
+
+template <typename T>
+void ReduceAndBroadcastTyped(ReductionKind reduction_kind,
+                             absl::Span<const void* const> inputs,
+                             absl::Span<void* const> outputs, int64_t begin,
+                             int64_t end) {
+  using U = SumProductType<T>;
+  switch (reduction_kind) {
+    case ReductionKind::SUM:
+      return ReduceAndBroadcastImpl<T>(
+          [](T a, T b) {
+            return absl::bit_cast<T>(static_cast<U>(absl::bit_cast<U>(a) +
+                                                    absl::bit_cast<U>(b)));
+          },
+          inputs, outputs, begin, end);
+    case ReductionKind::PRODUCT:
+      return ReduceAndBroadcastImpl<T>(
+          [](T a, T b) {
+            return absl::bit_cast<T>(static_cast<U>(absl::bit_cast<U>(a) *
+                                                    absl::bit_cast<U>(b)));
+          },
+          inputs, outputs, begin, end);
+    case ReductionKind::MIN:
+    case ReductionKind::MAX:
+      if constexpr (is_complex_v<T>) {
+        LOG(FATAL) << "min/max not valid for complex types";
+      } else if (reduction_kind == ReductionKind::MIN) {
+        return ReduceAndBroadcastImpl<T>(
+            [](T a, T b) { return std::min(a, b); }, inputs, outputs, begin,
+            end);
+      } else {
+        return ReduceAndBroadcastImpl<T>(
+            [](T a, T b) { return std::max(a, b); }, inputs, outputs, begin,
+            end);
+      }
+  }
+}
+
+// Calls `f` with the PrimitiveTypeConstant whose native type is used to reduce
+// elements of `type`.
+template <typename F>
+void ReductionTypeSwitch(PrimitiveType type, F&& f) {
+  switch (type) {
+    case S8:
+      return f(primitive_util::PrimitiveTypeConstant<S8>());
+    case PRED:
+    case U8:
+      return f(primitive_util::PrimitiveTypeConstant<U8>());
+    case S16:
+      return f(primitive_util::PrimitiveTypeConstant<S16>());
+    case U16:
+      return f(primitive_util::PrimitiveTypeConstant<U16>());
+    case S32:
+      return f(primitive_util::PrimitiveTypeConstant<S32>());
+    case U32:
+      return f(primitive_util::PrimitiveTypeConstant<U32>());
+    case S64:
+      return f(primitive_util::PrimitiveTypeConstant<S64>());
+    case U64:
+      return f(primitive_util::PrimitiveTypeConstant<U64>());
+    case F16:
+      return f(primitive_util::PrimitiveTypeConstant<F16>());
+    case F32:
+      return f(primitive_util::PrimitiveTypeConstant<F32>());
+    case F64:
+      return f(primitive_util::PrimitiveTypeConstant<F64>());
+    case C64:
+      return f(primitive_util::PrimitiveTypeConstant<C64>());
+    case C128:
+      return f(primitive_util::PrimitiveTypeConstant<C128>());
+    default:
+      LOG(FATAL) << "Unexpected datatype: "
+                 << primitive_util::LowercasePrimitiveTypeName(type);
+  }
+}
+
+}  // namespace
+
+void ReduceAndBroadcast(ReductionKind reduction_kind,
+                        PrimitiveType element_type,
+                        absl::Span<const void* const> inputs,
+                        absl::Span<void* const> outputs, int64_t begin,
+                        int64_t end) {
+  CHECK(!inputs.empty());
+  ReductionTypeSwitch(element_type, [&](auto type) {
+    using T = primitive_util::NativeTypeOf<decltype(type)::value>;
+    ReduceAndBroadcastTyped<T>(reduction_kind, inputs, outputs, begin, end);
+  });
+}
+
+std::pair<int64_t, int64_t> ReductionShardBounds(int64_t element_count,
+                                                 int64_t element_size,
+                                                 int64_t num_shards,
+                                                 int64_t rank) {
+  int64_t alignment = std::max<int64_t>(1, kShardAlignmentBytes / element_size);
+  int64_t shard_size =
+      RoundUpTo(CeilOfRatio(element_count, num_shards), alignment);
+  int64_t begin = std::min(element_count, rank * shard_size);
+  int64_t end = std::min(element_count, begin + shard_size);
+  return {begin, end};
+}
+
+}  // namespace cpu
+}  // namespace xla
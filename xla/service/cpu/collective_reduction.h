@@ -0,0 +1,55 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_CPU_COLLECTIVE_REDUCTION_H_
+#define XLA_SERVICE_CPU_COLLECTIVE_REDUCTION_H_
+
+#include <cstdint>
+#include <utility>
+
+#include "absl/types/span.h"
+#include "xla/service/collective_ops_utils.h"
+#include "xla/xla_data.pb.h"
+
+namespace xla {
+namespace cpu {
+
+// Reduces elements [begin, end) of the `element_type` arrays in `inputs` and
+// writes the result to the same elements of every array in `outputs`. Inputs
+// and outputs may alias as long as no other thread touches elements in
+// [begin, end).
+//
+// Inputs are combined in the order in which they are given, so the result does
+// not depend on how the element range is split across calls. PRED is reduced
+// as U8. Min/max reductions of complex types are not supported.
+void ReduceAndBroadcast(ReductionKind reduction_kind,
+                        PrimitiveType element_type,
+                        absl::Span<const void* const> inputs,
+                        absl::Span<void* const> outputs, int64_t begin,
+                        int64_t end);
+
+// Returns the [begin, end) element range of shard `rank` out of `num_shards`
+// for an array of `element_count` elements of `element_size` bytes each.
+// Shard boundaries are aligned to cache lines so that threads writing
+// different shards of the same array never share a line.
+std::pair<int64_t, int64_t> ReductionShardBounds(int64_t element_count,
+                                                 int64_t element_size,
+                                                 int64_t num_shards,
+                                                 int64_t rank);
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_CPU_COLLECTIVE_REDUCTION_H_
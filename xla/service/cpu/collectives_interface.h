@@ -0,0 +1,113 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_CPU_COLLECTIVES_INTERFACE_H_
+#define XLA_SERVICE_CPU_COLLECTIVES_INTERFACE_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "xla/service/collective_ops_utils.h"
+#include "xla/service/global_device_id.h"
+#include "xla/status.h"
+#include "xla/statusor.h"
+#include "xla/xla_data.pb.h"
+
+namespace xla {
+namespace cpu {
+
+// One array of an all-reduce.
+struct AllReduceBuffer {
+  PrimitiveType element_type;
+  int64_t num_elements;
+  const void* input;
+  void* output;
+};
+
+// Implements the collective operations of one group of devices. The position
+// of a device in the group is its rank. Every method is called once by every
+// rank of the group, each from the thread that runs the program for that rank,
+// and must not return before the data owned by the calling rank is complete.
+//
+// `key` identifies the collective within the current execution; it is the same
+// for all ranks of one call but run ids are only unique within one process.
+class CollectivesCommunicator {
+ public:
+  virtual ~CollectivesCommunicator() = default;
+
+  // Reduces the input of every buffer across all ranks and writes the result
+  // to the output of the same buffer on every rank. The input and output of a
+  // buffer may alias. All ranks pass the same number of buffers with the same
+  // types and sizes, e.g. the elements of a tuple all-reduce.
+  virtual Status AllReduce(const RendezvousKey& key,
+                           ReductionKind reduction_kind,
+                           absl::Span<const AllReduceBuffer> buffers,
+                           absl::Duration timeout) = 0;
+
+  // Copies `num_bytes` bytes from `input_buffer` to `output_buffer` of every
+  // rank in `target_ranks`. `source_rank` is the rank that sends to this one,
+  // if any; otherwise `output_buffer` is zeroed.
+  virtual Status CollectivePermute(const RendezvousKey& key, int64_t num_bytes,
+                                   std::optional<int> source_rank,
+                                   absl::Span<int const> target_ranks,
+                                   const void* input_buffer,
+                                   void* output_buffer,
+                                   absl::Duration timeout) = 0;
+
+  // Sends `input_buffers[i]` to rank i, which receives it in
+  // `output_buffers[r]` where r is the rank of the sender. All buffers are
+  // `chunk_bytes` bytes long.
+  virtual Status AllToAll(const RendezvousKey& key, int64_t chunk_bytes,
+                          absl::Span<const void* const> input_buffers,
+                          absl::Span<void* const> output_buffers,
+                          absl::Duration timeout) = 0;
+
+  // `input_buffer` consists of `outer_count` chunks of `chunk_bytes` bytes.
+  // For every chunk index, `output_buffer` receives that chunk from every rank
+  // in rank order.
+  virtual Status AllGather(const RendezvousKey& key, int64_t outer_count,
+                           int64_t chunk_bytes, const void* input_buffer,
+                           void* output_buffer, absl::Duration timeout) = 0;
+
+  // `input_buffer` is laid out as [outer_count, num_ranks, chunk_elements] and
+  // `output_buffer` as [outer_count, chunk_elements]. Rank r receives the
+  // reduction over all ranks of slice r of the middle dimension.
+  virtual Status ReduceScatter(const RendezvousKey& key,
+                               ReductionKind reduction_kind,
+                               PrimitiveType element_type, int64_t outer_count,
+                               int64_t chunk_elements, const void* input_buffer,
+                               void* output_buffer, absl::Duration timeout) = 0;
+};
+
+// Creates communicators for the CPU runtime. An implementation decides how
+// ranks exchange data, e.g. through shared memory within one process or over
+// the network between processes.
+class CollectivesInterface {
+ public:
+  virtual ~CollectivesInterface() = default;
+
+  // Returns the communicator used by the device at position `rank` of
+  // `devices`. May block until the other ranks ask for their communicators.
+  virtual StatusOr<std::shared_ptr<CollectivesCommunicator>> GetCommunicator(
+      absl::Span<GlobalDeviceId const> devices, int rank) = 0;
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_CPU_COLLECTIVES_INTERFACE_H_
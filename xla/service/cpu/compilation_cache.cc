@@ -0,0 +1,246 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/compilation_cache.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "llvm/Config/llvm-config.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/cpu/cpu_runtime.h"
+#include "xla/service/cpu/executable.pb.h"
+#include "xla/status.h"
+#include "xla/statusor.h"
+#include "xla/util.h"
+#include "xla/xla.pb.h"
+#include "tsl/lib/monitoring/counter.h"
+#include "tsl/lib/strings/proto_serialization.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/file_statistics.h"
+#include "tsl/platform/fingerprint.h"
+#include "tsl/platform/logging.h"
+#include "tsl/platform/path.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Bump when the format of cache entries or the code they hold changes in a
+// way that the key doesn't capture. Changes to the runtime functions called by
+// the code are captured by runtime::kRuntimeAbiVersion instead.
+constexpr int kCacheVersion = 1;
+
+constexpr absl::string_view kEntrySuffix = ".xla_cpu_executable";
+
+auto* cache_hits = tsl::monitoring::Counter<0>::New(
+    "/xla/service/cpu/compilation_cache_hits",
+    "Number of executables loaded from the CPU compilation cache.");
+
+auto* cache_misses = tsl::monitoring::Counter<0>::New(
+    "/xla/service/cpu/compilation_cache_misses",
+    "Number of CPU compilation cache lookups that found no entry.");
+
+auto* cache_evictions = tsl::monitoring::Counter<0>::New(
+    "/xla/service/cpu/compilation_cache_evictions",
+    "Number of entries evicted from the CPU compilation cache.");
+
+}  // namespace
+
+CompilationCache* CompilationCache::Get(const DebugOptions& debug_options) {
+  const std::string& directory = debug_options.xla_cpu_compilation_cache_dir();
+  if (directory.empty()) {
+    return nullptr;
+  }
+  static absl::Mutex mu(absl::kConstInit);
+  static auto* caches =
+      new absl::flat_hash_map<std::string, std::unique_ptr<CompilationCache>>();
+  absl::MutexLock lock(&mu);
+  std::unique_ptr<CompilationCache>& cache = (*caches)[directory];
+  if (cache == nullptr) {
+    cache = std::make_unique<CompilationCache>(
+        directory, debug_options.xla_cpu_compilation_cache_max_bytes());
+  }
+  return cache.get();
+}
+
+CompilationCache::CompilationCache(std::string directory, int64_t max_bytes)
+    : directory_(std::move(directory)), max_bytes_(max_bytes) {}
+
+StatusOr<std::string> CompilationCache::Key(const HloModule& module,
+                                            absl::string_view target) {
+  // Unlike the module's default fingerprint, keep all constants and backend
+  // configs: the compiled code depends on them.
+  std::string fingerprint = module.GetFingerprint128(
+      HloPrintOptions::Canonical()
+          .set_print_large_constants(true)
+          .set_print_backend_config(true));
+
+  // The location and size of the cache don't affect the compiled code.
+  DebugOptions debug_options = module.config().debug_options();
+  debug_options.clear_xla_cpu_compilation_cache_dir();
+  debug_options.clear_xla_cpu_compilation_cache_max_bytes();
+  std::string serialized_debug_options;
+  if (!tsl::SerializeToStringDeterministic(debug_options,
+                                           &serialized_debug_options)) {
+    return Internal("Failed to serialize the DebugOptions of %s",
+                    module.name());
+  }
+
+  // The parallel task profile affects the compiled code through its contents,
+  // not its path.
+  std::string parallel_task_profile;
+  if (!debug_options.xla_cpu_parallel_task_profile_path().empty()) {
+    TF_RETURN_IF_ERROR(tsl::ReadFileToString(
+        tsl::Env::Default(), debug_options.xla_cpu_parallel_task_profile_path(),
+        &parallel_task_profile));
+  }
+
+  const HloModuleConfig& config = module.config();
+  tsl::Fprint128 key = tsl::Fingerprint128(absl::StrCat(
+      kCacheVersion, ",", runtime::kRuntimeAbiVersion, ",", LLVM_VERSION_STRING,
+      "\n", fingerprint, "\n",
+      config.entry_computation_layout().ToString(), "\n",
+      config.replica_count(), ",", config.num_partitions(), ",",
+      config.intra_op_parallelism_threads(), ",", config.seed(), "\n", target,
+      "\n", serialized_debug_options, "\n", parallel_task_profile));
+  return absl::StrCat(absl::Hex(key.high64, absl::kZeroPad16),
+                      absl::Hex(key.low64, absl::kZeroPad16));
+}
+
+std::string CompilationCache::EntryPath(absl::string_view key) const {
+  return tsl::io::JoinPath(directory_, absl::StrCat(key, kEntrySuffix));
+}
+
+std::optional<CompilationCacheEntryProto> CompilationCache::Lookup(
+    absl::string_view key) {
+  tsl::Env* env = tsl::Env::Default();
+  std::string path = EntryPath(key);
+  std::string serialized;
+  if (!env->FileExists(path).ok() ||
+      !tsl::ReadFileToString(env, path, &serialized).ok()) {
+    cache_misses->GetCell()->IncrementBy(1);
+    return std::nullopt;
+  }
+  CompilationCacheEntryProto entry;
+  if (!entry.ParseFromString(serialized)) {
+    LOG(WARNING) << "Removing corrupt compilation cache entry " << path;
+    env->DeleteFile(path).IgnoreError();
+    cache_misses->GetCell()->IncrementBy(1);
+    return std::nullopt;
+  }
+  VLOG(1) << "Compilation cache hit: " << path;
+  // Eviction goes by modification time, so mark the entry as recently used.
+  // Best effort: the entry may have been evicted concurrently.
+#if !defined(_WIN32)
+  utimensat(AT_FDCWD, path.c_str(), /*times=*/nullptr, /*flags=*/0);
+#endif
+  cache_hits->GetCell()->IncrementBy(1);
+  return entry;
+}
+
+Status CompilationCache::Store(absl::string_view key,
+                               const CompilationCacheEntryProto& entry) {
+  tsl::Env* env = tsl::Env::Default();
+  TF_RETURN_IF_ERROR(env->RecursivelyCreateDir(directory_));
+
+  // Write to a temporary file first, so that concurrent readers never see a
+  // partially written entry.
+  std::string path = EntryPath(key);
+  std::string temp_path = absl::StrCat(path, ".");
+  if (!env->CreateUniqueFileName(&temp_path, ".tmp")) {
+    return InternalError("Could not create a temporary file name for %s",
+                         path);
+  }
+  TF_RETURN_IF_ERROR(
+      tsl::WriteStringToFile(env, temp_path, entry.SerializeAsString()));
+  TF_RETURN_IF_ERROR(env->RenameFile(temp_path, path));
+  VLOG(1) << "Stored compilation cache entry " << path;
+
+  return EvictIfNeeded();
+}
+
+Status CompilationCache::EvictIfNeeded() {
+  absl::MutexLock lock(&eviction_mu_);
+  tsl::Env* env = tsl::Env::Default();
+  std::vector<std::string> children;
+  TF_RETURN_IF_ERROR(env->GetChildren(directory_, &children));
+
+  struct Entry {
+    std::string path;
+    int64_t size;
+    int64_t mtime_nsec;
+  };
+  std::vector<Entry> entries;
+  int64_t total_bytes = 0;
+  for (const std::string& child : children) {
+    if (!absl::EndsWith(child, kEntrySuffix)) continue;
+    std::string path = tsl::io::JoinPath(directory_, child);
+    tsl::FileStatistics stat;
+    // Entries may be evicted concurrently by other processes.
+    if (!env->Stat(path, &stat).ok()) continue;
+    entries.push_back({std::move(path), stat.length, stat.mtime_nsec});
+    total_bytes += stat.length;
+  }
+  if (total_bytes <= max_bytes_) {
+    return OkStatus();
+  }
+
+  // Lookup() refreshes the modification time of the entries it hits, so this
+  // evicts the least recently used entries first.
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) {
+              return a.mtime_nsec < b.mtime_nsec;
+            });
+  for (const Entry& entry : entries) {
+    if (total_bytes <= max_bytes_) break;
+    if (env->DeleteFile(entry.path).ok()) {
+      VLOG(1) << "Evicted compilation cache entry " << entry.path;
+      cache_evictions->GetCell()->IncrementBy(1);
+    }
+    total_bytes -= entry.size;
+  }
+  return OkStatus();
+}
+
+int64_t GetCompilationCacheHits() { return cache_hits->GetCell()->value(); }
+
+int64_t GetCompilationCacheMisses() {
+  return cache_misses->GetCell()->value();
+}
+
+int64_t GetCompilationCacheEvictions() {
+  return cache_evictions->GetCell()->value();
+}
+
+}  // namespace cpu
+}  // namespace xla
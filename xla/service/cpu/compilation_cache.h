@@ -0,0 +1,92 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_CPU_COMPILATION_CACHE_H_
+#define XLA_SERVICE_CPU_COMPILATION_CACHE_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/cpu/executable.pb.h"
+#include "xla/status.h"
+#include "xla/statusor.h"
+#include "xla/xla.pb.h"
+
+namespace xla {
+namespace cpu {
+
+// A persistent cache of compiled CPU executables in a local directory, so that
+// restarted processes don't recompile identical modules.
+//
+// Entries are keyed on the unoptimized HLO module, its configuration
+// (including DebugOptions) and the target machine, and hold the object files
+// of the executable along with the optimized module and its buffer
+// assignment. Entries are written atomically, so a directory can be shared by
+// concurrent processes. Once the directory exceeds its size limit, the entries
+// used least recently are evicted.
+//
+// This class is thread-safe.
+class CompilationCache {
+ public:
+  // Returns the cache configured by `debug_options`, or nullptr if
+  // xla_cpu_compilation_cache_dir is not set. Caches are shared by all users of
+  // the same directory within the process.
+  static CompilationCache* Get(const DebugOptions& debug_options);
+
+  CompilationCache(std::string directory, int64_t max_bytes);
+
+  // Returns the key of `module`, before optimizations, compiled for `target`
+  // (e.g. the triple, CPU name and features of the target machine) by this
+  // version of LLVM against this version of the runtime. Fails if an input of
+  // the compilation can't be read, e.g. the parallel task profile; the module
+  // must then be compiled without the cache.
+  static StatusOr<std::string> Key(const HloModule& module,
+                                   absl::string_view target);
+
+  // Returns the entry stored under `key`, or nullopt if there is none. A hit
+  // marks the entry as recently used.
+  std::optional<CompilationCacheEntryProto> Lookup(absl::string_view key);
+
+  // Stores `entry` under `key`, and evicts old entries if the cache has grown
+  // past its size limit.
+  Status Store(absl::string_view key, const CompilationCacheEntryProto& entry);
+
+  const std::string& directory() const { return directory_; }
+
+ private:
+  std::string EntryPath(absl::string_view key) const;
+
+  Status EvictIfNeeded();
+
+  const std::string directory_;
+  const int64_t max_bytes_;
+
+  // Serializes evictions by this process.
+  absl::Mutex eviction_mu_;
+};
+
+// Compilation cache metrics, accumulated over all caches of the process.
+int64_t GetCompilationCacheHits();
+int64_t GetCompilationCacheMisses();
+int64_t GetCompilationCacheEvictions();
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_CPU_COMPILATION_CACHE_H_
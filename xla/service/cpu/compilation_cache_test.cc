@@ -0,0 +1,165 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/compilation_cache.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "xla/service/cpu/executable.pb.h"
+#include "xla/service/hlo_parser.h"
+#include "xla/xla.pb.h"
+#include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/path.h"
+#include "tsl/platform/statusor.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+constexpr char kHlo[] = R"(
+HloModule m
+
+ENTRY e {
+  p = f32[4] parameter(0)
+  c = f32[4] constant({1, 2, 3, 4})
+  ROOT a = f32[4] add(p, c)
+})";
+
+std::string TestDirectory(const std::string& name) {
+  std::string directory = tsl::io::JoinPath(tsl::testing::TmpDir(), name);
+  tsl::Env::Default()->RecursivelyCreateDir(directory).IgnoreError();
+  return directory;
+}
+
+CompilationCacheEntryProto EntryOfSize(int64_t size) {
+  CompilationCacheEntryProto entry;
+  entry.set_entry_function_name("entry");
+  entry.add_obj_files(std::string(size, 'x'));
+  return entry;
+}
+
+TEST(CompilationCacheTest, KeyDependsOnModuleAndTarget) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnUnverifiedModule(kHlo));
+  TF_ASSERT_OK_AND_ASSIGN(auto same, ParseAndReturnUnverifiedModule(kHlo));
+  TF_ASSERT_OK_AND_ASSIGN(std::string key,
+                          CompilationCache::Key(*module, "x86_64,skylake"));
+  EXPECT_EQ(key, CompilationCache::Key(*same, "x86_64,skylake").value());
+  EXPECT_NE(key, CompilationCache::Key(*module, "x86_64,znver3").value());
+
+  // The default module fingerprint elides constants; the key must not.
+  std::string other_hlo(kHlo);
+  other_hlo.replace(other_hlo.find("{1, 2, 3, 4}"), 12, "{1, 2, 3, 5}");
+  TF_ASSERT_OK_AND_ASSIGN(auto other,
+                          ParseAndReturnUnverifiedModule(other_hlo));
+  EXPECT_NE(key, CompilationCache::Key(*other, "x86_64,skylake").value());
+
+  DebugOptions debug_options = same->config().debug_options();
+  debug_options.set_xla_cpu_enable_fast_math(
+      !debug_options.xla_cpu_enable_fast_math());
+  same->mutable_config().set_debug_options(debug_options);
+  EXPECT_NE(key, CompilationCache::Key(*same, "x86_64,skylake").value());
+
+  // The cache configuration itself is not part of the key.
+  debug_options = module->config().debug_options();
+  debug_options.set_xla_cpu_compilation_cache_dir("/some/dir");
+  module->mutable_config().set_debug_options(debug_options);
+  EXPECT_EQ(key, CompilationCache::Key(*module, "x86_64,skylake").value());
+}
+
+// Without the contents of the profile the key can't tell apart compilations
+// that use different profiles, so there is no key.
+TEST(CompilationCacheTest, KeyFailsIfProfileIsUnreadable) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnUnverifiedModule(kHlo));
+  DebugOptions debug_options = module->config().debug_options();
+  debug_options.set_xla_cpu_parallel_task_profile_path(tsl::io::JoinPath(
+      tsl::testing::TmpDir(), "compilation_cache_test_missing_profile"));
+  module->mutable_config().set_debug_options(debug_options);
+  EXPECT_FALSE(CompilationCache::Key(*module, "x86_64,skylake").ok());
+}
+
+TEST(CompilationCacheTest, StoreAndLookup) {
+  CompilationCache cache(TestDirectory("store_and_lookup"),
+                         /*max_bytes=*/int64_t{1} << 20);
+  int64_t hits = GetCompilationCacheHits();
+  int64_t misses = GetCompilationCacheMisses();
+
+  EXPECT_FALSE(cache.Lookup("key").has_value());
+  EXPECT_EQ(GetCompilationCacheMisses(), misses + 1);
+
+  TF_ASSERT_OK(cache.Store("key", EntryOfSize(100)));
+  std::optional<CompilationCacheEntryProto> entry = cache.Lookup("key");
+  ASSERT_TRUE(entry.has_value());
+  EXPECT_EQ(entry->entry_function_name(), "entry");
+  ASSERT_EQ(entry->obj_files_size(), 1);
+  EXPECT_EQ(entry->obj_files(0).size(), 100);
+  EXPECT_EQ(GetCompilationCacheHits(), hits + 1);
+}
+
+TEST(CompilationCacheTest, CorruptEntryIsAMiss) {
+  std::string directory = TestDirectory("corrupt");
+  CompilationCache cache(directory, /*max_bytes=*/int64_t{1} << 20);
+  std::string path = tsl::io::JoinPath(directory, "key.xla_cpu_executable");
+  TF_ASSERT_OK(tsl::WriteStringToFile(tsl::Env::Default(), path, "\xff\xff"));
+
+  EXPECT_FALSE(cache.Lookup("key").has_value());
+  EXPECT_FALSE(tsl::Env::Default()->FileExists(path).ok());
+}
+
+TEST(CompilationCacheTest, EvictsOldestEntries) {
+  std::string directory = TestDirectory("eviction");
+  CompilationCache cache(directory, /*max_bytes=*/2500);
+  int64_t evictions = GetCompilationCacheEvictions();
+
+  TF_ASSERT_OK(cache.Store("a", EntryOfSize(1000)));
+  TF_ASSERT_OK(cache.Store("b", EntryOfSize(1000)));
+  EXPECT_EQ(GetCompilationCacheEvictions(), evictions);
+
+  // Make sure `a` is the oldest entry regardless of the file system's
+  // timestamp granularity.
+  tsl::Env::Default()->SleepForMicroseconds(1100 * 1000);
+  TF_ASSERT_OK(cache.Store("b", EntryOfSize(1000)));
+  TF_ASSERT_OK(cache.Store("c", EntryOfSize(1000)));
+  EXPECT_EQ(GetCompilationCacheEvictions(), evictions + 1);
+  EXPECT_FALSE(cache.Lookup("a").has_value());
+  EXPECT_TRUE(cache.Lookup("b").has_value());
+  EXPECT_TRUE(cache.Lookup("c").has_value());
+}
+
+TEST(CompilationCacheTest, EvictsLeastRecentlyUsedEntries) {
+  std::string directory = TestDirectory("lru_eviction");
+  CompilationCache cache(directory, /*max_bytes=*/2500);
+
+  TF_ASSERT_OK(cache.Store("a", EntryOfSize(1000)));
+  TF_ASSERT_OK(cache.Store("b", EntryOfSize(1000)));
+
+  // Using `a` after `b` was written makes `b` the least recently used entry,
+  // regardless of the file system's timestamp granularity.
+  tsl::Env::Default()->SleepForMicroseconds(1100 * 1000);
+  EXPECT_TRUE(cache.Lookup("a").has_value());
+  TF_ASSERT_OK(cache.Store("c", EntryOfSize(1000)));
+  EXPECT_TRUE(cache.Lookup("a").has_value());
+  EXPECT_FALSE(cache.Lookup("b").has_value());
+  EXPECT_TRUE(cache.Lookup("c").has_value());
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -22,6 +22,7 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/synchronization/mutex.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/Analysis/TargetTransformInfo.h"
@@ -103,9 +104,17 @@ llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> CompilerFunctor::operator()(
   XLA_VLOG_LINES(2, llvm_ir::DumpToString(&module));
 
   if (pre_optimization_hook_) {
+    absl::MutexLock lock(&hooks_mu_);
     pre_optimization_hook_(module);
   }
 
+  std::unique_ptr<llvm::TargetMachine> owned_target_machine;
+  llvm::TargetMachine* target_machine = target_machine_;
+  if (target_machine_builder_) {
+    owned_target_machine = target_machine_builder_();
+    target_machine = owned_target_machine.get();
+  }
+
   llvm::OptimizationLevel opt_level;
   if (optimize_for_size_) {
     opt_level = llvm::OptimizationLevel::Os;
@@ -140,10 +149,10 @@ llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> CompilerFunctor::operator()(
   llvm::StandardInstrumentations si(module.getContext(), false);
   si.registerCallbacks(pic, &mam);
 
-  llvm::PassBuilder pb(target_machine_, pto, {}, &pic);
+  llvm::PassBuilder pb(target_machine, pto, {}, &pic);
 
   // Add the appropriate TargetLibraryInfo.
-  llvm::Triple target_triple(target_machine_->getTargetTriple());
+  llvm::Triple target_triple(target_machine->getTargetTriple());
   auto target_library_info_impl =
       std::make_unique<llvm::TargetLibraryInfoImpl>(target_triple);
   target_library_info_impl->addVectorizableFunctions(
@@ -199,13 +208,14 @@ llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> CompilerFunctor::operator()(
   VLOG(2) << "IR after optimizations";
 
   if (post_optimization_hook_) {
+    absl::MutexLock lock(&hooks_mu_);
     post_optimization_hook_(module);
   }
 
   // Generate code.
   llvm::MCContext* mc_context;
   llvm::legacy::PassManager codegen_passes;
-  target_machine_->addPassesToEmitMC(codegen_passes, mc_context, ostream);
+  target_machine->addPassesToEmitMC(codegen_passes, mc_context, ostream);
   codegen_passes.run(module);
 
   std::unique_ptr<llvm::MemoryBuffer> memory_buffer(
@@ -215,6 +225,7 @@ llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> CompilerFunctor::operator()(
     llvm::Expected<std::unique_ptr<llvm::object::ObjectFile>> obj_file =
         llvm::object::ObjectFile::createObjectFile(*memory_buffer);
     if (obj_file) {
+      absl::MutexLock lock(&hooks_mu_);
       post_codegen_hook_(*obj_file.get());
     } else {
       LOG(WARNING) << "Could convert memory buffer to object file!";
@@ -17,10 +17,13 @@ limitations under the License.
 #define XLA_SERVICE_CPU_COMPILER_FUNCTOR_H_
 
 #include <functional>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
 #include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
@@ -37,6 +40,9 @@ namespace cpu {
 // Orc JIT compile layer.
 class CompilerFunctor : public llvm::orc::IRCompileLayer::IRCompiler {
  public:
+  using TargetMachineBuilder =
+      std::function<std::unique_ptr<llvm::TargetMachine>()>;
+
   explicit CompilerFunctor(
       llvm::TargetMachine* target_machine, int opt_level,
       bool optimize_for_size, bool disable_expensive_passes,
@@ -62,12 +68,32 @@ class CompilerFunctor : public llvm::orc::IRCompileLayer::IRCompiler {
         dfsan_abi_list_files_(dfsan_abi_list_files),
         convert_to_xla_runtime_abi_(convert_to_xla_runtime_abi) {}
 
+  // Like the above, but creates a new TargetMachine for every module, which
+  // makes it safe to compile several modules concurrently. The hooks are never
+  // invoked concurrently.
+  CompilerFunctor(
+      TargetMachineBuilder target_machine_builder, int opt_level,
+      bool optimize_for_size, bool disable_expensive_passes,
+      bool disable_slp_vectorizer, llvm::FastMathFlags fast_math_flags,
+      LLVMCompiler::ModuleHook pre_optimization_hook,
+      LLVMCompiler::ModuleHook post_optimization_hook,
+      std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook)
+      : CompilerFunctor(static_cast<llvm::TargetMachine*>(nullptr), opt_level,
+                        optimize_for_size, disable_expensive_passes,
+                        disable_slp_vectorizer, fast_math_flags,
+                        std::move(pre_optimization_hook),
+                        std::move(post_optimization_hook),
+                        std::move(post_codegen_hook)) {
+    target_machine_builder_ = std::move(target_machine_builder);
+  }
+
   // Compile a Module to an ObjectFile.
   llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> operator()(
       llvm::Module& module) override;
 
  private:
   llvm::TargetMachine* target_machine_;
+  TargetMachineBuilder target_machine_builder_;
   const unsigned opt_level_;
   const bool optimize_for_size_;
   const bool disable_expensive_passes_;
@@ -79,6 +105,9 @@ class CompilerFunctor : public llvm::orc::IRCompileLayer::IRCompiler {
   const bool dfsan_enabled_ = false;
   const std::vector<std::string> dfsan_abi_list_files_;
   const std::vector<std::string> convert_to_xla_runtime_abi_;
+
+  // Serializes calls to the hooks.
+  absl::Mutex hooks_mu_;
 };
 
 }  // namespace cpu
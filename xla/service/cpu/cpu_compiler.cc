@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "xla/service/cpu/cpu_compiler.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
@@ -40,12 +42,21 @@ limitations under the License.
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalValue.h"
+#include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Mangler.h"
 #include "llvm/IR/Module.h"
@@ -55,6 +66,7 @@ limitations under the License.
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/CodeGen.h"
 #include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetMachine.h"
@@ -62,6 +74,7 @@ limitations under the License.
 #include "llvm/TargetParser/Host.h"
 #include "llvm/TargetParser/Triple.h"
 #include "llvm/TargetParser/X86TargetParser.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
 #include "mlir/Conversion/AffineToStandard/AffineToStandard.h"  // from @llvm-project
 #include "mlir/Conversion/ReconcileUnrealizedCasts/ReconcileUnrealizedCasts.h"  // from @llvm-project
 #include "mlir/Dialect/Affine/IR/AffineOps.h"  // from @llvm-project
@@ -134,14 +147,20 @@ limitations under the License.
 #include "xla/service/convolution_group_converter.h"
 #include "xla/service/copy_insertion.h"
 #include "xla/service/cpu/buffer_info_util.h"
+#include "xla/service/cpu/compilation_cache.h"
 #include "xla/service/cpu/compiler_functor.h"
 #include "xla/service/cpu/conv_canonicalization.h"
 #include "xla/service/cpu/cpu_executable.h"
+#include "xla/service/cpu/cpu_float_support.h"
 #include "xla/service/cpu/cpu_instruction_fusion.h"
 #include "xla/service/cpu/cpu_layout_assignment.h"
+#include "xla/service/cpu/cpu_multi_output_fusion.h"
 #include "xla/service/cpu/cpu_options.h"
+#include "xla/service/cpu/cpu_scatter_expander.h"
 #include "xla/service/cpu/dot_op_emitter.h"
 #include "xla/service/cpu/hlo_xla_runtime_pipeline.h"
+#include "xla/service/cpu/int8_rewriter.h"
+#include "xla/service/cpu/ir_emission_utils.h"
 #include "xla/service/cpu/ir_emitter.h"
 #include "xla/service/cpu/parallel_task_assignment.h"
 #include "xla/service/cpu/runtime/collectives.h"
@@ -152,6 +171,7 @@ limitations under the License.
 #include "xla/service/cpu/runtime/xfeed.h"
 #include "xla/service/cpu/simple_orc_jit.h"
 #include "xla/service/cpu/target_machine_features.h"
+#include "xla/service/cpu/task_graph_outliner.h"
 #include "xla/service/cpu/xla_framework.h"
 #include "xla/service/cpu_gpu_shape_verifier.h"
 #include "xla/service/dot_decomposer.h"
@@ -197,7 +217,6 @@ limitations under the License.
 #include "xla/service/result_caster.h"
 #include "xla/service/rng_bit_generator_expander.h"
 #include "xla/service/rng_expander.h"
-#include "xla/service/scatter_expander.h"
 #include "xla/service/select_and_scatter_expander.h"
 #include "xla/service/sharding_propagation.h"
 #include "xla/service/sharding_remover.h"
@@ -229,10 +248,13 @@ limitations under the License.
 #include "xla/xla_data.pb.h"
 #include "tsl/platform/casts.h"
 #include "tsl/platform/cpu_info.h"
+#include "tsl/platform/denormal.h"
+#include "tsl/platform/env.h"
 #include "tsl/platform/errors.h"
 #include "tsl/platform/logging.h"  // IWYU pragma: keep
 #include "tsl/platform/status.h"
 #include "tsl/platform/statusor.h"
+#include "tsl/profiler/protobuf/profiled_instructions.pb.h"
 
 #if defined(INTEL_MKL) && defined(ENABLE_ONEDNN_V3)
 #include "xla/service/cpu/onednn_rewriter.h"
@@ -485,6 +507,25 @@ CpuCompiler::CpuCompiler(bool allow_sparse_shapes)
 
 CpuCompiler::CpuCompiler() : CpuCompiler(false) {}
 
+namespace {
+
+// Describes the machine the JIT generates code for, as part of compilation
+// cache keys.
+const std::string& CompilationCacheTarget() {
+  static const std::string* target = [] {
+    std::unique_ptr<llvm::TargetMachine> target_machine =
+        SimpleOrcJIT::InferTargetMachineForJIT(llvm::TargetOptions(),
+                                               llvm::CodeGenOptLevel::Default);
+    return new std::string(absl::StrCat(
+        target_machine->getTargetTriple().str(), ",",
+        target_machine->getTargetCPU().str(), ",",
+        target_machine->getTargetFeatureString().str()));
+  }();
+  return *target;
+}
+
+}  // namespace
+
 StatusOr<std::vector<std::unique_ptr<Executable>>> CpuCompiler::Compile(
     std::unique_ptr<HloModuleGroup> module_group,
     std::vector<std::vector<se::StreamExecutor*>> stream_execs,
@@ -495,7 +536,62 @@ StatusOr<std::vector<std::unique_ptr<Executable>>> CpuCompiler::Compile(
           "Model partitioning not implemented for the CPU compiler");
     }
   }
-  return LLVMCompiler::Compile(std::move(module_group), stream_execs, options);
+
+  // Same as LLVMCompiler::Compile, except that executables are looked up in
+  // and added to the compilation cache, if there is one.
+  tsl::port::ScopedDontFlushDenormal dont_flush_denormals;
+
+  std::vector<std::unique_ptr<Executable>> result;
+  std::vector<std::unique_ptr<HloModule>> modules =
+      module_group->ConsumeModules();
+  for (size_t i = 0; i < modules.size(); i++) {
+    CompilationCache* cache = GetCompilationCache(modules[i]->config());
+    std::string key;
+    if (cache != nullptr) {
+      StatusOr<std::string> cache_key =
+          CompilationCache::Key(*modules[i], CompilationCacheTarget());
+      if (!cache_key.ok()) {
+        LOG(WARNING) << "Compiling " << modules[i]->name()
+                     << " without the compilation cache: "
+                     << cache_key.status();
+        cache = nullptr;
+      } else {
+        key = *std::move(cache_key);
+      }
+    }
+    if (cache != nullptr) {
+      if (std::optional<CompilationCacheEntryProto> entry =
+              cache->Lookup(key)) {
+        StatusOr<std::unique_ptr<CpuExecutable>> executable =
+            LoadCachedExecutable(*entry);
+        if (executable.ok()) {
+          result.push_back(std::move(*executable));
+          continue;
+        }
+        LOG(WARNING) << "Failed to load executable of " << modules[i]->name()
+                     << " from the compilation cache: "
+                     << executable.status();
+      }
+    }
+
+    TF_ASSIGN_OR_RETURN(modules[i], RunHloPasses(std::move(modules[i]),
+                                                 stream_execs[i][0], options));
+    TF_ASSIGN_OR_RETURN(
+        std::unique_ptr<Executable> executable,
+        RunBackend(std::move(modules[i]), stream_execs[i][0], options));
+    if (cache != nullptr) {
+      Status status = StoreCachedExecutable(
+          *cache, key,
+          *tensorflow::down_cast<CpuExecutable*>(executable.get()));
+      if (!status.ok()) {
+        LOG(WARNING) << "Failed to store executable in the compilation cache: "
+                     << status;
+      }
+    }
+    result.push_back(std::move(executable));
+  }
+
+  return {std::move(result)};
 }
 
 /* static */ void CpuCompiler::InitializeLLVMTarget() {
@@ -613,6 +709,29 @@ void AddHloVerifier(HloPassPipeline* pipeline, bool allow_sparse_shapes,
   }
 }
 
+// Reads the profile of measured instruction latencies that guides parallel
+// task assignment, if there is one.
+StatusOr<std::optional<tensorflow::profiler::ProfiledInstructionsProto>>
+ReadParallelTaskProfile(const DebugOptions& debug_options) {
+  const std::string& path = debug_options.xla_cpu_parallel_task_profile_path();
+  if (path.empty()) {
+    return std::nullopt;
+  }
+  tensorflow::profiler::ProfiledInstructionsProto profile;
+  tsl::Env* env = tsl::Env::Default();
+  if (tsl::ReadTextProto(env, path, &profile).ok()) {
+    return profile;
+  }
+  profile.Clear();
+  Status status = tsl::ReadBinaryProto(env, path, &profile);
+  if (!status.ok()) {
+    return InvalidArgument(
+        "%s is neither a text nor a binary ProfiledInstructionsProto: %s", path,
+        status.message());
+  }
+  return profile;
+}
+
 }  // namespace
 
 Status CpuCompiler::RunHloPassesThroughLayoutAssn(
@@ -684,9 +803,19 @@ Status CpuCompiler::RunHloPassesThroughLayoutAssn(
   pipeline.AddPass<QrExpander>();
   pipeline.AddPass<EighExpander>();
   pipeline.AddPass<TriangularSolveExpander>();
-  pipeline.AddPass<AllGatherDecomposer>();
+  // All-gathers and reduce-scatters the IrEmitter can lower to runtime calls
+  // are kept; the rest become an all-reduce plus a dynamic-(update-)slice.
+  pipeline.AddPass<AllGatherDecomposer>(
+      [is_mlir_compile](const HloAllGatherInstruction& ag) {
+        return is_mlir_compile ||
+               !PotentiallyImplementedAsNativeCollective(ag);
+      });
   pipeline.AddPass<AllToAllDecomposer>();
-  pipeline.AddPass<ReduceScatterDecomposer>();
+  pipeline.AddPass<ReduceScatterDecomposer>(
+      /*update_layout=*/nullptr, [is_mlir_compile](const HloInstruction* rs) {
+        return is_mlir_compile ||
+               !PotentiallyImplementedAsNativeCollective(*rs);
+      });
   pipeline.AddPass<StochasticConvertDecomposer>();
 
   // Inline computations with a single call site.
@@ -696,10 +825,11 @@ Status CpuCompiler::RunHloPassesThroughLayoutAssn(
 
   // Rewrite to custom calls with target as oneDNN library calls.
 #if defined(INTEL_MKL) && defined(ENABLE_ONEDNN_V3)
-  // AOT compiled code runs in single thread.
-  if (!is_aot_compile) {
-    // Temporarily disabling oneDNN rewriter because it causes JAX regression.
-    // pipeline.AddPass<OneDnnRewriter>();
+  // AOT compiled code runs in single thread. The rewriter is opt-in, since it
+  // is not faster than Eigen for every model.
+  if (!is_aot_compile &&
+      module->config().debug_options().xla_cpu_enable_onednn_rewriter()) {
+    pipeline.AddPass<OneDnnRewriter>();
   }
 #endif  // INTEL_MKL && ENABLE_ONEDNN_V3
 
@@ -709,9 +839,13 @@ Status CpuCompiler::RunHloPassesThroughLayoutAssn(
   pipeline.AddPass<AllReducePromotion>(ar_promoted_types);
   // Convert BF16 and F8 operations to F32 and F16 respectively so that the CPU
   // backend can support BF16/F8 operations without directly implementing a
-  // BF16/F8 lowering for most ops.
-  FloatSupport bf16_support(BF16);
-  pipeline.AddPass<FloatNormalization>(&bf16_support);
+  // BF16/F8 lowering for most ops. BF16 dots and convolutions the bf16 runtime
+  // implements, and ops that only move data, are kept in BF16.
+  FloatSupport mlir_bf16_support(BF16);
+  CpuFloatSupport cpu_bf16_support(BF16, target_machine_features);
+  FloatSupport* bf16_support =
+      is_mlir_compile ? &mlir_bf16_support : &cpu_bf16_support;
+  pipeline.AddPass<FloatNormalization>(bf16_support);
   FloatSupport f8e5m2_support(F8E5M2, F16);
   pipeline.AddPass<FloatNormalization>(&f8e5m2_support);
   FloatSupport f8e4m3fn_support(F8E4M3FN, F16);
@@ -764,7 +898,8 @@ Status CpuCompiler::RunHloPassesThroughLayoutAssn(
   pipeline.AddPass<DynamicPadder>(dynamic_padder_options);
   if (!is_mlir_compile) {
     pipeline.AddPass<SelectAndScatterExpander>();
-    pipeline.AddPass<ScatterExpander>(ScatterExpander::kEliminateAllScatters);
+    pipeline.AddPass<CpuScatterExpander>(
+        module->config().debug_options().xla_cpu_use_native_scatter());
   }
   pipeline.AddPass<ConvCanonicalization>(target_machine_features);
 
@@ -827,7 +962,17 @@ Status CpuCompiler::RunHloPassesThroughLayoutAssn(
   // support libcalls. Disable this for now.
   if (!is_mlir_compile) {
     pipeline.AddPass<TopkRewriter>([](const HloSortInstruction* sort, int64_t) {
-      return sort->operand(0)->shape().element_type() == F32;
+      switch (sort->operand(0)->shape().element_type()) {
+        case F32:
+        case F64:
+        case BF16:
+        case F16:
+        case S32:
+        case U32:
+          return true;
+        default:
+          return false;
+      }
     });
   }
   pipeline.AddPass<IndexedArrayAnalysisPrinterPass>();
@@ -841,6 +986,14 @@ Status CpuCompiler::RunHloPassesThroughLayoutAssn(
       },
       TransposeFolding::NeverFoldTranspose);
   pipeline.AddPass<HloCSE>(/*is_layout_sensitive=*/false);
+  // The simplifications may have changed BF16 dots or convolutions into ones
+  // the bf16 runtime doesn't implement, so normalize them again.
+  pipeline.AddPass<FloatNormalization>(bf16_support);
+  // Runs after transposes are folded into dots, since whether a dot reads its
+  // int8 operands directly depends on its final dimension numbers.
+  if (!is_mlir_compile) {
+    pipeline.AddPass<Int8Rewriter>(target_machine_features);
+  }
 
   pipeline.AddPass<OptimizationBarrierExpander>();
   pipeline.AddPass<TupleSimplifier>();
@@ -894,8 +1047,12 @@ Status CpuCompiler::RunHloPassesAfterLayoutAssn(
 
   pipeline.AddPass<ReshapeDecomposer>();
 
-  // Add a fusion pass now that layout assignment is done.
+  // Add the fusion passes now that layout assignment is done. Multi-output
+  // fusion merges the fusions that read the same operands.
   pipeline.AddPass<CpuInstructionFusion>();
+  if (module->config().debug_options().xla_cpu_enable_multi_output_fusion()) {
+    pipeline.AddPass<CpuMultiOutputFusion>();
+  }
 
   // The LayoutAssignment pass may leave behind kCopy instructions which are
   // duplicate or NOPs, so remove them with algebraic simplification and CSE.
@@ -931,8 +1088,12 @@ Status CpuCompiler::RunHloPassesAfterLayoutAssn(
     // and thread synchronization dependencies which would likely increase
     // binary size (and most AOT applications are single-threaded).
     // TODO(b/29630486) Support multi-threaded AOT.
+    TF_ASSIGN_OR_RETURN(
+        std::optional<tensorflow::profiler::ProfiledInstructionsProto> profile,
+        ReadParallelTaskProfile(module->config().debug_options()));
     pipeline.AddPass<ParallelTaskAssigner>(
-        max_parallelism, ShapeSizeBytesFunction(), target_machine_features);
+        max_parallelism, ShapeSizeBytesFunction(), target_machine_features,
+        std::move(profile));
   }
   // Copy insertion should be performed immediately before IR emission to
   // avoid inserting unnecessary copies (later pass adds an instruction which
@@ -943,6 +1104,13 @@ Status CpuCompiler::RunHloPassesAfterLayoutAssn(
   pipeline.AddPass<HloDCE>();
   pipeline.AddPass<CopyInsertion>();
   pipeline.AddPass<HloDCE>();
+  // Outline the ops of the entry computation into tasks that the IrEmitter
+  // runs concurrently. This is not done for AOT for the same reasons as above,
+  // nor when profiling, since the profile counters aren't updated atomically.
+  if (!is_aot_compile && !module->config().hlo_profiling_enabled() &&
+      module->config().debug_options().xla_cpu_enable_inter_op_parallelism()) {
+    pipeline.AddPass<TaskGraphOutliner>();
+  }
   return pipeline.Run(module).status();
 }
 
@@ -959,6 +1127,9 @@ Status CpuCompiler::RunHloPasses(HloModule* module, bool is_aot_compile,
 
 namespace {
 
+// Name of the LLVM module holding the code of an executable.
+constexpr absl::string_view kLlvmModuleName = "__compute_module";
+
 // Align buffers to 16-byte boundaries.
 int64_t memory_alignment(LogicalBuffer::Color) {
   return cpu_function_runtime::MinAlign();
@@ -1005,7 +1176,12 @@ std::pair<LLVMCompiler::ModuleHook, LLVMCompiler::ModuleHook> GetIRModuleHooks(
     if (user_hook) {
       user_hook(llvm_module);
     }
-    llvm_ir::DumpIrIfEnabled(*hlo_module_ptr, llvm_module, optimized);
+    // Parts of a module split for parallel compilation are dumped separately.
+    absl::string_view part = llvm_module.getModuleIdentifier();
+    if (!absl::ConsumePrefix(&part, absl::StrCat(kLlvmModuleName, "."))) {
+      part = "";
+    }
+    llvm_ir::DumpIrIfEnabled(*hlo_module_ptr, llvm_module, optimized, part);
   };
   return {[hook](const llvm::Module& llvm_module) {
             return hook(/*optimized=*/false, llvm_module);
@@ -1108,14 +1284,17 @@ namespace {
 
 // Post-compilation callback functor for use by SimpleOrcJIT.
 //
-// Dumps machine code if dumping is enabled for the module.
+// Dumps machine code if dumping is enabled for the module, and appends it to
+// `obj_files` if not null.
 struct OrcJITPostCompilationHook {
   // Gets an std::function that implements this hook.
   static std::function<void(const llvm::object::ObjectFile& obj_file)> Create(
-      const HloModule* module) {
+      const HloModule* module,
+      std::shared_ptr<std::vector<std::string>> obj_files = nullptr) {
     // This struct is not copyable, but std::functions must be.  So to create an
     // std::function out of this struct, we have to wrap it in a shared_ptr.
-    auto wrapped = std::make_shared<OrcJITPostCompilationHook>(module);
+    auto wrapped = std::make_shared<OrcJITPostCompilationHook>(
+        module, std::move(obj_files));
     return [wrapped](const llvm::object::ObjectFile& obj_file) {
       (*wrapped)(obj_file);
     };
@@ -1123,20 +1302,32 @@ struct OrcJITPostCompilationHook {
 
   // Constructor can't be private because we want to call it from
   // std::make_shared, but users should call Create() instead.
-  explicit OrcJITPostCompilationHook(const HloModule* module)
-      : module(module) {}
+  OrcJITPostCompilationHook(const HloModule* module,
+                            std::shared_ptr<std::vector<std::string>> obj_files)
+      : module(module), obj_files(std::move(obj_files)) {}
 
  private:
   void operator()(const llvm::object::ObjectFile& obj_file) {
+    // SimpleOrcJIT runs this hook for one object file at a time.
+    if (obj_files != nullptr) {
+      obj_files->emplace_back(obj_file.getData().data(),
+                              obj_file.getData().size());
+    }
     if (!DumpingEnabledForHloModule(*module)) {
       return;
     }
-    DumpToFileInDir(*module, /*file_prefix=*/"", /*file_suffix=*/"o",
+    // A module compiled in parts yields several object files.
+    int index = num_object_files++;
+    DumpToFileInDir(*module, /*file_prefix=*/"",
+                    /*file_suffix=*/
+                    index == 0 ? "o" : absl::StrCat("part", index, ".o"),
                     absl::string_view(obj_file.getData().data(),
                                       obj_file.getData().size()));
   }
 
   const HloModule* module;
+  std::shared_ptr<std::vector<std::string>> obj_files;
+  std::atomic<int> num_object_files = 0;
 };
 
 void InitializeLLVMCommandLineOptions(const HloModuleConfig& config) {
@@ -1329,6 +1520,115 @@ std::vector<ComputationToEmit> SubcomputationEmissionOrder(
   return postorder;
 }
 
+// Copies `module` into `context` by round-tripping it through bitcode.
+std::unique_ptr<llvm::Module> CopyToContext(const llvm::Module& module,
+                                            llvm::LLVMContext& context) {
+  llvm::SmallString<0> bitcode;
+  llvm::raw_svector_ostream bitcode_ostream(bitcode);
+  llvm::WriteBitcodeToFile(module, bitcode_ostream);
+
+  llvm::Expected<std::unique_ptr<llvm::Module>> new_module =
+      llvm::parseBitcodeFile(
+          llvm::MemoryBufferRef(llvm::StringRef(bitcode.data(), bitcode.size()),
+                                module.getModuleIdentifier()),
+          context);
+  CHECK(new_module) << "Failed to parse bitcode "
+                    << llvm::toString(new_module.takeError());
+  return std::move(new_module.get());
+}
+
+// Splits `llvm_module` into up to `num_parts` modules, each in its own
+// context, and adds them to `jit`. Returns the mangled names of the symbols
+// that need to be looked up to compile all parts.
+//
+// llvm::SplitModule keeps every local value in the same part as all of its
+// users. The IrEmitter's constants and the functions it passes by pointer to
+// the runtime (e.g. parallel tasks) would glue most of the module together, so
+// those are made hidden external symbols before splitting. Functions that are
+// only called directly (e.g. reducers) stay local to their callers' part so
+// that they can still be inlined.
+StatusOr<std::vector<std::string>> AddModuleInParts(SimpleOrcJIT& jit,
+                                                    llvm::Module& llvm_module,
+                                                    int num_parts) {
+  XLA_SCOPED_LOGGING_TIMER("CpuCompiler - Splitting LLVM module");
+  auto externalize = [](llvm::GlobalValue& value) {
+    value.setLinkage(llvm::GlobalValue::ExternalLinkage);
+    value.setVisibility(llvm::GlobalValue::HiddenVisibility);
+    // Keep the names of externalized values clear of the runtime's symbols.
+    value.setName(absl::StrCat("__xla_cpu_split.", value.getName().str()));
+  };
+
+  // Small constants are duplicated into every part that uses them to keep
+  // them visible to constant folding, as in the GPU backend. Only plain data
+  // is: initializers that refer to other global values, like the task graph's
+  // array of task functions, would refer to the values of another module.
+  constexpr int64_t kMaxDuplicatedConstantBytes = 1024;
+  const llvm::DataLayout& data_layout = llvm_module.getDataLayout();
+  llvm::DenseMap<llvm::StringRef, llvm::Constant*> constant_initializers;
+  for (llvm::GlobalVariable& global : llvm_module.globals()) {
+    if (!global.hasLocalLinkage()) continue;
+    externalize(global);
+    if (global.isConstant() && global.hasInitializer() &&
+        llvm::isa<llvm::ConstantData>(global.getInitializer()) &&
+        data_layout.getTypeAllocSize(global.getValueType()) <=
+            kMaxDuplicatedConstantBytes) {
+      constant_initializers[global.getName()] = global.getInitializer();
+    }
+  }
+  int num_functions = 0;
+  for (llvm::Function& function : llvm_module.functions()) {
+    if (function.isDeclaration()) continue;
+    ++num_functions;
+    if (function.hasLocalLinkage() && function.hasAddressTaken()) {
+      externalize(function);
+    }
+  }
+
+  std::vector<std::unique_ptr<llvm::Module>> parts;
+  llvm::SplitModule(
+      llvm_module, std::clamp(num_functions, 1, num_parts),
+      [&](std::unique_ptr<llvm::Module> part) {
+        for (llvm::GlobalVariable& global : part->globals()) {
+          auto it = constant_initializers.find(global.getName());
+          if (!global.hasInitializer() && it != constant_initializers.end()) {
+            global.setInitializer(it->second);
+            global.setLinkage(llvm::GlobalValue::InternalLinkage);
+            global.setVisibility(llvm::GlobalValue::DefaultVisibility);
+          }
+        }
+        parts.push_back(std::move(part));
+      },
+      /*PreserveLocals=*/true);
+  VLOG(2) << "Split " << llvm_module.getModuleIdentifier() << " into "
+          << parts.size() << " parts";
+
+  std::vector<std::string> symbols;
+  for (int i = 0; i < parts.size(); ++i) {
+    parts[i]->setModuleIdentifier(
+        absl::StrCat(llvm_module.getModuleIdentifier(), ".part", i));
+    // Looking up any symbol defined by a part compiles all of it.
+    for (const llvm::GlobalValue& value : parts[i]->global_values()) {
+      if (value.isDeclaration() || value.hasLocalLinkage()) continue;
+      llvm::SmallVector<char, 40> mangled_name;
+      llvm::Mangler::getNameWithPrefix(mangled_name, value.getName(),
+                                       jit.data_layout());
+      symbols.emplace_back(mangled_name.begin(), mangled_name.end());
+      break;
+    }
+
+    // Each part gets its own context so that parts can be compiled
+    // concurrently.
+    auto context = std::make_unique<llvm::LLVMContext>();
+    std::unique_ptr<llvm::Module> module = CopyToContext(*parts[i], *context);
+    if (llvm::Error err = jit.AddModule(llvm::orc::ThreadSafeModule(
+            std::move(module), std::move(context)))) {
+      return InternalError("Adding LLVM module to the JIT failed: %s",
+                           llvm::toString(std::move(err)));
+    }
+  }
+  return symbols;
+}
+
 }  // namespace
 
 StatusOr<std::unique_ptr<CpuExecutable>>
@@ -1344,8 +1644,15 @@ CpuCompiler::CompileLegacyCpuExecutable(std::unique_ptr<HloModule> module) {
   LoadMLIRDialects(mlir_context);
   auto llvm_context = std::make_unique<llvm::LLVMContext>();
   auto llvm_module =
-      std::make_unique<llvm::Module>("__compute_module", *llvm_context);
-
+      std::make_unique<llvm::Module>(kLlvmModuleName, *llvm_context);
+
+  const int num_compile_threads =
+      module->config().debug_options().xla_cpu_parallel_codegen_threads();
+  // Keep the object files if the executable is to be cached.
+  std::shared_ptr<std::vector<std::string>> obj_files;
+  if (GetCompilationCache(module->config()) != nullptr) {
+    obj_files = std::make_shared<std::vector<std::string>>();
+  }
   auto jit = SimpleOrcJIT::Create(
       CompilerTargetOptions(module->config()),
       CodeGenOptLevel(module->config()),
@@ -1354,7 +1661,8 @@ CpuCompiler::CompileLegacyCpuExecutable(std::unique_ptr<HloModule> module) {
       options::SlpVectorizerDisabled(module->config()),
       llvm_ir::GetCpuFastMathFlags(module->config()), pre_optimization_ir_hook,
       post_optimization_ir_hook,
-      OrcJITPostCompilationHook::Create(module.get()));
+      OrcJITPostCompilationHook::Create(module.get(), obj_files),
+      num_compile_threads);
   if (!jit) {
     return InternalError("Creating JIT failed: %s",
                          llvm::toString(jit.takeError()));
@@ -1388,11 +1696,23 @@ CpuCompiler::CompileLegacyCpuExecutable(std::unique_ptr<HloModule> module) {
                                      ComputationSchedulerToModuleScheduler(
                                          DFSMemoryScheduler)));
 
+  // The tasks of a task graph run in any order their dependencies allow, so
+  // buffers may only be shared between instructions ordered by them.
+  const bool emit_task_graph =
+      module->config().debug_options().xla_cpu_enable_inter_op_parallelism() &&
+      !module->config().hlo_profiling_enabled() &&
+      IsTaskGraph(*entry_computation);
+  std::unique_ptr<HloOrdering> hlo_ordering;
+  if (emit_task_graph) {
+    hlo_ordering = std::make_unique<DependencyHloOrdering>(module.get());
+  } else {
+    hlo_ordering = std::make_unique<SequentialHloOrdering>(schedule);
+  }
+
   // Run buffer allocation on the HLO graph.
   TF_ASSIGN_OR_RETURN(
       std::unique_ptr<BufferAssignment> assignment,
-      BufferAssigner::Run(module.get(),
-                          std::make_unique<SequentialHloOrdering>(schedule),
+      BufferAssigner::Run(module.get(), std::move(hlo_ordering),
                           BufferSizeBytesFunction(), memory_alignment,
                           /*allocate_buffers_for_constants=*/true));
   DumpHloModuleIfEnabled(*module, *assignment,
@@ -1416,6 +1736,7 @@ CpuCompiler::CompileLegacyCpuExecutable(std::unique_ptr<HloModule> module) {
                        /*emit_code_for_msan=*/false
 #endif
   );
+  ir_emitter.set_emit_task_graph(emit_task_graph);
 
   TF_RETURN_IF_ERROR(ir_emitter.EmitConstantGlobals());
 
@@ -1459,9 +1780,19 @@ CpuCompiler::CompileLegacyCpuExecutable(std::unique_ptr<HloModule> module) {
   TF_RETURN_IF_ERROR(VerifyLlvmModule(*llvm_module));
 
   // JIT compile the LLVM IR module to in-memory machine code.
-  llvm::orc::ThreadSafeModule thread_safe_module(std::move(llvm_module),
-                                                 std::move(llvm_context));
-  cantFail((*jit)->AddModule(std::move(thread_safe_module)));
+  if (num_compile_threads > 1) {
+    TF_ASSIGN_OR_RETURN(
+        std::vector<std::string> symbols,
+        AddModuleInParts(**jit, *llvm_module, num_compile_threads));
+    if (llvm::Error err = (*jit)->CompileSymbols(symbols)) {
+      return InternalError("Compiling LLVM module failed: %s",
+                           llvm::toString(std::move(err)));
+    }
+  } else {
+    llvm::orc::ThreadSafeModule thread_safe_module(std::move(llvm_module),
+                                                   std::move(llvm_context));
+    cantFail((*jit)->AddModule(std::move(thread_safe_module)));
+  }
 
   TF_ASSIGN_OR_RETURN(
       auto cpu_executable,
@@ -1473,6 +1804,9 @@ CpuCompiler::CompileLegacyCpuExecutable(std::unique_ptr<HloModule> module) {
   if (embed_ir_in_executable) {
     cpu_executable->set_ir_module_string(ir_module_string);
   }
+  if (obj_files != nullptr) {
+    cpu_executable->set_obj_files(std::move(*obj_files));
+  }
 
   // Dump computation proto state and buffer assignment for
   // GetCompiledMemoryStats results.
@@ -1485,6 +1819,84 @@ CpuCompiler::CompileLegacyCpuExecutable(std::unique_ptr<HloModule> module) {
   return cpu_executable;
 }
 
+CompilationCache* CpuCompiler::GetCompilationCache(
+    const HloModuleConfig& config) const {
+  const DebugOptions& debug_options = config.debug_options();
+  // Cached executables bypass LLVM IR entirely, and only the legacy runtime
+  // can be restored from object files.
+  if (user_pre_optimization_hook_ || user_post_optimization_hook_ ||
+      debug_options.xla_cpu_use_xla_runtime() ||
+      debug_options.xla_embed_ir_in_executable() ||
+      config.hlo_profiling_enabled()) {
+    return nullptr;
+  }
+  return CompilationCache::Get(debug_options);
+}
+
+StatusOr<std::unique_ptr<CpuExecutable>> CpuCompiler::LoadCachedExecutable(
+    const CompilationCacheEntryProto& entry) {
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<HloModule> module,
+                      HloModule::CreateFromProtoWithConfig(entry.hlo_module()));
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<BufferAssignment> assignment,
+      BufferAssignment::FromProto(entry.buffer_assignment(), module.get(),
+                                  BufferSizeBytesFunction(),
+                                  /*can_share_buffer=*/nullptr));
+
+  auto jit = SimpleOrcJIT::Create(
+      CompilerTargetOptions(module->config()),
+      CodeGenOptLevel(module->config()),
+      options::OptimizeForSizeRequested(module->config()),
+      module->config().debug_options().xla_llvm_disable_expensive_passes(),
+      options::SlpVectorizerDisabled(module->config()),
+      llvm_ir::GetCpuFastMathFlags(module->config()),
+      /*pre_optimization_hook=*/nullptr, /*post_optimization_hook=*/nullptr,
+      /*post_codegen_hook=*/nullptr);
+  if (!jit) {
+    return InternalError("Creating JIT failed: %s",
+                         llvm::toString(jit.takeError()));
+  }
+  for (const std::string& obj_file : entry.obj_files()) {
+    if (llvm::Error err = (*jit)->AddObjFile(
+            llvm::MemoryBuffer::getMemBufferCopy(obj_file))) {
+      return InternalError("Loading cached object file failed: %s",
+                           llvm::toString(std::move(err)));
+    }
+  }
+
+  TF_ASSIGN_OR_RETURN(
+      auto cpu_executable,
+      CpuExecutable::Create(std::move(*jit), std::move(assignment),
+                            std::move(module), entry.entry_function_name(),
+                            /*hlo_profile_printer_data=*/nullptr,
+                            /*hlo_profile_index_map=*/nullptr));
+
+  auto hlo_proto = std::make_unique<HloProto>();
+  *hlo_proto->mutable_hlo_module() = entry.hlo_module().hlo_module();
+  *hlo_proto->mutable_buffer_assignment() = entry.buffer_assignment();
+  cpu_executable->set_hlo_proto(std::move(hlo_proto));
+  cpu_executable->set_debug_info(
+      cpu_executable->buffer_assignment().GetStats().ToString());
+  return cpu_executable;
+}
+
+Status CpuCompiler::StoreCachedExecutable(CompilationCache& cache,
+                                          absl::string_view key,
+                                          CpuExecutable& executable) {
+  CompilationCacheEntryProto entry;
+  TF_ASSIGN_OR_RETURN(*entry.mutable_hlo_module(),
+                      executable.module().ToProtoWithConfig());
+  *entry.mutable_buffer_assignment() =
+      executable.buffer_assignment().ToProto();
+  for (const std::string& obj_file : executable.obj_files()) {
+    entry.add_obj_files(obj_file);
+  }
+  entry.set_entry_function_name(executable.module_name());
+  // The object files are no longer needed once they are cached.
+  executable.set_obj_files({});
+  return cache.Store(key, entry);
+}
+
 namespace {
 
 StatusOr<std::unique_ptr<XlaRuntimeCpuExecutable>> GetXlaRuntimeCpuExecutable(
@@ -1768,7 +2180,7 @@ CpuCompiler::CompileAheadOfTime(std::unique_ptr<HloModuleGroup> module_group,
     } else {
       // Set required information before emitting IR
       llvm_module =
-          std::make_unique<llvm::Module>("__compute_module", llvm_context);
+          std::make_unique<llvm::Module>(kLlvmModuleName, llvm_context);
       llvm_module->setDataLayout(target_machine->createDataLayout());
       llvm_module->setTargetTriple(triple.getTriple());
       if (pic_level != llvm::PICLevel::NotPIC) {
@@ -22,12 +22,14 @@ limitations under the License.
 #include <string_view>
 #include <vector>
 
+#include "absl/strings/string_view.h"
 #include "llvm/Target/TargetMachine.h"
 #include "xla/cpu_function_runtime.h"
 #include "xla/hlo/ir/hlo_module.h"
 #include "xla/hlo/ir/hlo_module_group.h"
 #include "xla/service/buffer_assignment.h"
 #include "xla/service/compiler.h"
+#include "xla/service/cpu/compilation_cache.h"
 #include "xla/service/cpu/executable.pb.h"
 #include "xla/service/cpu/target_machine_features.h"
 #include "xla/service/executable.h"
@@ -237,6 +239,18 @@ class CpuCompiler : public LLVMCompiler {
   StatusOr<std::unique_ptr<CpuExecutable>> CompileLegacyCpuExecutable(
       std::unique_ptr<HloModule> module);
 
+  // Returns the compilation cache to use for modules with `config`, or nullptr
+  // if their executables are not to be cached.
+  CompilationCache* GetCompilationCache(const HloModuleConfig& config) const;
+
+  // Restores an executable from a compilation cache entry.
+  StatusOr<std::unique_ptr<CpuExecutable>> LoadCachedExecutable(
+      const CompilationCacheEntryProto& entry);
+
+  // Stores `executable`, which must have kept its object files, under `key`.
+  Status StoreCachedExecutable(CompilationCache& cache, absl::string_view key,
+                               CpuExecutable& executable);
+
   CpuCompiler(const CpuCompiler&) = delete;
   CpuCompiler& operator=(const CpuCompiler&) = delete;
 
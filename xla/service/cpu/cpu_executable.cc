@@ -16,9 +16,13 @@ limitations under the License.
 #include "xla/service/cpu/cpu_executable.h"
 
 #include <stdint.h>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
 
 #include <algorithm>
 #include <functional>
+#include <memory>
 #include <optional>
 #include <set>
 #include <string>
@@ -30,9 +34,11 @@ limitations under the License.
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
+#include "absl/synchronization/mutex.h"
 #include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"  // from @llvm-project
 #include "mlir/Parser/Parser.h"  // from @llvm-project
+#include "xla/cpu_function_runtime.h"
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_module.h"
 #include "xla/mlir/runtime/transforms/compiler.h"
@@ -52,12 +58,115 @@ limitations under the License.
 #include "xla/xla_data.pb.h"
 #include "tsl/platform/env.h"
 #include "tsl/platform/logging.h"
+#include "tsl/platform/mem.h"
 
 namespace xla {
 namespace cpu {
 
 namespace runtime = ::xla::runtime;
 
+// Buffer assignment combines the temporaries of a computation into a few
+// preallocated temp allocations, but those would still be allocated, and their
+// pages faulted in, on every execution. This pool lays out all of them in one
+// slab and keeps slabs around for later executions. Large slabs are aligned to
+// and backed by huge pages to reduce TLB pressure.
+//
+// A slab is handed out per execution, so concurrent executions use distinct
+// slabs. Executions on one stream run one at a time, so the pool retains at
+// most kMaxRetainedSlabs free slabs and frees the rest. Slabs may outlive the
+// pool, e.g. when the executable is destroyed with a run still queued; they
+// are freed then.
+class CpuExecutable::TempSlabPool
+    : public std::enable_shared_from_this<TempSlabPool> {
+ public:
+  explicit TempSlabPool(const BufferAssignment& assignment)
+      : offsets_(assignment.Allocations().size(), -1) {
+    for (const BufferAllocation& allocation : assignment.Allocations()) {
+      if (!allocation.IsPreallocatedTempBuffer()) continue;
+      slab_size_ =
+          RoundUpTo<int64_t>(slab_size_, cpu_function_runtime::Align());
+      offsets_[allocation.index()] = slab_size_;
+      slab_size_ += allocation.size();
+    }
+    alignment_ = slab_size_ >= kHugePageSize ? kHugePageSize
+                                             : cpu_function_runtime::Align();
+    slab_size_ = RoundUpTo<int64_t>(slab_size_, alignment_);
+  }
+
+  ~TempSlabPool() {
+    for (void* slab : free_slabs_) tsl::port::AlignedFree(slab);
+  }
+
+  int64_t slab_size() const { return slab_size_; }
+
+  // Returns a slab that goes back to the pool when the last reference to it is
+  // dropped.
+  StatusOr<std::shared_ptr<void>> Acquire() {
+    void* slab = nullptr;
+    {
+      absl::MutexLock lock(&mu_);
+      if (!free_slabs_.empty()) {
+        slab = free_slabs_.back();
+        free_slabs_.pop_back();
+      }
+    }
+    if (slab == nullptr) {
+      slab = tsl::port::AlignedMalloc(slab_size_, alignment_);
+      if (slab == nullptr) {
+        return ResourceExhausted("Out of memory allocating %d bytes.",
+                                 slab_size_);
+      }
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+      if (alignment_ == kHugePageSize) {
+        // Best effort; transparent huge pages may be disabled.
+        madvise(slab, slab_size_, MADV_HUGEPAGE);
+      }
+#endif
+      ABSL_ANNOTATE_MEMORY_IS_INITIALIZED(slab, slab_size_);
+    }
+    return std::shared_ptr<void>(
+        slab, [pool = weak_from_this()](void* slab) {
+          if (auto locked = pool.lock()) {
+            locked->Release(slab);
+          } else {
+            tsl::port::AlignedFree(slab);
+          }
+        });
+  }
+
+  // Returns the memory of temp allocation `allocation` within `slab`.
+  se::DeviceMemoryBase Buffer(void* slab,
+                              const BufferAllocation& allocation) const {
+    int64_t offset = offsets_[allocation.index()];
+    DCHECK_GE(offset, 0) << allocation.ToString();
+    return se::DeviceMemoryBase(static_cast<char*>(slab) + offset,
+                                allocation.size());
+  }
+
+ private:
+  static constexpr int64_t kHugePageSize = 2 * 1024 * 1024;
+  static constexpr int kMaxRetainedSlabs = 2;
+
+  void Release(void* slab) {
+    {
+      absl::MutexLock lock(&mu_);
+      if (free_slabs_.size() < kMaxRetainedSlabs) {
+        free_slabs_.push_back(slab);
+        return;
+      }
+    }
+    tsl::port::AlignedFree(slab);
+  }
+
+  // Offset of each temp allocation within a slab; -1 for other allocations.
+  std::vector<int64_t> offsets_;
+  int64_t slab_size_ = 0;
+  int64_t alignment_;
+
+  absl::Mutex mu_;
+  std::vector<void*> free_slabs_ ABSL_GUARDED_BY(mu_);
+};
+
 StatusOr<std::unique_ptr<CpuExecutable>> CpuExecutable::Create(
     std::unique_ptr<SimpleOrcJIT> jit,
     std::unique_ptr<const BufferAssignment> assignment,
@@ -115,6 +224,9 @@ CpuExecutable::CpuExecutable(
   if (assignment_ && has_module()) {
     XlaDebugInfoManager::Get()->RegisterModule(shared_module(),
                                                assignment_->ToProto());
+    if (module().config().debug_options().xla_cpu_use_temp_slab()) {
+      temp_slab_pool_ = std::make_shared<TempSlabPool>(*assignment_);
+    }
   }
 }
 
@@ -162,7 +274,7 @@ static StatusOr<MaybeOwningDeviceMemory> MemoryForAllocation(
 
 StatusOr<std::vector<MaybeOwningDeviceMemory>> CpuExecutable::CreateBufferTable(
     se::DeviceMemoryAllocator* memory_allocator, int device_ordinal,
-    absl::Span<ExecutionInput const> arguments) {
+    absl::Span<ExecutionInput const> arguments, void* temp_slab) {
   std::vector<MaybeOwningDeviceMemory> buffers(
       assignment_->Allocations().size());
   VLOG(3) << "Allocating " << assignment_->Allocations().size()
@@ -170,6 +282,11 @@ StatusOr<std::vector<MaybeOwningDeviceMemory>> CpuExecutable::CreateBufferTable(
   for (BufferAllocation::Index i = 0; i < assignment_->Allocations().size();
        ++i) {
     const BufferAllocation& allocation = assignment_->GetAllocation(i);
+    if (temp_slab != nullptr && allocation.IsPreallocatedTempBuffer()) {
+      buffers[i] = MaybeOwningDeviceMemory{
+          temp_slab_pool_->Buffer(temp_slab, allocation)};
+      continue;
+    }
     TF_ASSIGN_OR_RETURN(
         buffers[i], MemoryForAllocation(allocation, arguments, memory_allocator,
                                         device_ordinal));
@@ -613,10 +730,14 @@ StatusOr<ExecutionOutput> CpuExecutable::ExecuteAsyncOnStream(
       run_options->stream()->implementation());
   se::Stream* stream = run_options->stream();
   se::DeviceMemoryAllocator* memory_allocator = run_options->allocator();
+  std::shared_ptr<void> temp_slab;
+  if (temp_slab_pool_ && temp_slab_pool_->slab_size() > 0) {
+    TF_ASSIGN_OR_RETURN(temp_slab, temp_slab_pool_->Acquire());
+  }
   TF_ASSIGN_OR_RETURN(
       std::vector<MaybeOwningDeviceMemory> buffers,
       CreateBufferTable(memory_allocator, stream->parent()->device_ordinal(),
-                        arguments));
+                        arguments, temp_slab.get()));
 
   TF_ASSIGN_OR_RETURN(
       ExecutionOutput result,
@@ -636,6 +757,9 @@ StatusOr<ExecutionOutput> CpuExecutable::ExecuteAsyncOnStream(
     CpuExecutable* executable;
     ServiceExecutableRunOptions run_options;
     std::shared_ptr<std::vector<MaybeOwningDeviceMemory>> task_buffers;
+    // Returned to the pool once the last copy of the task is destroyed, i.e.
+    // after the computation ran.
+    std::shared_ptr<void> temp_slab;
     HloExecutionProfile* hlo_execution_profile;
 
     Status operator()() {
@@ -647,7 +771,7 @@ StatusOr<ExecutionOutput> CpuExecutable::ExecuteAsyncOnStream(
       AsyncRunTask{this, *run_options,
                    std::make_shared<std::vector<MaybeOwningDeviceMemory>>(
                        std::move(buffers)),
-                   hlo_execution_profile});
+                   std::move(temp_slab), hlo_execution_profile});
 
   MarkToBeReleasedArguments(absl::MakeSpan(arguments), result);
   return std::move(result);
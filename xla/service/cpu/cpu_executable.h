@@ -177,6 +177,17 @@ class CpuExecutable : public Executable {
     ir_module_string_ = ir_module_string;
   }
 
+  // Name of the JIT-compiled function performing the computation.
+  const std::string& module_name() const { return module_name_; }
+
+  // Object files holding the JIT-compiled code. These are only kept when the
+  // executable is to be written to the compilation cache.
+  const std::vector<std::string>& obj_files() const { return obj_files_; }
+
+  void set_obj_files(std::vector<std::string> obj_files) {
+    obj_files_ = std::move(obj_files);
+  }
+
   static int64_t ShapeSizeBytes(const Shape& shape);
 
   // Type of the computation function we expect in the JIT.
@@ -226,9 +237,12 @@ class CpuExecutable : public Executable {
   //
   //  - buffers_to_free: buffers whose ownership was donated by the caller that
   //    are to be freed by the caller.
+  //
+  // If `temp_slab` is not null, the temporary buffers are placed in it rather
+  // than allocated from `memory_allocator`.
   StatusOr<std::vector<MaybeOwningDeviceMemory>> CreateBufferTable(
       se::DeviceMemoryAllocator* memory_allocator, int device_ordinal,
-      absl::Span<ExecutionInput const> arguments);
+      absl::Span<ExecutionInput const> arguments, void* temp_slab);
 
   // Creates an Execution output holding ScopedShapedBuffer for holding the
   // result of the computation, moving buffers out of allocated_buffers and into
@@ -258,6 +272,8 @@ class CpuExecutable : public Executable {
   // Unique identifier.
   std::string module_name_;
 
+  std::vector<std::string> obj_files_;
+
   ComputeFunctionType compute_function_;
 
   // Entry function name for the computation.
@@ -266,6 +282,11 @@ class CpuExecutable : public Executable {
   // If not null, XLA Runtime is enabled.
   std::unique_ptr<XlaRuntimeCpuExecutable> xla_runtime_executable_;
 
+  // Reusable memory for the temporary buffers. Null unless
+  // xla_cpu_use_temp_slab is set.
+  class TempSlabPool;
+  std::shared_ptr<TempSlabPool> temp_slab_pool_;
+
   CpuExecutable(std::unique_ptr<HloModule> hlo_module,
                 std::unique_ptr<HloProfilePrinterData> hlo_profile_printer_data,
                 std::unique_ptr<HloProfileIndexMap> hlo_profile_index_map,
@@ -0,0 +1,159 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/cpu_float_support.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/hlo/utils/hlo_matchers.h"
+#include "xla/service/cpu/target_machine_features_fake.h"
+#include "xla/service/float_normalization.h"
+#include "xla/test.h"
+#include "xla/tests/hlo_test_base.h"
+#include "tsl/platform/statusor.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+namespace op = xla::testing::opcode_matchers;
+
+class FakeTargetMachineFeatures
+    : public TargetMachineFeaturesWithFakeAlignmentLogic {
+ public:
+  explicit FakeTargetMachineFeatures(bool has_avx512_bf16)
+      : TargetMachineFeaturesWithFakeAlignmentLogic([](int64_t size) {
+          return TargetMachineFeatures::kEigenExpectedTensorAlignment;
+        }),
+        has_avx512_bf16_(has_avx512_bf16) {}
+
+  bool has_avx512_bf16() const override { return has_avx512_bf16_; }
+
+ private:
+  bool has_avx512_bf16_;
+};
+
+class CpuFloatSupportTest : public HloTestBase {
+ protected:
+  StatusOr<bool> Normalize(HloModule* module, bool has_avx512_bf16 = true) {
+    FakeTargetMachineFeatures target_machine_features(has_avx512_bf16);
+    CpuFloatSupport float_support(BF16, &target_machine_features);
+    return FloatNormalization(&float_support).Run(module);
+  }
+};
+
+TEST_F(CpuFloatSupportTest, KeepsBF16Dot) {
+  const std::string hlo_string = R"(
+    HloModule BF16Dot
+    ENTRY e {
+      p0 = bf16[64,128] parameter(0)
+      p1 = bf16[128,32] parameter(1)
+      ROOT dot = bf16[64,32] dot(p0, p1),
+        lhs_contracting_dims={1}, rhs_contracting_dims={0}
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, Normalize(m.get()));
+  EXPECT_FALSE(changed);
+}
+
+TEST_F(CpuFloatSupportTest, NormalizesDotWithoutAvx512BF16) {
+  const std::string hlo_string = R"(
+    HloModule BF16Dot
+    ENTRY e {
+      p0 = bf16[64,128] parameter(0)
+      p1 = bf16[128,32] parameter(1)
+      ROOT dot = bf16[64,32] dot(p0, p1),
+        lhs_contracting_dims={1}, rhs_contracting_dims={0}
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed,
+                          Normalize(m.get(), /*has_avx512_bf16=*/false));
+  EXPECT_TRUE(changed);
+  EXPECT_THAT(m->entry_computation()->root_instruction(),
+              op::Convert(op::Dot(op::Convert(op::Parameter(0)),
+                                  op::Convert(op::Parameter(1)))));
+}
+
+TEST_F(CpuFloatSupportTest, NormalizesMatrixVectorDot) {
+  // Matrix-vector products are emitted as LLVM IR.
+  const std::string hlo_string = R"(
+    HloModule BF16Gemv
+    ENTRY e {
+      p0 = bf16[64,128] parameter(0)
+      p1 = bf16[128] parameter(1)
+      ROOT dot = bf16[64] dot(p0, p1),
+        lhs_contracting_dims={1}, rhs_contracting_dims={0}
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, Normalize(m.get()));
+  EXPECT_TRUE(changed);
+  EXPECT_THAT(m->entry_computation()->root_instruction(),
+              op::Convert(op::Dot(op::Convert(), op::Convert())));
+}
+
+TEST_F(CpuFloatSupportTest, KeepsBF16Convolution) {
+  const std::string hlo_string = R"(
+    HloModule BF16Convolution
+    ENTRY e {
+      p0 = bf16[4,16,16,32] parameter(0)
+      p1 = bf16[3,3,32,64] parameter(1)
+      ROOT conv = bf16[4,16,16,64] convolution(p0, p1),
+        window={size=3x3 pad=1_1x1_1}, dim_labels=b01f_01io->b01f
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, Normalize(m.get()));
+  EXPECT_FALSE(changed);
+}
+
+TEST_F(CpuFloatSupportTest, KeepsDataMovementAndNormalizesArithmetic) {
+  const std::string hlo_string = R"(
+    HloModule BF16Add
+    ENTRY e {
+      p0 = bf16[64,32] parameter(0)
+      p1 = bf16[32,64] parameter(1)
+      transpose = bf16[64,32] transpose(p1), dimensions={1,0}
+      ROOT add = bf16[64,32] add(p0, transpose)
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, Normalize(m.get()));
+  EXPECT_TRUE(changed);
+  EXPECT_THAT(m->entry_computation()->root_instruction(),
+              op::Convert(
+                  op::Add(op::Convert(op::Parameter(0)),
+                          op::Convert(op::Transpose(op::Parameter(1))))));
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -103,6 +103,11 @@ static bool OperandsAndResultMustHaveRowMajorLayout(
   } else if (instr.opcode() == HloOpcode::kDot) {
     return DotOperandsAndResultMustHaveRowMajorLayout(instr,
                                                       target_machine_features);
+  } else if (instr.opcode() == HloOpcode::kAllGather ||
+             instr.opcode() == HloOpcode::kReduceScatter) {
+    // The runtime concatenates and splits buffers along the most major
+    // dimensions, so operand and result layouts have to agree.
+    return PotentiallyImplementedAsNativeCollective(instr);
   }
   return false;
 }
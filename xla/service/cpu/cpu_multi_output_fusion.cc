@@ -0,0 +1,232 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/cpu_multi_output_fusion.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/layout_util.h"
+#include "xla/service/cpu/ir_emission_utils.h"
+#include "xla/service/llvm_ir/dynamic_update_slice_util.h"
+#include "xla/shape.h"
+#include "xla/shape_util.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/logging.h"
+
+namespace xla {
+namespace cpu {
+
+namespace {
+
+// Returns the shape of the loop that computes `instr`.
+const Shape& GetLoopShape(const HloInstruction* instr) {
+  return instr->shape().IsTuple() ? instr->shape().tuple_shapes(0)
+                                  : instr->shape();
+}
+
+// Returns whether `reduce` reduces the minor dimension of its operand. The
+// IrEmitter vectorizes the other reductions when they aren't fused.
+bool ReducesMinorDimension(const HloInstruction& reduce) {
+  const Shape& operand_shape = reduce.operand(0)->shape();
+  return operand_shape.rank() > 0 &&
+         absl::c_linear_search(reduce.dimensions(),
+                               LayoutUtil::Minor(operand_shape.layout(), 0));
+}
+
+// Returns the non-scalar operands of `instr`, which it reads from memory.
+absl::flat_hash_set<const HloInstruction*> GetReadOperands(
+    const HloInstruction* instr) {
+  absl::flat_hash_set<const HloInstruction*> operands;
+  for (const HloInstruction* operand : instr->operands()) {
+    if (!ShapeUtil::IsEffectiveScalar(operand->shape())) {
+      operands.insert(operand);
+    }
+  }
+  return operands;
+}
+
+// Merges the outputs of `fusion` into a single variadic reduce, if they are
+// all reductions of the same dimensions of operands of the same shape.
+StatusOr<bool> MergeSiblingReductions(HloInstruction* fusion) {
+  HloComputation* fused_computation = fusion->fused_instructions_computation();
+  HloInstruction* root = fused_computation->root_instruction();
+  if (root->opcode() != HloOpcode::kTuple) {
+    return false;
+  }
+  const HloInstruction* first = root->operand(0);
+  absl::flat_hash_set<const HloInstruction*> seen;
+  for (const HloInstruction* reduce : root->operands()) {
+    if (reduce->opcode() != HloOpcode::kReduce || !reduce->shape().IsArray() ||
+        reduce->user_count() != 1 || !seen.insert(reduce).second ||
+        reduce->dimensions() != first->dimensions() ||
+        !ShapeUtil::EqualIgnoringElementType(reduce->operand(0)->shape(),
+                                             first->operand(0)->shape())) {
+      return false;
+    }
+    for (const HloInstruction* instr : reduce->to_apply()->instructions()) {
+      if (!instr->called_computations().empty()) {
+        return false;
+      }
+    }
+  }
+
+  // The reducer of a variadic reduce takes all the accumulators, then all the
+  // values, and returns a tuple of the new accumulators.
+  const int64_t num_reduces = root->operand_count();
+  HloComputation::Builder builder(absl::StrCat(fusion->name(), "_reducer"));
+  std::vector<HloInstruction*> parameters(2 * num_reduces);
+  for (int64_t i = 0; i < num_reduces; ++i) {
+    const HloComputation* reducer = root->operand(i)->to_apply();
+    for (int64_t j = 0; j < 2; ++j) {
+      const HloInstruction* parameter = reducer->parameter_instruction(j);
+      const int64_t number = i + j * num_reduces;
+      parameters[number] =
+          builder.AddInstruction(HloInstruction::CreateParameter(
+              number, parameter->shape(),
+              absl::StrCat(parameter->name(), ".", i)));
+    }
+  }
+  std::vector<HloInstruction*> results;
+  for (int64_t i = 0; i < num_reduces; ++i) {
+    HloComputation* reducer = root->mutable_operand(i)->to_apply();
+    absl::flat_hash_map<const HloInstruction*, HloInstruction*> clones;
+    clones[reducer->parameter_instruction(0)] = parameters[i];
+    clones[reducer->parameter_instruction(1)] = parameters[i + num_reduces];
+    for (HloInstruction* instr : reducer->MakeInstructionPostOrder()) {
+      if (instr->opcode() == HloOpcode::kParameter) {
+        continue;
+      }
+      std::vector<HloInstruction*> new_operands;
+      for (const HloInstruction* operand : instr->operands()) {
+        new_operands.push_back(clones.at(operand));
+      }
+      clones[instr] = builder.AddInstruction(
+          instr->CloneWithNewOperands(instr->shape(), new_operands));
+    }
+    results.push_back(clones.at(reducer->root_instruction()));
+  }
+  builder.AddInstruction(HloInstruction::CreateTuple(results));
+  HloComputation* reducer =
+      fusion->GetModule()->AddEmbeddedComputation(builder.Build());
+
+  std::vector<HloInstruction*> inputs;
+  std::vector<HloInstruction*> init_values;
+  for (HloInstruction* reduce : root->operands()) {
+    inputs.push_back(reduce->mutable_operand(0));
+    init_values.push_back(reduce->mutable_operand(1));
+  }
+  HloInstruction* merged =
+      fused_computation->AddInstruction(HloInstruction::CreateReduce(
+          root->shape(), inputs, init_values, first->dimensions(), reducer));
+  VLOG(2) << "Merging the reductions of " << fusion->name() << " into "
+          << merged->ToString();
+  fused_computation->set_root_instruction(merged);
+  TF_RETURN_IF_ERROR(
+      fused_computation->RemoveInstructionAndUnusedOperands(root));
+  return true;
+}
+
+}  // namespace
+
+StatusOr<bool> CpuMultiOutputFusion::Run(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  TF_ASSIGN_OR_RETURN(bool changed,
+                      MultiOutputFusion::Run(module, execution_threads));
+  if (!changed) {
+    return false;
+  }
+  for (HloComputation* computation :
+       module->MakeNonfusionComputations(execution_threads)) {
+    for (HloInstruction* instr : computation->instructions()) {
+      if (instr->IsMultiOutputFusion()) {
+        TF_RETURN_IF_ERROR(MergeSiblingReductions(instr).status());
+      }
+    }
+  }
+  return true;
+}
+
+bool CpuMultiOutputFusion::ShapesCompatibleForFusion(HloInstruction* instr1,
+                                                     HloInstruction* instr2) {
+  // All outputs are computed by one loop over the shape of the first one.
+  return ShapeUtil::EqualIgnoringElementType(GetLoopShape(instr1),
+                                             GetLoopShape(instr2));
+}
+
+bool CpuMultiOutputFusion::IsFusible(HloInstruction* instr) {
+  if (instr->opcode() == HloOpcode::kFusion) {
+    // Dynamic-update-slices are emitted in place, and output fusions call the
+    // dot emitter.
+    if (!instr->IsLoopFusion() ||
+        llvm_ir::MayBeImplementedAsInPlaceDynamicUpdateSlice(instr)) {
+      return false;
+    }
+    return instr->shape().IsArray() ||
+           (instr->IsMultiOutputFusion() && IsMultiOutputLoop(*instr));
+  }
+  if (!instr->shape().IsArray()) {
+    return false;
+  }
+  if (instr->opcode() == HloOpcode::kReduce) {
+    return ReducesMinorDimension(*instr);
+  }
+  return instr->IsElementwise() && instr->operand_count() > 0;
+}
+
+int64_t CpuMultiOutputFusion::GetProfit(HloInstruction* instr1,
+                                        HloInstruction* instr2) {
+  // The bytes of the operands both instructions read, which the fusion reads
+  // once, in KiB. Siblings that share less than a KiB aren't fused: their
+  // shared operands stay in L1 between the two loops, so reading them twice
+  // costs about nothing, while fusing forces all outputs into one loop nest
+  // and a tuple-shaped result. Counting in KiB also makes the base class fuse
+  // the pairs that share the most memory first.
+  absl::flat_hash_set<const HloInstruction*> operands1 =
+      GetReadOperands(instr1);
+  int64_t profit = 0;
+  for (const HloInstruction* operand : GetReadOperands(instr2)) {
+    if (operands1.contains(operand)) {
+      profit += ShapeUtil::ByteSizeOf(operand->shape());
+    }
+  }
+  return profit >> 10;
+}
+
+bool CpuMultiOutputFusion::LegalToFuse(HloInstruction* instr1,
+                                       HloInstruction* instr2) {
+  // Unlike the base class, this also fuses two unfused instructions.
+  return LegalToFuseMainConstraints(instr1, instr2);
+}
+
+HloInstruction* CpuMultiOutputFusion::Fuse(HloInstruction* instr1,
+                                           HloInstruction* instr2) {
+  if (instr1->opcode() != HloOpcode::kFusion &&
+      instr2->opcode() != HloOpcode::kFusion) {
+    instr1 = CreateFusion(instr1, instr2);
+  }
+  return MultiOutputFusion::Fuse(instr1, instr2);
+}
+
+}  // namespace cpu
+}  // namespace xla
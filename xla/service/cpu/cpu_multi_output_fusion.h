@@ -0,0 +1,61 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_CPU_CPU_MULTI_OUTPUT_FUSION_H_
+#define XLA_SERVICE_CPU_CPU_MULTI_OUTPUT_FUSION_H_
+
+#include <cstdint>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/multi_output_fusion.h"
+#include "xla/statusor.h"
+
+namespace xla {
+namespace cpu {
+
+// Fuses sibling loop fusions, elementwise ops and reductions that read the same
+// operands into multi-output loop fusions, so that the shared operands are read
+// from memory once. E.g. the mean and the mean of squares of a layer norm.
+//
+// The IrEmitter computes all outputs of a multi-output loop fusion in one loop
+// nest, which requires them to have the same dimensions and layout. If all the
+// outputs of a fusion are reductions of the same dimensions, they are merged
+// into a single variadic reduce, which reads its inputs in one pass.
+class CpuMultiOutputFusion : public MultiOutputFusion {
+ public:
+  absl::string_view name() const override { return "cpu-multi-output-fusion"; }
+
+  using HloPassInterface::Run;
+  StatusOr<bool> Run(
+      HloModule* module,
+      const absl::flat_hash_set<absl::string_view>& execution_threads) override;
+
+ protected:
+  bool ShapesCompatibleForFusion(HloInstruction* instr1,
+                                 HloInstruction* instr2) override;
+  bool IsFusible(HloInstruction* instr) override;
+  int64_t GetProfit(HloInstruction* instr1, HloInstruction* instr2) override;
+  bool LegalToFuse(HloInstruction* instr1, HloInstruction* instr2) override;
+  HloInstruction* Fuse(HloInstruction* instr1,
+                       HloInstruction* instr2) override;
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_CPU_CPU_MULTI_OUTPUT_FUSION_H_
@@ -0,0 +1,188 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/cpu_multi_output_fusion.h"
+
+#include <memory>
+
+#include "absl/strings/string_view.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/hlo/utils/hlo_matchers.h"
+#include "xla/tests/hlo_test_base.h"
+#include "tsl/platform/statusor.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+namespace op = xla::testing::opcode_matchers;
+
+using CpuMultiOutputFusionTest = HloTestBase;
+
+// The sum and the sum of squares of a layer norm, over rows of 256 floats.
+constexpr absl::string_view kLayerNormStatistics = R"(
+HloModule LayerNormStatistics
+
+add {
+  lhs = f32[] parameter(0)
+  rhs = f32[] parameter(1)
+  ROOT add = f32[] add(lhs, rhs)
+}
+
+ENTRY e {
+  p0 = f32[64,256]{1,0} parameter(0)
+  zero = f32[] constant(0)
+  sum = f32[64]{0} reduce(p0, zero), dimensions={1}, to_apply=add
+  squares = f32[64,256]{1,0} multiply(p0, p0)
+  sum_of_squares = f32[64]{0} reduce(squares, zero), dimensions={1},
+    to_apply=add
+  ROOT tuple = (f32[64]{0}, f32[64]{0}) tuple(sum, sum_of_squares)
+})";
+
+TEST_F(CpuMultiOutputFusionTest, FusesSiblingReductions) {
+  // The sum of squares is fused with its producer by CpuInstructionFusion.
+  constexpr absl::string_view kHlo = R"(
+HloModule SiblingReductions
+
+add {
+  lhs = f32[] parameter(0)
+  rhs = f32[] parameter(1)
+  ROOT add = f32[] add(lhs, rhs)
+}
+
+fused_computation {
+  p = f32[64,256]{1,0} parameter(0)
+  squares = f32[64,256]{1,0} multiply(p, p)
+  zero = f32[] constant(0)
+  ROOT sum_of_squares = f32[64]{0} reduce(squares, zero), dimensions={1},
+    to_apply=add
+}
+
+ENTRY e {
+  p0 = f32[64,256]{1,0} parameter(0)
+  zero = f32[] constant(0)
+  sum = f32[64]{0} reduce(p0, zero), dimensions={1}, to_apply=add
+  sum_of_squares = f32[64]{0} fusion(p0), kind=kLoop,
+    calls=fused_computation
+  ROOT tuple = (f32[64]{0}, f32[64]{0}) tuple(sum, sum_of_squares)
+})";
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(kHlo));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed,
+                          CpuMultiOutputFusion().Run(module.get()));
+  EXPECT_TRUE(changed);
+
+  const HloInstruction* root = module->entry_computation()->root_instruction();
+  EXPECT_THAT(root, op::Tuple(op::GetTupleElement(op::Fusion()),
+                              op::GetTupleElement(op::Fusion())));
+  const HloInstruction* fusion = root->operand(0)->operand(0);
+  EXPECT_EQ(fusion, root->operand(1)->operand(0));
+  // Both sums are computed by a single variadic reduce.
+  const HloInstruction* reduce = fusion->fused_expression_root();
+  EXPECT_EQ(reduce->opcode(), HloOpcode::kReduce);
+  EXPECT_EQ(reduce->operand_count(), 4);
+  EXPECT_TRUE(reduce->shape().IsTuple());
+}
+
+TEST_F(CpuMultiOutputFusionTest, FusesSiblingLoopFusions) {
+  constexpr absl::string_view kHlo = R"(
+HloModule SiblingLoopFusions
+
+fused_computation_1 {
+  p = f32[64,256]{1,0} parameter(0)
+  ROOT exp = f32[64,256]{1,0} exponential(p)
+}
+
+fused_computation_2 {
+  p = f32[64,256]{1,0} parameter(0)
+  ROOT neg = f32[64,256]{1,0} negate(p)
+}
+
+ENTRY e {
+  p0 = f32[64,256]{1,0} parameter(0)
+  fusion.1 = f32[64,256]{1,0} fusion(p0), kind=kLoop,
+    calls=fused_computation_1
+  fusion.2 = f32[64,256]{1,0} fusion(p0), kind=kLoop,
+    calls=fused_computation_2
+  ROOT tuple = (f32[64,256]{1,0}, f32[64,256]{1,0}) tuple(fusion.1, fusion.2)
+})";
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(kHlo));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed,
+                          CpuMultiOutputFusion().Run(module.get()));
+  EXPECT_TRUE(changed);
+
+  const HloInstruction* root = module->entry_computation()->root_instruction();
+  EXPECT_THAT(root, op::Tuple(op::GetTupleElement(op::Fusion()),
+                              op::GetTupleElement(op::Fusion())));
+  const HloInstruction* fusion = root->operand(0)->operand(0);
+  EXPECT_EQ(fusion, root->operand(1)->operand(0));
+  EXPECT_THAT(fusion->fused_expression_root(),
+              op::Tuple(op::Exp(), op::Negate()));
+}
+
+TEST_F(CpuMultiOutputFusionTest, DoesNotFuseDifferentLayouts) {
+  constexpr absl::string_view kHlo = R"(
+HloModule DifferentLayouts
+
+ENTRY e {
+  p0 = f32[64,256]{1,0} parameter(0)
+  exp = f32[64,256]{1,0} exponential(p0)
+  neg = f32[64,256]{0,1} negate(p0)
+  ROOT tuple = (f32[64,256]{1,0}, f32[64,256]{0,1}) tuple(exp, neg)
+})";
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(kHlo));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed,
+                          CpuMultiOutputFusion().Run(module.get()));
+  EXPECT_FALSE(changed);
+}
+
+TEST_F(CpuMultiOutputFusionTest, DoesNotFuseColumnReductions) {
+  // Reductions over the major dimension are vectorized by the IrEmitter.
+  constexpr absl::string_view kHlo = R"(
+HloModule ColumnReductions
+
+add {
+  lhs = f32[] parameter(0)
+  rhs = f32[] parameter(1)
+  ROOT add = f32[] add(lhs, rhs)
+}
+
+ENTRY e {
+  p0 = f32[64,256]{1,0} parameter(0)
+  zero = f32[] constant(0)
+  sum = f32[256]{0} reduce(p0, zero), dimensions={0}, to_apply=add
+  squares = f32[64,256]{1,0} multiply(p0, p0)
+  sum_of_squares = f32[256]{0} reduce(squares, zero), dimensions={0},
+    to_apply=add
+  ROOT tuple = (f32[256]{0}, f32[256]{0}) tuple(sum, sum_of_squares)
+})";
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(kHlo));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed,
+                          CpuMultiOutputFusion().Run(module.get()));
+  EXPECT_FALSE(changed);
+}
+
+TEST_F(CpuMultiOutputFusionTest, LayerNormStatisticsExecuteCorrectly) {
+  EXPECT_TRUE(RunAndCompare(kLayerNormStatistics, ErrorSpec{1e-4, 1e-4}));
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
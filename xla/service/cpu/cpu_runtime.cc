@@ -20,6 +20,7 @@ limitations under the License.
 #include <cstddef>
 #include <cstring>
 #include <functional>
+#include <iterator>
 #include <limits>
 #include <map>
 #include <memory>
@@ -29,25 +30,34 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/algorithm/container.h"
 #include "absl/base/dynamic_annotations.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "xla/executable_run_options.h"
 #include "xla/layout_util.h"
 #include "xla/primitive_util.h"
-#include "xla/refcounting_hash_map.h"
 #include "xla/service/collective_ops_utils.h"
 #include "xla/service/computation_placer.h"
+#include "xla/service/cpu/collectives_interface.h"
+#include "xla/service/cpu/cpu_executable_run_options.h"
+#include "xla/service/cpu/in_process_collectives.h"
 #include "xla/service/cpu/xfeed_manager.h"
+#include "xla/service/custom_call_status.h"
+#include "xla/service/global_device_id.h"
 #include "xla/service/hlo_parser.h"
 #include "xla/shape_util.h"
+#include "xla/status.h"
 #include "xla/statusor.h"
 #include "xla/stream_executor/device_memory.h"
 #include "xla/stream_executor/stream_executor.h"
 #include "tsl/platform/logging.h"
 #include "tsl/platform/status.h"
+#include "tsl/platform/statusor.h"
 #include "tsl/profiler/lib/traceme.h"
 
 namespace xla {
@@ -78,6 +88,12 @@ extern const char* const kEigenMatMulC128SymbolName =
     "__xla_cpu_runtime_EigenMatMulC128";
 extern const char* const kEigenMatMulS32SymbolName =
     "__xla_cpu_runtime_EigenMatMulS32";
+extern const char* const kInt8MatMulSymbolName =
+    "__xla_cpu_runtime_Int8MatMul";
+extern const char* const kInt8MatMulU8SymbolName =
+    "__xla_cpu_runtime_Int8MatMulU8";
+extern const char* const kBF16MatMulSymbolName =
+    "__xla_cpu_runtime_BF16MatMul";
 extern const char* const kEigenBatchMatMulF32SymbolName =
     "__xla_cpu_runtime_EigenBatchMatMulF32";
 extern const char* const kMKLConv2DF32SymbolName =
@@ -92,6 +108,12 @@ extern const char* const kEigenConv2DF16SymbolName =
     "__xla_cpu_runtime_EigenConv2DF16";
 extern const char* const kEigenConv2DF32SymbolName =
     "__xla_cpu_runtime_EigenConv2DF32";
+extern const char* const kInt8Conv2DSymbolName =
+    "__xla_cpu_runtime_Int8Conv2D";
+extern const char* const kInt8Conv2DU8SymbolName =
+    "__xla_cpu_runtime_Int8Conv2DU8";
+extern const char* const kBF16Conv2DSymbolName =
+    "__xla_cpu_runtime_BF16Conv2D";
 extern const char* const kEigenConv3DF16SymbolName =
     "__xla_cpu_runtime_EigenConv3DF16";
 extern const char* const kEigenConv3DF32SymbolName =
@@ -135,13 +157,26 @@ extern const char* const kStatusIsSuccessSymbolName =
     "__xla_cpu_runtime_StatusIsSuccess";
 extern const char* const kKeyValueSortSymbolName =
     "__xla_cpu_runtime_KeyValueSort";
+extern const char* const kSortPrimitiveSymbolName =
+    "__xla_cpu_runtime_SortPrimitive";
 extern const char* const kTopKF32SymbolName = "__xla_cpu_runtime_TopKF32";
+extern const char* const kTopKF64SymbolName = "__xla_cpu_runtime_TopKF64";
+extern const char* const kTopKBF16SymbolName = "__xla_cpu_runtime_TopKBF16";
+extern const char* const kTopKF16SymbolName = "__xla_cpu_runtime_TopKF16";
+extern const char* const kTopKS32SymbolName = "__xla_cpu_runtime_TopKS32";
+extern const char* const kTopKU32SymbolName = "__xla_cpu_runtime_TopKU32";
+extern const char* const kTransposeSymbolName = "__xla_cpu_runtime_Transpose";
+extern const char* const kExecuteTaskGraphSymbolName =
+    "__xla_cpu_runtime_ExecuteTaskGraph";
 extern const char* const kTracingStartSymbolName =
     "__xla_cpu_runtime_TracingStart";
 extern const char* const kTracingEndSymbolName = "__xla_cpu_runtime_TracingEnd";
 extern const char* const kXlaCpuRuntimeSymbolNamePrefix = "__xla_cpu_runtime_";
 extern const char* const kAllReduceSymbolName = "__xla_cpu_runtime_AllReduce";
 extern const char* const kAllToAllSymbolName = "__xla_cpu_runtime_AllToAll";
+extern const char* const kAllGatherSymbolName = "__xla_cpu_runtime_AllGather";
+extern const char* const kReduceScatterSymbolName =
+    "__xla_cpu_runtime_ReduceScatter";
 extern const char* const kCollectivePermuteSymbolName =
     "__xla_cpu_runtime_CollectivePermute";
 extern const char* const kPartitionIdSymbolName =
@@ -152,69 +187,6 @@ extern const char* const kOneDnnMatMulSymbolName =
 
 namespace {
 
-struct CollectivePermuteParticipantData : ParticipantData {
-  CollectivePermuteParticipantData(const RendezvousKey& rendezvous_key_p,
-                                   int64_t device_ordinal_p,
-                                   se::Stream* stream_p)
-      : ParticipantData(rendezvous_key_p),
-        device_ordinal(device_ordinal_p),
-        stream(stream_p) {}
-
-  int64_t device_ordinal;
-  se::Stream* stream;
-  int replica_id;
-  se::DeviceMemoryBase source_data;
-  se::DeviceMemoryBase destination_data;
-  int64_t byte_size;
-  std::vector<int> replica_ids_to_copy_to;
-
-  std::string ToString() const override {
-    return absl::StrFormat(
-        "CollectivePermuteParticipantData{replica_id=%d, "
-        "source_data=%p, destination_data=%p, byte_size=%d, "
-        "replica_ids_to_copy_to=[%s], device_ordinal=%d, stream=%p}",
-        replica_id, source_data.opaque(), destination_data.opaque(), byte_size,
-        absl::StrJoin(replica_ids_to_copy_to, ", "), device_ordinal, stream);
-  }
-};
-
-struct AllToAllParticipantData : ParticipantData {
-  AllToAllParticipantData(const RendezvousKey& rendezvous_key_p,
-                          int64_t device_ordinal_p, se::Stream* stream_p)
-      : ParticipantData(rendezvous_key_p),
-        device_ordinal(device_ordinal_p),
-        stream(stream_p) {}
-
-  int64_t device_ordinal;
-  se::Stream* stream;
-  std::vector<se::DeviceMemoryBase> source_buffers;
-  std::vector<se::DeviceMemoryBase> destination_buffers;
-  GlobalDeviceId device_id;
-
-  // Replica ids participating in AllToAll, concatenation happens in the order
-  // of appearance.
-  std::vector<GlobalDeviceId> devices_to_copy_to;
-
-  std::string ToString() const override {
-    auto addr_formatter = [](std::string* out,
-                             const se::DeviceMemoryBase& mem) {
-      absl::StrAppend(out, absl::StrFormat("%p", mem.opaque()));
-    };
-    auto device_formatter = [](std::string* out, const GlobalDeviceId& device) {
-      absl::StrAppend(out, device.value());
-    };
-    return absl::StrFormat(
-        "AllToAllParticipantData{replica_id=%d, "
-        "replica_ids_to_copy_to=[%s], source_buffers=[%s], "
-        "destination_buffers=[%s], device_ordinal=%d, stream=%p}",
-        device_id.value(),
-        absl::StrJoin(devices_to_copy_to, ", ", device_formatter),
-        absl::StrJoin(source_buffers, ", ", addr_formatter),
-        absl::StrJoin(destination_buffers, ", ", addr_formatter),
-        device_ordinal, stream);
-  }
-};
-
 // Inverses the encoding of a Shape protobuf into an LLVM global variable.
 StatusOr<Shape> DecodeSelfDescribingShapeConstant(const void* shape_ptr,
                                                   int32_t size_bytes) {
@@ -250,319 +222,47 @@ int GetDeviceOrdinal(const ExecutableRunOptions* run_options) {
   return run_options->stream()->parent()->device_ordinal();
 }
 
-class CpuAllToAllRendezvous
-    : public Rendezvous<AllToAllParticipantData, std::nullptr_t> {
- public:
-  explicit CpuAllToAllRendezvous(const RendezvousKey& k)
-      : Rendezvous<AllToAllParticipantData, std::nullptr_t>(k) {}
-
- protected:
-  StatusOr<std::nullptr_t> RunCollectiveOp(
-      const AllToAllParticipantData& /*participant*/) override {
-    bool is_primary = InitializationBarrier();
-
-    if (is_primary) {
-      absl::MutexLock lock(&mu_);
-
-      CHECK(!participants_.empty());
-      CHECK(!participants_[0].source_buffers.empty());
-      int expected_buffer_size = participants_[0].source_buffers[0].size();
-
-      // Device id -> position in participants_.
-      absl::flat_hash_map<GlobalDeviceId, int> device_map;
-
-      for (int pos = 0; pos < participants_.size(); pos++) {
-        const AllToAllParticipantData& p = participants_[pos];
-        CHECK_EQ(p.source_buffers.size(), p.destination_buffers.size());
-        CHECK_EQ(p.source_buffers.size(), participants_.size());
-        for (int i = 0; i < p.source_buffers.size(); i++) {
-          CHECK_EQ(p.destination_buffers[i].size(), expected_buffer_size);
-          CHECK_EQ(p.source_buffers[i].size(), expected_buffer_size);
-        }
-        device_map[p.device_id] = pos;
-      }
-
-      const std::vector<GlobalDeviceId>& devices_to_copy_to =
-          participants_[0].devices_to_copy_to;
-
-      // Device id -> rank
-      absl::flat_hash_map<GlobalDeviceId, int> device_ranks;
-      for (int rank = 0; rank < devices_to_copy_to.size(); ++rank) {
-        auto device_id = devices_to_copy_to[rank];
-        device_ranks[device_id] = rank;
-      }
-
-      for (const AllToAllParticipantData& sender : participants_) {
-        VLOG(3) << "Processing AllToAll participant: " << sender.ToString();
-
-        int rank = FindOrDie(device_ranks, sender.device_id);
-
-        for (int i = 0; i < participants_.size(); ++i) {
-          auto device_id = devices_to_copy_to[i];
-          int participant_num = FindOrDie(device_map, device_id);
-          AllToAllParticipantData& receiver = participants_[participant_num];
-
-          std::memcpy(receiver.destination_buffers[rank].opaque(),
-                      sender.source_buffers[i].opaque(), expected_buffer_size);
-        }
-      }
-    }
-    return nullptr;
-  }
-};
-
-class CpuCollectivePermuteRendezvous
-    : public Rendezvous<CollectivePermuteParticipantData, std::nullptr_t> {
- public:
-  explicit CpuCollectivePermuteRendezvous(const RendezvousKey& k)
-      : Rendezvous<CollectivePermuteParticipantData, std::nullptr_t>(k) {}
-
- protected:
-  StatusOr<std::nullptr_t> RunCollectiveOp(
-      const CollectivePermuteParticipantData& /*participant*/) override {
-    bool primary = InitializationBarrier();
-
-    // Perform all copies from the primary thread.
-    if (primary) {
-      absl::MutexLock lock(&mu_);
-
-      std::map<int, int> replica_idx_to_participant_idx;
-      for (int p_idx = 0; p_idx < participants_.size(); p_idx++) {
-        replica_idx_to_participant_idx[participants_[p_idx].replica_id] = p_idx;
-      }
-      for (auto& p : participants_) {
-        for (int dest_replica : p.replica_ids_to_copy_to) {
-          auto& dest_p = participants_[FindOrDie(replica_idx_to_participant_idx,
-                                                 dest_replica)];
-          std::memcpy(dest_p.destination_data.opaque(), p.source_data.opaque(),
-                      p.byte_size);
-
-          // Each replica may be copied into only once.
-          replica_idx_to_participant_idx.erase(dest_replica);
-        }
-      }
-
-      // Zero out untouched participants.
-      for (auto& replica_p : replica_idx_to_participant_idx) {
-        auto& p = participants_[replica_p.second];
-        std::memset(p.destination_data.opaque(), 0, p.byte_size);
-      }
-    }
-    return nullptr;
-  }
-};
-
-class CpuAllReduceRendezvous
-    : public Rendezvous<AllReduceParticipantData, std::nullptr_t> {
- public:
-  explicit CpuAllReduceRendezvous(const RendezvousKey& k)
-      : Rendezvous<AllReduceParticipantData, std::nullptr_t>(k) {}
-
- protected:
-  StatusOr<std::nullptr_t> RunCollectiveOp(
-      const AllReduceParticipantData& participant) override {
-    PrimitiveType datatype = participant.buffers.front().primitive_type;
-    bool primary = InitializationBarrier();
-
-    if (primary) {
-      switch (datatype) {
-        case S8:
-          DoAllReduce<S8>(participant);
-          break;
-        case PRED:
-        case U8:
-          DoAllReduce<U8>(participant);
-          break;
-        case S16:
-          DoAllReduce<S16>(participant);
-          break;
-        case U16:
-          DoAllReduce<U16>(participant);
-          break;
-        case S32:
-          DoAllReduce<S32>(participant);
-          break;
-        case U32:
-          DoAllReduce<U32>(participant);
-          break;
-        case S64:
-          DoAllReduce<S64>(participant);
-          break;
-        case U64:
-          DoAllReduce<U64>(participant);
-          break;
-        case F16:
-          DoAllReduce<F16>(participant);
-          break;
-        case F32:
-          DoAllReduce<F32>(participant);
-          break;
-        case F64:
-          DoAllReduce<F64>(participant);
-          break;
-        case C64:
-          DoAllReduce<C64>(participant);
-          break;
-        case C128:
-          DoAllReduce<C128>(participant);
-          break;
-        default:
-          LOG(FATAL) << "Unexpected datatype;";
-      }
-    }
-    return nullptr;
-  }
-
- private:
-  template <PrimitiveType PT>
-  void DoAllReduce(AllReduceParticipantData participant) {
-    using T = typename primitive_util::PrimitiveTypeToNative<PT>::type;
-    absl::MutexLock lock(&mu_);
-    CHECK(!participants_.empty());
-    ReductionKind reduction_kind = participant.reduction_kind;
-    for (const auto& p : participants_) {
-      CHECK(p.reduction_kind == reduction_kind);
-    }
-    int num_participants = participants_.size();
-
-    // participant_idx -> buffer_idx -> buffer.
-    std::vector<std::vector<absl::Span<T>>> input_buffers;
-    std::vector<std::vector<absl::Span<T>>> output_buffers;
-    input_buffers.reserve(num_participants);
-    output_buffers.reserve(num_participants);
-    const AllReduceParticipantData& first_participant = participants_.front();
-
-    int buffers_per_participant = first_participant.buffers.size();
-    for (AllReduceParticipantData& p : participants_) {
-      CHECK_EQ(p.buffers.size(), buffers_per_participant);
-
-      input_buffers.emplace_back();
-      output_buffers.emplace_back();
-      std::vector<absl::Span<T>>& participant_input_buffers =
-          input_buffers.back();
-      std::vector<absl::Span<T>>& participant_output_buffers =
-          output_buffers.back();
-      participant_input_buffers.reserve(p.buffers.size());
-      participant_output_buffers.reserve(p.buffers.size());
-
-      for (int buffer_idx = 0; buffer_idx < buffers_per_participant;
-           buffer_idx++) {
-        auto& participant_buffer = p.buffers[buffer_idx];
-        participant_input_buffers.emplace_back(
-            static_cast<T*>(participant_buffer.source_data.opaque()),
-            participant_buffer.element_count);
-        participant_output_buffers.emplace_back(
-            static_cast<T*>(participant_buffer.destination_data.opaque()),
-            participant_buffer.element_count);
-        CHECK_EQ(participant_buffer.element_count,
-                 first_participant.buffers[buffer_idx].element_count);
-      }
-    }
-
-    for (int buffer_idx = 0; buffer_idx < buffers_per_participant;
-         buffer_idx++) {
-      int element_count = first_participant.buffers[buffer_idx].element_count;
-      for (int idx = 0; idx < element_count; idx++) {
-        T out = GetInitialValue<T>(reduction_kind);
-        for (int participant_idx = 0; participant_idx < participants_.size();
-             participant_idx++) {
-          out = PerformReductionStep<T>(
-              reduction_kind, out,
-              input_buffers[participant_idx][buffer_idx][idx]);
-        }
-        for (int participant_idx = 0; participant_idx < participants_.size();
-             participant_idx++) {
-          output_buffers[participant_idx][buffer_idx][idx] = out;
-        }
-      }
-    }
-  }
-
-  template <typename T>
-  T GetInitialValue(ReductionKind reduction_kind) {
-    switch (reduction_kind) {
-      case ReductionKind::SUM:
-        return static_cast<T>(0);
-      case ReductionKind::PRODUCT:
-        return static_cast<T>(1);
-      case ReductionKind::MIN:
-        return std::numeric_limits<T>::max();
-      case ReductionKind::MAX:
-        return std::numeric_limits<T>::min();
-    }
-  }
+// Returns the position of `device_id` in the participant list of a collective.
+// This is the order in which all-gather concatenates and reduce-scatter splits
+// buffers.
+int GetRankInCollective(const RendezvousKey& key, GlobalDeviceId device_id) {
+  auto it = absl::c_find(key.global_devices, device_id);
+  CHECK(it != key.global_devices.end())
+      << "Device " << device_id.value() << " not in " << key.ToString();
+  return std::distance(key.global_devices.begin(), it);
+}
 
-  template <typename T, bool kIsSignedIntegralType>
-  struct SumProductTypeForReductionStep {
-    using type = T;
-  };
-
-  template <typename T>
-  struct SumProductTypeForReductionStep<T, /*kIsSignedIntegralType=*/true> {
-    using type = typename std::make_unsigned_t<T>;
-  };
-
-  template <typename T,
-            typename std::enable_if<!is_complex_v<T>>::type* = nullptr>
-  T PerformReductionStep(ReductionKind reduction_kind, T a, T b) {
-    using SumProductType = typename SumProductTypeForReductionStep<
-        T, std::is_integral<T>::value && std::is_signed<T>::value>::type;
-    switch (reduction_kind) {
-      case ReductionKind::SUM:
-        return absl::bit_cast<T>(
-            static_cast<SumProductType>(absl::bit_cast<SumProductType>(a) +
-                                        absl::bit_cast<SumProductType>(b)));
-      case ReductionKind::PRODUCT:
-        return absl::bit_cast<T>(
-            static_cast<SumProductType>(absl::bit_cast<SumProductType>(a) *
-                                        absl::bit_cast<SumProductType>(b)));
-      case ReductionKind::MIN:
-        return std::min(a, b);
-      case ReductionKind::MAX:
-        return std::max(a, b);
-    }
-  }
+CollectivesInterface* GetInProcessCollectivesImpl() {
+  static InProcessCollectives* c = new InProcessCollectives();
+  return c;
+}
 
-  template <typename T,
-            typename std::enable_if<is_complex_v<T>>::type* = nullptr>
-  T PerformReductionStep(ReductionKind reduction_kind, T a, T b) {
-    using SumProductType = typename SumProductTypeForReductionStep<
-        T, std::is_integral<T>::value && std::is_signed<T>::value>::type;
-    switch (reduction_kind) {
-      case ReductionKind::SUM:
-        return absl::bit_cast<T>(
-            static_cast<SumProductType>(absl::bit_cast<SumProductType>(a) +
-                                        absl::bit_cast<SumProductType>(b)));
-      case ReductionKind::PRODUCT:
-        return absl::bit_cast<T>(
-            static_cast<SumProductType>(absl::bit_cast<SumProductType>(a) *
-                                        absl::bit_cast<SumProductType>(b)));
-      case ReductionKind::MIN:
-      case ReductionKind::MAX:
-        LOG(FATAL) << "min/max not valid for complex types";
-    }
+CollectivesInterface* GetCollectivesImpl(
+    const ExecutableRunOptions* run_options) {
+  if (run_options->cpu_executable_run_options() &&
+      run_options->cpu_executable_run_options()->collectives()) {
+    return run_options->cpu_executable_run_options()->collectives();
   }
-};
-
-RefcountingHashMap<RendezvousKey, CpuAllReduceRendezvous>&
-GlobalAllReduceRendezvousMap() {
-  static auto& m =
-      *new RefcountingHashMap<RendezvousKey, CpuAllReduceRendezvous>;
-  return m;
+  return GetInProcessCollectivesImpl();
 }
 
-RefcountingHashMap<RendezvousKey, CpuCollectivePermuteRendezvous>&
-GlobalCollectivePermuteRendezvousMap() {
-  static auto& m =
-      *new RefcountingHashMap<RendezvousKey, CpuCollectivePermuteRendezvous>;
-  return m;
+absl::Duration DefaultCollectiveTimeout() { return absl::Minutes(30); }
+
+StatusOr<std::shared_ptr<CollectivesCommunicator>> GetCommunicator(
+    const ExecutableRunOptions* run_options, const RendezvousKey& key,
+    int rank) {
+  return GetCollectivesImpl(run_options)
+      ->GetCommunicator(key.global_devices, rank);
 }
 
-RefcountingHashMap<RendezvousKey, CpuAllToAllRendezvous>&
-GlobalAllToAllRendezvousMap() {
-  static auto& m =
-      *new RefcountingHashMap<RendezvousKey, CpuAllToAllRendezvous>;
-  return m;
+// Collectives may fail because of another process, e.g. when a peer times out
+// or disconnects, so their errors are reported to the generated code, which
+// returns early from the computation, instead of aborting this process.
+void SetCollectiveStatus(void* status_ptr, const Status& status) {
+  if (status.ok()) return;
+  std::string message = status.ToString();
+  XlaCustomCallStatusSetFailure(static_cast<XlaCustomCallStatus*>(status_ptr),
+                                message.data(), message.size());
 }
 
 RendezvousKey GetRendezvousKey(const ExecutableRunOptions* run_options,
@@ -665,12 +365,12 @@ void ReleaseOutfeedBufferAfterPopulationImpl(
 }
 
 ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY
-void AllToAllImpl(const ExecutableRunOptions* run_options,
-                  int32_t channel_id_present, int64_t op_id,
-                  const void* replica_groups_str,
-                  int32_t replica_groups_str_size, int32_t num_buffers,
-                  int64_t buffer_size, void** source_buffers,
-                  void** destination_buffers) {
+Status AllToAllImpl(const ExecutableRunOptions* run_options,
+                    int32_t channel_id_present, int64_t op_id,
+                    const void* replica_groups_str,
+                    int32_t replica_groups_str_size, int32_t num_buffers,
+                    int64_t buffer_size, void** source_buffers,
+                    void** destination_buffers) {
   int device_ordinal = GetDeviceOrdinal(run_options);
   absl::string_view replica_groups_serialized(
       static_cast<const char*>(replica_groups_str), replica_groups_str_size);
@@ -680,42 +380,26 @@ void AllToAllImpl(const ExecutableRunOptions* run_options,
       GetRendezvousKey(run_options, group, channel_id_present,
                        /*use_global_device_ids=*/std::nullopt, op_id);
 
-  AllToAllParticipantData participant(rendezvous_key, device_ordinal,
-                                      run_options->stream());
-  participant.device_id = GlobalDeviceId(device_ordinal);
-  participant.devices_to_copy_to =
-      GetParticipatingDevices(
-          GlobalDeviceId(device_ordinal), *run_options->device_assignment(),
-          group,
-          GetCollectiveOpGroupMode(channel_id_present != 0,
-                                   /*use_global_device_ids=*/std::nullopt)
-              .value())
-          .value();
-  for (int i = 0; i < num_buffers; i++) {
-    participant.source_buffers.emplace_back(source_buffers[i], buffer_size);
-    participant.destination_buffers.emplace_back(destination_buffers[i],
-                                                 buffer_size);
-  }
-  auto make_cpu_rendezvous = [](const RendezvousKey& k) {
-    return std::make_unique<CpuAllToAllRendezvous>(k);
-  };
-  TF_CHECK_OK(CpuAllToAllRendezvous::SubmitParticipant(
-                  [&] {
-                    return GlobalAllToAllRendezvousMap().GetOrCreateIfAbsent(
-                        rendezvous_key, make_cpu_rendezvous);
-                  },
-                  participant)
-                  .status());
+  int rank =
+      GetRankInCollective(rendezvous_key, GlobalDeviceId(device_ordinal));
+  TF_ASSIGN_OR_RETURN(auto communicator,
+                      GetCommunicator(run_options, rendezvous_key, rank));
+  return communicator->AllToAll(
+      rendezvous_key, buffer_size,
+      absl::Span<const void* const>(source_buffers, num_buffers),
+      absl::Span<void* const>(destination_buffers, num_buffers),
+      DefaultCollectiveTimeout());
 }
 
 ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY
-void AllReduceImpl(const ExecutableRunOptions* run_options,
-                   const void* replica_groups_str,
-                   int32_t replica_groups_str_size, int32_t channel_id_present,
-                   int32_t use_global_device_ids, int64_t op_id,
-                   int32_t reduction_kind, const void* shape_ptr,
-                   int32_t shape_length, int32_t num_buffers,
-                   void** input_buffers, void** output_buffers) {
+Status AllReduceImpl(const ExecutableRunOptions* run_options,
+                     const void* replica_groups_str,
+                     int32_t replica_groups_str_size,
+                     int32_t channel_id_present, int32_t use_global_device_ids,
+                     int64_t op_id, int32_t reduction_kind,
+                     const void* shape_ptr, int32_t shape_length,
+                     int32_t num_buffers, void** input_buffers,
+                     void** output_buffers) {
   int device_ordinal = GetDeviceOrdinal(run_options);
   absl::string_view replica_groups_serialized(
       static_cast<const char*>(replica_groups_str), replica_groups_str_size);
@@ -732,32 +416,76 @@ void AllReduceImpl(const ExecutableRunOptions* run_options,
   CHECK((num_buffers > 1 && shape.IsTuple()) ||
         (num_buffers == 1 && LayoutUtil::IsDenseArray(shape)));
 
-  AllReduceParticipantData participant(rendezvous_key, device_ordinal,
-                                       run_options->stream());
-  participant.reduction_kind = static_cast<ReductionKind>(reduction_kind);
+  int rank =
+      GetRankInCollective(rendezvous_key, GlobalDeviceId(device_ordinal));
+  TF_ASSIGN_OR_RETURN(auto communicator,
+                      GetCommunicator(run_options, rendezvous_key, rank));
+  std::vector<AllReduceBuffer> buffers(num_buffers);
   for (int i = 0; i < num_buffers; i++) {
-    Shape subshape = num_buffers == 1 ? shape : shape.tuple_shapes(i);
-    AllReduceParticipantData::Buffer buffer;
-    buffer.element_count = ShapeUtil::ElementsIn(subshape);
-    buffer.primitive_type = subshape.element_type();
-    buffer.source_data =
-        se::DeviceMemoryBase(input_buffers[i], ShapeUtil::ByteSizeOf(subshape));
-    buffer.destination_data = se::DeviceMemoryBase(
-        output_buffers[i], ShapeUtil::ByteSizeOf(subshape));
-    participant.buffers.push_back(buffer);
+    const Shape& subshape = num_buffers == 1 ? shape : shape.tuple_shapes(i);
+    buffers[i] = {subshape.element_type(), ShapeUtil::ElementsIn(subshape),
+                  input_buffers[i], output_buffers[i]};
   }
+  return communicator->AllReduce(rendezvous_key,
+                                 static_cast<ReductionKind>(reduction_kind),
+                                 buffers, DefaultCollectiveTimeout());
+}
 
-  auto make_cpu_rendezvous = [](const RendezvousKey& k) {
-    return std::make_unique<CpuAllReduceRendezvous>(k);
-  };
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY
+Status AllGatherImpl(const ExecutableRunOptions* run_options,
+                     const void* replica_groups_str,
+                     int32_t replica_groups_str_size,
+                     int32_t channel_id_present, int32_t use_global_device_ids,
+                     int64_t op_id, int64_t outer_count, int64_t buffer_size,
+                     void* source_buffer, void* destination_buffer) {
+  int device_ordinal = GetDeviceOrdinal(run_options);
+  absl::string_view replica_groups_serialized(
+      static_cast<const char*>(replica_groups_str), replica_groups_str_size);
+  std::vector<ReplicaGroup> group =
+      ParseReplicaGroupsOnly(replica_groups_serialized).value();
+  RendezvousKey rendezvous_key = GetRendezvousKey(
+      run_options, group, channel_id_present, use_global_device_ids, op_id);
 
-  TF_CHECK_OK(CpuAllReduceRendezvous::SubmitParticipant(
-                  [&] {
-                    return GlobalAllReduceRendezvousMap().GetOrCreateIfAbsent(
-                        rendezvous_key, make_cpu_rendezvous);
-                  },
-                  participant)
-                  .status());
+  int rank =
+      GetRankInCollective(rendezvous_key, GlobalDeviceId(device_ordinal));
+  // An empty operand has nothing to exchange, and the chunk size below would
+  // divide by zero.
+  if (outer_count == 0) {
+    return OkStatus();
+  }
+  TF_ASSIGN_OR_RETURN(auto communicator,
+                      GetCommunicator(run_options, rendezvous_key, rank));
+  return communicator->AllGather(rendezvous_key, outer_count,
+                                 buffer_size / outer_count, source_buffer,
+                                 destination_buffer,
+                                 DefaultCollectiveTimeout());
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY
+Status ReduceScatterImpl(const ExecutableRunOptions* run_options,
+                         const void* replica_groups_str,
+                         int32_t replica_groups_str_size,
+                         int32_t channel_id_present,
+                         int32_t use_global_device_ids, int64_t op_id,
+                         int32_t reduction_kind, int32_t element_type,
+                         int64_t outer_count, int64_t chunk_elements,
+                         void* input_buffer, void* output_buffer) {
+  int device_ordinal = GetDeviceOrdinal(run_options);
+  absl::string_view replica_groups_serialized(
+      static_cast<const char*>(replica_groups_str), replica_groups_str_size);
+  std::vector<ReplicaGroup> group =
+      ParseReplicaGroupsOnly(replica_groups_serialized).value();
+  RendezvousKey rendezvous_key = GetRendezvousKey(
+      run_options, group, channel_id_present, use_global_device_ids, op_id);
+
+  int rank =
+      GetRankInCollective(rendezvous_key, GlobalDeviceId(device_ordinal));
+  TF_ASSIGN_OR_RETURN(auto communicator,
+                      GetCommunicator(run_options, rendezvous_key, rank));
+  return communicator->ReduceScatter(
+      rendezvous_key, static_cast<ReductionKind>(reduction_kind),
+      static_cast<PrimitiveType>(element_type), outer_count, chunk_elements,
+      input_buffer, output_buffer, DefaultCollectiveTimeout());
 }
 
 ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY
@@ -782,11 +510,12 @@ void PartitionIdImpl(const ExecutableRunOptions* run_options,
 }
 
 ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY
-void CollectivePermuteImpl(const ExecutableRunOptions* run_options,
-                           int32_t channel_id_present, int64_t op_id,
-                           int32_t byte_size, void* input_buffer,
-                           void* output_buffer, const void* source_target_pairs,
-                           int32_t source_target_pairs_size) {
+Status CollectivePermuteImpl(const ExecutableRunOptions* run_options,
+                             int32_t channel_id_present, int64_t op_id,
+                             int32_t byte_size, void* input_buffer,
+                             void* output_buffer,
+                             const void* source_target_pairs,
+                             int32_t source_target_pairs_size) {
   int device_ordinal = GetDeviceOrdinal(run_options);
   absl::string_view source_target_pairs_serialized(
       static_cast<const char*>(source_target_pairs), source_target_pairs_size);
@@ -798,6 +527,7 @@ void CollectivePermuteImpl(const ExecutableRunOptions* run_options,
   int32_t logical_device_id =
       channel_id_present ? logical_id.computation_id : logical_id.replica_id;
 
+  std::optional<int> source_replica_id;
   std::vector<int> copy_to;
   for (auto& p : pairs) {
     std::vector<std::string> mapping = absl::StrSplit(p, '=');
@@ -807,32 +537,29 @@ void CollectivePermuteImpl(const ExecutableRunOptions* run_options,
     if (from == logical_device_id) {
       copy_to.push_back(to);
     }
+    if (to == logical_device_id) {
+      CHECK(!source_replica_id.has_value()) << "Duplicate source replica ids.";
+      source_replica_id = from;
+    }
   }
   RendezvousKey rendezvous_key =
       GetRendezvousKey(run_options, {}, channel_id_present,
                        /*use_global_device_ids=*/std::nullopt, op_id);
 
-  CollectivePermuteParticipantData participant(rendezvous_key, device_ordinal,
-                                               run_options->stream());
-  participant.replica_id = logical_device_id;
-  participant.source_data = se::DeviceMemoryBase(input_buffer, byte_size);
-  participant.destination_data = se::DeviceMemoryBase(output_buffer, byte_size);
-  participant.replica_ids_to_copy_to = copy_to;
-  participant.byte_size = byte_size;
-
-  auto make_cpu_rendezvous = [](const RendezvousKey& k) {
-    return std::make_unique<CpuCollectivePermuteRendezvous>(k);
-  };
-  TF_CHECK_OK(
-      CpuCollectivePermuteRendezvous::SubmitParticipant(
-          [&] {
-            return GlobalCollectivePermuteRendezvousMap().GetOrCreateIfAbsent(
-                rendezvous_key, make_cpu_rendezvous);
-          },
-          participant)
-          .status());
+  // With an empty replica group the participants are all replicas (or all
+  // partitions) of the program in order of their logical id, so the logical
+  // id is the rank.
+  int rank =
+      GetRankInCollective(rendezvous_key, GlobalDeviceId(device_ordinal));
+  CHECK_EQ(rank, logical_device_id);
+  TF_ASSIGN_OR_RETURN(auto communicator,
+                      GetCommunicator(run_options, rendezvous_key, rank));
+  return communicator->CollectivePermute(
+      rendezvous_key, byte_size, source_replica_id, copy_to, input_buffer,
+      output_buffer, DefaultCollectiveTimeout());
 }
 }  // namespace
+
 }  // namespace runtime
 }  // namespace cpu
 }  // namespace xla
@@ -895,11 +622,12 @@ void __xla_cpu_runtime_AllToAll(const xla::ExecutableRunOptions* run_options,
                                 int32_t replica_groups_str_size,
                                 int32_t num_buffers, int64_t buffer_size,
                                 void** source_buffers,
-                                void** destination_buffers) {
-  return xla::cpu::runtime::AllToAllImpl(
-      run_options, channel_id_present, op_id, replica_groups_str,
-      replica_groups_str_size, num_buffers, buffer_size, source_buffers,
-      destination_buffers);
+                                void** destination_buffers, void* status) {
+  xla::cpu::runtime::SetCollectiveStatus(
+      status, xla::cpu::runtime::AllToAllImpl(
+                  run_options, channel_id_present, op_id, replica_groups_str,
+                  replica_groups_str_size, num_buffers, buffer_size,
+                  source_buffers, destination_buffers));
 }
 
 void __xla_cpu_runtime_AllReduce(const xla::ExecutableRunOptions* run_options,
@@ -909,11 +637,44 @@ void __xla_cpu_runtime_AllReduce(const xla::ExecutableRunOptions* run_options,
                                  int32_t use_global_device_ids, int64_t op_id,
                                  int32_t reduction_kind, const void* shape_ptr,
                                  int32_t shape_length, int32_t num_buffers,
-                                 void** input_buffers, void** output_buffers) {
-  return xla::cpu::runtime::AllReduceImpl(
-      run_options, replica_groups_str, replica_groups_str_size,
-      channel_id_present, use_global_device_ids, op_id, reduction_kind,
-      shape_ptr, shape_length, num_buffers, input_buffers, output_buffers);
+                                 void** input_buffers, void** output_buffers,
+                                 void* status) {
+  xla::cpu::runtime::SetCollectiveStatus(
+      status,
+      xla::cpu::runtime::AllReduceImpl(
+          run_options, replica_groups_str, replica_groups_str_size,
+          channel_id_present, use_global_device_ids, op_id, reduction_kind,
+          shape_ptr, shape_length, num_buffers, input_buffers, output_buffers));
+}
+
+void __xla_cpu_runtime_AllGather(const xla::ExecutableRunOptions* run_options,
+                                 const void* replica_groups_str,
+                                 int32_t replica_groups_str_size,
+                                 int32_t channel_id_present,
+                                 int32_t use_global_device_ids, int64_t op_id,
+                                 int64_t outer_count, int64_t buffer_size,
+                                 void* source_buffer,
+                                 void* destination_buffer, void* status) {
+  xla::cpu::runtime::SetCollectiveStatus(
+      status, xla::cpu::runtime::AllGatherImpl(
+                  run_options, replica_groups_str, replica_groups_str_size,
+                  channel_id_present, use_global_device_ids, op_id,
+                  outer_count, buffer_size, source_buffer, destination_buffer));
+}
+
+void __xla_cpu_runtime_ReduceScatter(
+    const xla::ExecutableRunOptions* run_options,
+    const void* replica_groups_str, int32_t replica_groups_str_size,
+    int32_t channel_id_present, int32_t use_global_device_ids, int64_t op_id,
+    int32_t reduction_kind, int32_t element_type, int64_t outer_count,
+    int64_t chunk_elements, void* input_buffer, void* output_buffer,
+    void* status) {
+  xla::cpu::runtime::SetCollectiveStatus(
+      status, xla::cpu::runtime::ReduceScatterImpl(
+                  run_options, replica_groups_str, replica_groups_str_size,
+                  channel_id_present, use_global_device_ids, op_id,
+                  reduction_kind, element_type, outer_count, chunk_elements,
+                  input_buffer, output_buffer));
 }
 
 void __xla_cpu_runtime_ReplicaId(const xla::ExecutableRunOptions* run_options,
@@ -929,10 +690,13 @@ void __xla_cpu_runtime_PartitionId(const xla::ExecutableRunOptions* run_options,
 void __xla_cpu_runtime_CollectivePermute(
     const xla::ExecutableRunOptions* run_options, int32_t channel_id_present,
     int64_t op_id, int32_t byte_size, void* input_buffer, void* output_buffer,
-    const void* source_target_pairs, int32_t source_target_pairs_size) {
-  return xla::cpu::runtime::CollectivePermuteImpl(
-      run_options, channel_id_present, op_id, byte_size, input_buffer,
-      output_buffer, source_target_pairs, source_target_pairs_size);
+    const void* source_target_pairs, int32_t source_target_pairs_size,
+    void* status) {
+  xla::cpu::runtime::SetCollectiveStatus(
+      status, xla::cpu::runtime::CollectivePermuteImpl(
+                  run_options, channel_id_present, op_id, byte_size,
+                  input_buffer, output_buffer, source_target_pairs,
+                  source_target_pairs_size));
 }
 
 }  // extern "C"
@@ -47,6 +47,9 @@ extern const char* const kEigenMatMulF64SymbolName;
 extern const char* const kEigenMatMulC64SymbolName;
 extern const char* const kEigenMatMulC128SymbolName;
 extern const char* const kEigenMatMulS32SymbolName;
+extern const char* const kInt8MatMulSymbolName;
+extern const char* const kInt8MatMulU8SymbolName;
+extern const char* const kBF16MatMulSymbolName;
 extern const char* const kEigenBatchMatMulF32SymbolName;
 extern const char* const kMKLConv2DF32SymbolName;
 extern const char* const kACLConv2DF32SymbolName;
@@ -54,6 +57,9 @@ extern const char* const kACLMatMulF32SymbolName;
 extern const char* const kACLBatchMatMulF32SymbolName;
 extern const char* const kEigenConv2DF16SymbolName;
 extern const char* const kEigenConv2DF32SymbolName;
+extern const char* const kInt8Conv2DSymbolName;
+extern const char* const kInt8Conv2DU8SymbolName;
+extern const char* const kBF16Conv2DSymbolName;
 extern const char* const kEigenConv3DF16SymbolName;
 extern const char* const kEigenConv3DF32SymbolName;
 extern const char* const kDuccFftSymbolName;
@@ -76,7 +82,15 @@ extern const char* const kParallelForkJoinSymbolName;
 extern const char* const kPrintfToStderrSymbolName;
 extern const char* const kStatusIsSuccessSymbolName;
 extern const char* const kKeyValueSortSymbolName;
+extern const char* const kSortPrimitiveSymbolName;
 extern const char* const kTopKF32SymbolName;
+extern const char* const kTopKF64SymbolName;
+extern const char* const kTopKBF16SymbolName;
+extern const char* const kTopKF16SymbolName;
+extern const char* const kTopKS32SymbolName;
+extern const char* const kTopKU32SymbolName;
+extern const char* const kTransposeSymbolName;
+extern const char* const kExecuteTaskGraphSymbolName;
 extern const char* const kAllReduceSymbolName;
 extern const char* const kCollectivePermuteSymbolName;
 extern const char* const kPartitionIdSymbolName;
@@ -84,12 +98,20 @@ extern const char* const kReplicaIdSymbolName;
 extern const char* const kTracingStartSymbolName;
 extern const char* const kTracingEndSymbolName;
 extern const char* const kAllToAllSymbolName;
+extern const char* const kAllGatherSymbolName;
+extern const char* const kReduceScatterSymbolName;
 extern const char* const kOneDnnMatMulSymbolName;
 
 // All symbol names for XLA CPU runtime functions need to start with this
 // prefix.
 extern const char* const kXlaCpuRuntimeSymbolNamePrefix;
 
+// Version of the calling convention between generated code and the runtime
+// functions above. Bump it whenever the signature or semantics of one of them
+// change, so that persisted code compiled against the old runtime (e.g. in the
+// compilation cache) is not linked against the new one.
+inline constexpr int kRuntimeAbiVersion = 1;
+
 // Returns the infeed manager used by the CPU runtime for the CPU device
 // `device_ordinal`.  Note the device ordinal does not name a CPU
 XfeedManager* GetXfeedManager(int device_ordinal);
@@ -170,6 +192,9 @@ extern void __xla_cpu_runtime_ReleaseOutfeedBufferAfterPopulation(
     const xla::ExecutableRunOptions* run_options, int32_t buffer_length,
     void* buffer_ptr, const void* shape_ptr, int32_t shape_length);
 
+// The collectives below report failures, e.g. a peer that timed out, through
+// `status`, an XlaCustomCallStatus*, instead of aborting the process.
+
 // Perform all reduce on a CPU.
 //
 // participating_replicas: array of replica IDs participating in the reduction,
@@ -182,18 +207,49 @@ extern void __xla_cpu_runtime_AllReduce(
     const void* replica_groups_str, int32_t replica_groups_str_size,
     int32_t channel_id_present, int32_t use_global_device_ids, int64_t op_id,
     int32_t reduction_kind, const void* shape_ptr, int32_t shape_length,
-    int32_t num_buffers, void** input_buffers, void** output_buffers);
+    int32_t num_buffers, void** input_buffers, void** output_buffers,
+    void* status);
 
 extern void __xla_cpu_runtime_CollectivePermute(
     const xla::ExecutableRunOptions* run_options, int32_t channel_id_present,
     int64_t op_id, int32_t byte_size, void* input_buffer, void* output_buffer,
-    const void* source_target_pairs, int32_t source_target_pairs_size);
+    const void* source_target_pairs, int32_t source_target_pairs_size,
+    void* status);
 
 extern void __xla_cpu_runtime_AllToAll(
     const xla::ExecutableRunOptions* run_options, int32_t channel_id_present,
     int64_t op_id, const void* replica_groups_str,
     int32_t replica_groups_str_size, int32_t num_buffers, int64_t buffer_size,
-    void** source_buffers, void** destination_buffers);
+    void** source_buffers, void** destination_buffers, void* status);
+
+// Perform all gather on a CPU.
+//
+// Every participant's source_buffer of buffer_size bytes is split into
+// outer_count equally sized chunks. For each chunk index, destination_buffer
+// receives that chunk from every participant in replica group order. This
+// covers gathering along any dimension: outer_count is the number of elements
+// in the dimensions that are more major than the gather dimension.
+extern void __xla_cpu_runtime_AllGather(
+    const xla::ExecutableRunOptions* run_options,
+    const void* replica_groups_str, int32_t replica_groups_str_size,
+    int32_t channel_id_present, int32_t use_global_device_ids, int64_t op_id,
+    int64_t outer_count, int64_t buffer_size, void* source_buffer,
+    void* destination_buffer, void* status);
+
+// Perform reduce scatter on a CPU.
+//
+// input_buffer is laid out as [outer_count, num_participants, chunk_elements]
+// and output_buffer as [outer_count, chunk_elements]; the participant with
+// rank r in its replica group receives the reduction of slice r.
+// reduction_kind: operator used for a reduction, cf. ReductionKind.
+// element_type: the PrimitiveType of the buffers.
+extern void __xla_cpu_runtime_ReduceScatter(
+    const xla::ExecutableRunOptions* run_options,
+    const void* replica_groups_str, int32_t replica_groups_str_size,
+    int32_t channel_id_present, int32_t use_global_device_ids, int64_t op_id,
+    int32_t reduction_kind, int32_t element_type, int64_t outer_count,
+    int64_t chunk_elements, void* input_buffer, void* output_buffer,
+    void* status);
 
 // Write the partition ID into the output buffer.
 extern void __xla_cpu_runtime_PartitionId(
@@ -15,23 +15,48 @@ limitations under the License.
 #define EIGEN_USE_THREADS
 #include "xla/service/cpu/cpu_runtime.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <numeric>
+#include <optional>
+#include <random>
 #include <string>
 #include <tuple>
+#include <vector>
 
 #include "absl/strings/str_format.h"
+#include "absl/types/span.h"
 #include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
 #include "xla/array2d.h"
 #include "xla/client/local_client.h"
+#include "xla/executable_run_options.h"
+#include "xla/service/collective_ops_utils.h"
+#include "xla/service/computation_placer.h"
+#include "xla/service/cpu/collectives_interface.h"
+#include "xla/service/cpu/cpu_executable_run_options.h"
+#include "xla/service/cpu/in_process_collectives.h"
 #include "xla/service/cpu/runtime_custom_call_status.h"
+#include "xla/service/cpu/runtime_fork_join.h"
+#include "xla/service/cpu/runtime_key_value_sort.h"
 #include "xla/service/cpu/runtime_matmul.h"
 #include "xla/service/cpu/runtime_matmul_acl.h"
 #include "xla/service/cpu/runtime_single_threaded_matmul.h"
+#include "xla/service/cpu/runtime_topk.h"
 #include "xla/service/custom_call_status_internal.h"
+#include "xla/service/global_device_id.h"
+#include "xla/shape_util.h"
+#include "xla/statusor.h"
 #include "xla/types.h"
+#include "xla/util.h"
+#include "tsl/platform/blocking_counter.h"
 #include "tsl/platform/env.h"
 #include "tsl/platform/logging.h"
 #include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
+#include "tsl/platform/threadpool.h"
 
 namespace xla {
 namespace {
@@ -180,5 +205,500 @@ TEST_F(CpuRuntimeTest, FailureStatus) {
   ASSERT_FALSE(__xla_cpu_runtime_StatusIsSuccess(&success_status));
 }
 
+// Comparator of a key-value sort of F32 keys, as emitted by the JIT.
+void LessThanF32(char* result, char* run_options, char** values,
+                 char** buffer_table, int64_t* prof_counters) {
+  *result = *reinterpret_cast<float*>(values[0]) <
+            *reinterpret_cast<float*>(values[1]);
+}
+
+// Sorts rows of the [a, b, c] array of keys and their positions with the
+// intra-op thread pool, and checks that it matches a sequential stable sort.
+void CheckParallelKeyValueSort(int64_t a, int64_t b, int64_t c) {
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "XLAEigen", 4);
+  Eigen::ThreadPoolDevice device(pool.AsEigenThreadPool(), pool.NumThreads());
+  ExecutableRunOptions run_options;
+  run_options.set_intra_op_thread_pool(&device);
+
+  std::minstd_rand0 engine;
+  const int64_t num_elements = a * b * c;
+  std::vector<float> keys(num_elements);
+  std::vector<int32_t> positions(num_elements);
+  for (int64_t i = 0; i < num_elements; ++i) {
+    // Few distinct keys, so that there are many ties.
+    keys[i] = engine() % 100;
+    positions[i] = i;
+  }
+  std::vector<float> original_keys = keys;
+  char* values[] = {reinterpret_cast<char*>(keys.data()),
+                    reinterpret_cast<char*>(positions.data())};
+  int32_t sizes[] = {sizeof(float), sizeof(int32_t)};
+  __xla_cpu_runtime_KeyValueSort(
+      a, b, c, values, /*values_count=*/2, sizes, /*is_stable=*/true,
+      reinterpret_cast<char*>(&run_options), /*prof_counters=*/nullptr,
+      LessThanF32);
+
+  for (int64_t row = 0; row < a * c; ++row) {
+    int64_t base = row % c + (row - row % c) * b;
+    std::vector<int32_t> expected(b);
+    for (int64_t i = 0; i < b; ++i) {
+      expected[i] = base + i * c;
+    }
+    std::stable_sort(expected.begin(), expected.end(),
+                     [&](int32_t lhs, int32_t rhs) {
+                       return original_keys[lhs] < original_keys[rhs];
+                     });
+    for (int64_t i = 0; i < b; ++i) {
+      ASSERT_EQ(positions[base + i * c], expected[i]);
+      ASSERT_EQ(keys[base + i * c], original_keys[expected[i]]);
+    }
+  }
+}
+
+TEST_F(CpuRuntimeTest, ParallelKeyValueSortOfManyRows) {
+  CheckParallelKeyValueSort(/*a=*/64, /*b=*/1000, /*c=*/3);
+}
+
+TEST_F(CpuRuntimeTest, ParallelKeyValueSortOfLongRow) {
+  CheckParallelKeyValueSort(/*a=*/1, /*b=*/300000, /*c=*/1);
+}
+
+TEST_F(CpuRuntimeTest, SortPrimitive) {
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "XLAEigen", 4);
+  Eigen::ThreadPoolDevice device(pool.AsEigenThreadPool(), pool.NumThreads());
+  ExecutableRunOptions run_options;
+  run_options.set_intra_op_thread_pool(&device);
+
+  std::minstd_rand0 engine;
+  std::vector<int16_t> data(2 * 100000);
+  for (int16_t& value : data) {
+    value = static_cast<int16_t>(engine());
+  }
+  std::vector<int16_t> expected = data;
+  std::sort(expected.begin(), expected.begin() + 100000,
+            std::greater<int16_t>());
+  std::sort(expected.begin() + 100000, expected.end(),
+            std::greater<int16_t>());
+
+  __xla_cpu_runtime_SortPrimitive(
+      /*a=*/2, /*b=*/100000, /*c=*/1, reinterpret_cast<char*>(data.data()),
+      sizeof(int16_t), /*is_floating_point=*/false, /*is_signed=*/true,
+      /*descending=*/true, /*is_stable=*/false,
+      reinterpret_cast<char*>(&run_options));
+  EXPECT_EQ(data, expected);
+}
+
+TEST_F(CpuRuntimeTest, ParallelTopK) {
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "XLAEigen", 4);
+  Eigen::ThreadPoolDevice device(pool.AsEigenThreadPool(), pool.NumThreads());
+  ExecutableRunOptions run_options;
+  run_options.set_intra_op_thread_pool(&device);
+
+  // Both a k that is small and one that is large relative to the input, with
+  // many repeated values to exercise the tie-break on indices.
+  constexpr int64_t kBatchSize = 64;
+  constexpr int64_t kInputSize = 4096;
+  for (int64_t k : {5, 4000}) {
+    std::minstd_rand0 engine;
+    std::vector<int32_t> values(kBatchSize * kInputSize);
+    for (int32_t& value : values) {
+      value = static_cast<int32_t>(engine() % 100) - 50;
+    }
+    std::vector<int32_t> out_values(kBatchSize * k);
+    std::vector<int32_t> out_indices(kBatchSize * k);
+    __xla_cpu_runtime_TopKS32(kBatchSize, kInputSize, k, values.data(),
+                              out_values.data(), out_indices.data(),
+                              &run_options);
+
+    for (int64_t batch = 0; batch < kBatchSize; ++batch) {
+      const int32_t* batch_values = values.data() + batch * kInputSize;
+      std::vector<int32_t> expected(kInputSize);
+      std::iota(expected.begin(), expected.end(), 0);
+      std::stable_sort(expected.begin(), expected.end(),
+                       [&](int32_t a, int32_t b) {
+                         return batch_values[a] > batch_values[b];
+                       });
+      for (int64_t i = 0; i < k; ++i) {
+        ASSERT_EQ(out_indices[batch * k + i], expected[i])
+            << "k=" << k << " batch=" << batch << " i=" << i;
+        ASSERT_EQ(out_values[batch * k + i], batch_values[expected[i]]);
+      }
+    }
+  }
+}
+
+// A parallel compute function that increments each element of a row-major
+// [rows, kForkJoinCols] array within the partition given by 'bounds', spending
+// roughly 'work' iterations per element. The partition starting at (0, 0)
+// fails if 'fail' is set.
+constexpr int64_t kForkJoinCols = 64;
+
+struct ForkJoinParams {
+  std::vector<std::atomic<int32_t>> counts;
+  int64_t work = 0;
+  bool fail = false;
+};
+
+void ForkJoinComputeFunction(void* result, const void* run_options,
+                             const void** params, void** buffer_table,
+                             void* status, int64_t* bounds,
+                             uint64_t* prof_counters) {
+  auto* fork_join_params = static_cast<ForkJoinParams*>(result);
+  for (int64_t row = bounds[0]; row < bounds[1]; ++row) {
+    for (int64_t col = bounds[2]; col < bounds[3]; ++col) {
+      float x = row + col;
+      for (int64_t i = 0; i < fork_join_params->work; ++i) {
+        x = x * 0.5f + 1.0f;
+      }
+      benchmark::DoNotOptimize(x);
+      fork_join_params->counts[row * kForkJoinCols + col].fetch_add(1);
+    }
+  }
+  if (fork_join_params->fail && bounds[0] == 0 && bounds[2] == 0) {
+    XlaCustomCallStatusSetFailure(static_cast<XlaCustomCallStatus*>(status),
+                                  "boom", 4);
+  }
+}
+
+// Returns partitions of a [rows, kForkJoinCols] array into
+// 'row_partitions' x 2 boxes, laid out as ParallelForkJoin expects.
+std::vector<int64_t> ForkJoinPartitions(int64_t rows, int64_t row_partitions) {
+  std::vector<int64_t> partitions;
+  for (int64_t i = 0; i < row_partitions; ++i) {
+    for (int64_t j = 0; j < 2; ++j) {
+      partitions.insert(partitions.end(),
+                        {rows * i / row_partitions,
+                         rows * (i + 1) / row_partitions,
+                         kForkJoinCols * j / 2, kForkJoinCols * (j + 1) / 2});
+    }
+  }
+  return partitions;
+}
+
+TEST_F(CpuRuntimeTest, ParallelForkJoin) {
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "XLAEigen", 4);
+  Eigen::ThreadPoolDevice device(pool.AsEigenThreadPool(), pool.NumThreads());
+  ExecutableRunOptions run_options;
+  run_options.set_intra_op_thread_pool(&device);
+
+  constexpr int64_t kRows = 37;
+  for (int64_t row_partitions : {1, 3, 8, 37}) {
+    for (bool fail : {false, true}) {
+      ForkJoinParams params;
+      params.counts = std::vector<std::atomic<int32_t>>(kRows * kForkJoinCols);
+      params.fail = fail;
+      std::vector<int64_t> partitions =
+          ForkJoinPartitions(kRows, row_partitions);
+      XlaCustomCallStatus status;
+      __xla_cpu_runtime_ParallelForkJoin(
+          &params, &run_options, /*params=*/nullptr, /*buffer_table=*/nullptr,
+          &status, /*prof_counters=*/nullptr, 2 * row_partitions,
+          partitions.data(), /*num_partitioned_dims=*/2,
+          reinterpret_cast<void*>(&ForkJoinComputeFunction));
+
+      // Every element is computed exactly once, however partitions are split.
+      for (int64_t i = 0; i < kRows * kForkJoinCols; ++i) {
+        ASSERT_EQ(params.counts[i].load(), 1)
+            << "row_partitions=" << row_partitions << " i=" << i;
+      }
+      std::optional<absl::string_view> error =
+          CustomCallStatusGetMessage(&status);
+      if (fail) {
+        ASSERT_TRUE(error.has_value());
+        EXPECT_EQ(*error, "Partition 0 error: boom");
+      } else {
+        EXPECT_FALSE(error.has_value());
+      }
+    }
+  }
+}
+
+// Runs an F32 all-reduce over all `num_replicas` devices with one thread per
+// replica. inputs[r] and outputs[r] are the buffers of replica r.
+void RunAllReduce(tsl::thread::ThreadPool* pool, int num_replicas,
+                  ReductionKind reduction_kind,
+                  std::vector<std::vector<float>>& inputs,
+                  std::vector<std::vector<float>>& outputs) {
+  DeviceAssignment device_assignment(num_replicas, 1);
+  for (int r = 0; r < num_replicas; ++r) {
+    device_assignment(r, 0) = r;
+  }
+  Shape shape = ShapeUtil::MakeShapeWithDescendingLayout(
+      F32, {static_cast<int64_t>(inputs[0].size())});
+  std::string shape_str = shape.ToProto().SerializeAsString();
+  std::string replica_groups = "{}";
+  RunId run_id;
+
+  tsl::BlockingCounter done(num_replicas);
+  for (int r = 0; r < num_replicas; ++r) {
+    pool->Schedule([&, r] {
+      ExecutableRunOptions run_options;
+      run_options.set_device_ordinal(r);
+      run_options.set_device_assignment(&device_assignment);
+      run_options.set_run_id(run_id);
+      void* input = inputs[r].data();
+      void* output = outputs[r].data();
+      XlaCustomCallStatus status;
+      __xla_cpu_runtime_AllReduce(
+          &run_options, replica_groups.data(), replica_groups.size(),
+          /*channel_id_present=*/0, /*use_global_device_ids=*/0,
+          /*op_id=*/0, static_cast<int32_t>(reduction_kind), shape_str.data(),
+          shape_str.size(), /*num_buffers=*/1, &input, &output, &status);
+      EXPECT_TRUE(__xla_cpu_runtime_StatusIsSuccess(&status));
+      done.DecrementCount();
+    });
+  }
+  done.Wait();
+}
+
+class CpuAllReduceTest
+    : public ::testing::TestWithParam<runtime::AllReduceStrategy> {
+ protected:
+  void SetUp() override { runtime::SetAllReduceStrategyForTesting(GetParam()); }
+  void TearDown() override {
+    runtime::SetAllReduceStrategyForTesting(runtime::AllReduceStrategy::kAuto);
+  }
+};
+
+TEST_P(CpuAllReduceTest, SumMinMax) {
+  constexpr int kNumReplicas = 5;
+  // Not a multiple of the shard alignment, so the last shard is partial.
+  constexpr int kNumElements = 1000;
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "all_reduce_test",
+                               kNumReplicas);
+
+  for (ReductionKind kind :
+       {ReductionKind::SUM, ReductionKind::MIN, ReductionKind::MAX}) {
+    std::vector<std::vector<float>> inputs(kNumReplicas);
+    std::vector<std::vector<float>> outputs(kNumReplicas);
+    for (int r = 0; r < kNumReplicas; ++r) {
+      for (int i = 0; i < kNumElements; ++i) {
+        inputs[r].push_back(static_cast<float>((r * 7 + i) % 11) - 5.0f);
+      }
+      outputs[r].resize(kNumElements);
+    }
+    RunAllReduce(&pool, kNumReplicas, kind, inputs, outputs);
+
+    for (int i = 0; i < kNumElements; ++i) {
+      float expected = inputs[0][i];
+      for (int r = 1; r < kNumReplicas; ++r) {
+        switch (kind) {
+          case ReductionKind::SUM:
+            expected += inputs[r][i];
+            break;
+          case ReductionKind::MIN:
+            expected = std::min(expected, inputs[r][i]);
+            break;
+          case ReductionKind::MAX:
+            expected = std::max(expected, inputs[r][i]);
+            break;
+          default:
+            break;
+        }
+      }
+      for (int r = 0; r < kNumReplicas; ++r) {
+        ASSERT_EQ(outputs[r][i], expected) << "replica " << r << " index " << i;
+      }
+    }
+  }
+}
+
+TEST_P(CpuAllReduceTest, InPlace) {
+  constexpr int kNumReplicas = 4;
+  constexpr int kNumElements = 4096;
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "all_reduce_test",
+                               kNumReplicas);
+
+  std::vector<std::vector<float>> buffers(kNumReplicas);
+  for (int r = 0; r < kNumReplicas; ++r) {
+    buffers[r].assign(kNumElements, static_cast<float>(r + 1));
+  }
+  RunAllReduce(&pool, kNumReplicas, ReductionKind::SUM, buffers, buffers);
+
+  for (int r = 0; r < kNumReplicas; ++r) {
+    for (int i = 0; i < kNumElements; ++i) {
+      ASSERT_EQ(buffers[r][i], 10.0f);
+    }
+  }
+}
+
+// The elements of a tuple all-reduce are reduced in a single rendezvous. Under
+// kAuto the large element is sharded and the small one is not.
+TEST_P(CpuAllReduceTest, Tuple) {
+  constexpr int kNumReplicas = 3;
+  constexpr int kNumLarge = 100000;
+  constexpr int kNumSmall = 10;
+  DeviceAssignment device_assignment(kNumReplicas, 1);
+  for (int r = 0; r < kNumReplicas; ++r) {
+    device_assignment(r, 0) = r;
+  }
+  Shape shape = ShapeUtil::MakeTupleShape(
+      {ShapeUtil::MakeShapeWithDescendingLayout(F32, {kNumLarge}),
+       ShapeUtil::MakeShapeWithDescendingLayout(S32, {kNumSmall})});
+  std::string shape_str = shape.ToProto().SerializeAsString();
+  std::string replica_groups = "{}";
+  RunId run_id;
+
+  std::vector<std::vector<float>> large(kNumReplicas);
+  std::vector<std::vector<int32_t>> small(kNumReplicas);
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "all_reduce_test",
+                               kNumReplicas);
+  tsl::BlockingCounter done(kNumReplicas);
+  for (int r = 0; r < kNumReplicas; ++r) {
+    large[r].assign(kNumLarge, r + 1.0f);
+    small[r].assign(kNumSmall, r + 1);
+    pool.Schedule([&, r] {
+      ExecutableRunOptions run_options;
+      run_options.set_device_ordinal(r);
+      run_options.set_device_assignment(&device_assignment);
+      run_options.set_run_id(run_id);
+      void* buffers[] = {large[r].data(), small[r].data()};
+      XlaCustomCallStatus status;
+      __xla_cpu_runtime_AllReduce(
+          &run_options, replica_groups.data(), replica_groups.size(),
+          /*channel_id_present=*/0, /*use_global_device_ids=*/0,
+          /*op_id=*/0, static_cast<int32_t>(ReductionKind::MAX),
+          shape_str.data(), shape_str.size(), /*num_buffers=*/2, buffers,
+          buffers, &status);
+      EXPECT_TRUE(__xla_cpu_runtime_StatusIsSuccess(&status));
+      done.DecrementCount();
+    });
+  }
+  done.Wait();
+
+  for (int r = 0; r < kNumReplicas; ++r) {
+    for (float value : large[r]) ASSERT_EQ(value, 3.0f);
+    for (int32_t value : small[r]) ASSERT_EQ(value, 3);
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    CpuAllReduceTestInstantiation, CpuAllReduceTest,
+    ::testing::Values(runtime::AllReduceStrategy::kAuto,
+                      runtime::AllReduceStrategy::kSequential,
+                      runtime::AllReduceStrategy::kSharded));
+
+// Fails to create communicators, like a transport that cannot reach its peers.
+class UnreachableCollectives : public cpu::CollectivesInterface {
+ public:
+  StatusOr<std::shared_ptr<cpu::CollectivesCommunicator>> GetCommunicator(
+      absl::Span<GlobalDeviceId const> devices, int rank) override {
+    return Unavailable("Collectives peers are unreachable");
+  }
+};
+
+TEST_F(CpuRuntimeTest, CollectiveFailureIsReportedThroughStatus) {
+  UnreachableCollectives collectives;
+  cpu::CpuExecutableRunOptions cpu_run_options;
+  cpu_run_options.set_collectives(&collectives);
+  DeviceAssignment device_assignment(1, 1);
+  device_assignment(0, 0) = 0;
+  ExecutableRunOptions run_options;
+  run_options.set_device_ordinal(0);
+  run_options.set_device_assignment(&device_assignment);
+  run_options.set_cpu_executable_run_options(&cpu_run_options);
+
+  Shape shape = ShapeUtil::MakeShapeWithDescendingLayout(F32, {4});
+  std::string shape_str = shape.ToProto().SerializeAsString();
+  std::string replica_groups = "{}";
+  std::vector<float> data(4);
+  void* buffer = data.data();
+  XlaCustomCallStatus status;
+  __xla_cpu_runtime_AllReduce(
+      &run_options, replica_groups.data(), replica_groups.size(),
+      /*channel_id_present=*/0, /*use_global_device_ids=*/0, /*op_id=*/0,
+      static_cast<int32_t>(ReductionKind::SUM), shape_str.data(),
+      shape_str.size(), /*num_buffers=*/1, &buffer, &buffer, &status);
+  std::optional<absl::string_view> error = CustomCallStatusGetMessage(&status);
+  ASSERT_TRUE(error.has_value());
+  EXPECT_THAT(*error, ::testing::HasSubstr("unreachable"));
+}
+
+// Arguments: number of replicas, elements per replica, strategy.
+void BM_AllReduce(::testing::benchmark::State& state) {
+  const int num_replicas = state.range(0);
+  const int num_elements = state.range(1);
+  runtime::SetAllReduceStrategyForTesting(
+      static_cast<runtime::AllReduceStrategy>(state.range(2)));
+
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "all_reduce_bench",
+                               num_replicas);
+  std::vector<std::vector<float>> inputs(
+      num_replicas, std::vector<float>(num_elements, 1.0f));
+  std::vector<std::vector<float>> outputs(num_replicas,
+                                          std::vector<float>(num_elements));
+  for (auto s : state) {
+    RunAllReduce(&pool, num_replicas, ReductionKind::SUM, inputs, outputs);
+  }
+  state.SetBytesProcessed(state.iterations() * num_replicas * num_elements *
+                          sizeof(float));
+  runtime::SetAllReduceStrategyForTesting(runtime::AllReduceStrategy::kAuto);
+}
+
+void AllReduceBenchmarkArgs(::benchmark::internal::Benchmark* b) {
+  for (int replicas : {2, 8, 32}) {
+    for (int elements : {1 << 10, 1 << 14, 1 << 18, 1 << 22}) {
+      for (auto strategy : {runtime::AllReduceStrategy::kSequential,
+                            runtime::AllReduceStrategy::kSharded}) {
+        b->Args({replicas, elements, static_cast<int>(strategy)});
+      }
+    }
+  }
+}
+
+BENCHMARK(BM_AllReduce)
+    ->ArgNames({"replicas", "elements", "strategy"})
+    ->Apply(AllReduceBenchmarkArgs)
+    ->UseRealTime();
+
+// Arguments: number of concurrent executions, number of partitions. Each
+// execution runs fork/join calls on a pool shared by all of them, which leaves
+// each call fewer free threads than it was partitioned for.
+void BM_ParallelForkJoin(::testing::benchmark::State& state) {
+  const int num_executions = state.range(0);
+  const int64_t num_partitions = state.range(1);
+  constexpr int64_t kRows = 1024;
+
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "XLAEigen", 8);
+  Eigen::ThreadPoolDevice device(pool.AsEigenThreadPool(), pool.NumThreads());
+  ExecutableRunOptions run_options;
+  run_options.set_intra_op_thread_pool(&device);
+  tsl::thread::ThreadPool executions(tsl::Env::Default(), "executions",
+                                     num_executions);
+
+  std::vector<int64_t> partitions =
+      ForkJoinPartitions(kRows, num_partitions / 2);
+  std::vector<ForkJoinParams> params(num_executions);
+  for (ForkJoinParams& p : params) {
+    p.counts = std::vector<std::atomic<int32_t>>(kRows * kForkJoinCols);
+    p.work = 64;
+  }
+  for (auto s : state) {
+    tsl::BlockingCounter done(num_executions);
+    for (int i = 0; i < num_executions; ++i) {
+      executions.Schedule([&, i] {
+        XlaCustomCallStatus status;
+        __xla_cpu_runtime_ParallelForkJoin(
+            &params[i], &run_options, /*params=*/nullptr,
+            /*buffer_table=*/nullptr, &status, /*prof_counters=*/nullptr,
+            num_partitions, partitions.data(), /*num_partitioned_dims=*/2,
+            reinterpret_cast<void*>(&ForkJoinComputeFunction));
+        done.DecrementCount();
+      });
+    }
+    done.Wait();
+  }
+  state.SetItemsProcessed(state.iterations() * num_executions * kRows *
+                          kForkJoinCols);
+}
+
+BENCHMARK(BM_ParallelForkJoin)
+    ->ArgNames({"executions", "partitions"})
+    ->ArgPair(1, 8)
+    ->ArgPair(4, 8)
+    ->ArgPair(8, 8)
+    ->ArgPair(4, 32)
+    ->UseRealTime();
+
 }  // namespace
 }  // namespace xla
@@ -0,0 +1,32 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/cpu_scatter_expander.h"
+
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+
+namespace xla {
+namespace cpu {
+
+bool CpuScatterExpander::InstructionMatchesPattern(HloInstruction* inst) {
+  // Variadic scatter is not emitted natively; it still goes through the
+  // expander.
+  return inst->opcode() == HloOpcode::kScatter &&
+         (!native_scatter_ || inst->shape().IsTuple());
+}
+
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,48 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_CPU_CPU_SCATTER_EXPANDER_H_
+#define XLA_SERVICE_CPU_CPU_SCATTER_EXPANDER_H_
+
+#include "absl/strings/string_view.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/service/scatter_expander.h"
+
+namespace xla {
+namespace cpu {
+
+// Expands the scatters that the CPU IrEmitter doesn't emit natively into
+// loops. If native scatter is disabled, all scatters are expanded.
+class CpuScatterExpander : public ScatterExpander {
+ public:
+  // Although we pass kEliminateAllScatters, we override this behavior in
+  // InstructionMatchesPattern and select only some scatters to expand.
+  explicit CpuScatterExpander(bool native_scatter)
+      : ScatterExpander(kEliminateAllScatters),
+        native_scatter_(native_scatter) {}
+
+  absl::string_view name() const override { return "cpu_scatter_expander"; }
+
+ protected:
+  bool InstructionMatchesPattern(HloInstruction* inst) override;
+
+ private:
+  const bool native_scatter_;
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_CPU_CPU_SCATTER_EXPANDER_H_
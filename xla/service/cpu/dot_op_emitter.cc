@@ -808,6 +808,12 @@ Status DotOpEmitter::EmitCallToRuntime() {
   llvm::Type* float_type;
   const char* fn_name;
   switch (type) {
+    case BF16:
+      // See DotImplementationCanHandleBF16.
+      TF_RET_CHECK(multi_threaded);
+      fn_name = runtime::kBF16MatMulSymbolName;
+      float_type = b_->getInt16Ty();
+      break;
     case F16:
       fn_name = multi_threaded
                     ? runtime::kEigenMatMulF16SymbolName
@@ -840,9 +846,23 @@ Status DotOpEmitter::EmitCallToRuntime() {
       float_type = llvm_ir::PrimitiveTypeToIrType(C128, module);
       break;
     case S32:
-      fn_name = multi_threaded
-                    ? runtime::kEigenMatMulS32SymbolName
-                    : runtime::kEigenSingleThreadedMatMulS32SymbolName;
+      if (lhs_array_.GetShape().element_type() == S8) {
+        // See DotImplementationCanHandleInt8Operands.
+        TF_RET_CHECK(multi_threaded);
+        fn_name = runtime::kInt8MatMulSymbolName;
+      } else if (lhs_array_.GetShape().element_type() == U8) {
+        // Int8Rewriter only pairs a u8 lhs with an s8 rhs. The operands of the
+        // row-major dot are swapped below, which makes the lhs the unsigned
+        // operand of the runtime function.
+        TF_RET_CHECK(multi_threaded);
+        TF_RET_CHECK(rhs_array_.GetShape().element_type() == S8);
+        TF_RET_CHECK(!GetMatMultDims().lhs_column_major);
+        fn_name = runtime::kInt8MatMulU8SymbolName;
+      } else {
+        fn_name = multi_threaded
+                      ? runtime::kEigenMatMulS32SymbolName
+                      : runtime::kEigenSingleThreadedMatMulS32SymbolName;
+      }
       float_type = b_->getInt32Ty();
       break;
     default:
@@ -1114,6 +1134,7 @@ bool AreGemmShapes(const Shape& lhs_shape, const Shape& rhs_shape,
       << output_shape.DebugString();
 
   switch (output_shape.element_type()) {
+    case BF16:
     case F16:
     case F32:
     case F64:
@@ -1167,7 +1188,8 @@ bool CanEmitTiledLlvmIrGemm(
     return false;
   }
 
-  if (dot_info.result_shape.element_type() == F16 ||
+  if (dot_info.result_shape.element_type() == BF16 ||
+      dot_info.result_shape.element_type() == F16 ||
       dot_info.result_shape.element_type() == C64 ||
       dot_info.result_shape.element_type() == C128) {
     // TODO(sanjoy): This is probably easy to fix, but I want to keep the CL
@@ -1228,8 +1250,13 @@ Status EmitNonBatchDotOperation(
   PrimitiveType type = target_array.GetShape().element_type();
   TF_RET_CHECK(PRED == type || S8 == type || U8 == type || S16 == type ||
                U16 == type || S32 == type || U32 == type || S64 == type ||
-               U64 == type || F16 == type || F32 == type || F64 == type ||
-               C64 == type || C128 == type);
+               U64 == type || BF16 == type || F16 == type || F32 == type ||
+               F64 == type || C64 == type || C128 == type);
+  // The LLVM IR implementations can't do arithmetic on bf16 values.
+  TF_RET_CHECK(type != BF16 ||
+               GetDotImplementationStrategy(hlo_module_config, dot_info,
+                                            target_machine_features) ==
+                   DotImplementationStrategy::kEigen);
   DotOpEmitter dot_emitter(std::move(dot_info), std::move(hlo_name),
                            target_array, lhs_array, rhs_array, addend_array,
                            executable_run_options_value, b, mlir_context,
@@ -1463,6 +1490,42 @@ bool DotImplementationCanHandleTranspose(
          impl_strategy == DotImplementationStrategy::kEigen;
 }
 
+bool DotImplementationCanHandleInt8Operands(
+    const HloInstruction& dot_instr,
+    const TargetMachineFeatures& target_machine_features) {
+  // Only the multi-threaded int8 runtime matmul reads s8 operands into an s32
+  // result, the LLVM IR implementations accumulate in the operand type.
+  const HloModuleConfig& config = dot_instr.GetModule()->config();
+  if (IsBatchDot(dot_instr) || dot_instr.shape().element_type() != S32 ||
+      !ShouldUseMultiThreadedEigen(config)) {
+    return false;
+  }
+  return GetDotImplementationStrategy(config, DotInfo(dot_instr),
+                                      target_machine_features) ==
+         DotImplementationStrategy::kEigen;
+}
+
+bool DotImplementationCanHandleBF16(
+    const HloInstruction& dot_instr,
+    const TargetMachineFeatures& target_machine_features) {
+  // Only the multi-threaded bf16 runtime matmul computes in bf16, the LLVM IR
+  // implementations would have to convert every element to f32.
+  const HloModuleConfig& config = dot_instr.GetModule()->config();
+  if (!target_machine_features.has_avx512_bf16() || IsBatchDot(dot_instr) ||
+      !ShouldUseMultiThreadedEigen(config)) {
+    return false;
+  }
+  // The operands of `dot_instr` may still be f32 when this is called, so
+  // evaluate the strategy for bf16 operands and result.
+  DotInfo dot_info(dot_instr);
+  dot_info.lhs_shape.set_element_type(BF16);
+  dot_info.rhs_shape.set_element_type(BF16);
+  dot_info.result_shape.set_element_type(BF16);
+  return GetDotImplementationStrategy(config, dot_info,
+                                      target_machine_features) ==
+         DotImplementationStrategy::kEigen;
+}
+
 bool DotOperandsAndResultMustHaveRowMajorLayout(
     const HloInstruction& dot_instr,
     const TargetMachineFeatures& target_machine_features) {
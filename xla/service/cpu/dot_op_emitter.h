@@ -42,6 +42,19 @@ bool DotImplementationCanHandleTranspose(
     const HloInstruction& dot_instr,
     const TargetMachineFeatures& target_machine_features);
 
+// Returns true if our lowering strategy for `dot_instr` can multiply s8
+// operands, or a u8 lhs with an s8 rhs, into its s32 result, without
+// converting them to s32 first.
+bool DotImplementationCanHandleInt8Operands(
+    const HloInstruction& dot_instr,
+    const TargetMachineFeatures& target_machine_features);
+
+// Returns true if our lowering strategy for `dot_instr` can compute it with
+// bf16 operands and result, accumulating in f32, on targets with AVX512-BF16.
+bool DotImplementationCanHandleBF16(
+    const HloInstruction& dot_instr,
+    const TargetMachineFeatures& target_machine_features);
+
 // Returns the index for an operand to `hlo` that should ideally be column
 // major.  Returns nullopt if there is no such operand or if `hlo` is not a dot
 // or a fusion containing a dot.
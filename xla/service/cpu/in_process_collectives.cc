@@ -0,0 +1,552 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/in_process_collectives.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "xla/map_util.h"
+#include "xla/primitive_util.h"
+#include "xla/refcounting_hash_map.h"
+#include "xla/service/collective_ops_utils.h"
+#include "xla/service/cpu/collective_reduction.h"
+#include "xla/service/cpu/collectives_interface.h"
+#include "xla/service/global_device_id.h"
+#include "xla/status.h"
+#include "xla/status_macros.h"
+#include "xla/statusor.h"
+#include "xla/xla_data.pb.h"
+#include "tsl/platform/logging.h"
+
+namespace xla {
+namespace cpu {
+namespace runtime {
+namespace {
+
+// Below this many bytes per participant the synchronization and cache-line
+// traffic of the sharded all-reduce outweighs the parallel speedup.
+constexpr int64_t kMinBytesForShardedAllReduce = 64 * 1024;
+
+std::atomic<AllReduceStrategy>& GlobalAllReduceStrategy() {
+  static auto* strategy =
+      new std::atomic<AllReduceStrategy>(AllReduceStrategy::kAuto);
+  return *strategy;
+}
+
+struct AllReduceParticipantData : ParticipantData {
+  AllReduceParticipantData(const RendezvousKey& rendezvous_key_p, int rank_p)
+      : ParticipantData(rendezvous_key_p), rank(rank_p) {}
+
+  int rank;
+  std::vector<AllReduceBuffer> buffers;
+  ReductionKind reduction_kind;
+
+  std::string ToString() const override {
+    auto buffer_formatter = [](std::string* out, const AllReduceBuffer& b) {
+      absl::StrAppend(out, PrimitiveType_Name(b.element_type), "[",
+                      b.num_elements, "]");
+    };
+    return absl::StrFormat(
+        "AllReduceParticipantData{rank=%d, buffers=[%s], rendezvous_key=%s}",
+        rank, absl::StrJoin(buffers, ", ", buffer_formatter),
+        rendezvous_key.ToString());
+  }
+};
+
+struct CollectivePermuteParticipantData : ParticipantData {
+  CollectivePermuteParticipantData(const RendezvousKey& rendezvous_key_p,
+                                   int rank_p)
+      : ParticipantData(rendezvous_key_p), rank(rank_p) {}
+
+  int rank;
+  const void* source_buffer;
+  void* destination_buffer;
+  int64_t num_bytes;
+  std::vector<int> target_ranks;
+
+  std::string ToString() const override {
+    return absl::StrFormat(
+        "CollectivePermuteParticipantData{rank=%d, source_buffer=%p, "
+        "destination_buffer=%p, num_bytes=%d, target_ranks=[%s]}",
+        rank, source_buffer, destination_buffer, num_bytes,
+        absl::StrJoin(target_ranks, ", "));
+  }
+};
+
+struct AllToAllParticipantData : ParticipantData {
+  AllToAllParticipantData(const RendezvousKey& rendezvous_key_p, int rank_p)
+      : ParticipantData(rendezvous_key_p), rank(rank_p) {}
+
+  int rank;
+  std::vector<const void*> source_buffers;
+  std::vector<void*> destination_buffers;
+  int64_t chunk_bytes;
+
+  std::string ToString() const override {
+    auto addr_formatter = [](std::string* out, const void* mem) {
+      absl::StrAppend(out, absl::StrFormat("%p", mem));
+    };
+    return absl::StrFormat(
+        "AllToAllParticipantData{rank=%d, source_buffers=[%s], "
+        "destination_buffers=[%s], chunk_bytes=%d}",
+        rank, absl::StrJoin(source_buffers, ", ", addr_formatter),
+        absl::StrJoin(destination_buffers, ", ", addr_formatter), chunk_bytes);
+  }
+};
+
+struct AllGatherParticipantData : ParticipantData {
+  AllGatherParticipantData(const RendezvousKey& rendezvous_key_p, int rank_p)
+      : ParticipantData(rendezvous_key_p), rank(rank_p) {}
+
+  int rank;
+  const void* source_buffer;
+  void* destination_buffer;
+  int64_t outer_count;
+  int64_t chunk_bytes;
+
+  std::string ToString() const override {
+    return absl::StrFormat(
+        "AllGatherParticipantData{rank=%d, source_buffer=%p, "
+        "destination_buffer=%p, outer_count=%d, chunk_bytes=%d}",
+        rank, source_buffer, destination_buffer, outer_count, chunk_bytes);
+  }
+};
+
+struct ReduceScatterParticipantData : ParticipantData {
+  ReduceScatterParticipantData(const RendezvousKey& rendezvous_key_p,
+                               int rank_p)
+      : ParticipantData(rendezvous_key_p), rank(rank_p) {}
+
+  int rank;
+  const void* source_buffer;
+  void* destination_buffer;
+  PrimitiveType element_type;
+  ReductionKind reduction_kind;
+  int64_t outer_count;
+  int64_t chunk_elements;
+
+  std::string ToString() const override {
+    return absl::StrFormat(
+        "ReduceScatterParticipantData{rank=%d, source_buffer=%p, "
+        "destination_buffer=%p, element_type=%s, outer_count=%d, "
+        "chunk_elements=%d}",
+        rank, source_buffer, destination_buffer,
+        primitive_util::LowercasePrimitiveTypeName(element_type), outer_count,
+        chunk_elements);
+  }
+};
+
+class CpuAllReduceRendezvous
+    : public Rendezvous<AllReduceParticipantData, std::nullptr_t> {
+ public:
+  explicit CpuAllReduceRendezvous(const RendezvousKey& k)
+      : Rendezvous<AllReduceParticipantData, std::nullptr_t>(k) {}
+
+ protected:
+  StatusOr<std::nullptr_t> RunCollectiveOp(
+      const AllReduceParticipantData& participant) override {
+    // In the sharded mode every participant reduces a disjoint, contiguous
+    // shard of the buffer (reduce-scatter) and writes it straight into the
+    // outputs of all participants (all-gather). Rendezvous::SubmitParticipant
+    // only returns once every participant has left RunCollectiveOp, so no
+    // additional barrier is needed before the outputs are consumed. Otherwise
+    // the first participant to get here reduces the buffer on its own.
+    bool primary = InitializationBarrier();
+    for (size_t i = 0; i < participant.buffers.size(); ++i) {
+      const AllReduceBuffer& buffer = participant.buffers[i];
+      bool sharded = UseShardedAllReduce(participant, buffer);
+      if (!sharded && !primary) {
+        continue;
+      }
+
+      // Buffers are ordered by rank so that the reduction order does not
+      // depend on the order in which threads arrived.
+      std::vector<const void*> input_buffers;
+      std::vector<void*> output_buffers;
+      {
+        absl::MutexLock lock(&mu_);
+        input_buffers.resize(participants_.size());
+        output_buffers.resize(participants_.size());
+        for (const AllReduceParticipantData& p : participants_) {
+          CHECK(p.reduction_kind == participant.reduction_kind);
+          CHECK_EQ(p.buffers.size(), participant.buffers.size());
+          CHECK_EQ(p.buffers[i].element_type, buffer.element_type);
+          CHECK_EQ(p.buffers[i].num_elements, buffer.num_elements);
+          input_buffers[p.rank] = p.buffers[i].input;
+          output_buffers[p.rank] = p.buffers[i].output;
+        }
+      }
+
+      int64_t begin = 0;
+      int64_t end = buffer.num_elements;
+      if (sharded) {
+        std::tie(begin, end) = ReductionShardBounds(
+            buffer.num_elements, primitive_util::ByteWidth(buffer.element_type),
+            input_buffers.size(), participant.rank);
+      }
+      ReduceAndBroadcast(participant.reduction_kind, buffer.element_type,
+                         input_buffers, output_buffers, begin, end);
+    }
+    return nullptr;
+  }
+
+ private:
+  // The decision only depends on data that is identical for all participants,
+  // so every participant picks the same mode.
+  static bool UseShardedAllReduce(const AllReduceParticipantData& participant,
+                                  const AllReduceBuffer& buffer) {
+    switch (GlobalAllReduceStrategy().load()) {
+      case AllReduceStrategy::kSequential:
+        return false;
+      case AllReduceStrategy::kSharded:
+        return true;
+      case AllReduceStrategy::kAuto:
+        break;
+    }
+    if (participant.rendezvous_key.num_local_participants < 2) {
+      return false;
+    }
+    int64_t num_bytes =
+        buffer.num_elements * primitive_util::ByteWidth(buffer.element_type);
+    return num_bytes >= kMinBytesForShardedAllReduce;
+  }
+};
+
+class CpuCollectivePermuteRendezvous
+    : public Rendezvous<CollectivePermuteParticipantData, std::nullptr_t> {
+ public:
+  explicit CpuCollectivePermuteRendezvous(const RendezvousKey& k)
+      : Rendezvous<CollectivePermuteParticipantData, std::nullptr_t>(k) {}
+
+ protected:
+  StatusOr<std::nullptr_t> RunCollectiveOp(
+      const CollectivePermuteParticipantData& /*participant*/) override {
+    bool primary = InitializationBarrier();
+
+    // Perform all copies from the primary thread.
+    if (primary) {
+      absl::MutexLock lock(&mu_);
+
+      std::map<int, int> rank_to_participant_idx;
+      for (int p_idx = 0; p_idx < participants_.size(); p_idx++) {
+        rank_to_participant_idx[participants_[p_idx].rank] = p_idx;
+      }
+      for (auto& p : participants_) {
+        for (int dest_rank : p.target_ranks) {
+          auto& dest_p =
+              participants_[FindOrDie(rank_to_participant_idx, dest_rank)];
+          std::memcpy(dest_p.destination_buffer, p.source_buffer,
+                      p.num_bytes);
+
+          // Each rank may be copied into only once.
+          rank_to_participant_idx.erase(dest_rank);
+        }
+      }
+
+      // Zero out untouched participants.
+      for (auto& rank_p : rank_to_participant_idx) {
+        auto& p = participants_[rank_p.second];
+        std::memset(p.destination_buffer, 0, p.num_bytes);
+      }
+    }
+    return nullptr;
+  }
+};
+
+class CpuAllToAllRendezvous
+    : public Rendezvous<AllToAllParticipantData, std::nullptr_t> {
+ public:
+  explicit CpuAllToAllRendezvous(const RendezvousKey& k)
+      : Rendezvous<AllToAllParticipantData, std::nullptr_t>(k) {}
+
+ protected:
+  StatusOr<std::nullptr_t> RunCollectiveOp(
+      const AllToAllParticipantData& /*participant*/) override {
+    bool is_primary = InitializationBarrier();
+
+    if (is_primary) {
+      absl::MutexLock lock(&mu_);
+
+      CHECK(!participants_.empty());
+      int64_t chunk_bytes = participants_[0].chunk_bytes;
+
+      // Rank -> position in participants_.
+      std::vector<int> rank_to_participant_idx(participants_.size(), -1);
+      for (int pos = 0; pos < participants_.size(); pos++) {
+        const AllToAllParticipantData& p = participants_[pos];
+        CHECK_EQ(p.source_buffers.size(), participants_.size());
+        CHECK_EQ(p.destination_buffers.size(), participants_.size());
+        CHECK_EQ(p.chunk_bytes, chunk_bytes);
+        rank_to_participant_idx[p.rank] = pos;
+      }
+
+      for (const AllToAllParticipantData& sender : participants_) {
+        VLOG(3) << "Processing AllToAll participant: " << sender.ToString();
+        for (int i = 0; i < participants_.size(); ++i) {
+          const AllToAllParticipantData& receiver =
+              participants_[rank_to_participant_idx[i]];
+          std::memcpy(receiver.destination_buffers[sender.rank],
+                      sender.source_buffers[i], chunk_bytes);
+        }
+      }
+    }
+    return nullptr;
+  }
+};
+
+class CpuAllGatherRendezvous
+    : public Rendezvous<AllGatherParticipantData, std::nullptr_t> {
+ public:
+  explicit CpuAllGatherRendezvous(const RendezvousKey& k)
+      : Rendezvous<AllGatherParticipantData, std::nullptr_t>(k) {}
+
+ protected:
+  StatusOr<std::nullptr_t> RunCollectiveOp(
+      const AllGatherParticipantData& participant) override {
+    // Every participant assembles its own output from the inputs of all
+    // participants, so the copies run in parallel and no two threads write to
+    // the same buffer.
+    std::vector<const char*> sources;
+    {
+      absl::MutexLock lock(&mu_);
+      sources.resize(participants_.size());
+      for (const AllGatherParticipantData& p : participants_) {
+        CHECK_EQ(p.chunk_bytes, participant.chunk_bytes);
+        CHECK_EQ(p.outer_count, participant.outer_count);
+        sources[p.rank] = static_cast<const char*>(p.source_buffer);
+      }
+    }
+
+    int64_t chunk_bytes = participant.chunk_bytes;
+    char* destination = static_cast<char*>(participant.destination_buffer);
+    for (int64_t outer = 0; outer < participant.outer_count; ++outer) {
+      for (const char* source : sources) {
+        std::memcpy(destination, source + outer * chunk_bytes, chunk_bytes);
+        destination += chunk_bytes;
+      }
+    }
+    return nullptr;
+  }
+};
+
+class CpuReduceScatterRendezvous
+    : public Rendezvous<ReduceScatterParticipantData, std::nullptr_t> {
+ public:
+  explicit CpuReduceScatterRendezvous(const RendezvousKey& k)
+      : Rendezvous<ReduceScatterParticipantData, std::nullptr_t>(k) {}
+
+ protected:
+  StatusOr<std::nullptr_t> RunCollectiveOp(
+      const ReduceScatterParticipantData& participant) override {
+    // Every participant reduces only the chunks it owns, so the reduction is
+    // spread over all participating threads.
+    std::vector<const char*> sources;
+    {
+      absl::MutexLock lock(&mu_);
+      sources.resize(participants_.size());
+      for (const ReduceScatterParticipantData& p : participants_) {
+        CHECK(p.reduction_kind == participant.reduction_kind);
+        CHECK_EQ(p.element_type, participant.element_type);
+        CHECK_EQ(p.outer_count, participant.outer_count);
+        CHECK_EQ(p.chunk_elements, participant.chunk_elements);
+        sources[p.rank] = static_cast<const char*>(p.source_buffer);
+      }
+    }
+
+    int64_t num_participants = sources.size();
+    int64_t chunk_bytes = participant.chunk_elements *
+                          primitive_util::ByteWidth(participant.element_type);
+    std::vector<const void*> inputs(num_participants);
+    for (int64_t outer = 0; outer < participant.outer_count; ++outer) {
+      int64_t offset = (outer * num_participants + participant.rank) *
+                       chunk_bytes;
+      for (int64_t i = 0; i < num_participants; ++i) {
+        inputs[i] = sources[i] + offset;
+      }
+      void* output = static_cast<char*>(participant.destination_buffer) +
+                     outer * chunk_bytes;
+      ReduceAndBroadcast(participant.reduction_kind, participant.element_type,
+                         inputs, absl::Span<void* const>(&output, 1), 0,
+                         participant.chunk_elements);
+    }
+    return nullptr;
+  }
+};
+
+}  // namespace
+
+struct InProcessCollectivesState {
+  RefcountingHashMap<RendezvousKey, CpuAllReduceRendezvous>
+      all_reduce_rendezvous_map;
+  RefcountingHashMap<RendezvousKey, CpuCollectivePermuteRendezvous>
+      collective_permute_rendezvous_map;
+  RefcountingHashMap<RendezvousKey, CpuAllToAllRendezvous>
+      all_to_all_rendezvous_map;
+  RefcountingHashMap<RendezvousKey, CpuAllGatherRendezvous>
+      all_gather_rendezvous_map;
+  RefcountingHashMap<RendezvousKey, CpuReduceScatterRendezvous>
+      reduce_scatter_rendezvous_map;
+};
+
+InProcessCollectivesCommunicator::InProcessCollectivesCommunicator(
+    InProcessCollectivesState* state, int rank)
+    : state_(state), rank_(rank) {}
+InProcessCollectivesCommunicator::~InProcessCollectivesCommunicator() = default;
+
+Status InProcessCollectivesCommunicator::AllReduce(
+    const RendezvousKey& key, ReductionKind reduction_kind,
+    absl::Span<const AllReduceBuffer> buffers, absl::Duration timeout) {
+  AllReduceParticipantData participant(key, rank_);
+  participant.buffers.assign(buffers.begin(), buffers.end());
+  participant.reduction_kind = reduction_kind;
+
+  auto make_cpu_rendezvous = [](const RendezvousKey& k) {
+    return std::make_unique<CpuAllReduceRendezvous>(k);
+  };
+
+  return CpuAllReduceRendezvous::SubmitParticipant(
+             [&] {
+               return state_->all_reduce_rendezvous_map.GetOrCreateIfAbsent(
+                   key, make_cpu_rendezvous);
+             },
+             participant)
+      .status();
+}
+
+Status InProcessCollectivesCommunicator::CollectivePermute(
+    const RendezvousKey& key, int64_t num_bytes, std::optional<int> source_rank,
+    absl::Span<int const> target_ranks, const void* input_buffer,
+    void* output_buffer, absl::Duration timeout) {
+  CollectivePermuteParticipantData participant(key, rank_);
+  participant.source_buffer = input_buffer;
+  participant.destination_buffer = output_buffer;
+  participant.num_bytes = num_bytes;
+  participant.target_ranks.assign(target_ranks.begin(), target_ranks.end());
+
+  auto make_cpu_rendezvous = [](const RendezvousKey& k) {
+    return std::make_unique<CpuCollectivePermuteRendezvous>(k);
+  };
+  return CpuCollectivePermuteRendezvous::SubmitParticipant(
+             [&] {
+               return state_->collective_permute_rendezvous_map
+                   .GetOrCreateIfAbsent(key, make_cpu_rendezvous);
+             },
+             participant)
+      .status();
+}
+
+Status InProcessCollectivesCommunicator::AllToAll(
+    const RendezvousKey& key, int64_t chunk_bytes,
+    absl::Span<const void* const> input_buffers,
+    absl::Span<void* const> output_buffers, absl::Duration timeout) {
+  AllToAllParticipantData participant(key, rank_);
+  TF_RET_CHECK(input_buffers.size() == output_buffers.size());
+  participant.chunk_bytes = chunk_bytes;
+  participant.source_buffers.assign(input_buffers.begin(),
+                                    input_buffers.end());
+  participant.destination_buffers.assign(output_buffers.begin(),
+                                         output_buffers.end());
+
+  auto make_cpu_rendezvous = [](const RendezvousKey& k) {
+    return std::make_unique<CpuAllToAllRendezvous>(k);
+  };
+  return CpuAllToAllRendezvous::SubmitParticipant(
+             [&] {
+               return state_->all_to_all_rendezvous_map.GetOrCreateIfAbsent(
+                   key, make_cpu_rendezvous);
+             },
+             participant)
+      .status();
+}
+
+Status InProcessCollectivesCommunicator::AllGather(
+    const RendezvousKey& key, int64_t outer_count, int64_t chunk_bytes,
+    const void* input_buffer, void* output_buffer, absl::Duration timeout) {
+  AllGatherParticipantData participant(key, rank_);
+  participant.source_buffer = input_buffer;
+  participant.destination_buffer = output_buffer;
+  participant.outer_count = outer_count;
+  participant.chunk_bytes = chunk_bytes;
+
+  auto make_cpu_rendezvous = [](const RendezvousKey& k) {
+    return std::make_unique<CpuAllGatherRendezvous>(k);
+  };
+  return CpuAllGatherRendezvous::SubmitParticipant(
+             [&] {
+               return state_->all_gather_rendezvous_map.GetOrCreateIfAbsent(
+                   key, make_cpu_rendezvous);
+             },
+             participant)
+      .status();
+}
+
+Status InProcessCollectivesCommunicator::ReduceScatter(
+    const RendezvousKey& key, ReductionKind reduction_kind,
+    PrimitiveType element_type, int64_t outer_count, int64_t chunk_elements,
+    const void* input_buffer, void* output_buffer, absl::Duration timeout) {
+  ReduceScatterParticipantData participant(key, rank_);
+  participant.source_buffer = input_buffer;
+  participant.destination_buffer = output_buffer;
+  participant.element_type = element_type;
+  participant.reduction_kind = reduction_kind;
+  participant.outer_count = outer_count;
+  participant.chunk_elements = chunk_elements;
+
+  auto make_cpu_rendezvous = [](const RendezvousKey& k) {
+    return std::make_unique<CpuReduceScatterRendezvous>(k);
+  };
+  return CpuReduceScatterRendezvous::SubmitParticipant(
+             [&] {
+               return state_->reduce_scatter_rendezvous_map
+                   .GetOrCreateIfAbsent(key, make_cpu_rendezvous);
+             },
+             participant)
+      .status();
+}
+
+InProcessCollectives::InProcessCollectives()
+    : state_(std::make_unique<InProcessCollectivesState>()) {}
+InProcessCollectives::~InProcessCollectives() = default;
+
+StatusOr<std::shared_ptr<CollectivesCommunicator>>
+InProcessCollectives::GetCommunicator(absl::Span<GlobalDeviceId const> devices,
+                                      int rank) {
+  // We don't care about devices here: we share rendezvous state globally.
+  return std::make_shared<InProcessCollectivesCommunicator>(state_.get(),
+                                                            rank);
+}
+
+void SetAllReduceStrategyForTesting(AllReduceStrategy strategy) {
+  GlobalAllReduceStrategy().store(strategy);
+}
+
+}  // namespace runtime
+}  // namespace cpu
+}  // namespace xla
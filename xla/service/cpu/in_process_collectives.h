@@ -0,0 +1,109 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_CPU_IN_PROCESS_COLLECTIVES_H_
+#define XLA_SERVICE_CPU_IN_PROCESS_COLLECTIVES_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "xla/service/collective_ops_utils.h"
+#include "xla/service/cpu/collectives_interface.h"
+#include "xla/service/global_device_id.h"
+#include "xla/status.h"
+#include "xla/statusor.h"
+#include "xla/xla_data.pb.h"
+
+namespace xla {
+namespace cpu {
+namespace runtime {
+
+// How the in-process all-reduce splits work between its participants.
+enum class AllReduceStrategy {
+  // Picks kSharded for large buffers and kSequential otherwise.
+  kAuto,
+  // The first participant to finish the rendezvous reduces all buffers while
+  // the others wait.
+  kSequential,
+  // Every participant reduces a contiguous shard of every buffer and writes
+  // the result into the outputs of all participants.
+  kSharded,
+};
+
+// Overrides the all-reduce strategy for all subsequent all-reduces in the
+// process. Must not be called while an all-reduce is in flight.
+void SetAllReduceStrategyForTesting(AllReduceStrategy strategy);
+
+struct InProcessCollectivesState;
+
+// A communicator whose ranks are threads of the current process. Ranks meet at
+// a rendezvous keyed by the RendezvousKey of the collective and access each
+// other's buffers directly.
+class InProcessCollectivesCommunicator : public CollectivesCommunicator {
+ public:
+  InProcessCollectivesCommunicator(InProcessCollectivesState* state, int rank);
+  ~InProcessCollectivesCommunicator() override;
+
+  Status AllReduce(const RendezvousKey& key, ReductionKind reduction_kind,
+                   absl::Span<const AllReduceBuffer> buffers,
+                   absl::Duration timeout) override;
+
+  Status CollectivePermute(const RendezvousKey& key, int64_t num_bytes,
+                           std::optional<int> source_rank,
+                           absl::Span<int const> target_ranks,
+                           const void* input_buffer, void* output_buffer,
+                           absl::Duration timeout) override;
+
+  Status AllToAll(const RendezvousKey& key, int64_t chunk_bytes,
+                  absl::Span<const void* const> input_buffers,
+                  absl::Span<void* const> output_buffers,
+                  absl::Duration timeout) override;
+
+  Status AllGather(const RendezvousKey& key, int64_t outer_count,
+                   int64_t chunk_bytes, const void* input_buffer,
+                   void* output_buffer, absl::Duration timeout) override;
+
+  Status ReduceScatter(const RendezvousKey& key, ReductionKind reduction_kind,
+                       PrimitiveType element_type, int64_t outer_count,
+                       int64_t chunk_elements, const void* input_buffer,
+                       void* output_buffer, absl::Duration timeout) override;
+
+ private:
+  InProcessCollectivesState* state_;
+  int rank_;
+};
+
+// Collectives between the devices of a single process. This is the default
+// when no other implementation is set in the CpuExecutableRunOptions.
+class InProcessCollectives : public CollectivesInterface {
+ public:
+  InProcessCollectives();
+  ~InProcessCollectives() override;
+
+  StatusOr<std::shared_ptr<CollectivesCommunicator>> GetCommunicator(
+      absl::Span<GlobalDeviceId const> devices, int rank) override;
+
+ private:
+  std::unique_ptr<InProcessCollectivesState> state_;
+};
+
+}  // namespace runtime
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_CPU_IN_PROCESS_COLLECTIVES_H_
@@ -0,0 +1,103 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/int8_rewriter.h"
+
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/service/cpu/dot_op_emitter.h"
+#include "xla/service/cpu/ir_emission_utils.h"
+#include "xla/xla_data.pb.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/statusor.h"
+
+namespace xla {
+namespace cpu {
+
+namespace {
+
+// Returns the s8 operand of `hlo` if it converts it to s32, and nullptr
+// otherwise. If `allow_u8`, also returns a u8 operand.
+HloInstruction* GetConvertedInt8Operand(HloInstruction* hlo, bool allow_u8) {
+  if (hlo->opcode() != HloOpcode::kConvert ||
+      hlo->shape().element_type() != S32) {
+    return nullptr;
+  }
+  const PrimitiveType type = hlo->operand(0)->shape().element_type();
+  if (type == S8 || (allow_u8 && type == U8)) {
+    return hlo->mutable_operand(0);
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+StatusOr<bool> Int8Rewriter::Run(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  if (!target_machine_features_.has_avx512_vnni()) {
+    return false;
+  }
+
+  bool changed = false;
+  for (HloComputation* computation :
+       module->MakeNonfusionComputations(execution_threads)) {
+    for (HloInstruction* hlo : computation->MakeInstructionPostOrder()) {
+      if ((hlo->opcode() != HloOpcode::kDot &&
+           hlo->opcode() != HloOpcode::kConvolution) ||
+          hlo->shape().element_type() != S32) {
+        continue;
+      }
+      // The lhs becomes the unsigned operand of the VNNI instructions, so it
+      // may be u8 too.
+      HloInstruction* lhs = GetConvertedInt8Operand(hlo->mutable_operand(0),
+                                                    /*allow_u8=*/true);
+      HloInstruction* rhs = GetConvertedInt8Operand(hlo->mutable_operand(1),
+                                                    /*allow_u8=*/false);
+      if (lhs == nullptr || rhs == nullptr) {
+        continue;
+      }
+
+      // Whether the s8 operands are supported depends on the strategy chosen
+      // for the narrowed instruction, so check it on the instruction itself.
+      HloInstruction* narrowed = computation->AddInstruction(
+          hlo->CloneWithNewOperands(hlo->shape(), {lhs, rhs}));
+      const bool supported =
+          hlo->opcode() == HloOpcode::kDot
+              ? DotImplementationCanHandleInt8Operands(
+                    *narrowed, target_machine_features_)
+              : PotentiallyImplementedAsEigenConvolution(
+                    *narrowed, target_machine_features_);
+      if (!supported) {
+        TF_RETURN_IF_ERROR(computation->RemoveInstruction(narrowed));
+        continue;
+      }
+
+      VLOG(2) << "Reading the int8 operands of " << hlo->name() << " directly";
+      // Removes the converts too, unless they have other users.
+      TF_RETURN_IF_ERROR(computation
+                             ->ReplaceInstruction(
+                                 hlo, narrowed, /*preserve_sharding=*/false,
+                                 /*relay_control_dependency=*/true)
+                             .status());
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,57 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_CPU_INT8_REWRITER_H_
+#define XLA_SERVICE_CPU_INT8_REWRITER_H_
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/cpu/target_machine_features.h"
+#include "xla/service/hlo_pass_interface.h"
+#include "xla/statusor.h"
+
+namespace xla {
+namespace cpu {
+
+// An HLO pass that rewrites quantized matmuls and convolutions to read their
+// int8 operands directly.
+//
+// OperandUpcaster converts the s8 operands of dots and convolutions with an
+// s32 result to s32, i.e. dot(convert(s8), convert(s8)). On targets with
+// AVX512-VNNI, this pass replaces them with dot(s8, s8) whenever they are
+// lowered to the int8 runtime functions, which multiply s8 values with the
+// VNNI dot product instructions. Those multiply u8 with s8 values natively, so
+// a u8 lhs, e.g. activations quantized to u8, is read directly too.
+class Int8Rewriter : public HloModulePass {
+ public:
+  explicit Int8Rewriter(const TargetMachineFeatures* target_machine_features)
+      : target_machine_features_(*target_machine_features) {}
+
+  ~Int8Rewriter() override {}
+  absl::string_view name() const override { return "cpu-int8-rewriter"; }
+  using HloPassInterface::Run;
+  StatusOr<bool> Run(
+      HloModule* module,
+      const absl::flat_hash_set<absl::string_view>& execution_threads) override;
+
+ private:
+  const TargetMachineFeatures& target_machine_features_;
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_CPU_INT8_REWRITER_H_
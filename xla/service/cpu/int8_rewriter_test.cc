@@ -0,0 +1,254 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/int8_rewriter.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/hlo/utils/hlo_matchers.h"
+#include "xla/service/cpu/target_machine_features_fake.h"
+#include "xla/test.h"
+#include "xla/tests/hlo_test_base.h"
+#include "tsl/platform/statusor.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+namespace op = xla::testing::opcode_matchers;
+
+class FakeTargetMachineFeatures
+    : public TargetMachineFeaturesWithFakeAlignmentLogic {
+ public:
+  explicit FakeTargetMachineFeatures(bool has_avx512_vnni)
+      : TargetMachineFeaturesWithFakeAlignmentLogic([](int64_t size) {
+          return TargetMachineFeatures::kEigenExpectedTensorAlignment;
+        }),
+        has_avx512_vnni_(has_avx512_vnni) {}
+
+  bool has_avx512_vnni() const override { return has_avx512_vnni_; }
+
+ private:
+  bool has_avx512_vnni_;
+};
+
+class Int8RewriterTest : public HloTestBase {
+ protected:
+  StatusOr<bool> RunInt8Rewriter(HloModule* module,
+                                 bool has_avx512_vnni = true) {
+    FakeTargetMachineFeatures target_machine_features(has_avx512_vnni);
+    return Int8Rewriter(&target_machine_features).Run(module);
+  }
+};
+
+TEST_F(Int8RewriterTest, RewritesDot) {
+  const std::string hlo_string = R"(
+    HloModule Int8Dot
+    ENTRY e {
+      p0 = s8[64,128] parameter(0)
+      p1 = s8[128,32] parameter(1)
+      c0 = s32[64,128] convert(p0)
+      c1 = s32[128,32] convert(p1)
+      ROOT dot = s32[64,32] dot(c0, c1),
+        lhs_contracting_dims={1}, rhs_contracting_dims={0}
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunInt8Rewriter(m.get()));
+  EXPECT_TRUE(changed);
+  EXPECT_THAT(m->entry_computation()->root_instruction(),
+              op::Dot(op::Parameter(0), op::Parameter(1)));
+  EXPECT_EQ(m->entry_computation()->instruction_count(), 3);
+}
+
+TEST_F(Int8RewriterTest, RewritesConvolution) {
+  const std::string hlo_string = R"(
+    HloModule Int8Convolution
+    ENTRY e {
+      p0 = s8[4,16,16,32] parameter(0)
+      p1 = s8[3,3,32,64] parameter(1)
+      c0 = s32[4,16,16,32] convert(p0)
+      c1 = s32[3,3,32,64] convert(p1)
+      ROOT conv = s32[4,16,16,64] convolution(c0, c1),
+        window={size=3x3 pad=1_1x1_1}, dim_labels=b01f_01io->b01f
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunInt8Rewriter(m.get()));
+  EXPECT_TRUE(changed);
+  EXPECT_THAT(m->entry_computation()->root_instruction(),
+              op::Convolution(op::Parameter(0), op::Parameter(1)));
+}
+
+TEST_F(Int8RewriterTest, RewritesDotWithU8Lhs) {
+  const std::string hlo_string = R"(
+    HloModule Int8Dot
+    ENTRY e {
+      p0 = u8[64,128] parameter(0)
+      p1 = s8[128,32] parameter(1)
+      c0 = s32[64,128] convert(p0)
+      c1 = s32[128,32] convert(p1)
+      ROOT dot = s32[64,32] dot(c0, c1),
+        lhs_contracting_dims={1}, rhs_contracting_dims={0}
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunInt8Rewriter(m.get()));
+  EXPECT_TRUE(changed);
+  EXPECT_THAT(m->entry_computation()->root_instruction(),
+              op::Dot(op::Parameter(0), op::Parameter(1)));
+}
+
+TEST_F(Int8RewriterTest, SkipsDotWithU8Rhs) {
+  // Only the lhs becomes the unsigned operand of the VNNI instructions.
+  const std::string hlo_string = R"(
+    HloModule Int8Dot
+    ENTRY e {
+      p0 = s8[64,128] parameter(0)
+      p1 = u8[128,32] parameter(1)
+      c0 = s32[64,128] convert(p0)
+      c1 = s32[128,32] convert(p1)
+      ROOT dot = s32[64,32] dot(c0, c1),
+        lhs_contracting_dims={1}, rhs_contracting_dims={0}
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunInt8Rewriter(m.get()));
+  EXPECT_FALSE(changed);
+}
+
+TEST_F(Int8RewriterTest, RewritesConvolutionWithU8Input) {
+  const std::string hlo_string = R"(
+    HloModule Int8Convolution
+    ENTRY e {
+      p0 = u8[4,16,16,32] parameter(0)
+      p1 = s8[3,3,32,64] parameter(1)
+      c0 = s32[4,16,16,32] convert(p0)
+      c1 = s32[3,3,32,64] convert(p1)
+      ROOT conv = s32[4,16,16,64] convolution(c0, c1),
+        window={size=3x3 pad=1_1x1_1}, dim_labels=b01f_01io->b01f
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunInt8Rewriter(m.get()));
+  EXPECT_TRUE(changed);
+  EXPECT_THAT(m->entry_computation()->root_instruction(),
+              op::Convolution(op::Parameter(0), op::Parameter(1)));
+}
+
+TEST_F(Int8RewriterTest, KeepsConvertWithOtherUsers) {
+  const std::string hlo_string = R"(
+    HloModule Int8Dot
+    ENTRY e {
+      p0 = s8[64,128] parameter(0)
+      p1 = s8[128,32] parameter(1)
+      c0 = s32[64,128] convert(p0)
+      c1 = s32[128,32] convert(p1)
+      dot = s32[64,32] dot(c0, c1),
+        lhs_contracting_dims={1}, rhs_contracting_dims={0}
+      ROOT tuple = (s32[64,32], s32[64,128]) tuple(dot, c0)
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunInt8Rewriter(m.get()));
+  EXPECT_TRUE(changed);
+  EXPECT_THAT(m->entry_computation()->root_instruction(),
+              op::Tuple(op::Dot(op::Parameter(0), op::Parameter(1)),
+                        op::Convert(op::Parameter(0))));
+}
+
+TEST_F(Int8RewriterTest, SkipsTargetsWithoutVnni) {
+  const std::string hlo_string = R"(
+    HloModule Int8Dot
+    ENTRY e {
+      p0 = s8[64,128] parameter(0)
+      p1 = s8[128,32] parameter(1)
+      c0 = s32[64,128] convert(p0)
+      c1 = s32[128,32] convert(p1)
+      ROOT dot = s32[64,32] dot(c0, c1),
+        lhs_contracting_dims={1}, rhs_contracting_dims={0}
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed,
+                          RunInt8Rewriter(m.get(), /*has_avx512_vnni=*/false));
+  EXPECT_FALSE(changed);
+}
+
+TEST_F(Int8RewriterTest, SkipsMatrixVectorDot) {
+  // Matrix-vector products are emitted as LLVM IR, which accumulates in the
+  // operand type.
+  const std::string hlo_string = R"(
+    HloModule Int8Gemv
+    ENTRY e {
+      p0 = s8[64,128] parameter(0)
+      p1 = s8[128,1] parameter(1)
+      c0 = s32[64,128] convert(p0)
+      c1 = s32[128,1] convert(p1)
+      ROOT dot = s32[64,1] dot(c0, c1),
+        lhs_contracting_dims={1}, rhs_contracting_dims={0}
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunInt8Rewriter(m.get()));
+  EXPECT_FALSE(changed);
+  EXPECT_THAT(m->entry_computation()->root_instruction(),
+              op::Dot(op::Convert(), op::Convert()));
+  EXPECT_EQ(m->entry_computation()->instruction_count(), 5);
+}
+
+TEST_F(Int8RewriterTest, SkipsGroupedConvolution) {
+  const std::string hlo_string = R"(
+    HloModule Int8Convolution
+    ENTRY e {
+      p0 = s8[4,16,16,32] parameter(0)
+      p1 = s8[3,3,16,64] parameter(1)
+      c0 = s32[4,16,16,32] convert(p0)
+      c1 = s32[3,3,16,64] convert(p1)
+      ROOT conv = s32[4,16,16,64] convolution(c0, c1),
+        window={size=3x3 pad=1_1x1_1}, dim_labels=b01f_01io->b01f,
+        feature_group_count=2
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunInt8Rewriter(m.get()));
+  EXPECT_FALSE(changed);
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -15,11 +15,22 @@ limitations under the License.
 
 #include "xla/service/cpu/ir_emission_utils.h"
 
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "xla/hlo/ir/hlo_casting_utils.h"
+#include "xla/hlo/ir/hlo_instructions.h"
 #include "xla/hlo/ir/hlo_module.h"
 #include "xla/layout_util.h"
+#include "xla/primitive_util.h"
+#include "xla/service/collective_ops_utils.h"
 #include "xla/service/cpu/cpu_runtime.h"
+#include "xla/service/llvm_ir/dynamic_update_slice_util.h"
 #include "xla/shape_util.h"
 #include "xla/window_util.h"
+#include "tsl/platform/status.h"
 
 namespace xla {
 namespace cpu {
@@ -67,12 +78,19 @@ bool PotentiallyImplementedAsEigenConvolution(
       ShapeUtil::IsZeroElementArray(kernel_shape)) {
     return false;
   }
-  // Make sure input and kernel has the same data type.
-  CHECK(
-      ShapeUtil::SameElementTypeIgnoringFpPrecision(input_shape, kernel_shape));
   // TODO(b/65408531): Explore using Eigen dot for complex64 type.
   PrimitiveType primitive_type = input_shape.element_type();
-  if (primitive_type != F16 && primitive_type != F32) {
+  // The int8 runtime multiplies s8 kernels with s8 or u8 inputs.
+  const bool is_int8 = (primitive_type == S8 || primitive_type == U8) &&
+                       kernel_shape.element_type() == S8 &&
+                       output_shape.element_type() == S32;
+  // Make sure input and kernel has the same data type.
+  CHECK(is_int8 || ShapeUtil::SameElementTypeIgnoringFpPrecision(input_shape,
+                                                                 kernel_shape));
+  const bool is_bf16 =
+      primitive_type == BF16 && output_shape.element_type() == BF16;
+  if (primitive_type != F16 && primitive_type != F32 && !is_int8 &&
+      !is_bf16) {
     return false;
   }
   if (window_util::HasWindowReversal(convolution.window())) {
@@ -86,6 +104,18 @@ bool PotentiallyImplementedAsEigenConvolution(
   if (num_spatial_dims < 1 || num_spatial_dims > 3) {
     return false;
   }
+  // Convolutions of s8 values into s32 and of bf16 values are implemented by
+  // the multi-threaded int8 and bf16 runtimes, which only handle 1D and 2D
+  // convolutions without groups.
+  if ((is_int8 || is_bf16) &&
+      (num_spatial_dims > 2 || convolution.feature_group_count() != 1 ||
+       convolution.batch_group_count() != 1 ||
+       !convolution.GetModule()
+            ->config()
+            .debug_options()
+            .xla_cpu_multi_thread_eigen())) {
+    return false;
+  }
 
   for (int64_t i = 0; i < num_spatial_dims; ++i) {
     if (dnums.input_spatial_dimensions(i) != i + 1) {
@@ -110,5 +140,193 @@ bool PotentiallyImplementedAsEigenConvolution(
              kernel_shape.dimensions_size() - 1;
 }
 
+bool IsSupportedCollectiveReductionType(PrimitiveType type) {
+  switch (type) {
+    case PRED:
+    case S8:
+    case U8:
+    case S16:
+    case U16:
+    case S32:
+    case U32:
+    case S64:
+    case U64:
+    case F16:
+    case F32:
+    case F64:
+    case C64:
+    case C128:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool PotentiallyImplementedAsNativeCollective(const HloInstruction& instr) {
+  // Tuple-shaped (combined) collectives are left to the decomposers.
+  if (instr.operand_count() != 1 || !instr.shape().IsArray()) {
+    return false;
+  }
+  switch (instr.opcode()) {
+    case HloOpcode::kAllGather:
+      return true;
+    case HloOpcode::kReduceScatter:
+      return IsSupportedCollectiveReductionType(instr.shape().element_type()) &&
+             MatchReductionComputation(instr.to_apply()).has_value();
+    default:
+      return false;
+  }
+}
+
+std::optional<llvm::AtomicRMWInst::BinOp> ScatterCombinerAsAtomicRMW(
+    const HloInstruction& scatter) {
+  std::optional<ReductionKind> kind =
+      MatchReductionComputation(scatter.to_apply());
+  if (!kind.has_value()) {
+    return std::nullopt;
+  }
+  PrimitiveType type = scatter.shape().element_type();
+  bool is_signed = primitive_util::IsSignedIntegralType(type);
+  bool is_integral = primitive_util::IsIntegralType(type) &&
+                     primitive_util::BitWidth(type) >= 32;
+  // Atomic floating-point additions make the result depend on the order in
+  // which threads apply the updates, so they are opt-in.
+  const HloModule* module = scatter.GetModule();
+  bool float_atomics =
+      module != nullptr &&
+      module->config().debug_options().xla_cpu_enable_float_scatter_atomics();
+  switch (*kind) {
+    case ReductionKind::SUM:
+      if (is_integral) return llvm::AtomicRMWInst::Add;
+      if (float_atomics && (type == F32 || type == F64)) {
+        return llvm::AtomicRMWInst::FAdd;
+      }
+      return std::nullopt;
+    // Floating-point minimum and maximum differ from XLA's in the handling of
+    // NaNs.
+    case ReductionKind::MIN:
+      if (!is_integral) return std::nullopt;
+      return is_signed ? llvm::AtomicRMWInst::Min : llvm::AtomicRMWInst::UMin;
+    case ReductionKind::MAX:
+      if (!is_integral) return std::nullopt;
+      return is_signed ? llvm::AtomicRMWInst::Max : llvm::AtomicRMWInst::UMax;
+    default:
+      return std::nullopt;
+  }
+}
+
+bool CanEmitParallelScatter(const HloInstruction& scatter) {
+  const auto* instr = Cast<HloScatterInstruction>(&scatter);
+  if (instr->scatter_operand_count() != 1 || !scatter.shape().IsArray()) {
+    return false;
+  }
+  return instr->unique_indices() ||
+         ScatterCombinerAsAtomicRMW(scatter).has_value();
+}
+
+bool IsMultiOutputLoop(const HloInstruction& instruction) {
+  const Shape& shape = instruction.shape();
+  if (!shape.IsTuple() || shape.tuple_shapes().empty() ||
+      !(instruction.IsLoopFusion() ||
+        instruction.opcode() == HloOpcode::kReduce ||
+        instruction.opcode() == HloOpcode::kReduceWindow)) {
+    return false;
+  }
+  return absl::c_all_of(shape.tuple_shapes(), [&](const Shape& element) {
+    return element.IsArray() &&
+           ShapeUtil::EqualIgnoringElementType(element, shape.tuple_shapes(0));
+  });
+}
+
+std::optional<RuntimeTranspose> GetRuntimeTranspose(
+    const HloInstruction& instruction) {
+  // Smaller arrays fit in L1, where strided accesses are cheap enough that the
+  // call into the runtime doesn't pay off.
+  constexpr int64_t kMinRuntimeTransposeBytes = 32 * 1024;
+
+  if (instruction.opcode() != HloOpcode::kCopy &&
+      instruction.opcode() != HloOpcode::kTranspose) {
+    return std::nullopt;
+  }
+  const HloModule* module = instruction.GetModule();
+  if (module != nullptr &&
+      !module->config().debug_options().xla_cpu_use_runtime_transpose()) {
+    return std::nullopt;
+  }
+  const Shape& shape = instruction.shape();
+  const Shape& operand_shape = instruction.operand(0)->shape();
+  if (!LayoutUtil::IsDenseArray(shape) || shape.is_dynamic() ||
+      operand_shape.is_dynamic() || !shape.layout().tiles().empty() ||
+      !operand_shape.layout().tiles().empty() ||
+      ShapeUtil::ByteSizeOf(shape) < kMinRuntimeTransposeBytes) {
+    return std::nullopt;
+  }
+  RuntimeTranspose transpose;
+  transpose.element_size =
+      ShapeUtil::ByteSizeOfPrimitiveType(shape.element_type());
+  switch (transpose.element_size) {
+    case 1:
+    case 2:
+    case 4:
+    case 8:
+    case 16:
+      break;
+    default:
+      return std::nullopt;
+  }
+
+  const int64_t rank = shape.rank();
+  std::vector<int64_t> operand_position(rank);
+  for (int64_t i = 0; i < rank; ++i) {
+    const int64_t dim = operand_shape.layout().minor_to_major(rank - 1 - i);
+    operand_position[dim] = i;
+    transpose.dims.push_back(operand_shape.dimensions(dim));
+  }
+  // Without a permutation of the non-degenerate dimensions, this is a copy
+  // that the elemental loop vectorizes.
+  bool is_copy = true;
+  int64_t last_position = -1;
+  for (int64_t i = 0; i < rank; ++i) {
+    int64_t dim = shape.layout().minor_to_major(rank - 1 - i);
+    if (instruction.opcode() == HloOpcode::kTranspose) {
+      dim = instruction.dimensions(dim);
+    }
+    const int64_t position = operand_position[dim];
+    transpose.permutation.push_back(position);
+    if (transpose.dims[position] != 1) {
+      is_copy &= position > last_position;
+      last_position = position;
+    }
+  }
+  if (is_copy) {
+    return std::nullopt;
+  }
+  return transpose;
+}
+
+Shape GetParallelPartitionedShape(const HloInstruction& instruction) {
+  if (instruction.opcode() == HloOpcode::kScatter) {
+    return Cast<HloScatterInstruction>(&instruction)
+        ->scatter_updates()[0]
+        ->shape();
+  }
+  if (instruction.opcode() == HloOpcode::kDynamicUpdateSlice) {
+    return instruction.operand(1)->shape();
+  }
+  if (llvm_ir::MayBeImplementedAsInPlaceDynamicUpdateSlice(&instruction)) {
+    // Fused updates are iterated over in the layout of the fusion.
+    const HloInstruction* dynamic_update_slice =
+        instruction.fused_expression_root();
+    Shape update_shape = dynamic_update_slice->operand(1)->shape();
+    TF_CHECK_OK(LayoutUtil::CopyLayoutBetweenShapes(
+        dynamic_update_slice->shape(), &update_shape));
+    return update_shape;
+  }
+  if (IsMultiOutputLoop(instruction)) {
+    return instruction.shape().tuple_shapes(0);
+  }
+  return instruction.shape();
+}
+
 }  // namespace cpu
 }  // namespace xla
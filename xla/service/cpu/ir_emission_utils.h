@@ -16,6 +16,11 @@ limitations under the License.
 #ifndef XLA_SERVICE_CPU_IR_EMISSION_UTILS_H_
 #define XLA_SERVICE_CPU_IR_EMISSION_UTILS_H_
 
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "llvm/IR/Instructions.h"
 #include "llvm/IR/Value.h"
 #include "xla/hlo/ir/hlo_instruction.h"
 #include "xla/service/cpu/target_machine_features.h"
@@ -32,6 +37,56 @@ bool PotentiallyImplementedAsEigenConvolution(
 int64_t GetMinimumAlignmentForArray(
     const Shape& shape, const TargetMachineFeatures& target_machine_features);
 
+// Returns true if the CPU runtime can reduce elements of `type` in collectives
+// such as all-reduce and reduce-scatter.
+bool IsSupportedCollectiveReductionType(PrimitiveType type);
+
+// Returns true if `instr`, an all-gather or a reduce-scatter, can be emitted as
+// a single call into the CPU runtime instead of being decomposed into an
+// all-reduce.
+bool PotentiallyImplementedAsNativeCollective(const HloInstruction& instr);
+
+// Returns the atomic read-modify-write operation equivalent to the combiner of
+// `scatter`, if there is one. Floating-point additions are only applied
+// atomically if xla_cpu_enable_float_scatter_atomics is set.
+std::optional<llvm::AtomicRMWInst::BinOp> ScatterCombinerAsAtomicRMW(
+    const HloInstruction& scatter);
+
+// Returns true if the updates of `scatter`, a single-operand scatter, can be
+// applied by several threads at once: its indices are unique, or its combiner
+// can be applied atomically.
+bool CanEmitParallelScatter(const HloInstruction& scatter);
+
+// Returns true if `instruction` is tuple-shaped, and all elements of its tuple
+// are computed by a single loop over the same dimensions: a multi-output loop
+// fusion, or a variadic reduce or reduce-window, whose outputs all have the
+// same dimensions and layout.
+bool IsMultiOutputLoop(const HloInstruction& instruction);
+
+// Returns the shape whose outer-most dimensions are partitioned when
+// `instruction` is emitted as parallel tasks: the updates of scatters and of
+// dynamic-update-slices that may be emitted in place, which only write their
+// updates, and the shared iteration space of multi-output loops. For all other
+// instructions, their own shape.
+Shape GetParallelPartitionedShape(const HloInstruction& instruction);
+
+// The arguments with which the CPU runtime transposes the operand of a copy or
+// transpose into its result. Both arrays are in major-to-minor order: `dims`
+// are the dimensions of the operand, and dimension i of the result is
+// dimension `permutation[i]` of the operand.
+struct RuntimeTranspose {
+  int64_t element_size;
+  std::vector<int64_t> dims;
+  std::vector<int64_t> permutation;
+};
+
+// Returns the runtime transpose implementing `instruction`, if it is a large
+// copy or transpose that permutes the physical dimensions of its operand. The
+// runtime copies tiles that fit in cache with SIMD kernels, while the elemental
+// loop reads or writes one element per cache line.
+std::optional<RuntimeTranspose> GetRuntimeTranspose(
+    const HloInstruction& instruction);
+
 // Dynamic loop bounds are specified as an array of dimension index
 // [start, limit) pairs of ir values (one for each partitioned outer dimension).
 //
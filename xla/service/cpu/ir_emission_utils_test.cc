@@ -16,6 +16,7 @@ limitations under the License.
 #include "xla/service/cpu/ir_emission_utils.h"
 
 #include <memory>
+#include <optional>
 
 #include "xla/service/cpu/target_machine_features_fake.h"
 #include "xla/test.h"
@@ -52,5 +53,43 @@ ENTRY Conv {
       *conv_instr, target_machine_features));
 }
 
+TEST_F(IrEmitterTest, LayoutChangingCopyIsRuntimeTranspose) {
+  const char* const hlo_string = R"(
+HloModule ModuleWithCopy
+
+ENTRY Copy {
+  p0 = f32[8,64,32]{2,1,0} parameter(0)
+  ROOT copy = f32[8,64,32]{1,2,0} copy(p0)
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+
+  std::optional<cpu::RuntimeTranspose> transpose = cpu::GetRuntimeTranspose(
+      *module->entry_computation()->root_instruction());
+  ASSERT_TRUE(transpose.has_value());
+  EXPECT_EQ(transpose->element_size, 4);
+  EXPECT_THAT(transpose->dims, ::testing::ElementsAre(8, 64, 32));
+  EXPECT_THAT(transpose->permutation, ::testing::ElementsAre(0, 2, 1));
+}
+
+TEST_F(IrEmitterTest, DegenerateTransposeIsNotRuntimeTranspose) {
+  const char* const hlo_string = R"(
+HloModule ModuleWithTranspose
+
+ENTRY Transpose {
+  p0 = f32[1,128,1,128]{3,2,1,0} parameter(0)
+  ROOT transpose = f32[128,1,1,128]{3,2,1,0} transpose(p0),
+    dimensions={1,0,2,3}
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+
+  EXPECT_FALSE(cpu::GetRuntimeTranspose(
+                   *module->entry_computation()->root_instruction())
+                   .has_value());
+}
+
 }  // namespace
 }  // namespace xla
@@ -24,11 +24,13 @@ limitations under the License.
 #include <map>
 #include <memory>
 #include <numeric>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
 
 // IWYU pragma: no_include "llvm/IR/Intrinsics.gen.inc"
+#include "absl/algorithm/container.h"
 #include "absl/cleanup/cleanup.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
@@ -47,6 +49,7 @@ limitations under the License.
 #include "llvm/IR/IntrinsicsX86.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Value.h"
+#include "xla/comparison_util.h"
 #include "xla/hlo/ir/hlo_casting_utils.h"
 #include "xla/hlo/ir/hlo_instruction.h"
 #include "xla/hlo/ir/hlo_instructions.h"
@@ -65,6 +68,7 @@ limitations under the License.
 #include "xla/service/cpu/ir_emission_utils.h"
 #include "xla/service/cpu/ir_function.h"
 #include "xla/service/cpu/parallel_loop_emitter.h"
+#include "xla/service/cpu/task_graph_outliner.h"
 #include "xla/service/elemental_ir_emitter.h"
 #include "xla/service/llvm_ir/buffer_assignment_util.h"
 #include "xla/service/llvm_ir/dynamic_update_slice_util.h"
@@ -173,14 +177,8 @@ StatusOr<llvm::Function*> IrEmitter::EmitComputation(
   VLOG(2) << "Emitting IR for CPU function [" << function_name_prefix << "]";
   is_top_level_computation_ = is_top_level_computation;
   allow_reassociation_ = allow_reassociation;
-  num_dynamic_loop_bounds_ = 0;
-  auto backend_config_or =
-      computation->root_instruction()->backend_config<BackendConfig>();
-  if (backend_config_or.ok() &&
-      !backend_config_or->outer_dimension_partitions().empty()) {
-    num_dynamic_loop_bounds_ =
-        backend_config_or->outer_dimension_partitions().size();
-  }
+  num_dynamic_loop_bounds_ =
+      GetLoopPartitions(computation->root_instruction()).size();
 
   if (computation->root_instruction()->opcode() != HloOpcode::kOutfeed) {
     TF_ASSIGN_OR_RETURN(
@@ -212,7 +210,20 @@ StatusOr<llvm::Function*> IrEmitter::EmitComputation(
   flags.setAllowReassoc(flags.allowReassoc() || allow_reassociation);
   builder()->setFastMathFlags(flags);
 
+  // Tasks may not have written the tuples of a task graph when its
+  // get-tuple-elements are emitted, so those need buffers of their own.
+  emitting_task_graph_ =
+      is_top_level_computation && emit_task_graph_ &&
+      IsTaskGraph(*computation) &&
+      absl::c_all_of(computation->instructions(),
+                     [&](const HloInstruction* hlo) {
+                       return hlo->opcode() != HloOpcode::kGetTupleElement ||
+                              assignment_.GetUniqueTopLevelSlice(hlo).ok();
+                     });
   TF_RETURN_IF_ERROR(computation->AcceptOrdered(this, instruction_order));
+  emitting_task_graph_ = false;
+  tasks_.clear();
+  task_functions_.clear();
   llvm::Function* ir_function = compute_function_->function();
   InsertOrDie(&emitted_functions_,
               ComputationToEmit{computation, allow_reassociation}, ir_function);
@@ -314,13 +325,45 @@ Status IrEmitter::HandleCopy(HloInstruction* copy) {
     TF_RETURN_IF_ERROR(EmitTargetAddressForOp(copy));
     return EmitMemcpy(*(copy->operand(0)), *copy);
   } else if (copy->shape().IsArray()) {
-    // Use the elemental emitter for array shapes.
+    // Layout changes that permute large arrays are transposed by the runtime.
+    if (std::optional<RuntimeTranspose> transpose =
+            GetRuntimeTranspose(*copy)) {
+      return EmitRuntimeTranspose(*copy, *transpose);
+    }
+    // Use the elemental emitter for other array shapes.
     return DefaultAction(copy);
   }
   return Unimplemented("unsupported operand type %s for copy instruction",
                        PrimitiveType_Name(copy->shape().element_type()));
 }
 
+Status IrEmitter::HandleTranspose(HloInstruction* transpose) {
+  if (std::optional<RuntimeTranspose> runtime_transpose =
+          GetRuntimeTranspose(*transpose)) {
+    return EmitRuntimeTranspose(*transpose, *runtime_transpose);
+  }
+  return DefaultAction(transpose);
+}
+
+Status IrEmitter::EmitRuntimeTranspose(const HloInstruction& instr,
+                                       const RuntimeTranspose& transpose) {
+  VLOG(2) << "Transposing " << instr.name() << " in the runtime";
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(&instr));
+  auto* dims =
+      EmitGlobalForLiteral(LiteralUtil::CreateR1<int64_t>(transpose.dims));
+  auto* permutation = EmitGlobalForLiteral(
+      LiteralUtil::CreateR1<int64_t>(transpose.permutation));
+  EmitCallToFunc(runtime::kTransposeSymbolName,
+                 {GetExecutableRunOptionsArgument(), GetEmittedValueFor(&instr),
+                  GetEmittedValueFor(instr.operand(0)),
+                  b_.getInt64(transpose.element_size), dims, permutation,
+                  b_.getInt64(transpose.dims.size())},
+                 b_.getVoidTy(), /*does_not_throw=*/true,
+                 /*only_accesses_arg_memory=*/false,
+                 /*only_accesses_inaccessible_mem_or_arg_mem=*/true);
+  return OkStatus();
+}
+
 // Calculate the alignment of a buffer allocated for a given primitive type.
 int IrEmitter::MinimumAlignmentForPrimitiveType(PrimitiveType primitive_type) {
   int64_t byte_size = ShapeUtil::ByteSizeOfPrimitiveType(primitive_type);
@@ -384,6 +427,9 @@ Status IrEmitter::HandleGetTupleElement(HloInstruction* get_tuple_element) {
   // to the output buffer of its corresponding operand. A GetTupleElement
   // instruction forwards a pointer to the tuple element buffer at the given
   // index.
+  if (emitting_task_graph_) {
+    return EmitTargetAddressForOp(get_tuple_element);
+  }
   const HloInstruction* operand = get_tuple_element->operand(0);
   const Shape& shape = get_tuple_element->shape();
   emitted_value_[get_tuple_element] = llvm_ir::EmitGetTupleElement(
@@ -553,6 +599,50 @@ Status IrEmitter::HandleOutfeed(HloInstruction* outfeed) {
   return OkStatus();
 }
 
+namespace {
+
+// Returns the direction in which `sort` orders its keys if the runtime can sort
+// them without calling the comparator: `sort` has a single operand of an
+// integer or F32/F64 type, and its comparator applies the default comparison
+// of that type to its two parameters.
+std::optional<ComparisonDirection> PrimitiveSortDirection(
+    const HloSortInstruction& sort) {
+  PrimitiveType type = sort.keys()->shape().element_type();
+  if (sort.operand_count() != 1 ||
+      !(primitive_util::IsIntegralType(type) || type == F32 || type == F64) ||
+      primitive_util::BitWidth(type) < 8) {
+    return std::nullopt;
+  }
+  // Floats must be compared with the partial order of IEEE comparisons, not
+  // the total order.
+  const HloInstruction* root = sort.to_apply()->root_instruction();
+  if (root->opcode() != HloOpcode::kCompare ||
+      (primitive_util::IsFloatingPointType(type) &&
+       Cast<HloCompareInstruction>(root)->order() !=
+           ComparisonOrder::kPartial)) {
+    return std::nullopt;
+  }
+  const HloInstruction* lhs = root->operand(0);
+  const HloInstruction* rhs = root->operand(1);
+  if (lhs->opcode() != HloOpcode::kParameter ||
+      rhs->opcode() != HloOpcode::kParameter ||
+      lhs->parameter_number() == rhs->parameter_number()) {
+    return std::nullopt;
+  }
+  // compare(p1, p0), direction=LT is a greater-than comparator.
+  const bool swapped = lhs->parameter_number() == 1;
+  switch (root->comparison_direction()) {
+    case ComparisonDirection::kLt:
+      return swapped ? ComparisonDirection::kGt : ComparisonDirection::kLt;
+    case ComparisonDirection::kGt:
+      return swapped ? ComparisonDirection::kLt : ComparisonDirection::kGt;
+    default:
+      return std::nullopt;
+  }
+}
+
+}  // namespace
+
 Status IrEmitter::HandleSort(HloInstruction* hlo) {
   const HloSortInstruction* sort = Cast<HloSortInstruction>(hlo);
   TF_RETURN_IF_ERROR(EmitTargetAddressForOp(sort));
@@ -612,6 +702,21 @@ Status IrEmitter::HandleSort(HloInstruction* hlo) {
     lower_dimensions *= normalized_keys_shape.dimensions(i);
   }
 
+  if (std::optional<ComparisonDirection> direction =
+          PrimitiveSortDirection(*sort)) {
+    EmitCallToFunc(
+        runtime::kSortPrimitiveSymbolName,
+        {b_.getInt64(higher_dimensions), b_.getInt64(sort_dimension_elements),
+         b_.getInt64(lower_dimensions), destination_addresses[0],
+         b_.getInt32(ShapeUtil::ByteSizeOfPrimitiveType(keys_type)),
+         b_.getInt1(primitive_util::IsFloatingPointType(keys_type)),
+         b_.getInt1(primitive_util::IsSignedIntegralType(keys_type)),
+         b_.getInt1(*direction == ComparisonDirection::kGt),
+         b_.getInt1(sort->is_stable()), GetExecutableRunOptionsArgument()},
+        b_.getVoidTy());
+    return OkStatus();
+  }
+
   CHECK(absl::c_binary_search(thread_local_computations_, sort->to_apply()));
   llvm::Value* values = llvm_ir::EmitAllocaAtFunctionEntryWithCount(
       b_.getPtrTy(), b_.getInt32(sort->operand_count()), "cc_values_alloca",
@@ -864,10 +969,15 @@ Status IrEmitter::HandleSelectAndScatter(HloInstruction* select_and_scatter) {
 Status IrEmitter::HandleDot(HloInstruction* dot) {
   auto lhs = dot->operand(0);
   auto rhs = dot->operand(1);
+  // Int8Rewriter pairs u8 lhs with s8 rhs, which are only supported by the
+  // int8 runtime matmul.
+  const bool u8_lhs = lhs->shape().element_type() == U8 &&
+                      rhs->shape().element_type() == S8;
   TF_RETURN_IF_ERROR(ElementTypesSameAndSupported(
-      /*instruction=*/*dot, /*operands=*/{lhs, rhs},
+      /*instruction=*/*dot, /*operands=*/{u8_lhs ? rhs : lhs, rhs},
       /*supported_types=*/
-      {PRED, S8, U8, S16, U16, S32, U32, S64, U64, F16, F32, F64, C64, C128}));
+      {PRED, S8, U8, S16, U16, S32, U32, S64, U64, BF16, F16, F32, F64, C64,
+       C128}));
   const DotDimensionNumbers& dnums = dot->dot_dimension_numbers();
 
   if (dnums.lhs_contracting_dimensions_size() != 1) {
@@ -900,10 +1010,15 @@ Status IrEmitter::HandleDot(HloInstruction* dot) {
 Status IrEmitter::HandleConvolution(HloInstruction* convolution) {
   auto lhs = convolution->operand(0);
   auto rhs = convolution->operand(1);
+  // Int8Rewriter pairs u8 inputs with s8 kernels, which are only supported by
+  // the int8 runtime convolution below.
+  const bool u8_lhs = lhs->shape().element_type() == U8 &&
+                      rhs->shape().element_type() == S8;
   TF_RETURN_IF_ERROR(ElementTypesSameAndSupported(
-      /*instruction=*/*convolution, /*operands=*/{lhs, rhs},
+      /*instruction=*/*convolution, /*operands=*/{u8_lhs ? rhs : lhs, rhs},
       /*supported_types=*/
-      {PRED, S8, U8, S16, U16, S32, U32, S64, U64, F16, F32, F64, C64, C128}));
+      {PRED, S8, U8, S16, U16, S32, U32, S64, U64, BF16, F16, F32, F64, C64,
+       C128}));
 
   // TODO(tonywy): Add PotentiallyImplementedAsMKLConvolution to support
   // different data layouts.
@@ -1004,7 +1119,15 @@ Status IrEmitter::HandleConvolution(HloInstruction* convolution) {
       // TODO(b/78639006) Singlethread MKL conv2d is not implemented due to the
       // potential race condition by setting the omp_num_threads.
       const char* fn_name;
-      if (input_dims.size() == 2) {
+      if (primitive_type == S8 || primitive_type == U8) {
+        // See PotentiallyImplementedAsEigenConvolution.
+        TF_RET_CHECK(input_dims.size() == 2 && multi_threaded);
+        fn_name = primitive_type == U8 ? runtime::kInt8Conv2DU8SymbolName
+                                       : runtime::kInt8Conv2DSymbolName;
+      } else if (primitive_type == BF16) {
+        TF_RET_CHECK(input_dims.size() == 2 && multi_threaded);
+        fn_name = runtime::kBF16Conv2DSymbolName;
+      } else if (input_dims.size() == 2) {
         fn_name =
             primitive_type == F16
                 ? (multi_threaded
@@ -1073,6 +1196,11 @@ Status IrEmitter::HandleConvolution(HloInstruction* convolution) {
       return OkStatus();
     }
   }
+  // The elemental implementation can't do arithmetic on bf16 values.
+  if (lhs->shape().element_type() == BF16) {
+    return Unimplemented("Unsupported bf16 convolution %s",
+                         convolution->ToString());
+  }
   // This is a completely un-optimized version of convolution just to
   // have an early version that works. E.g. the input index and
   // padding calculation is not hoisted out of the inner loop.
@@ -1174,28 +1302,7 @@ Status IrEmitter::HandleAllReduceMultipleReplica(HloInstruction* crs) {
   PrimitiveType datatype = crs->operand(0)->shape().element_type();
   TF_RETURN_IF_ERROR(EmitTargetAddressForOp(crs));
 
-  bool is_datatype_supported = [&] {
-    // TODO(cheshire): Fix duplication wrt. cpu_runtime
-    switch (datatype) {
-      case PRED:
-      case S8:
-      case U8:
-      case S16:
-      case U16:
-      case S32:
-      case U32:
-      case S64:
-      case U64:
-      case F16:
-      case F32:
-      case F64:
-      case C64:
-      case C128:
-        return true;
-      default:
-        return false;
-    }
-  }();
+  bool is_datatype_supported = IsSupportedCollectiveReductionType(datatype);
 
   if (!is_datatype_supported) {
     return Unimplemented("AllReduce for datatype '%s' is not supported",
@@ -1270,8 +1377,10 @@ Status IrEmitter::HandleAllReduceMultipleReplica(HloInstruction* crs) {
        /*shape_length=*/b_.getInt32(shape_length),
        /*num_buffers=*/b_.getInt32(crs->operand_count()),
        /*input_buffers=*/input_buffers,
-       /*output_buffers=*/output_buffers},
+       /*output_buffers=*/output_buffers,
+       /*status=*/GetStatusArgument()},
       b_.getVoidTy());
+  EmitEarlyReturnIfErrorStatus();
 
   return OkStatus();
 }
@@ -1284,8 +1393,154 @@ Status IrEmitter::HandleAllReduce(HloInstruction* crs) {
   return HandleAllReduceMultipleReplica(crs);
 }
 
-Status IrEmitter::HandleReduceScatter(HloInstruction* rs) {
-  return Unimplemented("ReduceScatter is not implemented on CPU.");
+namespace {
+
+// Returns the number of elements in the dimensions of `shape` that are more
+// major than `dimension` in its layout.
+int64_t ElementsInMoreMajorDimensions(const Shape& shape, int64_t dimension) {
+  absl::Span<const int64_t> minor_to_major = shape.layout().minor_to_major();
+  auto it = absl::c_find(minor_to_major, dimension);
+  CHECK(it != minor_to_major.end());
+  int64_t elements = 1;
+  for (++it; it != minor_to_major.end(); ++it) {
+    elements *= shape.dimensions(*it);
+  }
+  return elements;
+}
+
+}  // namespace
+
+Status IrEmitter::HandleAllGather(HloInstruction* instruction) {
+  auto* instr = Cast<HloAllGatherInstruction>(instruction);
+  if (!PotentiallyImplementedAsNativeCollective(*instr)) {
+    return Unimplemented("AllGather %s is not supported on CPU.",
+                         instr->ToString());
+  }
+  const Shape& operand_shape = instr->operand(0)->shape();
+  if (!LayoutUtil::Equal(operand_shape.layout(), instr->shape().layout())) {
+    return Unimplemented(
+        "AllGather with different operand and result layouts is not "
+        "supported on CPU: %s",
+        instr->ToString());
+  }
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(instr));
+
+  // With a single participant all-gather is the identity.
+  if (hlo_module_config_.replica_count() == 1 &&
+      hlo_module_config_.num_partitions() == 1) {
+    return EmitMemcpy(*instr->operand(0), *instr);
+  }
+  // The result is empty as well. All participants have the same shapes, so
+  // they all skip the collective.
+  if (ShapeUtil::IsZeroElementArray(operand_shape)) {
+    return OkStatus();
+  }
+
+  std::string replica_groups = ReplicaGroupsToString(instr->replica_groups());
+  int32_t replica_groups_size = replica_groups.size();
+  llvm::Value* replica_groups_v = b_.CreateGlobalStringPtr(replica_groups);
+
+  TF_ASSIGN_OR_RETURN(BufferAllocation::Slice input_slice,
+                      assignment_.GetUniqueSlice(instr->operand(0), {}));
+  llvm::Value* input_buffer = EmitBufferPointer(input_slice, operand_shape);
+  TF_ASSIGN_OR_RETURN(BufferAllocation::Slice output_slice,
+                      assignment_.GetUniqueSlice(instr, {}));
+  llvm::Value* output_buffer = EmitBufferPointer(output_slice, instr->shape());
+
+  EmitCallToFunc(
+      runtime::kAllGatherSymbolName,
+      {/*run_options=*/GetExecutableRunOptionsArgument(),
+       /*replica_groups=*/replica_groups_v,
+       /*replica_groups_size=*/b_.getInt32(replica_groups_size),
+       /*channel_id_present=*/
+       b_.getInt32(static_cast<int32_t>(instr->channel_id().has_value())),
+       /*use_global_device_ids=*/
+       b_.getInt32(static_cast<int32_t>(instr->use_global_device_ids())),
+       /*op_id=*/
+       b_.getInt64(instr->channel_id().has_value()
+                       ? *instr->channel_id()
+                       : instr->GetModule()->unique_id()),
+       /*outer_count=*/
+       b_.getInt64(ElementsInMoreMajorDimensions(
+           operand_shape, instr->all_gather_dimension())),
+       /*buffer_size=*/b_.getInt64(ShapeUtil::ByteSizeOf(operand_shape)),
+       /*source_buffer=*/input_buffer,
+       /*destination_buffer=*/output_buffer,
+       /*status=*/GetStatusArgument()},
+      b_.getVoidTy());
+  EmitEarlyReturnIfErrorStatus();
+
+  return OkStatus();
+}
+
+Status IrEmitter::HandleReduceScatter(HloInstruction* instruction) {
+  auto* instr = Cast<HloReduceScatterInstruction>(instruction);
+  if (!PotentiallyImplementedAsNativeCollective(*instr)) {
+    return Unimplemented("ReduceScatter %s is not supported on CPU.",
+                         instr->ToString());
+  }
+  const Shape& operand_shape = instr->operand(0)->shape();
+  if (!LayoutUtil::Equal(operand_shape.layout(), instr->shape().layout())) {
+    return Unimplemented(
+        "ReduceScatter with different operand and result layouts is not "
+        "supported on CPU: %s",
+        instr->ToString());
+  }
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(instr));
+
+  // With a single participant reduce-scatter is the identity.
+  if (hlo_module_config_.replica_count() == 1 &&
+      hlo_module_config_.num_partitions() == 1) {
+    return EmitMemcpy(*instr->operand(0), *instr);
+  }
+  // The result is empty as well. All participants have the same shapes, so
+  // they all skip the collective.
+  if (ShapeUtil::IsZeroElementArray(operand_shape)) {
+    return OkStatus();
+  }
+
+  std::string replica_groups = ReplicaGroupsToString(instr->replica_groups());
+  int32_t replica_groups_size = replica_groups.size();
+  llvm::Value* replica_groups_v = b_.CreateGlobalStringPtr(replica_groups);
+
+  TF_ASSIGN_OR_RETURN(BufferAllocation::Slice input_slice,
+                      assignment_.GetUniqueSlice(instr->operand(0), {}));
+  llvm::Value* input_buffer = EmitBufferPointer(input_slice, operand_shape);
+  TF_ASSIGN_OR_RETURN(BufferAllocation::Slice output_slice,
+                      assignment_.GetUniqueSlice(instr, {}));
+  llvm::Value* output_buffer = EmitBufferPointer(output_slice, instr->shape());
+
+  int64_t outer_count =
+      ElementsInMoreMajorDimensions(instr->shape(), instr->scatter_dimension());
+  int64_t chunk_elements = ShapeUtil::ElementsIn(instr->shape()) / outer_count;
+
+  EmitCallToFunc(
+      runtime::kReduceScatterSymbolName,
+      {/*run_options=*/GetExecutableRunOptionsArgument(),
+       /*replica_groups=*/replica_groups_v,
+       /*replica_groups_size=*/b_.getInt32(replica_groups_size),
+       /*channel_id_present=*/
+       b_.getInt32(static_cast<int32_t>(instr->channel_id().has_value())),
+       /*use_global_device_ids=*/
+       b_.getInt32(static_cast<int32_t>(instr->use_global_device_ids())),
+       /*op_id=*/
+       b_.getInt64(instr->channel_id().has_value()
+                       ? *instr->channel_id()
+                       : instr->GetModule()->unique_id()),
+       /*reduction_kind=*/
+       b_.getInt32(
+           static_cast<int32_t>(*MatchReductionComputation(instr->to_apply()))),
+       /*element_type=*/
+       b_.getInt32(static_cast<int32_t>(instr->shape().element_type())),
+       /*outer_count=*/b_.getInt64(outer_count),
+       /*chunk_elements=*/b_.getInt64(chunk_elements),
+       /*input_buffer=*/input_buffer,
+       /*output_buffer=*/output_buffer,
+       /*status=*/GetStatusArgument()},
+      b_.getVoidTy());
+  EmitEarlyReturnIfErrorStatus();
+
+  return OkStatus();
 }
 
 Status IrEmitter::HandleAllToAll(HloInstruction* instruction) {
@@ -1337,8 +1592,10 @@ Status IrEmitter::HandleAllToAll(HloInstruction* instruction) {
                      /*buffer_size=*/b_.getInt64(buffer_size),
                      /*source_buffers=*/input_buffers,
                      /*destination_buffers=*/output_buffers,
+                     /*status=*/GetStatusArgument(),
                  },
                  b_.getVoidTy());
+  EmitEarlyReturnIfErrorStatus();
 
   llvm_ir::EmitTuple(GetIrArrayFor(instruction), output_buffer_ptrs, &b_);
   return OkStatus();
@@ -1375,8 +1632,10 @@ Status IrEmitter::HandleCollectivePermute(HloInstruction* crs) {
        /*input_buffer=*/input_buffer,
        /*output_buffer=*/output_buffer,
        /*source_target_pairs=*/source_target_pairs_v,
-       /*source_target_pairs_size=*/b_.getInt32(source_target_pairs.size())},
+       /*source_target_pairs_size=*/b_.getInt32(source_target_pairs.size()),
+       /*status=*/GetStatusArgument()},
       b_.getVoidTy());
+  EmitEarlyReturnIfErrorStatus();
 
   return OkStatus();
 }
@@ -1794,17 +2053,31 @@ StatusOr<bool> IrEmitter::EmitVectorizedReduce(
   //      output[d1, d0] = vector_acc
   //    }
   //  }
+  //
+  // When the reduction is split into parallel tasks, the loops over the
+  // outer-most dimensions of the result only run over the task's partition.
+  // If the partition includes the minor-most dimension, it is reduced in tiles
+  // of VS elements up to the last full tile, and one element at a time after.
+  DynamicLoopBounds dynamic_loop_bounds;
+  if (ShouldEmitParallelLoopFor(*reduce)) {
+    dynamic_loop_bounds = compute_function_->GetDynamicLoopBounds();
+  }
+  const int64_t num_dims = reduce->shape().dimensions_size();
 
   llvm_ir::ForLoopNest loop_nest(IrName(reduce), &b_);
-  std::vector<llvm::Value*> array_multi_index(
-      reduce->shape().dimensions_size());
-  for (int i = LayoutUtil::MinorToMajor(reduce->shape()).size() - 1; i > 0;
-       --i) {
+  std::vector<llvm::Value*> array_multi_index(num_dims);
+  for (int i = num_dims - 1; i > 0; --i) {
     int64_t dimension = LayoutUtil::Minor(reduce->shape().layout(), i);
-    int64_t start_index = 0;
-    int64_t end_index = reduce->shape().dimensions(dimension);
-    std::unique_ptr<llvm_ir::ForLoop> loop = loop_nest.AddLoop(
-        start_index, end_index, absl::StrFormat("dim.%d", dimension));
+    const int bounds_index = num_dims - 1 - i;
+    std::unique_ptr<llvm_ir::ForLoop> loop;
+    if (bounds_index < dynamic_loop_bounds.size()) {
+      loop = loop_nest.AddLoop(absl::StrFormat("dim.%d", dimension),
+                               dynamic_loop_bounds[bounds_index].first,
+                               dynamic_loop_bounds[bounds_index].second);
+    } else {
+      loop = loop_nest.AddLoop(0, reduce->shape().dimensions(dimension),
+                               absl::StrFormat("dim.%d", dimension));
+    }
     array_multi_index[dimension] = loop->GetIndVarValue();
   }
 
@@ -1819,19 +2092,13 @@ StatusOr<bool> IrEmitter::EmitVectorizedReduce(
 
   auto outermost_loop_exit_block = loop_nest.GetOuterLoopExitBasicBlock();
 
-  if (innermost_dimension_size >= vectorization_factor) {
-    int64_t start_index = 0;
-    int64_t end_index = (innermost_dimension_size / vectorization_factor) *
-                        vectorization_factor;
-    std::unique_ptr<llvm_ir::ForLoop> loop =
-        loop_nest.AddLoop(start_index, end_index, vectorization_factor,
-                          absl::StrFormat("dim.%d", innermost_dimension));
-    array_multi_index[innermost_dimension] = loop->GetIndVarValue();
-
-    SetToFirstInsertPoint(loop->GetBodyBasicBlock(), &b_);
-
-    ShardedVectorType vector_type = CreateShardedVectorType(
-        reduce->shape().element_type(), vectorization_factor);
+  // Reduces `num_elements` consecutive elements of the result, starting at
+  // `innermost_index` in the minor-most dimension, into vector accumulators.
+  auto emit_tile = [&](llvm::Value* innermost_index,
+                       int64_t num_elements) -> Status {
+    array_multi_index[innermost_dimension] = innermost_index;
+    ShardedVectorType vector_type =
+        CreateShardedVectorType(reduce->shape().element_type(), num_elements);
     llvm_ir::IrArray::Index array_index(array_multi_index, reduce->shape(),
                                         b_.getInt64Ty());
     TF_ASSIGN_OR_RETURN(std::vector<llvm::Value*> accumulator,
@@ -1844,44 +2111,73 @@ StatusOr<bool> IrEmitter::EmitVectorizedReduce(
         target_array.EmitArrayElementAddress(array_index, &b_);
     EmitShardedVectorStore(output_address, accumulator, element_alignment,
                            target_array);
+    return OkStatus();
+  };
 
-    if (auto exit_terminator = loop->GetExitBasicBlock()->getTerminator()) {
-      CHECK_GT(LayoutUtil::MinorToMajor(reduce->shape()).size(), 1);
+  // Continues emitting after `loop`, which is the inner-most loop of the nest
+  // if there are outer loops.
+  auto set_insert_point_after = [&](const llvm_ir::ForLoop& loop) {
+    if (auto exit_terminator = loop.GetExitBasicBlock()->getTerminator()) {
       b_.SetInsertPoint(exit_terminator);
     } else {
-      CHECK_EQ(LayoutUtil::MinorToMajor(reduce->shape()).size(), 1);
-      b_.SetInsertPoint(loop->GetExitBasicBlock());
+      b_.SetInsertPoint(loop.GetExitBasicBlock());
     }
-  }
-
-  // Since we increment the stride for the inner dimension by more than 1, we
-  // may need to peel out an "epilogue" iteration to get the remaining elements
-  // in the following case:
-  if (innermost_dimension_size % vectorization_factor) {
-    // TODO(b/63775531): Consider using a scalar loop here to save on code size.
-    array_multi_index[innermost_dimension] =
-        b_.getInt64(innermost_dimension_size -
-                    (innermost_dimension_size % vectorization_factor));
+  };
 
-    ShardedVectorType vector_type = CreateShardedVectorType(
-        reduce->shape().element_type(),
-        innermost_dimension_size % vectorization_factor);
-    llvm_ir::IrArray::Index array_index(array_multi_index, reduce->shape(),
-                                        b_.getInt64Ty());
-    llvm::IRBuilderBase::FastMathFlagGuard guard(b_);
-    llvm::FastMathFlags flags = b_.getFastMathFlags();
-    flags.setAllowReassoc(true);
-    b_.setFastMathFlags(flags);
-    TF_ASSIGN_OR_RETURN(std::vector<llvm::Value*> accumulator,
-                        EmitInnerLoopForVectorizedReduction(
-                            reduction_generator, array_index, vector_type,
-                            init_value, arg, dimensions, element_alignment));
+  if (dynamic_loop_bounds.size() == num_dims) {
+    llvm::Value* start_index = dynamic_loop_bounds.back().first;
+    llvm::Value* end_index = dynamic_loop_bounds.back().second;
+    llvm::Value* vectorization_factor_value =
+        b_.getInt64(vectorization_factor);
+    llvm::Value* tiled_end_index =
+        Add(start_index, Mul(UDiv(Sub(end_index, start_index),
+                                  vectorization_factor_value),
+                             vectorization_factor_value));
+    std::unique_ptr<llvm_ir::ForLoop> loop = loop_nest.AddLoop(
+        absl::StrFormat("dim.%d", innermost_dimension), start_index,
+        tiled_end_index, vectorization_factor_value);
+    SetToFirstInsertPoint(loop->GetBodyBasicBlock(), &b_);
+    TF_RETURN_IF_ERROR(
+        emit_tile(loop->GetIndVarValue(), vectorization_factor));
+    set_insert_point_after(*loop);
+
+    llvm_ir::ForLoopNest epilogue_loop_nest(IrName(reduce, "epilogue"), &b_);
+    std::unique_ptr<llvm_ir::ForLoop> epilogue_loop =
+        epilogue_loop_nest.AddLoop(
+            absl::StrFormat("dim.%d", innermost_dimension), tiled_end_index,
+            end_index);
+    SetToFirstInsertPoint(epilogue_loop->GetBodyBasicBlock(), &b_);
+    TF_RETURN_IF_ERROR(emit_tile(epilogue_loop->GetIndVarValue(), 1));
+    set_insert_point_after(*epilogue_loop);
+  } else {
+    if (innermost_dimension_size >= vectorization_factor) {
+      int64_t start_index = 0;
+      int64_t end_index = (innermost_dimension_size / vectorization_factor) *
+                          vectorization_factor;
+      std::unique_ptr<llvm_ir::ForLoop> loop =
+          loop_nest.AddLoop(start_index, end_index, vectorization_factor,
+                            absl::StrFormat("dim.%d", innermost_dimension));
+      SetToFirstInsertPoint(loop->GetBodyBasicBlock(), &b_);
+      TF_RETURN_IF_ERROR(
+          emit_tile(loop->GetIndVarValue(), vectorization_factor));
+      set_insert_point_after(*loop);
+    }
 
-    llvm_ir::IrArray target_array = GetIrArrayFor(reduce);
-    llvm::Value* output_address =
-        target_array.EmitArrayElementAddress(array_index, &b_);
-    EmitShardedVectorStore(output_address, accumulator, element_alignment,
-                           target_array);
+    // Since we increment the stride for the inner dimension by more than 1, we
+    // may need to peel out an "epilogue" iteration to get the remaining
+    // elements in the following case:
+    if (innermost_dimension_size % vectorization_factor) {
+      // TODO(b/63775531): Consider using a scalar loop here to save on code
+      // size.
+      llvm::IRBuilderBase::FastMathFlagGuard guard(b_);
+      llvm::FastMathFlags flags = b_.getFastMathFlags();
+      flags.setAllowReassoc(true);
+      b_.setFastMathFlags(flags);
+      TF_RETURN_IF_ERROR(emit_tile(
+          b_.getInt64(innermost_dimension_size -
+                      (innermost_dimension_size % vectorization_factor)),
+          innermost_dimension_size % vectorization_factor));
+    }
   }
 
   if (outermost_loop_exit_block) {
@@ -1930,8 +2226,206 @@ Status IrEmitter::HandleSendDone(HloInstruction* send_done) {
   return Unimplemented("Send-done is not implemented on CPU.");
 }
 
-Status IrEmitter::HandleScatter(HloInstruction*) {
-  return Unimplemented("Scatter is not implemented on CPUs.");
+Status IrEmitter::HandleScatter(HloInstruction* instruction) {
+  auto* scatter = Cast<HloScatterInstruction>(instruction);
+  // Variadic scatters are expanded into loops by CpuScatterExpander.
+  if (scatter->scatter_operand_count() != 1) {
+    return Unimplemented("Variadic scatter is not implemented on CPU.");
+  }
+  const HloInstruction* operand = scatter->scatter_operands()[0];
+  const HloInstruction* indices = scatter->scatter_indices();
+  const HloInstruction* updates = scatter->scatter_updates()[0];
+
+  // Updates are applied in place, so start from a copy of the operand unless
+  // it already lives in the output buffer.
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(scatter));
+  TF_ASSIGN_OR_RETURN(BufferAllocation::Slice operand_slice,
+                      assignment_.GetUniqueTopLevelSlice(operand));
+  TF_ASSIGN_OR_RETURN(BufferAllocation::Slice indices_slice,
+                      assignment_.GetUniqueTopLevelSlice(indices));
+  TF_ASSIGN_OR_RETURN(BufferAllocation::Slice updates_slice,
+                      assignment_.GetUniqueTopLevelSlice(updates));
+  TF_ASSIGN_OR_RETURN(BufferAllocation::Slice output_slice,
+                      assignment_.GetUniqueTopLevelSlice(scatter));
+  if (operand_slice != output_slice) {
+    TF_RETURN_IF_ERROR(EmitMemcpy(*operand, *scatter));
+  }
+
+  std::vector<int64_t> partitions;
+  auto backend_config_or = scatter->backend_config<BackendConfig>();
+  if (backend_config_or.ok()) {
+    partitions.assign(backend_config_or->outer_dimension_partitions().begin(),
+                      backend_config_or->outer_dimension_partitions().end());
+  }
+
+  // The parallel loop runs in a function of its own, which can only reach
+  // buffers through the buffer table. Updates that may collide and can't be
+  // applied atomically are applied in order.
+  if (!CanEmitParallelScatter(*scatter) ||
+      indices_slice.allocation()->is_thread_local() ||
+      updates_slice.allocation()->is_thread_local() ||
+      output_slice.allocation()->is_thread_local()) {
+    partitions.clear();
+  }
+
+  if (partitions.empty()) {
+    return EmitScatterLoop(*scatter, GetIrArrayFor(indices),
+                           GetIrArrayFor(updates), GetIrArrayFor(scatter),
+                           /*dynamic_loop_bounds=*/nullptr);
+  }
+
+  // Emit a function that applies the updates in the dynamic loop bounds it's
+  // called with. While it's being emitted, it replaces the compute function
+  // whose arguments the emitter reads buffers and run options from.
+  std::string function_name =
+      name_uniquer_.GetUniqueName(IrName(scatter, "parallel"));
+  std::unique_ptr<IrFunction> caller_function = std::move(compute_function_);
+  compute_function_ = std::make_unique<IrFunction>(
+      function_name, llvm::GlobalValue::InternalLinkage, hlo_module_config_,
+      module_, &b_, partitions.size());
+  auto get_array = [&](const HloInstruction* hlo,
+                       const BufferAllocation::Slice& slice) {
+    llvm_ir::IrArray array(EmitBufferPointer(slice, hlo->shape()),
+                           IrShapeType(hlo->shape()), hlo->shape());
+    AddAliasingInformationToIrArray(*hlo, &array);
+    return array;
+  };
+  DynamicLoopBounds dynamic_loop_bounds =
+      compute_function_->GetDynamicLoopBounds();
+  Status status = EmitScatterLoop(
+      *scatter, get_array(indices, indices_slice),
+      get_array(updates, updates_slice), get_array(scatter, output_slice),
+      &dynamic_loop_bounds);
+  llvm::Function* parallel_function = compute_function_->function();
+  // Finalizes the parallel function and restores the caller's insert point.
+  compute_function_ = std::move(caller_function);
+  TF_RETURN_IF_ERROR(status);
+
+  std::vector<llvm::Value*> call_args = GetArrayFunctionCallArguments(
+      {}, &b_, function_name,
+      /*return_value_buffer=*/GetEmittedValueFor(scatter),
+      /*exec_run_options_arg=*/GetExecutableRunOptionsArgument(),
+      /*buffer_table_arg=*/GetBufferTableArgument(),
+      /*status_arg=*/GetStatusArgument(),
+      /*profile_counters_arg=*/GetProfileCountersArgument());
+  TF_RETURN_IF_ERROR(EmitCallToParallelForkJoin(
+      call_args, updates->shape(), partitions, &b_, parallel_function,
+      function_name));
+  if (ComputationTransitivelyContainsCustomCall(scatter->to_apply())) {
+    EmitEarlyReturnIfErrorStatus();
+  }
+  return OkStatus();
+}
+
+Status IrEmitter::EmitScatterLoop(
+    const HloScatterInstruction& scatter, const llvm_ir::IrArray& indices,
+    const llvm_ir::IrArray& updates, const llvm_ir::IrArray& output,
+    const DynamicLoopBounds* dynamic_loop_bounds) {
+  const ScatterDimensionNumbers& dim_numbers =
+      scatter.scatter_dimension_numbers();
+  const Shape& operand_shape = output.GetShape();
+  const Shape& indices_shape = indices.GetShape();
+  const Shape& updates_shape = updates.GetShape();
+  const int64_t rank = operand_shape.rank();
+  const int64_t index_vector_dim = dim_numbers.index_vector_dim();
+  const bool has_index_vector_dim = index_vector_dim < indices_shape.rank();
+
+  // Partitions may update the same elements concurrently, unless the indices
+  // are unique.
+  std::optional<llvm::AtomicRMWInst::BinOp> atomic_op;
+  if (dynamic_loop_bounds != nullptr && !scatter.unique_indices()) {
+    atomic_op = ScatterCombinerAsAtomicRMW(scatter);
+    TF_RET_CHECK(atomic_op.has_value())
+        << "Parallel scatter needs unique indices or an atomic combiner: "
+        << scatter.ToString();
+  }
+
+  auto loop_body_emitter = [&](const llvm_ir::IrArray::Index& index) -> Status {
+    // Split the update index into the window index and the index of the
+    // scatter indices to apply it at.
+    std::vector<llvm::Value*> window_multidim;
+    std::vector<int64_t> window_bounds;
+    std::vector<llvm::Value*> indices_multidim;
+    for (int64_t i = 0, e = index.size(); i < e; ++i) {
+      if (absl::c_linear_search(dim_numbers.update_window_dims(), i)) {
+        window_multidim.push_back(index[i]);
+        window_bounds.push_back(updates_shape.dimensions(i));
+      } else {
+        indices_multidim.push_back(index[i]);
+      }
+    }
+
+    // Map the window index to the operand, with inserted_window_dims as
+    // trivial dimensions.
+    std::vector<llvm::Value*> operand_multidim;
+    std::vector<int64_t> operand_window_bounds;
+    for (int64_t i = 0, window_dim = 0; i < rank; ++i) {
+      if (absl::c_linear_search(dim_numbers.inserted_window_dims(), i)) {
+        operand_multidim.push_back(index.GetConstantWithIndexType(0));
+        operand_window_bounds.push_back(1);
+      } else {
+        operand_multidim.push_back(window_multidim[window_dim]);
+        operand_window_bounds.push_back(window_bounds[window_dim]);
+        ++window_dim;
+      }
+    }
+
+    // Offset the window by the scatter indices, and skip updates whose window
+    // doesn't fit in the operand.
+    if (has_index_vector_dim) {
+      indices_multidim.insert(indices_multidim.begin() + index_vector_dim,
+                              nullptr);
+    }
+    llvm::Value* is_in_bounds = b_.getTrue();
+    for (int64_t i = 0; i < dim_numbers.scatter_dims_to_operand_dims_size();
+         ++i) {
+      if (has_index_vector_dim) {
+        indices_multidim[index_vector_dim] = index.GetConstantWithIndexType(i);
+      }
+      llvm::Value* scatter_index = IntCast(
+          indices.EmitReadArrayElement(
+              llvm_ir::IrArray::Index(indices_multidim, indices_shape,
+                                      index.GetType()),
+              &b_),
+          index.GetType(),
+          /*isSigned=*/ShapeUtil::ElementIsSigned(indices_shape));
+      int64_t operand_dim = dim_numbers.scatter_dims_to_operand_dims(i);
+      operand_multidim[operand_dim] =
+          Add(operand_multidim[operand_dim], scatter_index);
+      // index >= 0 && index < dim - window + 1  <=>  index u< dim - window + 1
+      int64_t max_index = operand_shape.dimensions(operand_dim) -
+                          operand_window_bounds[operand_dim] + 1;
+      is_in_bounds = And(is_in_bounds,
+                         ICmpULT(scatter_index,
+                                 index.GetConstantWithIndexType(max_index)));
+    }
+
+    llvm_ir::LlvmIfData if_in_bounds = llvm_ir::EmitIfThenElse(
+        is_in_bounds, "scatter.in_bounds", &b_, /*emit_else=*/false);
+    llvm_ir::SetToFirstInsertPoint(if_in_bounds.true_block, &b_);
+    llvm_ir::IrArray::Index operand_index(operand_multidim, operand_shape,
+                                          index.GetType());
+    llvm::Value* update = updates.EmitReadArrayElement(index, &b_);
+    if (atomic_op.has_value()) {
+      AtomicRMW(*atomic_op, output.EmitArrayElementAddress(operand_index, &b_),
+                update, llvm::MaybeAlign(), llvm::AtomicOrdering::Monotonic);
+    } else {
+      llvm::Value* current = output.EmitReadArrayElement(operand_index, &b_);
+      llvm::Value* combined = EmitScalarReturningThreadLocalCall(
+          *scatter.to_apply(), {current, update}, "scatter_combiner");
+      output.EmitWriteArrayElement(operand_index, combined, &b_);
+    }
+    llvm_ir::SetToFirstInsertPoint(if_in_bounds.after_block, &b_);
+    return OkStatus();
+  };
+
+  if (dynamic_loop_bounds != nullptr) {
+    return ParallelLoopEmitter(loop_body_emitter, updates_shape,
+                               dynamic_loop_bounds, &b_)
+        .EmitLoop(IrName(&scatter));
+  }
+  return llvm_ir::LoopEmitter(loop_body_emitter, updates_shape, &b_)
+      .EmitLoop(IrName(&scatter));
 }
 
 Status IrEmitter::HandleSlice(HloInstruction* slice) {
@@ -2091,11 +2585,59 @@ Status IrEmitter::HandleDynamicUpdateSlice(
     auto operands = GetIrArraysForOperandsOf(dynamic_update_slice);
     return llvm_ir::EmitDynamicUpdateSliceInPlace(
         operands, GetIrArrayFor(dynamic_update_slice),
-        IrName(dynamic_update_slice, "in_place"), &b_);
+        IrName(dynamic_update_slice, "in_place"),
+        GetUpdateLoopEmitter(*dynamic_update_slice), &b_);
   }
   return DefaultAction(dynamic_update_slice);
 }
 
+std::vector<int64_t> IrEmitter::GetLoopPartitions(HloInstruction* root) {
+  auto backend_config_or = root->backend_config<BackendConfig>();
+  if (!backend_config_or.ok()) {
+    return {};
+  }
+  // Scatters are partitioned along their updates and parallelized by
+  // HandleScatter itself.
+  if (root->opcode() == HloOpcode::kScatter) {
+    return {};
+  }
+  // Partitions of a dynamic-update-slice were assigned over its update, which
+  // is all it writes only if it is emitted in place. Otherwise every partition
+  // would write the whole output, so it is emitted as a single sequential
+  // loop instead.
+  if ((root->opcode() == HloOpcode::kDynamicUpdateSlice &&
+       !llvm_ir::CanUpdateDynamicSliceInPlace(root, assignment_)) ||
+      (root->opcode() == HloOpcode::kFusion &&
+       llvm_ir::MayBeImplementedAsInPlaceDynamicUpdateSlice(root) &&
+       !llvm_ir::CanEmitFusedDynamicUpdateSliceInPlace(root, assignment_))) {
+    VLOG(2) << "Emitting " << root->name()
+            << " sequentially; it can't be updated in place.";
+    return {};
+  }
+  return {backend_config_or->outer_dimension_partitions().begin(),
+          backend_config_or->outer_dimension_partitions().end()};
+}
+
+llvm_ir::UpdateLoopEmitter IrEmitter::GetUpdateLoopEmitter(
+    const HloInstruction& op) {
+  if (!ShouldEmitParallelLoopFor(op)) {
+    return [this](const llvm_ir::BodyEmitter& body_emitter,
+                  const Shape& update_shape, absl::string_view name) {
+      return llvm_ir::LoopEmitter(body_emitter, update_shape, &b_)
+          .EmitLoop(name);
+    };
+  }
+  return [this](const llvm_ir::BodyEmitter& body_emitter,
+                const Shape& update_shape, absl::string_view name) {
+    // Each partition writes its part of the update.
+    DynamicLoopBounds dynamic_loop_bounds =
+        compute_function_->GetDynamicLoopBounds();
+    return ParallelLoopEmitter(body_emitter, update_shape,
+                               &dynamic_loop_bounds, &b_)
+        .EmitLoop(name);
+  };
+}
+
 Status IrEmitter::HandleRecv(HloInstruction* recv) {
   // TODO(b/33942983): Support Send/Recv on CPU.
   return Unimplemented("Recv is not implemented on CPU.");
@@ -2176,7 +2718,8 @@ Status IrEmitter::HandleFusion(HloInstruction* fusion) {
     TF_RETURN_IF_ERROR(EmitTargetAddressForOp(fusion));
     // Delegate to common implementation of fused in-place dynamic-update-slice.
     return llvm_ir::EmitFusedDynamicUpdateSliceInPlace(
-        fusion, GetIrArrayFor(fusion), &fused_emitter, &b_);
+        fusion, GetIrArrayFor(fusion), &fused_emitter,
+        GetUpdateLoopEmitter(*fusion), &b_);
   } else if (fusion->IsLoopFusion()) {
     VLOG(3) << "HandleFusion kLoop";
     CpuElementalIrEmitter elemental_emitter(hlo_module_config_, this, module_);
@@ -2221,16 +2764,21 @@ Status IrEmitter::HandleFusion(HloInstruction* fusion) {
 }
 
 Status IrEmitter::HandleCall(HloInstruction* call) {
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(call));
+  if (emitting_task_graph_) {
+    return EmitTask(call);
+  }
+  return EmitCallToComputation(call);
+}
+
+Status IrEmitter::EmitCallToComputation(HloInstruction* call) {
   HloComputation* computation = call->to_apply();
   llvm::Function* call_ir_function = FindOrDie(
       emitted_functions_, ComputationToEmit{computation, allow_reassociation_});
 
-  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(call));
-
-  auto backend_config_or =
-      computation->root_instruction()->backend_config<BackendConfig>();
-  if (backend_config_or.ok() &&
-      !backend_config_or->outer_dimension_partitions().empty()) {
+  HloInstruction* root = computation->root_instruction();
+  std::vector<int64_t> partitions = GetLoopPartitions(root);
+  if (!partitions.empty()) {
     // Having a nonempty set of 'outer_dimension_partitions' means that this
     // computation has been specially selected to be parallelized (one where the
     // root instruction is trivially parallelizable, like elementwise addition
@@ -2249,11 +2797,9 @@ Status IrEmitter::HandleCall(HloInstruction* call) {
     // The parallel fork/join runtime will call the generated function once for
     // each partition in parallel, using an appropriate set of loop bounds for
     // each call such that it only generates one partition of the output.
-    HloInstruction* root = computation->root_instruction();
     TF_RETURN_IF_ERROR(EmitCallToParallelForkJoin(
-        call_args, root->shape(),
-        backend_config_or->outer_dimension_partitions(), &b_, call_ir_function,
-        computation->name()));
+        call_args, GetParallelPartitionedShape(*root), partitions, &b_,
+        call_ir_function, computation->name()));
 
     if (ComputationTransitivelyContainsCustomCall(computation)) {
       EmitEarlyReturnIfErrorStatus();
@@ -2265,6 +2811,123 @@ Status IrEmitter::HandleCall(HloInstruction* call) {
   return OkStatus();
 }
 
+Status IrEmitter::EmitTask(HloInstruction* call) {
+  // While the task function is being emitted, it replaces the compute function
+  // whose arguments the emitter reads buffers and run options from.
+  std::string function_name =
+      name_uniquer_.GetUniqueName(IrName(call, "task"));
+  std::unique_ptr<IrFunction> caller_function = std::move(compute_function_);
+  llvm::Value* caller_address = emitted_value_[call];
+  compute_function_ = std::make_unique<IrFunction>(
+      function_name, llvm::GlobalValue::InternalLinkage, hlo_module_config_,
+      module_, &b_, /*num_dynamic_loop_bounds=*/0);
+  Status status = EmitTargetAddressForOp(call);
+  if (status.ok()) {
+    status = EmitCallToComputation(call);
+  }
+  llvm::Function* task_function = compute_function_->function();
+  // Finalizes the task function and restores the caller's insert point.
+  compute_function_ = std::move(caller_function);
+  emitted_value_[call] = caller_address;
+  TF_RETURN_IF_ERROR(status);
+
+  tasks_.push_back(call);
+  task_functions_.push_back(task_function);
+  return OkStatus();
+}
+
+Status IrEmitter::EmitTaskGraph(const HloComputation& computation) {
+  const int32_t num_tasks = tasks_.size();
+  absl::flat_hash_map<const HloInstruction*, int32_t> task_index;
+  for (int32_t i = 0; i < num_tasks; ++i) {
+    task_index[tasks_[i]] = i;
+  }
+
+  // A task depends on the nearest tasks it reaches through data and control
+  // dependencies, looking through the pass-through instructions between them.
+  std::vector<std::vector<int32_t>> successors(num_tasks);
+  std::vector<int32_t> num_predecessors(num_tasks);
+  for (int32_t i = 0; i < num_tasks; ++i) {
+    std::vector<int32_t> predecessors;
+    absl::flat_hash_set<const HloInstruction*> visited;
+    std::vector<const HloInstruction*> worklist;
+    auto add_dependencies = [&](const HloInstruction* hlo) {
+      for (const HloInstruction* operand : hlo->operands()) {
+        if (visited.insert(operand).second) worklist.push_back(operand);
+      }
+      for (const HloInstruction* predecessor : hlo->control_predecessors()) {
+        if (visited.insert(predecessor).second) worklist.push_back(predecessor);
+      }
+    };
+    add_dependencies(tasks_[i]);
+    while (!worklist.empty()) {
+      const HloInstruction* hlo = worklist.back();
+      worklist.pop_back();
+      auto it = task_index.find(hlo);
+      if (it != task_index.end()) {
+        predecessors.push_back(it->second);
+      } else {
+        TF_RET_CHECK(IsTaskGraphPassThrough(*hlo)) << hlo->ToString();
+        add_dependencies(hlo);
+      }
+    }
+    absl::c_sort(predecessors);
+    num_predecessors[i] = predecessors.size();
+    for (int32_t predecessor : predecessors) {
+      successors[predecessor].push_back(i);
+    }
+  }
+  std::vector<int32_t> successor_offsets = {0};
+  std::vector<int32_t> flat_successors;
+  for (const std::vector<int32_t>& task_successors : successors) {
+    flat_successors.insert(flat_successors.end(), task_successors.begin(),
+                           task_successors.end());
+    successor_offsets.push_back(flat_successors.size());
+  }
+
+  auto make_global = [&](llvm::Constant* initializer, absl::string_view name) {
+    auto* global = new llvm::GlobalVariable(
+        /*Module=*/*module_,
+        /*Type=*/initializer->getType(),
+        /*isConstant=*/true,
+        /*Linkage=*/llvm::GlobalValue::PrivateLinkage,
+        /*Initializer=*/initializer,
+        /*Name=*/absl::StrCat(computation.name(), "_", name));
+    global->setUnnamedAddr(llvm::GlobalVariable::UnnamedAddr::Global);
+    return global;
+  };
+  auto make_int32_global = [&](absl::Span<const int32_t> values,
+                               absl::string_view name) {
+    // Tasks without successors leave the array empty, which LLVM can't
+    // represent as data; pad it instead.
+    std::vector<int32_t> data(values.begin(), values.end());
+    if (data.empty()) data.push_back(0);
+    return make_global(
+        llvm::ConstantDataArray::get(module_->getContext(),
+                                     llvm::ArrayRef<int32_t>(data)),
+        name);
+  };
+  llvm::Constant* functions = make_global(
+      llvm::ConstantArray::get(
+          llvm::ArrayType::get(b_.getPtrTy(), num_tasks), task_functions_),
+      "task_functions");
+
+  VLOG(2) << "Emitting a task graph of " << num_tasks << " tasks for "
+          << computation.name();
+  EmitCallToFunc(runtime::kExecuteTaskGraphSymbolName,
+                 {GetExecutableRunOptionsArgument(), GetBufferTableArgument(),
+                  GetStatusArgument(), GetProfileCountersArgument(),
+                  b_.getInt32(num_tasks), functions,
+                  make_int32_global(num_predecessors, "num_predecessors"),
+                  make_int32_global(successor_offsets, "successor_offsets"),
+                  make_int32_global(flat_successors, "successors")},
+                 b_.getVoidTy());
+  if (ComputationTransitivelyContainsCustomCall(&computation)) {
+    EmitEarlyReturnIfErrorStatus();
+  }
+  return OkStatus();
+}
+
 Status IrEmitter::HandleSliceToDynamic(HloInstruction* hlo) {
   TF_RETURN_IF_ERROR(EmitTargetAddressForOp(hlo));
   std::vector<llvm::Value*> dynamic_dims;
@@ -2378,7 +3041,31 @@ Status IrEmitter::HandleTopK(HloInstruction* hlo) {
   const HloInstruction* input = hlo->operand(0);
   const int64_t k = hlo->shape().tuple_shapes(0).dimensions().back();
   const bool has_batch = hlo->shape().tuple_shapes(0).dimensions_size() == 2;
-  TF_RET_CHECK(input->shape().element_type() == F32);
+  const char* symbol_name;
+  switch (input->shape().element_type()) {
+    case F32:
+      symbol_name = runtime::kTopKF32SymbolName;
+      break;
+    case F64:
+      symbol_name = runtime::kTopKF64SymbolName;
+      break;
+    case BF16:
+      symbol_name = runtime::kTopKBF16SymbolName;
+      break;
+    case F16:
+      symbol_name = runtime::kTopKF16SymbolName;
+      break;
+    case S32:
+      symbol_name = runtime::kTopKS32SymbolName;
+      break;
+    case U32:
+      symbol_name = runtime::kTopKU32SymbolName;
+      break;
+    default:
+      return Unimplemented(
+          "Element type %s not supported in the TopK op on CPU.",
+          PrimitiveType_Name(input->shape().element_type()));
+  }
   TF_RET_CHECK(LayoutUtil::IsMonotonicWithDim0Major(
       hlo->shape().tuple_shapes(0).layout()));
   TF_RET_CHECK(LayoutUtil::IsMonotonicWithDim0Major(
@@ -2398,10 +3085,11 @@ Status IrEmitter::HandleTopK(HloInstruction* hlo) {
       EmitBufferPointer(out_values_slice, hlo->shape().tuple_shapes(0));
   llvm::Value* out_indices_ptr =
       EmitBufferPointer(out_indices_slice, hlo->shape().tuple_shapes(1));
-  EmitCallToFunc(runtime::kTopKF32SymbolName,
+  EmitCallToFunc(symbol_name,
                  {b_.getInt64(has_batch ? input->shape().dimensions(0) : 1),
                   b_.getInt64(input->shape().dimensions().back()),
-                  b_.getInt64(k), values_ptr, out_values_ptr, out_indices_ptr},
+                  b_.getInt64(k), values_ptr, out_values_ptr, out_indices_ptr,
+                  GetExecutableRunOptionsArgument()},
                  b_.getVoidTy());
 
   llvm_ir::EmitTuple(GetIrArrayFor(hlo), {out_values_ptr, out_indices_ptr},
@@ -2411,17 +3099,28 @@ Status IrEmitter::HandleTopK(HloInstruction* hlo) {
 
 #if defined(INTEL_MKL) && defined(ENABLE_ONEDNN_V3)
 Status IrEmitter::HandleOneDnnMatMul(HloInstruction* custom_call) {
-  auto lhs = custom_call->operand(0);
-  llvm_ir::IrArray lhs_array(GetIrArrayFor(lhs));
-  auto lhs_stack_alloca = GetAllocaAndEmitMemrefInfo(b_, lhs_array);
-
-  auto rhs = custom_call->operand(1);
-  llvm_ir::IrArray rhs_array(GetIrArrayFor(rhs));
-  auto rhs_stack_alloca = GetAllocaAndEmitMemrefInfo(b_, rhs_array);
-
-  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(custom_call));
-  llvm_ir::IrArray result_array = GetIrArrayFor(custom_call);
-  auto result_stack_alloca = GetAllocaAndEmitMemrefInfo(b_, result_array);
+  // args[0]: pointer to the number of args
+  // args[1]: ExecutableRunOptions
+  // args[2]: serialized OneDnnMatMulConfig
+  // args[3...]: MemrefInfo of the operands
+  constexpr int kNumArgsBeforeOperands = 3;
+  const int num_operands = custom_call->operand_count();
+  const int num_args = kNumArgsBeforeOperands + num_operands;
+  int arg_index = 0;
+
+  llvm::Type* i64_type = b_.getInt64Ty();
+  llvm::Type* ptr_type = b_.getPtrTy();
+  llvm::ArrayType* ptr_array_type = llvm::ArrayType::get(ptr_type, num_args);
+  llvm::Value* args_val = llvm::UndefValue::get(ptr_array_type);
+
+  llvm::Value* num_args_ptr =
+      llvm_ir::EmitAllocaAtFunctionEntry(i64_type, "num_args", &b_);
+  b_.CreateLifetimeStart(num_args_ptr, b_.getInt64(-1));
+  b_.CreateStore(b_.getInt64(num_args), num_args_ptr);
+  args_val = b_.CreateInsertValue(args_val, num_args_ptr, arg_index++);
+
+  args_val = b_.CreateInsertValue(args_val, GetExecutableRunOptionsArgument(),
+                                  arg_index++);
 
   auto typed_custom_call = Cast<HloCustomCallInstruction>(custom_call);
   auto backend_config = typed_custom_call->backend_config<BackendConfig>();
@@ -2429,19 +3128,37 @@ Status IrEmitter::HandleOneDnnMatMul(HloInstruction* custom_call) {
   matmul_config.CopyFrom(backend_config->onednn_matmul_config());
   std::string str_config;
   matmul_config.SerializeToString(&str_config);
+  args_val = b_.CreateInsertValue(
+      args_val, b_.CreateGlobalStringPtr(llvm_ir::AsStringRef(str_config)),
+      arg_index++);
+
+  std::vector<StackAlloca> operand_stack_allocas;
+  operand_stack_allocas.reserve(num_operands);
+  for (const HloInstruction* operand : custom_call->operands()) {
+    llvm_ir::IrArray operand_array(GetIrArrayFor(operand));
+    operand_stack_allocas.push_back(
+        GetAllocaAndEmitMemrefInfo(b_, operand_array));
+    args_val = b_.CreateInsertValue(
+        args_val, operand_stack_allocas.back().value, arg_index++);
+  }
+
+  llvm::Value* args_ptr =
+      llvm_ir::EmitAllocaAtFunctionEntry(ptr_array_type, "matmul.args", &b_);
+  b_.CreateLifetimeStart(args_ptr, b_.getInt64(-1));
+  b_.CreateStore(args_val, args_ptr);
+
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(custom_call));
+  llvm_ir::IrArray result_array = GetIrArrayFor(custom_call);
+  auto result_stack_alloca = GetAllocaAndEmitMemrefInfo(b_, result_array);
 
   EmitCallToFunc(runtime::kOneDnnMatMulSymbolName,
-                 {
-                     GetExecutableRunOptionsArgument(),
-                     lhs_stack_alloca.value,
-                     rhs_stack_alloca.value,
-                     result_stack_alloca.value,
-                     b_.CreateGlobalStringPtr(llvm_ir::AsStringRef(str_config)),
-                 },
-                 b_.getVoidTy());
+                 {result_stack_alloca.value, args_ptr}, b_.getVoidTy());
 
-  lhs_stack_alloca.EmitLifetimeEnd();
-  rhs_stack_alloca.EmitLifetimeEnd();
+  b_.CreateLifetimeEnd(num_args_ptr, b_.getInt64(-1));
+  for (StackAlloca& stack_alloca : operand_stack_allocas) {
+    stack_alloca.EmitLifetimeEnd();
+  }
+  b_.CreateLifetimeEnd(args_ptr, b_.getInt64(-1));
   result_stack_alloca.EmitLifetimeEnd();
 
   return OkStatus();
@@ -2991,6 +3708,10 @@ Status IrEmitter::FinishVisit(HloInstruction* root) {
     }
   };
 
+  if (emitting_task_graph_) {
+    TF_RETURN_IF_ERROR(EmitTaskGraph(*root->parent()));
+  }
+
   // For the entry computation this increment is cumulative of embedded
   // computations since it includes cycles spent in computations invoked by
   // While, Call etc.
@@ -3347,7 +4068,6 @@ Status IrEmitter::EmitTargetElementLoop(
        target_op->opcode() == HloOpcode::kReduce ||
        target_op->opcode() == HloOpcode::kReduceWindow)) {
     // For multiple outputs fusion, we need to emit each operand and the root.
-    TF_RET_CHECK(num_dynamic_loop_bounds_ == 0);
     std::vector<llvm_ir::IrArray> output_arrays;
     for (int64_t i = 0; i < ShapeUtil::TupleElementCount(target_shape); ++i) {
       TF_ASSIGN_OR_RETURN(BufferAllocation::Slice slice,
@@ -3358,10 +4078,22 @@ Status IrEmitter::EmitTargetElementLoop(
       output_arrays.push_back(
           llvm_ir::IrArray(op_target_address, op_target_type, element_shape));
     }
-    TF_RETURN_IF_ERROR(
-        llvm_ir::LoopEmitter(element_generator, output_arrays, &b_)
-            .EmitLoop(IrName(target_op)));
+    if (ShouldEmitParallelLoopFor(*target_op)) {
+      // All outputs are computed by the same loop, whose iteration space is
+      // partitioned like the first output.
+      TF_RET_CHECK(IsMultiOutputLoop(*target_op));
+      std::vector<std::pair<llvm::Value*, llvm::Value*>> dynamic_loop_bounds =
+          compute_function_->GetDynamicLoopBounds();
+      TF_RETURN_IF_ERROR(ParallelLoopEmitter(element_generator, output_arrays,
+                                             &dynamic_loop_bounds, &b_)
+                             .EmitLoop(IrName(target_op)));
+    } else {
+      TF_RETURN_IF_ERROR(
+          llvm_ir::LoopEmitter(element_generator, output_arrays, &b_)
+              .EmitLoop(IrName(target_op)));
+    }
 
+    // Partitions of a parallel loop all write the same tuple of pointers.
     std::vector<llvm::Value*> tuple_operand_ptrs;
     for (int64_t i = 0; i < output_arrays.size(); ++i) {
       tuple_operand_ptrs.push_back(output_arrays[i].GetBasePointer());
@@ -37,11 +37,14 @@ limitations under the License.
 #include "mlir/IR/MLIRContext.h"  // from @llvm-project
 #include "xla/hlo/ir/dfs_hlo_visitor_with_default.h"
 #include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instructions.h"
 #include "xla/service/buffer_assignment.h"
+#include "xla/service/cpu/ir_emission_utils.h"
 #include "xla/service/cpu/ir_function.h"
 #include "xla/service/cpu/target_machine_features.h"
 #include "xla/service/hlo_module_config.h"
 #include "xla/service/llvm_ir/alias_analysis.h"
+#include "xla/service/llvm_ir/dynamic_update_slice_util.h"
 #include "xla/service/llvm_ir/fused_ir_emitter.h"
 #include "xla/service/llvm_ir/ir_array.h"
 #include "xla/service/llvm_ir/ir_builder_mixin.h"
@@ -126,6 +129,14 @@ class IrEmitter : public DfsHloVisitorWithDefault,
   // Emit an LLVM global variable for every constant buffer allocation.
   Status EmitConstantGlobals();
 
+  // If set, an entry computation that is a task graph (see
+  // TaskGraphOutliner) is emitted as a call to the runtime, which runs its
+  // calls concurrently as their dependencies allow. The buffer assignment
+  // must not share buffers between calls that don't depend on each other.
+  void set_emit_task_graph(bool emit_task_graph) {
+    emit_task_graph_ = emit_task_graph;
+  }
+
  protected:
   //
   // The following methods implement the DfsHloVisitor interface.
@@ -135,6 +146,7 @@ class IrEmitter : public DfsHloVisitorWithDefault,
   Status DefaultAction(HloInstruction* hlo) override;
 
   Status HandleAllToAll(HloInstruction* instruction) override;
+  Status HandleAllGather(HloInstruction* instruction) override;
   Status HandleBitcast(HloInstruction* bitcast) override;
   Status HandleConstant(HloInstruction* constant) override;
   Status HandleCopy(HloInstruction* copy) override;
@@ -144,7 +156,7 @@ class IrEmitter : public DfsHloVisitorWithDefault,
   Status HandleConvolution(HloInstruction* convolution) override;
   Status HandleFft(HloInstruction* fft) override;
   Status HandleAllReduce(HloInstruction* crs) override;
-  Status HandleReduceScatter(HloInstruction* crs) override;
+  Status HandleReduceScatter(HloInstruction* instruction) override;
   Status HandleCollectivePermute(HloInstruction* crs) override;
   Status HandleInfeed(HloInstruction* instruction) override;
   Status HandleOutfeed(HloInstruction* outfeed) override;
@@ -168,6 +180,7 @@ class IrEmitter : public DfsHloVisitorWithDefault,
   Status HandleCustomCall(HloInstruction* custom_call) override;
   Status HandleWhile(HloInstruction* xla_while) override;
   Status HandleConcatenate(HloInstruction* concatenate) override;
+  Status HandleTranspose(HloInstruction* transpose) override;
   Status HandleConditional(HloInstruction* conditional) override;
   Status HandleScatter(HloInstruction* scatter) override;
   Status HandleAfterAll(HloInstruction* after_all) override;
@@ -334,12 +347,39 @@ class IrEmitter : public DfsHloVisitorWithDefault,
       HloInstruction* target_op, absl::string_view desc,
       const llvm_ir::ElementGenerator& element_generator);
 
+  // Emits a loop over the updates of `scatter` that combines each of them into
+  // `output`, which must already hold the scatter operand. If
+  // `dynamic_loop_bounds` is set, only the updates in the given outer
+  // dimension bounds are applied, concurrently with other partitions.
+  Status EmitScatterLoop(const HloScatterInstruction& scatter,
+                         const llvm_ir::IrArray& indices,
+                         const llvm_ir::IrArray& updates,
+                         const llvm_ir::IrArray& output,
+                         const DynamicLoopBounds* dynamic_loop_bounds);
+
+  // Emits the call of `call` to its computation, after the address of its
+  // output has been emitted.
+  Status EmitCallToComputation(HloInstruction* call);
+
+  // Emits `call` as a task of the task graph of the entry computation: a
+  // function of its own that only reaches buffers through the buffer table.
+  Status EmitTask(HloInstruction* call);
+
+  // Emits a call to the runtime that runs the tasks of `computation` emitted
+  // by EmitTask, each once the tasks it depends on have finished.
+  Status EmitTaskGraph(const HloComputation& computation);
+
   // Emits a memcpy from the source instruction's result value to the
   // destination's.  Both source and destination must have an entry in the
   // emitted_value_ table.
   Status EmitMemcpy(const HloInstruction& source,
                     const HloInstruction& destination);
 
+  // Emits a call to the runtime transposing the operand of `instr` into its
+  // result.
+  Status EmitRuntimeTranspose(const HloInstruction& instr,
+                              const RuntimeTranspose& transpose);
+
   // Emits IR to compute the target address of the buffer for the given op.
   // After calling this function, you can get a pointer to this buffer by
   // calling GetIrArrayForOp or GetEmittedValueFor.
@@ -552,6 +592,16 @@ class IrEmitter : public DfsHloVisitorWithDefault,
            op.parent()->root_instruction() == &op;
   }
 
+  // Returns the outer dimension partitions the computation rooted at `root`
+  // is emitted with, or an empty vector if it is emitted as a sequential loop
+  // (or, for scatter, parallelized by HandleScatter itself).
+  std::vector<int64_t> GetLoopPartitions(HloInstruction* root);
+
+  // Returns the emitter of the loop over the update of the in-place
+  // dynamic-update-slice `op`, which is a parallel loop over the partitions of
+  // the update if `op` should be emitted as a parallel loop.
+  llvm_ir::UpdateLoopEmitter GetUpdateLoopEmitter(const HloInstruction& op);
+
   // This struct contains all the state needed to emit instructions for
   // profiling a computation.
   class ProfilingState {
@@ -676,6 +726,14 @@ class IrEmitter : public DfsHloVisitorWithDefault,
 
   bool emit_code_for_msan_;
 
+  bool emit_task_graph_ = false;
+
+  // Whether the computation being emitted is emitted as a task graph, and the
+  // tasks and task functions emitted for it so far.
+  bool emitting_task_graph_ = false;
+  std::vector<const HloInstruction*> tasks_;
+  std::vector<llvm::Constant*> task_functions_;
+
   IrEmitter(const IrEmitter&) = delete;
   IrEmitter& operator=(const IrEmitter&) = delete;
 };
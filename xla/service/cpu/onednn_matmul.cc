@@ -19,13 +19,22 @@ limitations under the License.
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <initializer_list>
+#include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #define EIGEN_USE_THREADS
 
 #include "dnnl.hpp"
 #include "absl/base/dynamic_annotations.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/synchronization/mutex.h"
 #include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
 #include "xla/executable_run_options.h"
 #include "xla/service/cpu/backend_config.pb.h"
@@ -36,22 +45,80 @@ limitations under the License.
 namespace xla {
 namespace cpu {
 namespace {
+using dnnl::algorithm;
 using dnnl::engine;
 using dnnl::matmul;
 using dnnl::memory;
 using dnnl::stream;
+
+// Primitives are bound to the engine they are created for, so all of them are
+// created for the same engine.
+const engine& CpuEngine() {
+  static const engine* cpu_engine = new engine(engine::kind::cpu, 0);
+  return *cpu_engine;
+}
+
+// Creating a matmul primitive JIT-compiles its kernel, which takes longer than
+// running it on small matrices. Primitives can be executed concurrently, so
+// they are created once per distinct config and operand layouts, and reused
+// across executions.
+class MatMulPrimitiveCache {
+ public:
+  // Bounds the memory held by the cache. Programs with that many distinct
+  // matmuls are rare, so the cache is simply cleared when it is full.
+  static constexpr int64_t kMaxSize = 1024;
+
+  static MatMulPrimitiveCache& Global() {
+    static auto* cache = new MatMulPrimitiveCache();
+    return *cache;
+  }
+
+  template <typename CreateFn>
+  matmul GetOrCreate(const std::string& key, CreateFn&& create) {
+    {
+      absl::MutexLock lock(&mu_);
+      auto it = primitives_.find(key);
+      if (it != primitives_.end()) return it->second;
+    }
+    // Created without holding the lock, so that other matmuls aren't blocked
+    // on it. Concurrent misses on the same key create equivalent primitives.
+    matmul primitive = create();
+    absl::MutexLock lock(&mu_);
+    if (primitives_.size() >= kMaxSize) primitives_.clear();
+    return primitives_.try_emplace(key, std::move(primitive)).first->second;
+  }
+
+ private:
+  absl::Mutex mu_;
+  absl::flat_hash_map<std::string, matmul> primitives_ ABSL_GUARDED_BY(mu_);
+};
+
+void AppendToKey(const memory::desc& md, std::string* key) {
+  absl::StrAppend(key, "|", static_cast<int>(md.get_data_type()), ":",
+                  absl::StrJoin(md.get_dims(), ","), ":",
+                  absl::StrJoin(md.get_strides(), ","));
+}
+
+// Returns 'md', with dimensions of size 1 prepended up to rank 'rank'.
+memory::desc ExpandToRank(const memory::desc& md, int rank) {
+  memory::dims dims = md.get_dims();
+  dims.insert(dims.begin(), rank - dims.size(), 1);
+  return md.reshape(dims);
+}
+
 }  // namespace
 
 ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_OneDnnMatMul(
-    const void* run_options_ptr, void* lhs, void* rhs, void* result,
-    void* config) {
+    void* result, void** args) {
+  int arg_index = 0;
+  const int64_t num_args = *static_cast<int64_t*>(args[arg_index++]);
   const xla::ExecutableRunOptions* run_options =
-      static_cast<const xla::ExecutableRunOptions*>(run_options_ptr);
+      static_cast<const xla::ExecutableRunOptions*>(args[arg_index++]);
   XLA_LIGHTWEIGHT_CHECK(run_options != nullptr);
   XLA_LIGHTWEIGHT_CHECK(run_options->intra_op_thread_pool() != nullptr);
   tsl::OneDnnThreadPool thread_pool(
       run_options->intra_op_thread_pool()->getPool(), false);
-  engine cpu_engine(engine::kind::cpu, 0);
+  const engine& cpu_engine = CpuEngine();
 #ifndef ENABLE_ONEDNN_OPENMP
   auto onednn_stream =
       stream(dnnl::threadpool_interop::make_stream(cpu_engine, &thread_pool));
@@ -59,35 +126,82 @@ ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_OneDnnMatMul(
   auto onednn_stream = stream(cpu_engine);
 #endif  // ENABLE_ONEDNN_OPENMP
 
-  MemrefInfo lhs_minfo(lhs);
-  MemrefInfo rhs_minfo(rhs);
-  MemrefInfo result_minfo(result);
-
-  std::string config_str(static_cast<const char*>(config));
+  std::string config_str(static_cast<const char*>(args[arg_index++]));
   OneDnnMatMulConfig matmul_config;
   matmul_config.ParseFromString(config_str);
 
-  // Currently, no fusion is supported.
-  XLA_LIGHTWEIGHT_CHECK(matmul_config.fused_ops().empty());
+  MemrefInfo lhs_minfo(args[arg_index++]);
+  MemrefInfo rhs_minfo(args[arg_index++]);
+  MemrefInfo result_minfo(result);
 
   auto src_md = lhs_minfo.GetOneDnnMemDesc();
   auto weights_md = rhs_minfo.GetOneDnnMemDesc();
   auto dst_md = result_minfo.GetOneDnnMemDesc();
+  const int rank = dst_md.get_ndims();
 
-  auto src_mem = memory(src_md, cpu_engine, lhs_minfo.Data());
-  auto weights_mem = memory(weights_md, cpu_engine, rhs_minfo.Data());
-  auto dst_mem = memory(dst_md, cpu_engine, result_minfo.Data());
-
-  auto matmul_pd =
-      matmul::primitive_desc(cpu_engine, src_md, weights_md, dst_md);
-
-  auto matmul_prim = matmul(matmul_pd);
+  std::string key = config_str;
+  AppendToKey(src_md, &key);
+  AppendToKey(weights_md, &key);
+  AppendToKey(dst_md, &key);
 
   std::unordered_map<int, memory> matmul_args;
-  matmul_args.insert({DNNL_ARG_SRC, src_mem});
-  matmul_args.insert({DNNL_ARG_WEIGHTS, weights_mem});
-  matmul_args.insert({DNNL_ARG_DST, dst_mem});
-
+  matmul_args.insert({DNNL_ARG_SRC, memory(src_md, cpu_engine,
+                                           lhs_minfo.Data())});
+  matmul_args.insert({DNNL_ARG_WEIGHTS, memory(weights_md, cpu_engine,
+                                               rhs_minfo.Data())});
+  matmul_args.insert({DNNL_ARG_DST, memory(dst_md, cpu_engine,
+                                           result_minfo.Data())});
+
+  // The bias is a matmul argument, the other fused ops are post-ops applied
+  // in order.
+  memory::desc bias_md;
+  dnnl::post_ops post_ops;
+  for (int fused_op : matmul_config.fused_ops()) {
+    switch (fused_op) {
+      case OneDnnMatMulConfig::BIAS: {
+        XLA_LIGHTWEIGHT_CHECK(arg_index < num_args);
+        MemrefInfo bias_minfo(args[arg_index++]);
+        bias_md = ExpandToRank(bias_minfo.GetOneDnnMemDesc(), rank);
+        AppendToKey(bias_md, &key);
+        matmul_args.insert(
+            {DNNL_ARG_BIAS, memory(bias_md, cpu_engine, bias_minfo.Data())});
+        break;
+      }
+      case OneDnnMatMulConfig::RELU:
+        post_ops.append_eltwise(algorithm::eltwise_relu, 0.f, 0.f);
+        break;
+      case OneDnnMatMulConfig::TANH:
+        post_ops.append_eltwise(algorithm::eltwise_tanh, 0.f, 0.f);
+        break;
+      case OneDnnMatMulConfig::GELU_ERF:
+        post_ops.append_eltwise(algorithm::eltwise_gelu_erf, 0.f, 0.f);
+        break;
+      case OneDnnMatMulConfig::GELU_TANH:
+        post_ops.append_eltwise(algorithm::eltwise_gelu_tanh, 0.f, 0.f);
+        break;
+      case OneDnnMatMulConfig::BINARY_ADD: {
+        XLA_LIGHTWEIGHT_CHECK(arg_index < num_args);
+        MemrefInfo addend_minfo(args[arg_index++]);
+        auto addend_md = addend_minfo.GetOneDnnMemDesc();
+        AppendToKey(addend_md, &key);
+        matmul_args.insert(
+            {DNNL_ARG_ATTR_MULTIPLE_POST_OP(post_ops.len()) | DNNL_ARG_SRC_1,
+             memory(addend_md, cpu_engine, addend_minfo.Data())});
+        post_ops.append_binary(algorithm::binary_add, addend_md);
+        break;
+      }
+      default:
+        XLA_LIGHTWEIGHT_CHECK(false);
+    }
+  }
+  XLA_LIGHTWEIGHT_CHECK(arg_index == num_args);
+
+  matmul matmul_prim = MatMulPrimitiveCache::Global().GetOrCreate(key, [&] {
+    dnnl::primitive_attr attrs;
+    attrs.set_post_ops(post_ops);
+    return matmul(matmul::primitive_desc(cpu_engine, src_md, weights_md,
+                                         bias_md, dst_md, attrs));
+  });
   matmul_prim.execute(onednn_stream, matmul_args);
 }
 
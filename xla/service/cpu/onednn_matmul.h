@@ -21,19 +21,13 @@ namespace xla {
 namespace cpu {
 
 extern "C" {
-// TODO(intel-tf): Change the function signature as
-//    void onednn_matmul(void* result, void** args)
-// where
-//        args[0]: num_args (>=3, including itself)
-//        args[1]: ExecutableRunOption
-//        args[2]: OneDnnMatMulConfig
-//        args[3...]: Actual Operands
-// so that it can take variable number of arguments.
-//
-// For now, we are using a fixed number of arguments.
-extern void __xla_cpu_runtime_OneDnnMatMul(const void* run_options_ptr,
-                                           void* lhs, void* rhs, void* result,
-                                           void* config);
+// 'args' are
+//   args[0]: pointer to the number of args (>= 5, including itself)
+//   args[1]: ExecutableRunOptions
+//   args[2]: serialized OneDnnMatMulConfig
+//   args[3...]: MemrefInfo of the lhs, the rhs and the operands of the fused
+//               ops, in the order of the fused ops of the config
+extern void __xla_cpu_runtime_OneDnnMatMul(void* result, void** args);
 }  // extern "C"
 
 }  // namespace cpu
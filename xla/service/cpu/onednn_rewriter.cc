@@ -17,11 +17,20 @@ limitations under the License.
 
 #include "xla/service/cpu/onednn_rewriter.h"
 
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/strings/string_view.h"
 #include "xla/hlo/ir/dfs_hlo_visitor_with_default.h"
 #include "xla/hlo/ir/hlo_instruction.h"
 #include "xla/service/cpu/backend_config.pb.h"
 #include "xla/service/cpu/onednn_memory_util.h"
 #include "xla/service/pattern_matcher.h"
+#include "xla/shape_util.h"
 #include "xla/status_macros.h"
 #include "tsl/platform/cpu_info.h"
 
@@ -60,6 +69,36 @@ bool IsSupportedType(xla::PrimitiveType dtype) {
   return false;
 }
 
+constexpr absl::string_view kOneDnnMatMulTarget = "__onednn$matmul";
+
+bool IsOneDnnMatMul(const HloInstruction* instr) {
+  return instr->opcode() == HloOpcode::kCustomCall &&
+         instr->custom_call_target() == kOneDnnMatMulTarget;
+}
+
+// Returns whether 'instr' is a scalar constant, or a broadcast of one, whose
+// value is within 0.1% of 'value'.
+bool IsScalarConstantNear(const HloInstruction* instr, double value) {
+  if (instr->opcode() == HloOpcode::kBroadcast) {
+    instr = instr->operand(0);
+  }
+  if (instr->opcode() != HloOpcode::kConstant ||
+      !ShapeUtil::IsEffectiveScalar(instr->shape())) {
+    return false;
+  }
+  std::optional<double> actual =
+      instr->literal().GetAsDouble(std::vector<int64_t>(instr->shape().rank()));
+  return actual.has_value() &&
+         std::abs(*actual - value) <= 1e-3 * std::abs(value);
+}
+
+// Matches a scalar constant or a broadcast of one.
+auto ScalarConstant(HloInstruction** constant) {
+  return m::AnyOf<HloInstruction>(
+      m::Broadcast(m::ConstantEffectiveScalar(constant)),
+      m::ConstantEffectiveScalar(constant));
+}
+
 }  // namespace
 
 class OneDnnRewriterVisitor : public DfsHloRewriteVisitor {
@@ -122,14 +161,144 @@ class OneDnnRewriterVisitor : public DfsHloRewriteVisitor {
         dot_instr->AddInstruction(HloInstruction::CreateCustomCall(
             output_shape,
             {dot_instr->mutable_operand(0), dot_instr->mutable_operand(1)},
-            "__onednn$matmul"));
-    // Set additional info via config, e.g., fusion info.
+            kOneDnnMatMulTarget));
+    // Epilogues are added to the config as they are fused.
     BackendConfig backend_config;
-    // No fusion is supported now, so nothing to add to the config.
     TF_RETURN_IF_ERROR(matmul_call->set_backend_config(backend_config));
     TF_RETURN_IF_ERROR(ReplaceInstruction(dot_instr, matmul_call));
     return OkStatus();
   }
+
+  // Fuses 'matmul + broadcast(bias)' as a bias, and 'matmul + addend' as a
+  // binary add post-op.
+  Status HandleAdd(HloInstruction* instr) override {
+    for (int64_t i = 0; i < 2; ++i) {
+      HloInstruction* matmul = instr->mutable_operand(i);
+      HloInstruction* addend = instr->mutable_operand(1 - i);
+      if (!CanFuseEpilogue(matmul) || addend == matmul) continue;
+      // oneDNN adds the bias before any post-op, so a bias can only be fused
+      // into a matmul without epilogues.
+      HloInstruction* bias;
+      if (!HasFusedOps(matmul) &&
+          Match(addend, m::Broadcast(m::Op(&bias))) &&
+          bias->shape().rank() == 1 &&
+          addend->dimensions() ==
+              std::vector<int64_t>{instr->shape().rank() - 1}) {
+        return FuseEpilogue(instr, matmul, OneDnnMatMulConfig::BIAS, bias);
+      }
+      return FuseEpilogue(instr, matmul, OneDnnMatMulConfig::BINARY_ADD,
+                          addend);
+    }
+    return OkStatus();
+  }
+
+  // Fuses 'max(matmul, 0)' as a ReLU.
+  Status HandleMaximum(HloInstruction* instr) override {
+    HloInstruction *matmul, *zero;
+    if (!Match(instr,
+               m::MaximumAnyOrder(m::Op(&matmul), ScalarConstant(&zero))) ||
+        !CanFuseEpilogue(matmul) || !IsScalarConstantNear(zero, 0.0)) {
+      return OkStatus();
+    }
+    return FuseEpilogue(instr, matmul, OneDnnMatMulConfig::RELU);
+  }
+
+  // Fuses 'tanh(matmul)'.
+  Status HandleTanh(HloInstruction* instr) override {
+    HloInstruction* matmul = instr->mutable_operand(0);
+    if (!CanFuseEpilogue(matmul)) return OkStatus();
+    return FuseEpilogue(instr, matmul, OneDnnMatMulConfig::TANH);
+  }
+
+  // Fuses the tanh approximation of GELU of the matmul,
+  //
+  //   x * (0.5 * (1 + tanh(sqrt(2 / pi) * (x + 0.044715 * x^3)))),
+  //
+  // as emitted by jax.nn.gelu.
+  Status HandleMultiply(HloInstruction* instr) override {
+    for (HloInstruction* matmul : instr->operands()) {
+      if (!IsOneDnnMatMul(matmul) || matmul->HasControlDependencies()) {
+        continue;
+      }
+      auto x = m::Op().Is(matmul);
+      HloInstruction *half, *one, *sqrt_2_over_pi, *coeff;
+      std::vector<HloInstruction*> intermediates(8);
+      auto pattern = m::MultiplyAnyOrder(
+          x,
+          m::MultiplyAnyOrder(
+              &intermediates[0], ScalarConstant(&half),
+              m::AddAnyOrder(
+                  &intermediates[1], ScalarConstant(&one),
+                  m::Tanh(
+                      &intermediates[2],
+                      m::MultiplyAnyOrder(
+                          &intermediates[3], ScalarConstant(&sqrt_2_over_pi),
+                          m::AddAnyOrder(
+                              &intermediates[4], x,
+                              m::MultiplyAnyOrder(
+                                  &intermediates[7], ScalarConstant(&coeff),
+                                  m::MultiplyAnyOrder(
+                                      &intermediates[5], x,
+                                      m::MultiplyAnyOrder(&intermediates[6],
+                                                          x, x)))))))));
+      if (!Match(instr, pattern) || !IsScalarConstantNear(half, 0.5) ||
+          !IsScalarConstantNear(one, 1.0) ||
+          !IsScalarConstantNear(sqrt_2_over_pi, std::sqrt(2.0 / M_PI)) ||
+          !IsScalarConstantNear(coeff, 0.044715)) {
+        continue;
+      }
+      // The matmul and the GELU must not be used elsewhere, otherwise the
+      // matmul would be computed twice.
+      const bool only_used_by_gelu = absl::c_all_of(
+          matmul->users(), [&](const HloInstruction* user) {
+            return user == instr || absl::c_linear_search(intermediates, user);
+          });
+      const bool intermediates_used_once =
+          absl::c_all_of(intermediates, [](const HloInstruction* i) {
+            return i->user_count() == 1;
+          });
+      if (!only_used_by_gelu || !intermediates_used_once) continue;
+      return FuseEpilogue(instr, matmul, OneDnnMatMulConfig::GELU_TANH);
+    }
+    return OkStatus();
+  }
+
+ private:
+  static bool HasFusedOps(const HloInstruction* matmul) {
+    auto backend_config = matmul->backend_config<BackendConfig>();
+    return !backend_config.ok() ||
+           backend_config->onednn_matmul_config().fused_ops_size() > 0;
+  }
+
+  // An epilogue can be fused into a oneDNN matmul that it is the only user of.
+  static bool CanFuseEpilogue(const HloInstruction* matmul) {
+    return IsOneDnnMatMul(matmul) && matmul->user_count() == 1 &&
+           !matmul->HasControlDependencies();
+  }
+
+  // Replaces 'epilogue' with a copy of 'matmul' that also applies 'kind',
+  // with 'operand' as an additional operand if it isn't null.
+  Status FuseEpilogue(HloInstruction* epilogue, HloInstruction* matmul,
+                      OneDnnMatMulConfig::FusionKind kind,
+                      HloInstruction* operand = nullptr) {
+    if (epilogue->HasControlDependencies() ||
+        epilogue->shape().element_type() != matmul->shape().element_type()) {
+      return OkStatus();
+    }
+    std::vector<HloInstruction*> operands(matmul->operands().begin(),
+                                          matmul->operands().end());
+    if (operand != nullptr) {
+      operands.push_back(operand);
+    }
+    HloInstruction* fused_matmul =
+        matmul->AddInstruction(HloInstruction::CreateCustomCall(
+            matmul->shape(), operands, kOneDnnMatMulTarget));
+    TF_ASSIGN_OR_RETURN(BackendConfig backend_config,
+                        matmul->backend_config<BackendConfig>());
+    backend_config.mutable_onednn_matmul_config()->add_fused_ops(kind);
+    TF_RETURN_IF_ERROR(fused_matmul->set_backend_config(backend_config));
+    return ReplaceInstruction(epilogue, fused_matmul);
+  }
 };
 
 StatusOr<bool> OneDnnRewriter::Run(
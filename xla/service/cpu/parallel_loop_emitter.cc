@@ -29,6 +29,19 @@ ParallelLoopEmitter::ParallelLoopEmitter(
     : LoopEmitter(target_element_generator, target_array, b),
       dynamic_loop_bounds_(dynamic_loop_bounds) {}
 
+ParallelLoopEmitter::ParallelLoopEmitter(
+    const llvm_ir::ElementGenerator& target_element_generator,
+    absl::Span<const llvm_ir::IrArray> target_arrays,
+    const DynamicLoopBounds* dynamic_loop_bounds, llvm::IRBuilder<>* b)
+    : LoopEmitter(target_element_generator, target_arrays, b),
+      dynamic_loop_bounds_(dynamic_loop_bounds) {}
+
+ParallelLoopEmitter::ParallelLoopEmitter(
+    const llvm_ir::BodyEmitter& body_emitter, const Shape& shape,
+    const DynamicLoopBounds* dynamic_loop_bounds, llvm::IRBuilder<>* b)
+    : LoopEmitter(body_emitter, shape, b),
+      dynamic_loop_bounds_(dynamic_loop_bounds) {}
+
 std::vector<llvm_ir::IrArray::Index>
 ParallelLoopEmitter::EmitIndexAndSetExitBasicBlock(absl::string_view loop_name,
                                                    llvm::Type* index_type,
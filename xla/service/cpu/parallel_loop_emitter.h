@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef XLA_SERVICE_CPU_PARALLEL_LOOP_EMITTER_H_
 #define XLA_SERVICE_CPU_PARALLEL_LOOP_EMITTER_H_
 
+#include "absl/types/span.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Value.h"
 #include "xla/service/cpu/ir_emission_utils.h"
@@ -56,6 +57,22 @@ class ParallelLoopEmitter : public llvm_ir::LoopEmitter {
                       const DynamicLoopBounds* dynamic_loop_bounds,
                       llvm::IRBuilder<>* b);
 
+  // Constructs a ParallelLoopEmitter for a multi-output loop, which writes the
+  // elements of the struct generated by 'target_element_generator' to
+  // 'target_arrays'. All target arrays must have the same dimensions.
+  ParallelLoopEmitter(const llvm_ir::ElementGenerator& target_element_generator,
+                      absl::Span<const llvm_ir::IrArray> target_arrays,
+                      const DynamicLoopBounds* dynamic_loop_bounds,
+                      llvm::IRBuilder<>* b);
+
+  // Constructs a ParallelLoopEmitter which calls 'body_emitter' on every index
+  // of 'shape', with the loop bounds of the most-major dimensions set by
+  // 'dynamic_loop_bounds'.
+  ParallelLoopEmitter(const llvm_ir::BodyEmitter& body_emitter,
+                      const Shape& shape,
+                      const DynamicLoopBounds* dynamic_loop_bounds,
+                      llvm::IRBuilder<>* b);
+
   ParallelLoopEmitter(const ParallelLoopEmitter&) = delete;
   ParallelLoopEmitter& operator=(const ParallelLoopEmitter&) = delete;
   ~ParallelLoopEmitter() override = default;
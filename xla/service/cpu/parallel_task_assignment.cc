@@ -19,10 +19,12 @@ limitations under the License.
 #include <cmath>
 #include <cstdint>
 #include <memory>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
@@ -34,17 +36,34 @@ limitations under the License.
 #include "xla/service/cpu/shape_partition.h"
 #include "xla/service/cpu/target_machine_features.h"
 #include "xla/service/hlo_cost_analysis.h"
-#include "xla/service/llvm_ir/dynamic_update_slice_util.h"
+#include "xla/shape.h"
 #include "xla/status.h"
 #include "xla/statusor.h"
 #include "xla/util.h"
 #include "tsl/platform/cpu_info.h"
 #include "tsl/platform/logging.h"  // IWYU pragma: keep
 #include "tsl/platform/status.h"
+#include "tsl/profiler/protobuf/profiled_instructions.pb.h"
 
 namespace xla {
 namespace cpu {
 
+// Returns the size of the outputs that 'instruction' writes when it's emitted
+// as parallel tasks: all outputs of multi-output loops, and only the update of
+// scatters and in-place dynamic-update-slices.
+static int64_t ParallelOutputSize(
+    const HloCostAnalysis::ShapeSizeFunction& shape_size,
+    const HloInstruction& instruction) {
+  if (!IsMultiOutputLoop(instruction)) {
+    return shape_size(GetParallelPartitionedShape(instruction));
+  }
+  int64_t size = 0;
+  for (const Shape& element : instruction.shape().tuple_shapes()) {
+    size += shape_size(element);
+  }
+  return size;
+}
+
 class SimpleCostModel : public ParallelCostModel {
  public:
   SimpleCostModel(const int64_t max_parallelism,
@@ -54,7 +73,8 @@ class SimpleCostModel : public ParallelCostModel {
 
   int64_t GetParallelTaskCount(HloInstruction* instruction) override {
     // Simple cost model based on hlo size and typical L2 cache size.
-    const int64_t instruction_cost = shape_size_(instruction->shape());
+    const int64_t instruction_cost =
+        ParallelOutputSize(shape_size_, *instruction);
     const int64_t min_cost_per_thread = 256LL << 10;  // 256KB L2 Cache size.
     // Return target parallel task count in [1, max_parallelism_].
     return std::min(
@@ -96,7 +116,7 @@ class DefaultCostModel : public ParallelCostModel {
       max_parallelism = std::min<int64_t>(
           max_parallelism_, std::ceil(std::sqrt(tsl::port::MaxParallelism())));
       // Use shape size instruction cost and L2 cache size min per-thread cost.
-      instruction_cost = shape_size_(instruction->shape());
+      instruction_cost = ParallelOutputSize(shape_size_, *instruction);
       min_cost_per_thread = 256LL << 10;  // 256KB L2 Cache size.
     } else {
       // Use max parallelism for compute bound instructions.
@@ -124,10 +144,52 @@ class DefaultCostModel : public ParallelCostModel {
   const std::unique_ptr<HloCostAnalysis> cost_analysis_;
 };
 
+// Cost model based on the measured latencies of instructions run as a single
+// task. Running an instruction as 'n' tasks is modeled to take
+//
+//   latency / n + (n - 1) * kTaskOverheadUs
+//
+// which is minimized by n = sqrt(latency / kTaskOverheadUs). Instructions
+// missing from the profile are left to 'fallback'.
+class ProfileGuidedCostModel : public ParallelCostModel {
+ public:
+  ProfileGuidedCostModel(
+      const int64_t max_parallelism,
+      const tensorflow::profiler::ProfiledInstructionsProto& profile,
+      std::unique_ptr<ParallelCostModel> fallback)
+      : max_parallelism_(max_parallelism), fallback_(std::move(fallback)) {
+    for (const auto& cost : profile.costs()) {
+      latencies_us_[cost.name()] = cost.cost_us();
+    }
+  }
+  ~ProfileGuidedCostModel() override {}
+
+  int64_t GetParallelTaskCount(HloInstruction* instruction) override {
+    auto it = latencies_us_.find(instruction->name());
+    if (it == latencies_us_.end()) {
+      return fallback_->GetParallelTaskCount(instruction);
+    }
+    const int64_t task_count =
+        std::sqrt(std::max(0.0, it->second) / kTaskOverheadUs);
+    // Return target parallel task count in [1, max_parallelism_].
+    return std::clamp<int64_t>(task_count, 1, max_parallelism_);
+  }
+
+ private:
+  // Cost of running one more task: dispatching it to the intra-op thread pool
+  // and joining it.
+  static constexpr double kTaskOverheadUs = 5.0;
+
+  const int64_t max_parallelism_;
+  const std::unique_ptr<ParallelCostModel> fallback_;
+  absl::flat_hash_map<std::string, double> latencies_us_;
+};
+
 ParallelTaskAssignment::ParallelTaskAssignment(
     const int64_t max_parallelism,
     const HloCostAnalysis::ShapeSizeFunction& shape_size, HloModule* module,
-    const TargetMachineFeatures* target_machine_features)
+    const TargetMachineFeatures* target_machine_features,
+    const tensorflow::profiler::ProfiledInstructionsProto* profile)
     : target_machine_features_(*target_machine_features) {
   VLOG(1) << "ParallelTaskAssignment max_parallelism: " << max_parallelism;
   // Run cost analysis on 'module'.
@@ -145,28 +207,47 @@ ParallelTaskAssignment::ParallelTaskAssignment(
     cost_model_ =
         std::make_unique<SimpleCostModel>(max_parallelism, shape_size);
   }
+  if (profile != nullptr) {
+    // Measured latencies take precedence over estimated costs.
+    cost_model_ = std::make_unique<ProfileGuidedCostModel>(
+        max_parallelism, *profile, std::move(cost_model_));
+  }
 }
 
 int64_t ParallelTaskAssignment::GetTargetParallelTaskCount(
     HloInstruction* instruction) {
   // Currently, we do not assign parallel tasks to instructions with at least
   // one of the following properties:
-  // *) Internal threading (library calls to kConv, kDot, kFft, kCustomCall).
+  // *) Internal threading (library calls to kConv, kDot, kFft, kCustomCall,
+  //    and copies and transposes emitted as runtime transposes).
   // *) Emit custom loops (kSelectAndScatter).
-  // *) Operations that are not thread safe (like infeed and rng).
-  // *) Tuple-shaped.
-  // *) Operations that might be implemented as an in-place
-  //    dynamic-update-slice, because we can't know how many output elements
-  //    they will write (out-of-place will touch the whole output buffer, while
-  //    in-place will only touch the updated elements).
+  // *) Operations that are not thread safe (like infeed and rng). Random
+  //    numbers are generated by expanding rng into counter-based bit
+  //    generation, which is partitioned like any other loop.
+  // *) Tuple-shaped, unless all outputs are computed by a single loop.
+  //
+  // Operations that might be implemented as an in-place dynamic-update-slice
+  // are partitioned along their update, which is all they write once emitted
+  // in place. The IrEmitter ignores the partitions of those that can't be.
   // TODO(b/27458679) Parallelize instructions which are skipped here.
   auto opcode = instruction->opcode();
-  if (llvm_ir::MayBeImplementedAsInPlaceDynamicUpdateSlice(instruction) ||
-      instruction->shape().IsTuple() || opcode == HloOpcode::kRng ||
-      opcode == HloOpcode::kConstant) {
+  if ((instruction->shape().IsTuple() && !IsMultiOutputLoop(*instruction)) ||
+      opcode == HloOpcode::kRng || opcode == HloOpcode::kConstant) {
     return 1;
   }
 
+  if (GetRuntimeTranspose(*instruction).has_value()) {
+    return 1;
+  }
+
+  // Scatter updates are applied in parallel, which is only safe if they don't
+  // collide or can be combined atomically.
+  if (opcode == HloOpcode::kScatter) {
+    return CanEmitParallelScatter(*instruction)
+               ? cost_model_->GetParallelTaskCount(instruction)
+               : 1;
+  }
+
   // Only allow instructions that can be trivially parallelized (where all
   // outputs can be computed independently of each other).
   if (instruction->IsElementwise() || instruction->IsLoopFusion() ||
@@ -198,7 +279,7 @@ StatusOr<bool> ParallelTaskAssigner::Run(
   ComputeTargetParallelTasks(module, &hlo_to_parallel_tasks);
 
   // Assign parallel tasks to target specific instructions in 'module'.
-  // TODO(b/27458679) Support inter-op parallelism.
+  // Inter-op parallelism is handled separately by TaskGraphOutliner.
   bool changed = AssignParallelTasks(module, hlo_to_parallel_tasks);
 
   XLA_VLOG_LINES(2, "ParallelTaskAssigner EXIT");
@@ -240,8 +321,10 @@ bool ParallelTaskAssigner::AssignParallelTasksHelper(
     // Get target parallel task count computed for 'instruction'.
     const int64_t target_parallel_task_count = (*it).second;
     // Assign feasible dimension partitions (based on actual dimension sizes).
-    auto dim_partition_counts = ShapePartitionAssigner(instruction->shape())
-                                    .Run(target_parallel_task_count);
+    const bool is_scatter = instruction->opcode() == HloOpcode::kScatter;
+    auto dim_partition_counts =
+        ShapePartitionAssigner(GetParallelPartitionedShape(*instruction))
+            .Run(target_parallel_task_count);
     const int64_t total_partition_count =
         ShapePartitionAssigner::GetTotalPartitionCount(dim_partition_counts);
     if (total_partition_count <= 1) {
@@ -249,6 +332,22 @@ bool ParallelTaskAssigner::AssignParallelTasksHelper(
       continue;
     }
 
+    BackendConfig backend_config;
+    absl::c_copy(dim_partition_counts,
+                 tsl::protobuf::RepeatedFieldBackInserter(
+                     backend_config.mutable_outer_dimension_partitions()));
+
+    // The IrEmitter outlines the loop over scatter updates itself, after
+    // copying the operand into the output buffer.
+    if (is_scatter) {
+      TF_CHECK_OK(instruction->set_backend_config(backend_config));
+      VLOG(2) << "Assigned parallel task count: " << total_partition_count
+              << " to scatter: " << instruction->name()
+              << " parent: " << computation->name();
+      changed = true;
+      continue;
+    }
+
     // Outline 'instruction' in 'computation' for parallel task assignment.
     auto* call = module->OutlineExpressionFromComputation(
         {instruction}, absl::StrCat("parallel_", instruction->name()),
@@ -256,10 +355,6 @@ bool ParallelTaskAssigner::AssignParallelTasksHelper(
 
     // Set assigned dimension partitioning to 'instruction'.
     auto* new_root = call->to_apply()->root_instruction();
-    BackendConfig backend_config;
-    absl::c_copy(dim_partition_counts,
-                 tsl::protobuf::RepeatedFieldBackInserter(
-                     backend_config.mutable_outer_dimension_partitions()));
     TF_CHECK_OK(new_root->set_backend_config(backend_config));
 
     VLOG(2) << "Assigned parallel task count: " << total_partition_count
@@ -272,9 +367,9 @@ bool ParallelTaskAssigner::AssignParallelTasksHelper(
 
 void ParallelTaskAssigner::ComputeTargetParallelTasks(
     HloModule* module, HloToParallelTasks* hlo_to_parallel_tasks) {
-  ParallelTaskAssignment parallel_task_assignment(max_parallelism_,
-                                                  shape_size_function_, module,
-                                                  &target_machine_features_);
+  ParallelTaskAssignment parallel_task_assignment(
+      max_parallelism_, shape_size_function_, module,
+      &target_machine_features_, profile_ ? &*profile_ : nullptr);
 
   // Compute parallel task counts for all instructions in 'module'.
   for (auto* computation : module->MakeNonfusionComputations()) {
@@ -15,11 +15,17 @@ limitations under the License.
 
 #include "xla/service/cpu/parallel_task_assignment.h"
 
+#include <optional>
+#include <utility>
+
+#include "xla/service/cpu/backend_config.pb.h"
 #include "xla/service/cpu/cpu_executable.h"
 #include "xla/service/cpu/target_machine_features_fake.h"
 #include "xla/test.h"
 #include "xla/tests/hlo_test_base.h"
 #include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/cpu_info.h"
+#include "tsl/profiler/protobuf/profiled_instructions.pb.h"
 
 namespace xla {
 namespace {
@@ -40,9 +46,13 @@ class ParallelTaskAssignmentTest : public HloTestBase {
           return cpu::TargetMachineFeatures::kEigenExpectedTensorAlignment;
         }) {}
 
-  StatusOr<bool> RunParallelTaskAssigner(HloModule* module) {
+  StatusOr<bool> RunParallelTaskAssigner(
+      HloModule* module,
+      std::optional<tensorflow::profiler::ProfiledInstructionsProto> profile =
+          std::nullopt) {
     return cpu::ParallelTaskAssigner(max_parallelism_, shape_size_func_,
-                                     &target_machine_features_)
+                                     &target_machine_features_,
+                                     std::move(profile))
         .Run(module);
   }
 };
@@ -126,11 +136,12 @@ TEST_F(ParallelTaskAssignmentTest, InfeedOutfeedOperationNotParallelized) {
   EXPECT_FALSE(changed);
 }
 
-TEST_F(ParallelTaskAssignmentTest, InPlaceDynamicUpdateSliceNotParallelized) {
+TEST_F(ParallelTaskAssignmentTest,
+       SmallInPlaceDynamicUpdateSliceNotParallelized) {
   // A dynamic-update-slice within a while loop.  This construction is an easy
   // way to make a DUS which can be run "in-place" (i.e. the input and output
   // are the same buffer, and running the DUS only writes to the updated
-  // elements).
+  // elements). Its cost is that of its small update, not of its output.
   const std::string hlo_string = R"(
   HloModule test
 
@@ -171,6 +182,90 @@ TEST_F(ParallelTaskAssignmentTest, InPlaceDynamicUpdateSliceNotParallelized) {
   EXPECT_FALSE(changed);
 }
 
+TEST_F(ParallelTaskAssignmentTest,
+       InPlaceDynamicUpdateSlicePartitionedByUpdate) {
+  if (tsl::port::MaxParallelism() < 2) {
+    GTEST_SKIP() << "Memory-bound ops aren't parallelized on a single core.";
+  }
+  constexpr char hlo_string[] = R"(
+  HloModule TestTaskParallel_dynamic_update_slice
+    ENTRY dus {
+      data = f32[4096,1048576] parameter(0)
+      update = f32[1,1048576] parameter(1)
+      i = s32[] parameter(2)
+      zero = s32[] constant(0)
+      ROOT dus = f32[4096,1048576] dynamic-update-slice(data, update, i, zero)
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_TRUE(changed);
+
+  const HloInstruction* call = m->entry_computation()->root_instruction();
+  ASSERT_EQ(call->opcode(), HloOpcode::kCall);
+  const HloInstruction* dus = call->to_apply()->root_instruction();
+  TF_ASSERT_OK_AND_ASSIGN(cpu::BackendConfig backend_config,
+                          dus->backend_config<cpu::BackendConfig>());
+  // The single row of the update can't be split, so partitions are assigned
+  // to its columns.
+  EXPECT_THAT(backend_config.outer_dimension_partitions(),
+              ::testing::ElementsAre(1, ::testing::Gt(1)));
+}
+
+TEST_F(ParallelTaskAssignmentTest, MultiOutputLoopFusionParallelized) {
+  if (tsl::port::MaxParallelism() < 2) {
+    GTEST_SKIP() << "Memory-bound ops aren't parallelized on a single core.";
+  }
+  constexpr char hlo_string[] = R"(
+  HloModule TestTaskParallel_multi_output_fusion
+    fused_computation {
+      p0 = f32[1024,1024] parameter(0)
+      p1 = f32[1024,1024] parameter(1)
+      add = f32[1024,1024] add(p0, p1)
+      mul = f32[1024,1024] multiply(p0, p1)
+      ROOT tuple = (f32[1024,1024], f32[1024,1024]) tuple(add, mul)
+    }
+    ENTRY multi_output_fusion {
+      p0 = f32[1024,1024] parameter(0)
+      p1 = f32[1024,1024] parameter(1)
+      ROOT fusion = (f32[1024,1024], f32[1024,1024]) fusion(p0, p1),
+          kind=kLoop, calls=fused_computation
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_TRUE(changed);
+  EXPECT_EQ(m->entry_computation()->root_instruction()->opcode(),
+            HloOpcode::kCall);
+}
+
+TEST_F(ParallelTaskAssignmentTest,
+       MultiOutputFusionWithDifferentShapesNotParallelized) {
+  constexpr char hlo_string[] = R"(
+  HloModule TestTaskParallel_multi_output_fusion
+    fused_computation {
+      p0 = f32[1024,1024] parameter(0)
+      add = f32[1024,1024] add(p0, p0)
+      slice = f32[512,1024] slice(add), slice={[0:512], [0:1024]}
+      ROOT tuple = (f32[1024,1024], f32[512,1024]) tuple(add, slice)
+    }
+    ENTRY multi_output_fusion {
+      p0 = f32[1024,1024] parameter(0)
+      ROOT fusion = (f32[1024,1024], f32[512,1024]) fusion(p0),
+          kind=kLoop, calls=fused_computation
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_FALSE(changed);
+}
+
 TEST_F(ParallelTaskAssignmentTest, AllReduceNotParallelized) {
   constexpr char hlo_string[] = R"(
   HloModule TestTaskParallel_allreduce
@@ -206,5 +301,85 @@ TEST_F(ParallelTaskAssignmentTest, ConstantNotParallelized) {
   EXPECT_FALSE(changed);
 }
 
+TEST_F(ParallelTaskAssignmentTest,
+       ScatterWithoutAtomicCombinerNotParallelized) {
+  constexpr char hlo_string[] = R"(
+  HloModule TestTaskParallel_scatter
+    mul {
+      lhs = f32[] parameter(0)
+      rhs = f32[] parameter(1)
+      ROOT mul = f32[] multiply(lhs, rhs)
+    }
+    ENTRY scatter {
+      operand = f32[1024,1024] parameter(0)
+      indices = s32[4096,1] parameter(1)
+      updates = f32[4096,1024] parameter(2)
+      ROOT scatter = f32[1024,1024] scatter(operand, indices, updates),
+          update_window_dims={1}, inserted_window_dims={0},
+          scatter_dims_to_operand_dims={0}, index_vector_dim=1, to_apply=mul
+    }
+  )";
+
+  // Updates with duplicate indices would race on the output.
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_FALSE(changed);
+}
+
+TEST_F(ParallelTaskAssignmentTest, ProfiledLatencyOverridesEstimatedCost) {
+  constexpr char hlo_string[] = R"(
+  HloModule TestTaskParallel_profile
+    ENTRY profile {
+      p0 = f32[1024] parameter(0)
+      ROOT exp = f32[1024] exponential(p0)
+    }
+  )";
+
+  // Too small to parallelize by its estimated cost, but slow enough to split
+  // into the maximum number of tasks by its measured latency.
+  tensorflow::profiler::ProfiledInstructionsProto profile;
+  auto* cost = profile.add_costs();
+  cost->set_name("exp");
+  cost->set_cost_us(2000.0);
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed,
+                          RunParallelTaskAssigner(m.get(), profile));
+  EXPECT_TRUE(changed);
+
+  const HloInstruction* call = m->entry_computation()->root_instruction();
+  ASSERT_EQ(call->opcode(), HloOpcode::kCall);
+  const HloInstruction* exp = call->to_apply()->root_instruction();
+  TF_ASSERT_OK_AND_ASSIGN(cpu::BackendConfig backend_config,
+                          exp->backend_config<cpu::BackendConfig>());
+  EXPECT_THAT(backend_config.outer_dimension_partitions(),
+              ::testing::ElementsAre(max_parallelism_));
+}
+
+TEST_F(ParallelTaskAssignmentTest, FastProfiledInstructionNotParallelized) {
+  constexpr char hlo_string[] = R"(
+  HloModule TestTaskParallel_profile
+    ENTRY profile {
+      p0 = f32[4096,4096] parameter(0)
+      p1 = f32[4096,4096] parameter(1)
+      ROOT add = f32[4096,4096] add(p0, p1)
+    }
+  )";
+
+  // Splitting it would cost more than it saves.
+  tensorflow::profiler::ProfiledInstructionsProto profile;
+  auto* cost = profile.add_costs();
+  cost->set_name("add");
+  cost->set_cost_us(8.0);
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed,
+                          RunParallelTaskAssigner(m.get(), profile));
+  EXPECT_FALSE(changed);
+}
+
 }  // namespace
 }  // namespace xla
@@ -26,12 +26,15 @@
 #include <utility>
 #include <vector>
 
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
 #include "mlir/Support/LogicalResult.h"  // from @llvm-project
 #include "xla/executable_run_options.h"
 #include "xla/runtime/custom_call.h"
 #include "xla/runtime/custom_call_registry.h"
 #include "xla/runtime/executable.h"
 #include "xla/service/cpu/cpu_runtime.h"
+#include "xla/service/custom_call_status_internal.h"
 #include "xla/shape.h"
 #include "xla/shape_util.h"
 #include "xla/xla_data.pb.h"
@@ -54,6 +57,15 @@ static constexpr CustomCall::RuntimeChecks RuntimeChecks() {
 #endif
 }
 
+// Returns the failure that a collective runtime function reported in `status`.
+static absl::Status ToStatus(const XlaCustomCallStatus& status) {
+  if (std::optional<absl::string_view> message =
+          CustomCallStatusGetMessage(&status)) {
+    return absl::InternalError(*message);
+  }
+  return absl::OkStatus();
+}
+
 static std::string ReplicaGroupsToString(
     CustomCall::TensorRef<int64_t> replica_groups) {
   if (replica_groups.shape[0] == 0) {
@@ -204,15 +216,16 @@ absl::Status XlaAllReduce::operator()(
       (shape.tuple_shapes().size() == 1 ? shape.tuple_shapes(0) : shape)
           .SerializeAsString();
 
+  XlaCustomCallStatus status;
   __xla_cpu_runtime_AllReduce(
       run_options, replica_groups_str.c_str(),
       static_cast<int32_t>(replica_groups_str.size()),
       static_cast<int32_t>(channel_id), use_global_device_ids, op_id,
       reduction_kind, shape_str.c_str(), static_cast<int32_t>(shape_str.size()),
       static_cast<int32_t>(num_buffers), input_buffers.data(),
-      output_buffers.data());
+      output_buffers.data(), &status);
 
-  return absl::OkStatus();
+  return ToStatus(status);
 }
 
 static bool AllReduce(xla::runtime::ExecutionContext* ctx, void** args,
@@ -275,13 +288,14 @@ absl::Status XlaTupleAllToAll::operator()(
   size_t buffer_size = ShapeUtil::ByteSizeOfElements(
       ShapeUtil::MakeShape(first_input.dtype, first_input.sizes));
 
+  XlaCustomCallStatus status;
   __xla_cpu_runtime_AllToAll(
       run_options, channel_id_present, op_id, replica_groups_str.c_str(),
       static_cast<int32_t>(replica_groups_str.size()),
       static_cast<int32_t>(num_buffers), static_cast<int64_t>(buffer_size),
-      input_buffers.data(), output_buffers.data());
+      input_buffers.data(), output_buffers.data(), &status);
 
-  return absl::OkStatus();
+  return ToStatus(status);
 }
 
 static bool TupleAllToAll(xla::runtime::ExecutionContext* ctx, void** args,
@@ -324,13 +338,14 @@ absl::Status XlaCollectivePermute::operator()(
   std::string source_target_pairs_str =
       SourceTargetPairsToString(source_target_pairs);
 
+  XlaCustomCallStatus status;
   __xla_cpu_runtime_CollectivePermute(
       run_options, static_cast<int32_t>(channel_id), 0,
       static_cast<int32_t>(byte_size), input.data, output.data,
       source_target_pairs_str.c_str(),
-      static_cast<int32_t>(source_target_pairs_str.size()));
+      static_cast<int32_t>(source_target_pairs_str.size()), &status);
 
-  return absl::OkStatus();
+  return ToStatus(status);
 }
 
 static bool CollectivePermute(xla::runtime::ExecutionContext* ctx, void** args,
@@ -0,0 +1,321 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/runtime_bf16_matmul.h"
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "absl/base/dynamic_annotations.h"
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "xla/executable_run_options.h"
+#include "xla/service/cpu/runtime_lightweight_check.h"
+#include "tsl/platform/cpu_info.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define XLA_CPU_BF16_MATMUL_AVX512 1
+#endif
+
+namespace {
+
+using bfloat16 = Eigen::bfloat16;
+
+// The operands of a matmul, with the conventions of the matmul runtime
+// functions.
+struct BF16MatMulArgs {
+  bfloat16* out;
+  const bfloat16* lhs;
+  const bfloat16* rhs;
+  int64_t m;
+  int64_t n;
+  int64_t k;
+  bool transpose_lhs;
+  bool transpose_rhs;
+
+  bfloat16 Lhs(int64_t i, int64_t p) const {
+    return transpose_lhs ? lhs[p + i * k] : lhs[i + p * m];
+  }
+  bfloat16 Rhs(int64_t p, int64_t j) const {
+    return transpose_rhs ? rhs[j + p * n] : rhs[p + j * k];
+  }
+};
+
+// Contracts the operands converted to f32 with Eigen, and rounds the result.
+void EigenBF16MatMul(const Eigen::ThreadPoolDevice& device,
+                     const BF16MatMulArgs& args) {
+  int64_t lhs_rows = args.m;
+  int64_t lhs_cols = args.k;
+  if (args.transpose_lhs) {
+    std::swap(lhs_rows, lhs_cols);
+  }
+  int64_t rhs_rows = args.k;
+  int64_t rhs_cols = args.n;
+  if (args.transpose_rhs) {
+    std::swap(rhs_rows, rhs_cols);
+  }
+
+  const Eigen::TensorMap<Eigen::Tensor<const bfloat16, 2>, Eigen::Unaligned> A(
+      args.lhs, lhs_rows, lhs_cols);
+  const Eigen::TensorMap<Eigen::Tensor<const bfloat16, 2>, Eigen::Unaligned> B(
+      args.rhs, rhs_rows, rhs_cols);
+  Eigen::TensorMap<Eigen::Tensor<bfloat16, 2>, Eigen::Unaligned> C(
+      args.out, args.m, args.n);
+
+  typedef Eigen::Tensor<float, 2>::DimensionPair DimPair;
+  const Eigen::array<DimPair, 1> dims({DimPair(args.transpose_lhs ? 0 : 1,
+                                               args.transpose_rhs ? 1 : 0)});
+  C.device(device) = A.cast<float>()
+                         .contract(B.cast<float>(), dims)
+                         .cast<bfloat16>();
+}
+
+#if defined(XLA_CPU_BF16_MATMUL_AVX512)
+
+#define XLA_CPU_AVX512_BF16_TARGET \
+  __attribute__((target("avx512f,avx512bw,avx512vl,avx512bf16")))
+
+// vdpbf16ps sums the products of 2 consecutive bf16 pairs into each of the 16
+// f32 lanes of a register. A tile of the output is 2 blocks of 16 rows by 8
+// columns, i.e. 16 accumulator registers.
+constexpr int64_t kBlockRows = 16;
+constexpr int64_t kDepthGroup = 2;
+constexpr int64_t kTileBlocks = 2;
+constexpr int64_t kTileCols = 8;
+
+bool HostSupportsAvx512BF16() {
+  using tsl::port::CPUFeature;
+  static const bool supported =
+      tsl::port::TestCPUFeature(CPUFeature::AVX512F) &&
+      tsl::port::TestCPUFeature(CPUFeature::AVX512BW) &&
+      tsl::port::TestCPUFeature(CPUFeature::AVX512VL) &&
+      tsl::port::TestCPUFeature(CPUFeature::AVX512_BF16);
+  return supported;
+}
+
+uint16_t Bits(bfloat16 value) {
+  return Eigen::numext::bit_cast<uint16_t>(value);
+}
+
+// The operands packed for the AVX512-BF16 kernel, padded with zeros to whole
+// tiles and depth groups.
+//
+// For every block of 16 rows, 'lhs' holds the 16 lanes x 2 values operand of
+// each depth group. For every panel of 8 columns, 'rhs' holds the 2 values of
+// each column in each depth group as one uint32, to be broadcast to all lanes.
+struct PackedBF16Operands {
+  int64_t num_blocks;
+  int64_t num_panels;
+  int64_t num_groups;
+  std::vector<uint16_t> lhs;
+  std::vector<uint32_t> rhs;
+};
+
+PackedBF16Operands PackBF16Operands(const Eigen::ThreadPoolDevice& device,
+                                    const BF16MatMulArgs& args) {
+  PackedBF16Operands packed;
+  const int64_t tile_rows = kTileBlocks * kBlockRows;
+  packed.num_blocks = (args.m + tile_rows - 1) / tile_rows * kTileBlocks;
+  packed.num_panels = (args.n + kTileCols - 1) / kTileCols;
+  packed.num_groups = (args.k + kDepthGroup - 1) / kDepthGroup;
+  packed.lhs.resize(packed.num_blocks * packed.num_groups * kBlockRows *
+                    kDepthGroup);
+  packed.rhs.resize(packed.num_panels * packed.num_groups * kTileCols);
+
+  device.parallelFor(
+      packed.num_blocks,
+      Eigen::TensorOpCost(kBlockRows * args.k * sizeof(bfloat16),
+                          kBlockRows * args.k * sizeof(bfloat16),
+                          kBlockRows * args.k),
+      [&](Eigen::Index first, Eigen::Index last) {
+        for (int64_t block = first; block < last; ++block) {
+          uint16_t* dst =
+              &packed.lhs[block * packed.num_groups * kBlockRows * kDepthGroup];
+          const int64_t num_rows =
+              std::min(kBlockRows, args.m - block * kBlockRows);
+          for (int64_t r = 0; r < num_rows; ++r) {
+            const int64_t i = block * kBlockRows + r;
+            for (int64_t p = 0; p < args.k; ++p) {
+              dst[(p / kDepthGroup) * kBlockRows * kDepthGroup +
+                  r * kDepthGroup + p % kDepthGroup] = Bits(args.Lhs(i, p));
+            }
+          }
+        }
+      });
+
+  device.parallelFor(
+      packed.num_panels,
+      Eigen::TensorOpCost(kTileCols * args.k * sizeof(bfloat16),
+                          kTileCols * args.k * sizeof(bfloat16),
+                          kTileCols * args.k),
+      [&](Eigen::Index first, Eigen::Index last) {
+        for (int64_t panel = first; panel < last; ++panel) {
+          uint32_t* dst = &packed.rhs[panel * packed.num_groups * kTileCols];
+          const int64_t num_cols =
+              std::min(kTileCols, args.n - panel * kTileCols);
+          for (int64_t c = 0; c < num_cols; ++c) {
+            const int64_t j = panel * kTileCols + c;
+            for (int64_t p = 0; p < args.k; ++p) {
+              dst[(p / kDepthGroup) * kTileCols + c] |=
+                  uint32_t{Bits(args.Rhs(p, j))} << (16 * (p % kDepthGroup));
+            }
+          }
+        }
+      });
+  return packed;
+}
+
+// Computes the tile of 'kTileBlocks' blocks of rows starting at 'block' and
+// the columns of 'panel'.
+XLA_CPU_AVX512_BF16_TARGET void Avx512BF16Tile(
+    const PackedBF16Operands& packed, const BF16MatMulArgs& args,
+    int64_t block, int64_t panel) {
+  const int64_t group_values = kBlockRows * kDepthGroup;
+  const uint16_t* lhs =
+      packed.lhs.data() + block * packed.num_groups * group_values;
+  const uint16_t* lhs_next = lhs + packed.num_groups * group_values;
+  const uint32_t* rhs =
+      packed.rhs.data() + panel * packed.num_groups * kTileCols;
+
+  __m512 acc[kTileBlocks][kTileCols];
+  for (int64_t b = 0; b < kTileBlocks; ++b) {
+    for (int64_t c = 0; c < kTileCols; ++c) {
+      acc[b][c] = _mm512_setzero_ps();
+    }
+  }
+  for (int64_t g = 0; g < packed.num_groups; ++g) {
+    const __m512bh a0 =
+        (__m512bh)_mm512_loadu_si512(lhs + g * group_values);
+    const __m512bh a1 =
+        (__m512bh)_mm512_loadu_si512(lhs_next + g * group_values);
+    for (int64_t c = 0; c < kTileCols; ++c) {
+      const __m512bh b = (__m512bh)_mm512_set1_epi32(rhs[g * kTileCols + c]);
+      acc[0][c] = _mm512_dpbf16_ps(acc[0][c], a0, b);
+      acc[1][c] = _mm512_dpbf16_ps(acc[1][c], a1, b);
+    }
+  }
+
+  const int64_t num_cols = std::min(kTileCols, args.n - panel * kTileCols);
+  for (int64_t b = 0; b < kTileBlocks; ++b) {
+    const int64_t row = (block + b) * kBlockRows;
+    if (row >= args.m) break;
+    const int64_t num_rows = std::min(kBlockRows, args.m - row);
+    const __mmask16 mask = static_cast<__mmask16>((1u << num_rows) - 1);
+    for (int64_t c = 0; c < num_cols; ++c) {
+      const int64_t col = panel * kTileCols + c;
+      // Rounds to nearest even, like the conversion of the Eigen fallback.
+      _mm256_mask_storeu_epi16(args.out + row + col * args.m, mask,
+                               (__m256i)_mm512_cvtneps_pbh(acc[b][c]));
+    }
+  }
+}
+
+void Avx512BF16MatMul(const Eigen::ThreadPoolDevice& device,
+                      const BF16MatMulArgs& args) {
+  const PackedBF16Operands packed = PackBF16Operands(device, args);
+  const int64_t num_tile_rows = packed.num_blocks / kTileBlocks;
+  const int64_t tile_macs = kTileBlocks * kBlockRows * kTileCols * args.k;
+  // Consecutive tiles share their rows of lhs, which stay in cache.
+  device.parallelFor(
+      num_tile_rows * packed.num_panels,
+      Eigen::TensorOpCost(
+          (kTileBlocks * kBlockRows + kTileCols) * args.k * sizeof(bfloat16),
+          kTileBlocks * kBlockRows * kTileCols * sizeof(bfloat16),
+          tile_macs / (kBlockRows * kDepthGroup)),
+      [&](Eigen::Index first, Eigen::Index last) {
+        for (int64_t tile = first; tile < last; ++tile) {
+          Avx512BF16Tile(packed, args,
+                         (tile / packed.num_panels) * kTileBlocks,
+                         tile % packed.num_panels);
+        }
+      });
+}
+
+#endif  // XLA_CPU_BF16_MATMUL_AVX512
+
+void BF16MatMul(const Eigen::ThreadPoolDevice& device,
+                const BF16MatMulArgs& args) {
+  if (args.m == 0 || args.n == 0) return;
+#if defined(XLA_CPU_BF16_MATMUL_AVX512)
+  // The compiler only emits calls to this function for targets with
+  // AVX512-BF16, but an ahead-of-time compiled or cached executable may run on
+  // another host.
+  if (HostSupportsAvx512BF16()) {
+    Avx512BF16MatMul(device, args);
+    return;
+  }
+#endif
+  EigenBF16MatMul(device, args);
+}
+
+const Eigen::ThreadPoolDevice& IntraOpThreadPool(const void* run_options_ptr) {
+  const xla::ExecutableRunOptions* run_options =
+      static_cast<const xla::ExecutableRunOptions*>(run_options_ptr);
+  XLA_LIGHTWEIGHT_CHECK(run_options->intra_op_thread_pool() != nullptr);
+  return *run_options->intra_op_thread_pool();
+}
+
+}  // namespace
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_BF16MatMul(
+    const void* run_options_ptr, bfloat16* out, bfloat16* lhs, bfloat16* rhs,
+    int64_t m, int64_t n, int64_t k, int32_t transpose_lhs,
+    int32_t transpose_rhs) {
+  BF16MatMul(IntraOpThreadPool(run_options_ptr),
+             BF16MatMulArgs{out, lhs, rhs, m, n, k, transpose_lhs != 0,
+                            transpose_rhs != 0});
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_BF16Conv2D(
+    const void* run_options_ptr, bfloat16* out, bfloat16* lhs, bfloat16* rhs,
+    int64_t input_batch, int64_t input_rows, int64_t input_cols,
+    int64_t input_channels, int64_t kernel_rows, int64_t kernel_cols,
+    int64_t kernel_channels, int64_t kernel_filters, int64_t output_rows,
+    int64_t output_cols, int64_t row_stride, int64_t col_stride,
+    int64_t padding_top, int64_t padding_bottom, int64_t padding_left,
+    int64_t padding_right, int64_t lhs_row_dilation, int64_t lhs_col_dilation,
+    int64_t rhs_row_dilation, int64_t rhs_col_dilation,
+    int64_t feature_group_count) {
+  XLA_LIGHTWEIGHT_CHECK(feature_group_count == 1);
+  const Eigen::ThreadPoolDevice& device = IntraOpThreadPool(run_options_ptr);
+
+  const Eigen::TensorMap<Eigen::Tensor<const bfloat16, 4, Eigen::RowMajor>,
+                         Eigen::Unaligned>
+      input(lhs, input_batch, input_rows, input_cols, input_channels);
+
+  // The patches are laid out like in __xla_cpu_runtime_Int8Conv2D.
+  const int64_t num_patches = input_batch * output_rows * output_cols;
+  const int64_t patch_size = kernel_rows * kernel_cols * kernel_channels;
+  std::vector<bfloat16> patches(num_patches * patch_size);
+  Eigen::TensorMap<Eigen::Tensor<bfloat16, 2, Eigen::RowMajor>,
+                   Eigen::Unaligned>(patches.data(), num_patches, patch_size)
+      .device(device) =
+      input
+          .extract_image_patches(kernel_cols, kernel_rows, col_stride,
+                                 row_stride, rhs_col_dilation,
+                                 rhs_row_dilation, lhs_col_dilation,
+                                 lhs_row_dilation, padding_left, padding_right,
+                                 padding_top, padding_bottom, bfloat16(0))
+          .reshape(Eigen::DSizes<Eigen::Index, 2>(num_patches, patch_size));
+
+  BF16MatMul(device, BF16MatMulArgs{out, rhs, patches.data(), kernel_filters,
+                                    num_patches, patch_size,
+                                    /*transpose_lhs=*/false,
+                                    /*transpose_rhs=*/false});
+}
@@ -17,6 +17,15 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "absl/base/dynamic_annotations.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
@@ -26,12 +35,145 @@ limitations under the License.
 #include "tsl/platform/blocking_counter.h"
 #include "tsl/platform/logging.h"
 
+namespace {
+
 using ComputeFunctionType = void (*)(void*, const void*, const void**, void**,
                                      void*, int64_t*, uint64_t*);
 
-// Dispatches 'num_partitions - 1' calls to 'function_ptr' in parallel.
-// Calls 'function_ptr' for first partition inline.
-// Uses blocking counter to synchronize threads after parallel calls complete.
+// Maximum number of sub-ranges each partition is split into. Partitions are
+// sized by the compiler for a fixed number of threads; smaller units of work
+// let threads that are free (or faster) take over the work of the others.
+constexpr int64_t kMaxSubRangesPerPartition = 4;
+
+// Runs the sub-ranges of all partitions of a fork/join call. The calling
+// thread and each worker start with the sub-ranges of a partition of their
+// own, and then steal the remaining sub-ranges of other partitions.
+//
+// Workers share ownership of the state, since workers that start after all
+// sub-ranges have been claimed may still look for work after the calling
+// thread returns.
+class ForkJoinState {
+ public:
+  ForkJoinState(void* result_ptr, const void* run_options_ptr,
+                void** buffer_table, uint64_t* prof_counters,
+                int32_t num_partitions, const int64_t* partitions,
+                int32_t num_partitioned_dims, ComputeFunctionType function)
+      : result_ptr_(result_ptr),
+        run_options_ptr_(run_options_ptr),
+        buffer_table_(buffer_table),
+        prof_counters_(prof_counters),
+        num_partitioned_dims_(num_partitioned_dims),
+        function_(function),
+        partition_begin_(num_partitions + 1),
+        next_sub_range_(num_partitions) {
+    const int64_t stride = 2 * num_partitioned_dims;
+    for (int32_t i = 0; i < num_partitions; ++i) {
+      partition_begin_[i] = sub_range_partition_.size();
+      next_sub_range_[i].store(partition_begin_[i], std::memory_order_relaxed);
+      const int64_t* partition = &partitions[i * stride];
+      // Split the partition along its outer-most dimension with more than
+      // one index. The compute function handles any box of indices.
+      int32_t split_dim = 0;
+      while (split_dim + 1 < num_partitioned_dims &&
+             partition[2 * split_dim + 1] - partition[2 * split_dim] <= 1) {
+        ++split_dim;
+      }
+      const int64_t start = partition[2 * split_dim];
+      const int64_t limit = partition[2 * split_dim + 1];
+      const int64_t num_sub_ranges =
+          std::max<int64_t>(1, std::min(kMaxSubRangesPerPartition,
+                                        limit - start));
+      for (int64_t j = 0; j < num_sub_ranges; ++j) {
+        bounds_.insert(bounds_.end(), partition, partition + stride);
+        int64_t* sub_range = &bounds_[bounds_.size() - stride];
+        sub_range[2 * split_dim] =
+            start + (limit - start) * j / num_sub_ranges;
+        sub_range[2 * split_dim + 1] =
+            start + (limit - start) * (j + 1) / num_sub_ranges;
+        sub_range_partition_.push_back(i);
+      }
+    }
+    partition_begin_[num_partitions] = sub_range_partition_.size();
+    statuses_.resize(sub_range_partition_.size());
+    pending_ = std::make_unique<tsl::BlockingCounter>(
+        sub_range_partition_.size());
+  }
+
+  int32_t num_partitions() const { return next_sub_range_.size(); }
+
+  // Runs sub-ranges, starting with those of partition 'home', until none are
+  // left to claim.
+  void Run(int32_t home) {
+    const int32_t n = num_partitions();
+    for (int32_t k = 0; k < n; ++k) {
+      const int32_t partition = (home + k) % n;
+      int64_t sub_range;
+      while ((sub_range = next_sub_range_[partition].fetch_add(
+                  1, std::memory_order_relaxed)) <
+             partition_begin_[partition + 1]) {
+        function_(result_ptr_, run_options_ptr_, nullptr, buffer_table_,
+                  &statuses_[sub_range],
+                  &bounds_[sub_range * 2 * num_partitioned_dims_],
+                  prof_counters_);
+        pending_->DecrementCount();
+      }
+    }
+  }
+
+  // Waits until all sub-ranges have finished.
+  void Wait() { pending_->Wait(); }
+
+  // Returns the first error message of each partition that failed, if any.
+  std::vector<std::pair<int32_t, absl::string_view>> ErrorMessages() const {
+    std::vector<std::pair<int32_t, absl::string_view>> error_messages;
+    for (int64_t i = 0; i < statuses_.size(); ++i) {
+      const int32_t partition = sub_range_partition_[i];
+      if (!error_messages.empty() && error_messages.back().first == partition) {
+        continue;
+      }
+      std::optional<absl::string_view> msg =
+          xla::CustomCallStatusGetMessage(&statuses_[i]);
+      if (msg) {
+        error_messages.emplace_back(partition, *msg);
+      }
+    }
+    return error_messages;
+  }
+
+ private:
+  void* result_ptr_;
+  const void* run_options_ptr_;
+  void** buffer_table_;
+  uint64_t* prof_counters_;
+  const int32_t num_partitioned_dims_;
+  ComputeFunctionType function_;
+
+  // The bounds of each sub-range, laid out like 'partitions', and the
+  // partition it belongs to. The sub-ranges of partition 'i' are
+  // [partition_begin_[i], partition_begin_[i + 1]).
+  std::vector<int64_t> bounds_;
+  std::vector<int32_t> sub_range_partition_;
+  std::vector<int64_t> partition_begin_;
+  // The next sub-range of each partition that hasn't been claimed yet.
+  std::vector<std::atomic<int64_t>> next_sub_range_;
+  // Each sub-range writes its own status.
+  std::vector<XlaCustomCallStatus> statuses_;
+  std::unique_ptr<tsl::BlockingCounter> pending_;
+};
+
+}  // namespace
+
+// Dispatches calls to 'function_ptr' for all partitions, and returns once they
+// have all finished.
+//
+// Each partition is split into sub-ranges along its outer-most partitioned
+// dimension with more than one index. Up to 'num_partitions - 1' workers are
+// enqueued on the intra-op thread pool, and each of them, like the calling
+// thread, runs the sub-ranges of a partition of its own before stealing the
+// remaining sub-ranges of the others. Workers that only start once all
+// sub-ranges are claimed return immediately, so a busy thread pool doesn't
+// hold up the calling thread, which does the work of any worker that doesn't
+// start in time.
 //
 // The 'partitions' array has a total number of elements equal to
 // 'num_partitions * num_partitioned_dims * 2' (the '2' is necessary to specify
@@ -75,42 +217,30 @@ ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_ParallelForkJoin(
   CHECK_NE(run_options, nullptr);
   CHECK_NE(run_options->intra_op_thread_pool(), nullptr);
 
-  ComputeFunctionType function =
-      reinterpret_cast<ComputeFunctionType>(function_ptr);
-  // Compute partition stride in 'partitions' array.
-  const int64_t stride = 2 * num_partitioned_dims;
-
-  std::vector<XlaCustomCallStatus> statuses(num_partitions);
-
-  // Dispatch 'num_partitions - 1' compute functions to run in parallel.
-  tsl::BlockingCounter bc(num_partitions - 1);
-  for (int32_t i = 1; i < num_partitions; ++i) {
-    const int64_t offset = i * stride;
-    run_options->intra_op_thread_pool()->enqueueNoNotification(
-        [i, function, result_ptr, run_options_ptr, buffer_table, prof_counters,
-         partitions, offset, &bc, &statuses]() {
-          function(result_ptr, run_options_ptr, nullptr, buffer_table,
-                   &statuses[i], &partitions[offset], prof_counters);
-          bc.DecrementCount();
-          VLOG(3) << "ParallelForkJoin partition " << i << " done.";
-        });
+  auto state = std::make_shared<ForkJoinState>(
+      result_ptr, run_options_ptr, buffer_table, prof_counters, num_partitions,
+      partitions, num_partitioned_dims,
+      reinterpret_cast<ComputeFunctionType>(function_ptr));
+
+  // Dispatch workers for the partitions the calling thread doesn't start with.
+  const Eigen::ThreadPoolDevice* pool = run_options->intra_op_thread_pool();
+  const int32_t num_workers =
+      std::min<int32_t>(num_partitions - 1, pool->numThreads());
+  for (int32_t i = 1; i <= num_workers; ++i) {
+    pool->enqueueNoNotification([i, state]() {
+      state->Run(/*home=*/i);
+      VLOG(3) << "ParallelForkJoin worker " << i << " done.";
+    });
   }
 
-  // Call first compute function inline.
-  function(result_ptr, run_options_ptr, params, buffer_table, &statuses[0],
-           &partitions[0], prof_counters);
-  VLOG(3) << "ParallelForkJoin partition 0 done.";
-  bc.Wait();
+  // Help the workers instead of just waiting for them.
+  state->Run(/*home=*/0);
+  VLOG(3) << "ParallelForkJoin calling thread done.";
+  state->Wait();
 
   // Collect all error messages (if any).
-  std::vector<std::pair<int32_t, absl::string_view>> error_messages;
-  for (int32_t i = 0; i < num_partitions; ++i) {
-    std::optional<absl::string_view> msg =
-        xla::CustomCallStatusGetMessage(&statuses[i]);
-    if (msg) {
-      error_messages.emplace_back(i, *msg);
-    }
-  }
+  std::vector<std::pair<int32_t, absl::string_view>> error_messages =
+      state->ErrorMessages();
 
   if (!error_messages.empty()) {
     // Join all error messages into a single string to serve as the message for
@@ -0,0 +1,382 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/runtime_int8_matmul.h"
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/base/dynamic_annotations.h"
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "xla/executable_run_options.h"
+#include "xla/service/cpu/runtime_lightweight_check.h"
+#include "tsl/platform/cpu_info.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define XLA_CPU_INT8_MATMUL_VNNI 1
+#endif
+
+namespace {
+
+// The operands of a matmul, with the conventions of the matmul runtime
+// functions. 'rhs' holds u8 values if 'unsigned_rhs'.
+struct Int8MatMulArgs {
+  int32_t* out;
+  const int8_t* lhs;
+  const int8_t* rhs;
+  int64_t m;
+  int64_t n;
+  int64_t k;
+  bool transpose_lhs;
+  bool transpose_rhs;
+  bool unsigned_rhs;
+
+  int8_t Lhs(int64_t i, int64_t p) const {
+    return transpose_lhs ? lhs[p + i * k] : lhs[i + p * m];
+  }
+  int32_t Rhs(int64_t p, int64_t j) const {
+    const int8_t value = transpose_rhs ? rhs[j + p * n] : rhs[p + j * k];
+    return unsigned_rhs ? static_cast<uint8_t>(value) : value;
+  }
+};
+
+// Contracts the operands converted to s32 with Eigen.
+template <typename RhsType>
+void EigenInt8MatMul(const Eigen::ThreadPoolDevice& device,
+                     const Int8MatMulArgs& args) {
+  int64_t lhs_rows = args.m;
+  int64_t lhs_cols = args.k;
+  if (args.transpose_lhs) {
+    std::swap(lhs_rows, lhs_cols);
+  }
+  int64_t rhs_rows = args.k;
+  int64_t rhs_cols = args.n;
+  if (args.transpose_rhs) {
+    std::swap(rhs_rows, rhs_cols);
+  }
+
+  const Eigen::TensorMap<Eigen::Tensor<const int8_t, 2>, Eigen::Unaligned> A(
+      args.lhs, lhs_rows, lhs_cols);
+  const Eigen::TensorMap<Eigen::Tensor<const RhsType, 2>, Eigen::Unaligned> B(
+      reinterpret_cast<const RhsType*>(args.rhs), rhs_rows, rhs_cols);
+  Eigen::TensorMap<Eigen::Tensor<int32_t, 2>, Eigen::Unaligned> C(
+      args.out, args.m, args.n);
+
+  typedef Eigen::Tensor<int32_t, 2>::DimensionPair DimPair;
+  const Eigen::array<DimPair, 1> dims({DimPair(args.transpose_lhs ? 0 : 1,
+                                               args.transpose_rhs ? 1 : 0)});
+  C.device(device) = A.cast<int32_t>().contract(B.cast<int32_t>(), dims);
+}
+
+#if defined(XLA_CPU_INT8_MATMUL_VNNI)
+
+#define XLA_CPU_VNNI_TARGET \
+  __attribute__((target("avx512f,avx512bw,avx512vnni")))
+
+// vpdpbusd sums the products of 4 consecutive bytes into each of the 16 int32
+// lanes of a register. A tile of the output is 2 blocks of 16 rows by 8
+// columns, i.e. 16 accumulator registers.
+constexpr int64_t kBlockRows = 16;
+constexpr int64_t kDepthGroup = 4;
+constexpr int64_t kTileBlocks = 2;
+constexpr int64_t kTileCols = 8;
+
+bool HostSupportsVnni() {
+  using tsl::port::CPUFeature;
+  static const bool supported =
+      tsl::port::TestCPUFeature(CPUFeature::AVX512F) &&
+      tsl::port::TestCPUFeature(CPUFeature::AVX512BW) &&
+      tsl::port::TestCPUFeature(CPUFeature::AVX512_VNNI);
+  return supported;
+}
+
+// The operands packed for the VNNI kernel, padded with zeros to whole tiles
+// and depth groups.
+//
+// For every block of 16 rows, 'lhs' holds the 16 lanes x 4 bytes operand of
+// each depth group. For every panel of 8 columns, 'rhs' holds the 4 bytes of
+// each column in each depth group as one int32, to be broadcast to all lanes.
+//
+// vpdpbusd multiplies unsigned with signed bytes. Unless 'rhs' is already
+// unsigned, it is biased by 128 and 'lhs_bias' holds 128 times the sum of each
+// row of lhs, which is subtracted from the results.
+struct PackedInt8Operands {
+  int64_t num_blocks;
+  int64_t num_panels;
+  int64_t num_groups;
+  std::vector<int8_t> lhs;
+  std::vector<int32_t> lhs_bias;
+  std::vector<uint32_t> rhs;
+};
+
+PackedInt8Operands PackInt8Operands(const Eigen::ThreadPoolDevice& device,
+                                    const Int8MatMulArgs& args) {
+  PackedInt8Operands packed;
+  const int64_t tile_rows = kTileBlocks * kBlockRows;
+  packed.num_blocks = (args.m + tile_rows - 1) / tile_rows * kTileBlocks;
+  packed.num_panels = (args.n + kTileCols - 1) / kTileCols;
+  packed.num_groups = (args.k + kDepthGroup - 1) / kDepthGroup;
+  packed.lhs.resize(packed.num_blocks * packed.num_groups * kBlockRows *
+                    kDepthGroup);
+  packed.lhs_bias.resize(packed.num_blocks * kBlockRows);
+  packed.rhs.resize(packed.num_panels * packed.num_groups * kTileCols);
+
+  device.parallelFor(
+      packed.num_blocks,
+      Eigen::TensorOpCost(kBlockRows * args.k, kBlockRows * args.k,
+                          kBlockRows * args.k),
+      [&](Eigen::Index first, Eigen::Index last) {
+        for (int64_t block = first; block < last; ++block) {
+          int8_t* dst =
+              &packed.lhs[block * packed.num_groups * kBlockRows * kDepthGroup];
+          for (int64_t r = 0; r < kBlockRows; ++r) {
+            const int64_t i = block * kBlockRows + r;
+            int32_t sum = 0;
+            if (i < args.m) {
+              for (int64_t p = 0; p < args.k; ++p) {
+                const int8_t value = args.Lhs(i, p);
+                dst[(p / kDepthGroup) * kBlockRows * kDepthGroup +
+                    r * kDepthGroup + p % kDepthGroup] = value;
+                sum += value;
+              }
+            }
+            packed.lhs_bias[i] = args.unsigned_rhs ? 0 : sum * 128;
+          }
+        }
+      });
+
+  device.parallelFor(
+      packed.num_panels,
+      Eigen::TensorOpCost(kTileCols * args.k, kTileCols * args.k,
+                          kTileCols * args.k),
+      [&](Eigen::Index first, Eigen::Index last) {
+        for (int64_t panel = first; panel < last; ++panel) {
+          uint32_t* dst = &packed.rhs[panel * packed.num_groups * kTileCols];
+          const int64_t num_cols =
+              std::min(kTileCols, args.n - panel * kTileCols);
+          for (int64_t c = 0; c < num_cols; ++c) {
+            const int64_t j = panel * kTileCols + c;
+            for (int64_t p = 0; p < args.k; ++p) {
+              const uint32_t value = static_cast<uint8_t>(args.Rhs(p, j)) ^
+                                     (args.unsigned_rhs ? 0u : 0x80u);
+              dst[(p / kDepthGroup) * kTileCols + c] |=
+                  value << (8 * (p % kDepthGroup));
+            }
+          }
+        }
+      });
+  return packed;
+}
+
+// Computes the tile of 'kTileBlocks' blocks of rows starting at 'block' and
+// the columns of 'panel'.
+XLA_CPU_VNNI_TARGET void VnniTile(const PackedInt8Operands& packed,
+                                  const Int8MatMulArgs& args, int64_t block,
+                                  int64_t panel) {
+  const int64_t group_bytes = kBlockRows * kDepthGroup;
+  const int8_t* lhs =
+      packed.lhs.data() + block * packed.num_groups * group_bytes;
+  const int8_t* lhs_next = lhs + packed.num_groups * group_bytes;
+  const uint32_t* rhs =
+      packed.rhs.data() + panel * packed.num_groups * kTileCols;
+
+  __m512i acc[kTileBlocks][kTileCols];
+  for (int64_t b = 0; b < kTileBlocks; ++b) {
+    for (int64_t c = 0; c < kTileCols; ++c) {
+      acc[b][c] = _mm512_setzero_si512();
+    }
+  }
+  for (int64_t g = 0; g < packed.num_groups; ++g) {
+    const __m512i a0 = _mm512_loadu_si512(lhs + g * group_bytes);
+    const __m512i a1 = _mm512_loadu_si512(lhs_next + g * group_bytes);
+    for (int64_t c = 0; c < kTileCols; ++c) {
+      const __m512i b = _mm512_set1_epi32(rhs[g * kTileCols + c]);
+      acc[0][c] = _mm512_dpbusd_epi32(acc[0][c], b, a0);
+      acc[1][c] = _mm512_dpbusd_epi32(acc[1][c], b, a1);
+    }
+  }
+
+  const int64_t num_cols = std::min(kTileCols, args.n - panel * kTileCols);
+  for (int64_t b = 0; b < kTileBlocks; ++b) {
+    const int64_t row = (block + b) * kBlockRows;
+    if (row >= args.m) break;
+    const int64_t num_rows = std::min(kBlockRows, args.m - row);
+    const __mmask16 mask = static_cast<__mmask16>((1u << num_rows) - 1);
+    const __m512i bias = _mm512_loadu_si512(&packed.lhs_bias[row]);
+    for (int64_t c = 0; c < num_cols; ++c) {
+      const int64_t col = panel * kTileCols + c;
+      _mm512_mask_storeu_epi32(args.out + row + col * args.m, mask,
+                               _mm512_sub_epi32(acc[b][c], bias));
+    }
+  }
+}
+
+void VnniInt8MatMul(const Eigen::ThreadPoolDevice& device,
+                    const Int8MatMulArgs& args) {
+  const PackedInt8Operands packed = PackInt8Operands(device, args);
+  const int64_t num_tile_rows = packed.num_blocks / kTileBlocks;
+  const int64_t tile_macs = kTileBlocks * kBlockRows * kTileCols * args.k;
+  // Consecutive tiles share their rows of lhs, which stay in cache.
+  device.parallelFor(
+      num_tile_rows * packed.num_panels,
+      Eigen::TensorOpCost(
+          (kTileBlocks * kBlockRows + kTileCols) * args.k,
+          kTileBlocks * kBlockRows * kTileCols * sizeof(int32_t),
+          tile_macs / (kBlockRows * kDepthGroup)),
+      [&](Eigen::Index first, Eigen::Index last) {
+        for (int64_t tile = first; tile < last; ++tile) {
+          VnniTile(packed, args, (tile / packed.num_panels) * kTileBlocks,
+                   tile % packed.num_panels);
+        }
+      });
+}
+
+#endif  // XLA_CPU_INT8_MATMUL_VNNI
+
+void Int8MatMul(const Eigen::ThreadPoolDevice& device,
+                const Int8MatMulArgs& args) {
+  if (args.m == 0 || args.n == 0) return;
+#if defined(XLA_CPU_INT8_MATMUL_VNNI)
+  // The compiler only emits calls to this function for targets with VNNI, but
+  // an ahead-of-time compiled or cached executable may run on another host.
+  if (HostSupportsVnni()) {
+    VnniInt8MatMul(device, args);
+    return;
+  }
+#endif
+  if (args.unsigned_rhs) {
+    EigenInt8MatMul<uint8_t>(device, args);
+  } else {
+    EigenInt8MatMul<int8_t>(device, args);
+  }
+}
+
+const Eigen::ThreadPoolDevice& IntraOpThreadPool(const void* run_options_ptr) {
+  const xla::ExecutableRunOptions* run_options =
+      static_cast<const xla::ExecutableRunOptions*>(run_options_ptr);
+  XLA_LIGHTWEIGHT_CHECK(run_options->intra_op_thread_pool() != nullptr);
+  return *run_options->intra_op_thread_pool();
+}
+
+// Convolves an s8 or u8 input with an s8 kernel by multiplying the kernel with
+// the patches of the input.
+template <typename InputType>
+void Int8Conv2D(const void* run_options_ptr, int32_t* out,
+                const InputType* lhs, const int8_t* rhs, int64_t input_batch,
+                int64_t input_rows, int64_t input_cols, int64_t input_channels,
+                int64_t kernel_rows, int64_t kernel_cols,
+                int64_t kernel_channels, int64_t kernel_filters,
+                int64_t output_rows, int64_t output_cols, int64_t row_stride,
+                int64_t col_stride, int64_t padding_top,
+                int64_t padding_bottom, int64_t padding_left,
+                int64_t padding_right, int64_t lhs_row_dilation,
+                int64_t lhs_col_dilation, int64_t rhs_row_dilation,
+                int64_t rhs_col_dilation, int64_t feature_group_count) {
+  XLA_LIGHTWEIGHT_CHECK(feature_group_count == 1);
+  const Eigen::ThreadPoolDevice& device = IntraOpThreadPool(run_options_ptr);
+
+  const Eigen::TensorMap<Eigen::Tensor<const InputType, 4, Eigen::RowMajor>,
+                         Eigen::Unaligned>
+      input(lhs, input_batch, input_rows, input_cols, input_channels);
+
+  // The patches are laid out like in EigenConv2DImpl, as a row-major matrix
+  // with a row per output pixel that matches the row-major kernel, so that
+  // out = patches x kernel.
+  const int64_t num_patches = input_batch * output_rows * output_cols;
+  const int64_t patch_size = kernel_rows * kernel_cols * kernel_channels;
+  std::vector<InputType> patches(num_patches * patch_size);
+  Eigen::TensorMap<Eigen::Tensor<InputType, 2, Eigen::RowMajor>,
+                   Eigen::Unaligned>(patches.data(), num_patches, patch_size)
+      .device(device) =
+      input
+          .extract_image_patches(kernel_cols, kernel_rows, col_stride,
+                                 row_stride, rhs_col_dilation,
+                                 rhs_row_dilation, lhs_col_dilation,
+                                 lhs_row_dilation, padding_left, padding_right,
+                                 padding_top, padding_bottom, InputType{0})
+          .reshape(Eigen::DSizes<Eigen::Index, 2>(num_patches, patch_size));
+
+  // In column-major order, out is filters x patches, the kernel is filters x
+  // patch_size and the patches are patch_size x patches.
+  Int8MatMul(device,
+             Int8MatMulArgs{out, rhs,
+                            reinterpret_cast<const int8_t*>(patches.data()),
+                            kernel_filters, num_patches, patch_size,
+                            /*transpose_lhs=*/false, /*transpose_rhs=*/false,
+                            std::is_same_v<InputType, uint8_t>});
+}
+
+}  // namespace
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_Int8MatMul(
+    const void* run_options_ptr, int32_t* out, int8_t* lhs, int8_t* rhs,
+    int64_t m, int64_t n, int64_t k, int32_t transpose_lhs,
+    int32_t transpose_rhs) {
+  Int8MatMul(IntraOpThreadPool(run_options_ptr),
+             Int8MatMulArgs{out, lhs, rhs, m, n, k, transpose_lhs != 0,
+                            transpose_rhs != 0, /*unsigned_rhs=*/false});
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_Int8MatMulU8(
+    const void* run_options_ptr, int32_t* out, int8_t* lhs, uint8_t* rhs,
+    int64_t m, int64_t n, int64_t k, int32_t transpose_lhs,
+    int32_t transpose_rhs) {
+  Int8MatMul(IntraOpThreadPool(run_options_ptr),
+             Int8MatMulArgs{out, lhs, reinterpret_cast<const int8_t*>(rhs), m,
+                            n, k, transpose_lhs != 0, transpose_rhs != 0,
+                            /*unsigned_rhs=*/true});
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_Int8Conv2D(
+    const void* run_options_ptr, int32_t* out, int8_t* lhs, int8_t* rhs,
+    int64_t input_batch, int64_t input_rows, int64_t input_cols,
+    int64_t input_channels, int64_t kernel_rows, int64_t kernel_cols,
+    int64_t kernel_channels, int64_t kernel_filters, int64_t output_rows,
+    int64_t output_cols, int64_t row_stride, int64_t col_stride,
+    int64_t padding_top, int64_t padding_bottom, int64_t padding_left,
+    int64_t padding_right, int64_t lhs_row_dilation, int64_t lhs_col_dilation,
+    int64_t rhs_row_dilation, int64_t rhs_col_dilation,
+    int64_t feature_group_count) {
+  Int8Conv2D(run_options_ptr, out, lhs, rhs, input_batch, input_rows,
+             input_cols, input_channels, kernel_rows, kernel_cols,
+             kernel_channels, kernel_filters, output_rows, output_cols,
+             row_stride, col_stride, padding_top, padding_bottom, padding_left,
+             padding_right, lhs_row_dilation, lhs_col_dilation,
+             rhs_row_dilation, rhs_col_dilation, feature_group_count);
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_Int8Conv2DU8(
+    const void* run_options_ptr, int32_t* out, uint8_t* lhs, int8_t* rhs,
+    int64_t input_batch, int64_t input_rows, int64_t input_cols,
+    int64_t input_channels, int64_t kernel_rows, int64_t kernel_cols,
+    int64_t kernel_channels, int64_t kernel_filters, int64_t output_rows,
+    int64_t output_cols, int64_t row_stride, int64_t col_stride,
+    int64_t padding_top, int64_t padding_bottom, int64_t padding_left,
+    int64_t padding_right, int64_t lhs_row_dilation, int64_t lhs_col_dilation,
+    int64_t rhs_row_dilation, int64_t rhs_col_dilation,
+    int64_t feature_group_count) {
+  Int8Conv2D(run_options_ptr, out, lhs, rhs, input_batch, input_rows,
+             input_cols, input_channels, kernel_rows, kernel_cols,
+             kernel_channels, kernel_filters, output_rows, output_cols,
+             row_stride, col_stride, padding_top, padding_bottom, padding_left,
+             padding_right, lhs_row_dilation, lhs_col_dilation,
+             rhs_row_dilation, rhs_col_dilation, feature_group_count);
+}
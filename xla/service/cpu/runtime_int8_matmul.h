@@ -0,0 +1,72 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_CPU_RUNTIME_INT8_MATMUL_H_
+#define XLA_SERVICE_CPU_RUNTIME_INT8_MATMUL_H_
+
+#include <stdint.h>
+
+extern "C" {
+
+// Performs a multi-threaded matrix multiplication of s8 matrices, accumulating
+// into s32 with wrap-around like a dot of the operands converted to s32. The
+// conventions are those of __xla_cpu_runtime_EigenMatMulS32: 'lhs' is m x k,
+// 'rhs' is k x n and 'out' is m x n, all in column-major order.
+//
+// Uses AVX512-VNNI dot product instructions if the host supports them, and an
+// Eigen contraction otherwise.
+extern void __xla_cpu_runtime_Int8MatMul(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, int32_t* out,
+    int8_t* lhs, int8_t* rhs, int64_t m, int64_t n, int64_t k,
+    int32_t transpose_lhs, int32_t transpose_rhs);
+
+// Like __xla_cpu_runtime_Int8MatMul, with a u8 'rhs'. The VNNI dot product
+// instructions multiply u8 with s8 values natively.
+extern void __xla_cpu_runtime_Int8MatMulU8(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, int32_t* out,
+    int8_t* lhs, uint8_t* rhs, int64_t m, int64_t n, int64_t k,
+    int32_t transpose_lhs, int32_t transpose_rhs);
+
+// Performs a multi-threaded 2D convolution of an s8 input with an s8 kernel
+// into an s32 output, with the conventions of __xla_cpu_runtime_EigenConv2DF32.
+// The patches of the input are extracted as s8 and multiplied with the kernel
+// as in __xla_cpu_runtime_Int8MatMul. Grouped convolutions are not supported.
+extern void __xla_cpu_runtime_Int8Conv2D(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, int32_t* out,
+    int8_t* lhs, int8_t* rhs, int64_t input_batch, int64_t input_rows,
+    int64_t input_cols, int64_t input_channels, int64_t kernel_rows,
+    int64_t kernel_cols, int64_t kernel_channels, int64_t kernel_filters,
+    int64_t output_rows, int64_t output_cols, int64_t row_stride,
+    int64_t col_stride, int64_t padding_top, int64_t padding_bottom,
+    int64_t padding_left, int64_t padding_right, int64_t lhs_row_dilation,
+    int64_t lhs_col_dilation, int64_t rhs_row_dilation,
+    int64_t rhs_col_dilation, int64_t feature_group_count);
+
+// Like __xla_cpu_runtime_Int8Conv2D, with a u8 input whose patches are
+// multiplied with the kernel as in __xla_cpu_runtime_Int8MatMulU8.
+extern void __xla_cpu_runtime_Int8Conv2DU8(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, int32_t* out,
+    uint8_t* lhs, int8_t* rhs, int64_t input_batch, int64_t input_rows,
+    int64_t input_cols, int64_t input_channels, int64_t kernel_rows,
+    int64_t kernel_cols, int64_t kernel_channels, int64_t kernel_filters,
+    int64_t output_rows, int64_t output_cols, int64_t row_stride,
+    int64_t col_stride, int64_t padding_top, int64_t padding_bottom,
+    int64_t padding_left, int64_t padding_right, int64_t lhs_row_dilation,
+    int64_t lhs_col_dilation, int64_t rhs_row_dilation,
+    int64_t rhs_col_dilation, int64_t feature_group_count);
+
+}  // extern "C"
+
+#endif  // XLA_SERVICE_CPU_RUNTIME_INT8_MATMUL_H_
@@ -14,14 +14,184 @@ limitations under the License.
 ==============================================================================*/
 #include "xla/service/cpu/runtime_key_value_sort.h"
 
+#define EIGEN_USE_THREADS
+
 #include <algorithm>
+#include <cstdint>
 #include <cstring>
+#include <functional>
 #include <memory>
 #include <numeric>
-#include <string>
+#include <vector>
 
 #include "absl/base/dynamic_annotations.h"
 #include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "xla/executable_run_options.h"
+#include "tsl/platform/blocking_counter.h"
+
+namespace {
+
+// Sorts with fewer elements than this run on a single thread.
+constexpr int64_t kMinParallelSortElements = 1 << 15;
+
+// Returns the intra-op thread pool of `run_options`, or null if there is none
+// or it has a single thread.
+//
+// ParallelFor blocks until all the work it schedules is done. Inside a pool
+// thread, e.g. a task of a task graph, the work could wait behind the very
+// threads blocked on it, so sorts called there don't use the pool either.
+const Eigen::ThreadPoolDevice* GetThreadPool(const void* run_options) {
+  if (run_options == nullptr) return nullptr;
+  const Eigen::ThreadPoolDevice* pool =
+      static_cast<const xla::ExecutableRunOptions*>(run_options)
+          ->intra_op_thread_pool();
+  return pool != nullptr && pool->numThreads() > 1 &&
+                 pool->currentThreadId() == -1
+             ? pool
+             : nullptr;
+}
+
+// Calls `fn(i)` for every i in [0, n) on `pool`, the first call on the calling
+// thread, and waits for all of them to finish.
+void ParallelFor(const Eigen::ThreadPoolDevice* pool, int64_t n,
+                 const std::function<void(int64_t)>& fn) {
+  tsl::BlockingCounter counter(n - 1);
+  for (int64_t i = 1; i < n; ++i) {
+    pool->enqueueNoNotification([i, &fn, &counter]() {
+      fn(i);
+      counter.DecrementCount();
+    });
+  }
+  fn(0);
+  counter.Wait();
+}
+
+// Sorts [begin, end) with the comparators returned by `make_less`. Each thread
+// calls `make_less` for a comparator of its own, which is used by reference.
+// Long ranges are split into chunks that are sorted in parallel and then
+// merged pairwise, also in parallel.
+template <typename T, typename MakeLess>
+void Sort(T* begin, T* end, bool is_stable, const MakeLess& make_less,
+          const Eigen::ThreadPoolDevice* pool) {
+  const int64_t n = end - begin;
+  const int64_t num_chunks =
+      pool == nullptr ? 1
+                      : std::min<int64_t>(pool->numThreads(),
+                                          n / (kMinParallelSortElements / 2));
+  auto sort_range = [&](T* first, T* last) {
+    auto less = make_less();
+    if (is_stable) {
+      std::stable_sort(first, last, std::ref(less));
+    } else {
+      std::sort(first, last, std::ref(less));
+    }
+  };
+  if (num_chunks <= 1) {
+    sort_range(begin, end);
+    return;
+  }
+
+  std::vector<int64_t> bounds(num_chunks + 1);
+  for (int64_t i = 0; i <= num_chunks; ++i) {
+    bounds[i] = n * i / num_chunks;
+  }
+  ParallelFor(pool, num_chunks, [&](int64_t i) {
+    sort_range(begin + bounds[i], begin + bounds[i + 1]);
+  });
+
+  // std::merge takes equivalent elements from its first range first, which
+  // keeps stable sorts stable.
+  std::unique_ptr<T[]> scratch(new T[n]);
+  T* src = begin;
+  T* dst = scratch.get();
+  for (int64_t width = 1; width < num_chunks; width *= 2) {
+    const int64_t num_merges = (num_chunks + 2 * width - 1) / (2 * width);
+    ParallelFor(pool, num_merges, [&](int64_t i) {
+      const int64_t lo = bounds[2 * i * width];
+      const int64_t mid = bounds[std::min(num_chunks, (2 * i + 1) * width)];
+      const int64_t hi = bounds[std::min(num_chunks, (2 * i + 2) * width)];
+      auto less = make_less();
+      std::merge(src + lo, src + mid, src + mid, src + hi, dst + lo,
+                 std::ref(less));
+    });
+    std::swap(src, dst);
+  }
+  if (src != begin) {
+    std::copy(src, src + n, begin);
+  }
+}
+
+// Calls `sort_rows(first, last)` to sort rows [first, last) of the
+// `num_rows` rows of `row_elements` elements. Rows are split between the
+// threads of `pool` if there are enough of them; otherwise `sort_rows` may
+// sort each row in parallel.
+void SortRows(int64_t num_rows, int64_t row_elements,
+              const Eigen::ThreadPoolDevice* pool,
+              const std::function<void(int64_t, int64_t,
+                                       const Eigen::ThreadPoolDevice*)>&
+                  sort_rows) {
+  if (pool == nullptr || num_rows * row_elements < kMinParallelSortElements) {
+    sort_rows(0, num_rows, nullptr);
+    return;
+  }
+  if (num_rows < pool->numThreads()) {
+    sort_rows(0, num_rows, pool);
+    return;
+  }
+  const int64_t num_tasks = pool->numThreads();
+  ParallelFor(pool, num_tasks, [&](int64_t i) {
+    sort_rows(num_rows * i / num_tasks, num_rows * (i + 1) / num_tasks,
+              nullptr);
+  });
+}
+
+// Returns the offset of the first element of row `row` in a [a, b, c] shape
+// sorted along b, in elements.
+int64_t RowBaseOffset(int64_t row, int64_t b, int64_t c) {
+  // 'row' can be split into two values which index into the 'c' dimension
+  // and the 'a' dimension, respectively. 'row' % 'c' is the index into the
+  // 'c' dimension, 'row' / 'c' is the index into the 'a' dimension. When
+  // calculating the base offset, we need to multiply the index into the 'a'
+  // dimension with 'b' * 'c'.
+  // 'row' / 'c' * 'c' * 'b' = ('row' - 'row' % 'c') * 'b'.
+  return row % c + (row - row % c) * b;
+}
+
+template <typename T, typename Less>
+void SortPrimitive(int64_t a, int64_t b, int64_t c, T* data, bool is_stable,
+                   const Eigen::ThreadPoolDevice* pool) {
+  auto make_less = []() { return Less(); };
+  SortRows(a * c, b, pool,
+           [&](int64_t first, int64_t last,
+               const Eigen::ThreadPoolDevice* row_pool) {
+             // Rows that aren't contiguous are sorted in a contiguous copy.
+             std::unique_ptr<T[]> row(c == 1 ? nullptr : new T[b]);
+             for (int64_t r = first; r < last; ++r) {
+               T* base = data + RowBaseOffset(r, b, c);
+               if (c == 1) {
+                 Sort(base, base + b, is_stable, make_less, row_pool);
+                 continue;
+               }
+               for (int64_t i = 0; i < b; ++i) row[i] = base[i * c];
+               Sort(row.get(), row.get() + b, is_stable, make_less, row_pool);
+               for (int64_t i = 0; i < b; ++i) base[i * c] = row[i];
+             }
+           });
+}
+
+template <typename T>
+void SortPrimitive(int64_t a, int64_t b, int64_t c, char* data,
+                   bool descending, bool is_stable,
+                   const Eigen::ThreadPoolDevice* pool) {
+  T* typed_data = reinterpret_cast<T*>(data);
+  if (descending) {
+    SortPrimitive<T, std::greater<T>>(a, b, c, typed_data, is_stable, pool);
+  } else {
+    SortPrimitive<T, std::less<T>>(a, b, c, typed_data, is_stable, pool);
+  }
+}
+
+}  // namespace
 
 ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_KeyValueSort(
     int64_t a, int64_t b, int64_t c, char** values, int32_t values_count,
@@ -41,71 +211,110 @@ ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_KeyValueSort(
   // dimensions (set to 1 if b is the most major dimension). There are a * c
   // many rows that we need to sort. We iterate through these, calculate a
   // 'base_offset' value which points to the first element in that row, and add
-  // i * c for accessing the 'i'-th element in that row.
+  // i * c for accessing the 'i'-th element in that row. The rows are sorted
+  // concurrently by the threads of the intra-op thread pool.
 
   int64_t sort_dimension_elements = b;
   int64_t num_iteration_elements = a * c;
   int64_t sort_dimension_offset = c;
+  int32_t max_primitive_type_size = *std::max_element(
+      values_primitive_type_size_in_bytes,
+      values_primitive_type_size_in_bytes + values_count);
 
-  std::unique_ptr<int64_t[]> indices(new int64_t[sort_dimension_elements]);
-  std::unique_ptr<char*[]> comparison_values(new char*[2 * values_count]);
-  std::iota(indices.get(), indices.get() + sort_dimension_elements, 0);
-  std::unique_ptr<std::string[]> reordered_values(
-      new std::string[sort_dimension_elements]);
-  for (int64_t index = 0; index < num_iteration_elements; ++index) {
-    // If the sort should be stable, we have to reinitialize indices to iota to
-    // guarantee that we still keep the relative order in case of ties.
-    if (is_stable && index > 0) {
+  auto sort_rows = [&](int64_t first, int64_t last,
+                       const Eigen::ThreadPoolDevice* row_pool) {
+    std::unique_ptr<int64_t[]> indices(new int64_t[sort_dimension_elements]);
+    std::unique_ptr<char[]> reordered_values(
+        new char[sort_dimension_elements * max_primitive_type_size]);
+    for (int64_t index = first; index < last; ++index) {
+      // Start every row from the identity permutation, so that stable sorts
+      // keep the relative order of ties.
       std::iota(indices.get(), indices.get() + sort_dimension_elements, 0);
-    }
-    // 'index' can be split into two values which index into the 'c' dimension
-    // and the 'a' dimension, respectively. 'index' % 'c' is the index into the
-    // 'c' dimension, 'index' / 'c' is the index into the 'a' dimension. When
-    // calculating the base offset, we need to multiply the index into the 'a'
-    // dimension with 'b' * 'c'.
-    // 'index' / 'c' * 'c' * 'b' = ('index' - 'index' % 'c') * 'b'.
-    int64_t base_offset =
-        index % sort_dimension_offset +
-        (index - index % sort_dimension_offset) * sort_dimension_elements;
-    auto compare_function = [&](int64_t a, int64_t b) -> bool {
-      for (int32_t i = 0; i < values_count; ++i) {
-        int64_t memory_index_lhs = (base_offset + a * sort_dimension_offset) *
-                                   values_primitive_type_size_in_bytes[i];
-        int64_t memory_index_rhs = (base_offset + b * sort_dimension_offset) *
-                                   values_primitive_type_size_in_bytes[i];
-        comparison_values[i * 2] = values[i] + memory_index_lhs;
-        comparison_values[i * 2 + 1] = values[i] + memory_index_rhs;
+      int64_t base_offset = RowBaseOffset(index, sort_dimension_elements,
+                                          sort_dimension_offset);
+      // Every thread comparing elements needs buffers of its own for the
+      // comparator's arguments.
+      auto make_less = [&]() {
+        return [&, comparison_values = std::vector<char*>(2 * values_count)](
+                   int64_t a, int64_t b) mutable -> bool {
+          for (int32_t i = 0; i < values_count; ++i) {
+            int64_t memory_index_lhs =
+                (base_offset + a * sort_dimension_offset) *
+                values_primitive_type_size_in_bytes[i];
+            int64_t memory_index_rhs =
+                (base_offset + b * sort_dimension_offset) *
+                values_primitive_type_size_in_bytes[i];
+            comparison_values[i * 2] = values[i] + memory_index_lhs;
+            comparison_values[i * 2 + 1] = values[i] + memory_index_rhs;
+          }
+          char result = 0;  // Overwritten by less_than.
+          less_than(&result, run_options, comparison_values.data(), nullptr,
+                    prof_counters);
+          return result != 0u;
+        };
+      };
+      Sort(indices.get(), indices.get() + sort_dimension_elements, is_stable,
+           make_less, row_pool);
+
+      // Reorder the values according to the order defined by 'indices'.
+      for (int32_t idx = 0; idx < values_count; ++idx) {
+        const int32_t size = values_primitive_type_size_in_bytes[idx];
+        for (int64_t i = 0; i < sort_dimension_elements; ++i) {
+          int64_t memory_index =
+              (base_offset + indices[i] * sort_dimension_offset) * size;
+          memcpy(reordered_values.get() + i * size, values[idx] + memory_index,
+                 size);
+        }
+        for (int64_t i = 0; i < sort_dimension_elements; ++i) {
+          int64_t memory_index =
+              (base_offset + i * sort_dimension_offset) * size;
+          memcpy(values[idx] + memory_index, reordered_values.get() + i * size,
+                 size);
+        }
       }
-      char result = 0;  // Overwritten by less_than.
-      less_than(&result, run_options, comparison_values.get(), nullptr,
-                prof_counters);
-      return result != 0u;
-    };
-    if (is_stable) {
-      std::stable_sort(indices.get(), indices.get() + sort_dimension_elements,
-                       compare_function);
-    } else {
-      std::sort(indices.get(), indices.get() + sort_dimension_elements,
-                compare_function);
     }
+  };
+  SortRows(num_iteration_elements, sort_dimension_elements,
+           GetThreadPool(run_options), sort_rows);
+}
 
-    // Reorder the values according to the order defined by 'indices'.
-    for (int32_t idx = 0; idx < values_count; ++idx) {
-      for (int64_t i = 0; i < sort_dimension_elements; ++i) {
-        int64_t memory_index =
-            (base_offset + indices[i] * sort_dimension_offset) *
-            values_primitive_type_size_in_bytes[idx];
-
-        reordered_values[i] =
-            std::string(values[idx] + memory_index,
-                        values_primitive_type_size_in_bytes[idx]);
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_SortPrimitive(
+    int64_t a, int64_t b, int64_t c, char* data,
+    int32_t primitive_type_size_in_bytes, bool is_floating_point,
+    bool is_signed, bool descending, bool is_stable, char* run_options) {
+  const Eigen::ThreadPoolDevice* pool = GetThreadPool(run_options);
+  switch (primitive_type_size_in_bytes) {
+    case 1:
+      if (is_signed) {
+        SortPrimitive<int8_t>(a, b, c, data, descending, is_stable, pool);
+      } else {
+        SortPrimitive<uint8_t>(a, b, c, data, descending, is_stable, pool);
       }
-      for (int64_t i = 0; i < sort_dimension_elements; ++i) {
-        int64_t memory_index = (base_offset + i * sort_dimension_offset) *
-                               values_primitive_type_size_in_bytes[idx];
-        memcpy(values[idx] + memory_index, reordered_values[i].c_str(),
-               values_primitive_type_size_in_bytes[idx]);
+      break;
+    case 2:
+      if (is_signed) {
+        SortPrimitive<int16_t>(a, b, c, data, descending, is_stable, pool);
+      } else {
+        SortPrimitive<uint16_t>(a, b, c, data, descending, is_stable, pool);
       }
-    }
+      break;
+    case 4:
+      if (is_floating_point) {
+        SortPrimitive<float>(a, b, c, data, descending, is_stable, pool);
+      } else if (is_signed) {
+        SortPrimitive<int32_t>(a, b, c, data, descending, is_stable, pool);
+      } else {
+        SortPrimitive<uint32_t>(a, b, c, data, descending, is_stable, pool);
+      }
+      break;
+    case 8:
+      if (is_floating_point) {
+        SortPrimitive<double>(a, b, c, data, descending, is_stable, pool);
+      } else if (is_signed) {
+        SortPrimitive<int64_t>(a, b, c, data, descending, is_stable, pool);
+      } else {
+        SortPrimitive<uint64_t>(a, b, c, data, descending, is_stable, pool);
+      }
+      break;
   }
 }
@@ -29,6 +29,8 @@ extern "C" {
 // 'values' and 'values_primitive_type_size_in_bytes'. The size of the primitive
 // type of the i-th shape has exactly 'values_primitive_type_size_in_bytes[i]'
 // bytes. 'is_stable' specifies whether the sorting should be stable.
+// The rows are sorted concurrently on the intra-op thread pool of
+// 'run_options', if it has one, and so are the parts of long rows.
 // 'run_options' and 'prof_counters' are passed through to the less-than
 // function, which expects the following arguments:
 // - pointer to the return value buffer (char*)
@@ -41,6 +43,17 @@ extern void __xla_cpu_runtime_KeyValueSort(
     int32_t* values_primitive_type_size_in_bytes, bool is_stable,
     char* run_options, int64_t* prof_counters,
     void (*less_than)(char*, char*, char**, char**, int64_t*));
+
+// Sorts the 'b' dimension of the [a, b, c] shaped array 'data' of a primitive
+// type with the natural order of the type, or its reverse if 'descending' is
+// set. This is the same as __xla_cpu_runtime_KeyValueSort with a single
+// operand and a less-than comparator, without calling the comparator. The
+// primitive type is an integer of 1, 2, 4 or 8 bytes, 'is_signed' or not, or
+// a 4 or 8 byte floating point type if 'is_floating_point' is set.
+extern void __xla_cpu_runtime_SortPrimitive(
+    int64_t a, int64_t b, int64_t c, char* data,
+    int32_t primitive_type_size_in_bytes, bool is_floating_point,
+    bool is_signed, bool descending, bool is_stable, char* run_options);
 }
 
 #endif  // XLA_SERVICE_CPU_RUNTIME_KEY_VALUE_SORT_H_
@@ -0,0 +1,264 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/runtime_task_graph.h"
+
+#define EIGEN_USE_THREADS
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/dynamic_annotations.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "xla/executable_run_options.h"
+#include "xla/service/custom_call_status_internal.h"
+#include "tsl/platform/logging.h"
+
+namespace {
+
+using ComputeFunctionType = void (*)(void*, const void*, const void**, void**,
+                                     void*, uint64_t*);
+
+// Bounds the number of task graph workers on each intra-op thread pool, over
+// all executions sharing the pool.
+//
+// Tasks may themselves block on work they enqueue on the same thread pool
+// (e.g. parallel fork/join calls or Eigen matmuls). Leaving at least one
+// thread of the pool to such work guarantees that it makes progress, however
+// many task graphs run on the pool at once.
+class WorkerAdmission {
+ public:
+  // Admits a worker on `pool` if fewer than `pool.numThreads() - 1` are
+  // admitted; returns whether it did.
+  static bool TryAdmit(const Eigen::ThreadPoolDevice* pool) {
+    if (pool->numThreads() <= 1) return false;
+    absl::MutexLock lock(&mu_);
+    int64_t& num_workers = (*num_workers_)[pool->getPool()];
+    if (num_workers >= pool->numThreads() - 1) {
+      return false;
+    }
+    ++num_workers;
+    return true;
+  }
+
+  // Releases a worker admitted on `pool`. Takes the underlying pool, since
+  // the device may be gone by the time a late worker exits.
+  static void Release(const Eigen::ThreadPoolInterface* pool) {
+    absl::MutexLock lock(&mu_);
+    auto it = num_workers_->find(pool);
+    if (--it->second == 0) {
+      num_workers_->erase(it);
+    }
+  }
+
+ private:
+  static absl::Mutex mu_;
+  static absl::flat_hash_map<const Eigen::ThreadPoolInterface*, int64_t>*
+      num_workers_ ABSL_GUARDED_BY(mu_);
+};
+
+ABSL_CONST_INIT absl::Mutex WorkerAdmission::mu_(absl::kConstInit);
+absl::flat_hash_map<const Eigen::ThreadPoolInterface*, int64_t>*
+    WorkerAdmission::num_workers_ =
+        new absl::flat_hash_map<const Eigen::ThreadPoolInterface*, int64_t>();
+
+// Runs the tasks of a task graph. Ready tasks are run by the calling thread
+// and by workers on the intra-op thread pool, which are started as tasks
+// become ready, as far as WorkerAdmission allows, and exit when they run out
+// of them. Since the calling thread drains its own graph, it finishes even if
+// no worker is admitted or none gets to run.
+//
+// Workers share ownership of the executor, since they may start or still be
+// releasing its lock after the calling thread returned.
+class TaskGraphExecutor
+    : public std::enable_shared_from_this<TaskGraphExecutor> {
+ public:
+  TaskGraphExecutor(const void* run_options_ptr, void** buffer_table,
+                    uint64_t* prof_counters, int32_t num_tasks,
+                    void** task_functions, const int32_t* num_predecessors,
+                    const int32_t* successor_offsets, const int32_t* successors)
+      : run_options_ptr_(run_options_ptr),
+        buffer_table_(buffer_table),
+        prof_counters_(prof_counters),
+        num_tasks_(num_tasks),
+        task_functions_(task_functions),
+        successor_offsets_(successor_offsets),
+        successors_(successors),
+        pending_predecessors_(num_predecessors, num_predecessors + num_tasks),
+        statuses_(num_tasks) {
+    const auto* run_options =
+        static_cast<const xla::ExecutableRunOptions*>(run_options_ptr);
+    pool_ = run_options == nullptr ? nullptr
+                                   : run_options->intra_op_thread_pool();
+    thread_pool_ = pool_ == nullptr ? nullptr : pool_->getPool();
+    for (int32_t i = 0; i < num_tasks; ++i) {
+      if (pending_predecessors_[i] == 0) {
+        ready_.push_back(i);
+      }
+    }
+  }
+
+  // Runs all tasks, and returns once they have all finished. Workers that are
+  // still queued on the pool then find no ready task and exit.
+  void Run() {
+    absl::MutexLock lock(&mu_);
+    StartWorkers();
+    while (true) {
+      mu_.Await(absl::Condition(
+          +[](TaskGraphExecutor* e) {
+            return !e->ready_.empty() || e->num_finished_ == e->num_tasks_;
+          },
+          this));
+      if (num_finished_ == num_tasks_) break;
+      RunReadyTask();
+    }
+  }
+
+  // Returns the error messages of the tasks that failed, if any.
+  std::vector<std::pair<int32_t, absl::string_view>> ErrorMessages() const {
+    std::vector<std::pair<int32_t, absl::string_view>> error_messages;
+    for (int32_t i = 0; i < num_tasks_; ++i) {
+      std::optional<absl::string_view> msg =
+          xla::CustomCallStatusGetMessage(&statuses_[i]);
+      if (msg) {
+        error_messages.emplace_back(i, *msg);
+      }
+    }
+    return error_messages;
+  }
+
+ private:
+  // Starts workers for the ready tasks the calling thread won't run itself.
+  void StartWorkers() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    if (pool_ == nullptr) return;
+    int64_t num_new_workers =
+        static_cast<int64_t>(ready_.size()) - 1 - num_idle_workers_;
+    for (; num_new_workers > 0; --num_new_workers) {
+      if (!WorkerAdmission::TryAdmit(pool_)) return;
+      ++num_idle_workers_;
+      pool_->enqueueNoNotification([self = shared_from_this()]() {
+        {
+          absl::MutexLock lock(&self->mu_);
+          --self->num_idle_workers_;
+          while (!self->ready_.empty()) {
+            self->RunReadyTask();
+          }
+        }
+        WorkerAdmission::Release(self->thread_pool_);
+      });
+    }
+  }
+
+  // Pops a ready task and runs it without holding the lock. Once it finishes,
+  // its successors whose predecessors have all finished become ready.
+  void RunReadyTask() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    const int32_t task = ready_.back();
+    ready_.pop_back();
+    // Tasks after a failed one may read buffers that were never written, so
+    // they are skipped.
+    const bool skip = failed_;
+    mu_.Unlock();
+    if (!skip) {
+      auto function = reinterpret_cast<ComputeFunctionType>(
+          task_functions_[task]);
+      function(nullptr, run_options_ptr_, nullptr, buffer_table_,
+               &statuses_[task], prof_counters_);
+      VLOG(3) << "ExecuteTaskGraph task " << task << " done.";
+    }
+    const bool task_failed =
+        !skip && xla::CustomCallStatusGetMessage(&statuses_[task]).has_value();
+    mu_.Lock();
+    failed_ |= task_failed;
+    ++num_finished_;
+    for (int32_t i = successor_offsets_[task];
+         i < successor_offsets_[task + 1]; ++i) {
+      if (--pending_predecessors_[successors_[i]] == 0) {
+        ready_.push_back(successors_[i]);
+      }
+    }
+    StartWorkers();
+  }
+
+  const void* run_options_ptr_;
+  void** buffer_table_;
+  uint64_t* prof_counters_;
+  const int32_t num_tasks_;
+  void** task_functions_;
+  const int32_t* successor_offsets_;
+  const int32_t* successors_;
+  const Eigen::ThreadPoolDevice* pool_;
+  const Eigen::ThreadPoolInterface* thread_pool_;
+
+  absl::Mutex mu_;
+  std::vector<int32_t> pending_predecessors_ ABSL_GUARDED_BY(mu_);
+  std::vector<int32_t> ready_ ABSL_GUARDED_BY(mu_);
+  int32_t num_finished_ ABSL_GUARDED_BY(mu_) = 0;
+  // Workers that were enqueued but have not started running tasks yet.
+  int64_t num_idle_workers_ ABSL_GUARDED_BY(mu_) = 0;
+  bool failed_ ABSL_GUARDED_BY(mu_) = false;
+  // Each task writes its own status, without holding the lock.
+  std::vector<XlaCustomCallStatus> statuses_;
+};
+
+}  // namespace
+
+// The task graph is emitted as constant arrays by the IrEmitter. Its tasks are
+// compute functions without dynamic loop bounds, which read all buffers
+// through 'buffer_table'.
+//
+// EX: A graph where tasks 1 and 2 depend on task 0, and task 3 on both of
+//     them, has
+//
+//   num_predecessors:  [0, 1, 1, 2]
+//   successor_offsets: [0, 2, 3, 4, 4]
+//   successors:        [1, 2, 3, 3]
+//
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_ExecuteTaskGraph(
+    const void* run_options_ptr, void** buffer_table, void* status,
+    uint64_t* prof_counters, int32_t num_tasks, void** task_functions,
+    const int32_t* num_predecessors, const int32_t* successor_offsets,
+    const int32_t* successors) {
+  VLOG(2) << "ExecuteTaskGraph ENTRY num_tasks: " << num_tasks;
+  auto executor = std::make_shared<TaskGraphExecutor>(
+      run_options_ptr, buffer_table, prof_counters, num_tasks, task_functions,
+      num_predecessors, successor_offsets, successors);
+  executor->Run();
+
+  std::vector<std::pair<int32_t, absl::string_view>> error_messages =
+      executor->ErrorMessages();
+  if (!error_messages.empty()) {
+    std::string error_message = absl::StrJoin(
+        error_messages, "\n",
+        [](std::string* out, std::pair<int32_t, absl::string_view> p) {
+          absl::StrAppend(out,
+                          absl::StrFormat("Task %d error: %s", p.first,
+                                          p.second));
+        });
+    XlaCustomCallStatusSetFailure(
+        reinterpret_cast<XlaCustomCallStatus*>(status), error_message.data(),
+        error_message.length());
+  }
+  VLOG(2) << "ExecuteTaskGraph EXIT";
+}
@@ -0,0 +1,37 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_CPU_RUNTIME_TASK_GRAPH_H_
+#define XLA_SERVICE_CPU_RUNTIME_TASK_GRAPH_H_
+
+#include <stdint.h>
+
+extern "C" {
+
+// Calls the 'num_tasks' compute functions in 'task_functions' once each, on
+// the intra-op thread pool, and returns once all of them have finished. Task
+// 'i' runs once the 'num_predecessors[i]' tasks it depends on have finished.
+// The tasks that depend on task 'i' are
+// 'successors[successor_offsets[i]:successor_offsets[i + 1]]'. See comments in
+// runtime_task_graph.cc for details.
+extern void __xla_cpu_runtime_ExecuteTaskGraph(
+    const void* run_options_ptr, void** buffer_table, void* status,
+    uint64_t* prof_counters, int32_t num_tasks, void** task_functions,
+    const int32_t* num_predecessors, const int32_t* successor_offsets,
+    const int32_t* successors);
+
+}  // extern "C"
+
+#endif  // XLA_SERVICE_CPU_RUNTIME_TASK_GRAPH_H_
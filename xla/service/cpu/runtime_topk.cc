@@ -15,49 +15,88 @@ limitations under the License.
 
 #include "xla/service/cpu/runtime_topk.h"
 
+#define EIGEN_USE_THREADS
+
 #include <algorithm>
+#include <cstdint>
 #include <cstring>
+#include <functional>
 #include <limits>
-#include <memory>
 #include <numeric>
+#include <type_traits>
 #include <vector>
 
 #include "absl/base/dynamic_annotations.h"
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "xla/executable_run_options.h"
+#include "tsl/platform/blocking_counter.h"
+
+namespace {
+
+// TopKs with fewer elements than this per thread run on a single thread.
+constexpr int64_t kMinParallelTopKElements = 1 << 15;
+
+// For k up to 1/kPartialSortMaxFraction of the input, a heap based partial
+// sort is cheapest; beyond it, selecting the top k first and sorting only
+// those is.
+constexpr int64_t kPartialSortMaxFraction = 16;
+
+// Maps the bits of a floating point value to a signed integer of the same
+// width, such that comparing the integers orders the values
+// -NaN < -Inf < -0 < +0 < +Inf < +NaN.
+template <typename UInt>
+std::make_signed_t<UInt> FloatBitsToKey(UInt bits) {
+  using Int = std::make_signed_t<UInt>;
+  return static_cast<Int>(bits) < 0
+             ? static_cast<Int>(
+                   static_cast<UInt>(std::numeric_limits<Int>::max() - bits))
+             : static_cast<Int>(bits);
+}
 
 template <typename T>
-static void TopK(int64_t batch_size, int64_t input_size, int64_t k,
-                 const T* values, T* out_values, int32_t* out_indices) {
-  // 'values' is managed by the JIT code, so msan can't tell they are
-  // initialized.
-  ABSL_ANNOTATE_MEMORY_IS_INITIALIZED(values,
-                                      input_size * batch_size * sizeof(T));
+auto FloatToKey(T value) {
+  using UInt = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
+  UInt bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return FloatBitsToKey(bits);
+}
+
+template <typename T>
+T Identity(T value) {
+  return value;
+}
 
+// Calculates the topk of `num_batches` batches starting at `values`.
+template <typename T, typename ToKey>
+void TopKBatches(int64_t num_batches, int64_t input_size, int64_t k,
+                 const T* values, T* out_values, int32_t* out_indices,
+                 ToKey to_key) {
   std::vector<int32_t> temp_indices(input_size);
-  for (int64_t batch = 0; batch != batch_size; ++batch) {
+  for (int64_t batch = 0; batch != num_batches; ++batch) {
     std::iota(temp_indices.begin(), temp_indices.end(), 0);
 
     const T* values_batch = values + batch * input_size;
 
-    auto convert_to_int = [](T value) {
-      uint32_t x;
-      std::memcpy(&x, &value, sizeof(x));
-      return static_cast<int32_t>(x) < 0
-                 ? std::numeric_limits<int32_t>::max() - x
-                 : x;
+    auto greater = [&](int32_t i1, int32_t i2) {
+      // Do the comparison in integers to enforce a total order on floating
+      // point values.
+      auto v1 = to_key(values_batch[i1]);
+      auto v2 = to_key(values_batch[i2]);
+      if (v1 == v2) {
+        return i1 < i2;  // Stabilize sorting.
+      }
+      return v1 > v2;
     };
 
     auto kth_element = temp_indices.begin() + k;
-    std::partial_sort(temp_indices.begin(), kth_element, temp_indices.end(),
-                      [&](size_t i1, size_t i2) {
-                        // Do the comparison in integers to enforce a total
-                        // order of -NaN < -Inf < -0 < +0 < +Inf < +NaN.
-                        int32_t v1 = convert_to_int(values_batch[i1]);
-                        int32_t v2 = convert_to_int(values_batch[i2]);
-                        if (v1 == v2) {
-                          return i1 < i2;  // Stabilize sorting.
-                        }
-                        return v1 > v2;
-                      });
+    if (k * kPartialSortMaxFraction <= input_size) {
+      std::partial_sort(temp_indices.begin(), kth_element, temp_indices.end(),
+                        greater);
+    } else {
+      std::nth_element(temp_indices.begin(), kth_element, temp_indices.end(),
+                       greater);
+      std::sort(temp_indices.begin(), kth_element, greater);
+    }
 
     T* out_values_batch = out_values + batch * k;
     int32_t* out_indices_batch = out_indices + batch * k;
@@ -68,8 +107,91 @@ static void TopK(int64_t batch_size, int64_t input_size, int64_t k,
   }
 }
 
+template <typename T, typename ToKey>
+void TopK(int64_t batch_size, int64_t input_size, int64_t k, const T* values,
+          T* out_values, int32_t* out_indices, const void* run_options,
+          ToKey to_key) {
+  // 'values' is managed by the JIT code, so msan can't tell they are
+  // initialized.
+  ABSL_ANNOTATE_MEMORY_IS_INITIALIZED(values,
+                                      input_size * batch_size * sizeof(T));
+
+  const Eigen::ThreadPoolDevice* pool =
+      run_options == nullptr
+          ? nullptr
+          : static_cast<const xla::ExecutableRunOptions*>(run_options)
+                ->intra_op_thread_pool();
+  const int64_t num_tasks =
+      pool == nullptr
+          ? 1
+          : std::min<int64_t>({pool->numThreads(), batch_size,
+                               batch_size * input_size /
+                                   kMinParallelTopKElements});
+  if (num_tasks <= 1) {
+    TopKBatches(batch_size, input_size, k, values, out_values, out_indices,
+                to_key);
+    return;
+  }
+
+  // Each task handles a contiguous range of batches; the first one runs on
+  // the calling thread.
+  auto run_task = [&](int64_t task) {
+    const int64_t begin = batch_size * task / num_tasks;
+    const int64_t end = batch_size * (task + 1) / num_tasks;
+    TopKBatches(end - begin, input_size, k, values + begin * input_size,
+                out_values + begin * k, out_indices + begin * k, to_key);
+  };
+  tsl::BlockingCounter counter(num_tasks - 1);
+  for (int64_t task = 1; task < num_tasks; ++task) {
+    pool->enqueueNoNotification([task, &run_task, &counter]() {
+      run_task(task);
+      counter.DecrementCount();
+    });
+  }
+  run_task(0);
+  counter.Wait();
+}
+
+}  // namespace
+
 ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_TopKF32(
     int64_t batch_size, int64_t input_size, int64_t k, const float* values,
-    float* out_values, int32_t* out_indices) {
-  TopK(batch_size, input_size, k, values, out_values, out_indices);
+    float* out_values, int32_t* out_indices, const void* run_options) {
+  TopK(batch_size, input_size, k, values, out_values, out_indices, run_options,
+       FloatToKey<float>);
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_TopKF64(
+    int64_t batch_size, int64_t input_size, int64_t k, const double* values,
+    double* out_values, int32_t* out_indices, const void* run_options) {
+  TopK(batch_size, input_size, k, values, out_values, out_indices, run_options,
+       FloatToKey<double>);
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_TopKS32(
+    int64_t batch_size, int64_t input_size, int64_t k, const int32_t* values,
+    int32_t* out_values, int32_t* out_indices, const void* run_options) {
+  TopK(batch_size, input_size, k, values, out_values, out_indices, run_options,
+       Identity<int32_t>);
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_TopKU32(
+    int64_t batch_size, int64_t input_size, int64_t k, const uint32_t* values,
+    uint32_t* out_values, int32_t* out_indices, const void* run_options) {
+  TopK(batch_size, input_size, k, values, out_values, out_indices, run_options,
+       Identity<uint32_t>);
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_TopKBF16(
+    int64_t batch_size, int64_t input_size, int64_t k, const uint16_t* values,
+    uint16_t* out_values, int32_t* out_indices, const void* run_options) {
+  TopK(batch_size, input_size, k, values, out_values, out_indices, run_options,
+       FloatBitsToKey<uint16_t>);
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_TopKF16(
+    int64_t batch_size, int64_t input_size, int64_t k, const uint16_t* values,
+    uint16_t* out_values, int32_t* out_indices, const void* run_options) {
+  TopK(batch_size, input_size, k, values, out_values, out_indices, run_options,
+       FloatBitsToKey<uint16_t>);
 }
@@ -21,10 +21,39 @@ limitations under the License.
 extern "C" {
 
 // Calculates `batch_size` topk operations with `input_size` inputs each. The
-// outputs are written to `out_values` and `out_indices`.
+// outputs are written to `out_values` and `out_indices`. Floating point values
+// are ordered -NaN < -Inf < -0 < +0 < +Inf < +NaN, and equal values by
+// increasing index. Batches are split between the threads of the intra-op
+// thread pool of `run_options`, if it has one.
 extern void __xla_cpu_runtime_TopKF32(int64_t batch_size, int64_t input_size,
                                       int64_t k, const float* values,
-                                      float* out_values, int32_t* out_indices);
+                                      float* out_values, int32_t* out_indices,
+                                      const void* run_options);
+extern void __xla_cpu_runtime_TopKF64(int64_t batch_size, int64_t input_size,
+                                      int64_t k, const double* values,
+                                      double* out_values, int32_t* out_indices,
+                                      const void* run_options);
+extern void __xla_cpu_runtime_TopKS32(int64_t batch_size, int64_t input_size,
+                                      int64_t k, const int32_t* values,
+                                      int32_t* out_values, int32_t* out_indices,
+                                      const void* run_options);
+extern void __xla_cpu_runtime_TopKU32(int64_t batch_size, int64_t input_size,
+                                      int64_t k, const uint32_t* values,
+                                      uint32_t* out_values,
+                                      int32_t* out_indices,
+                                      const void* run_options);
+
+// As above, for the raw bits of bf16 and f16 values.
+extern void __xla_cpu_runtime_TopKBF16(int64_t batch_size, int64_t input_size,
+                                       int64_t k, const uint16_t* values,
+                                       uint16_t* out_values,
+                                       int32_t* out_indices,
+                                       const void* run_options);
+extern void __xla_cpu_runtime_TopKF16(int64_t batch_size, int64_t input_size,
+                                      int64_t k, const uint16_t* values,
+                                      uint16_t* out_values,
+                                      int32_t* out_indices,
+                                      const void* run_options);
 }
 
 #endif  // XLA_SERVICE_CPU_RUNTIME_TOPK_H_
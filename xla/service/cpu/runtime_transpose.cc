@@ -0,0 +1,108 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/runtime_transpose.h"
+
+#define EIGEN_USE_THREADS
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/base/dynamic_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "xla/executable_run_options.h"
+#include "xla/pjrt/transpose.h"
+#include "xla/service/cpu/runtime_lightweight_check.h"
+#include "xla/statusor.h"
+
+namespace {
+
+// Returns the plan transposing 'dims' by 'permutation' on 'num_threads'
+// threads. Plans are cached, since a compiled program transposes the same
+// shapes on every run. They are created outside of the lock, so that a
+// transpose of a new shape doesn't hold up the transposes of cached ones.
+std::shared_ptr<xla::TransposePlan> GetTransposePlan(
+    int64_t element_size, absl::Span<const int64_t> dims,
+    absl::Span<const int64_t> permutation, int num_threads) {
+  using Key = std::tuple<int64_t, std::vector<int64_t>, std::vector<int64_t>,
+                         int>;
+  // Once full, the cache is cleared rather than evicting the least recently
+  // used plan; a program only transposes a handful of shapes.
+  constexpr int kCapacity = 64;
+  static absl::Mutex mu(absl::kConstInit);
+  static auto* cache =
+      new absl::flat_hash_map<Key, std::shared_ptr<xla::TransposePlan>>();
+
+  Key key(element_size, std::vector<int64_t>(dims.begin(), dims.end()),
+          std::vector<int64_t>(permutation.begin(), permutation.end()),
+          num_threads);
+  {
+    absl::MutexLock lock(&mu);
+    auto it = cache->find(key);
+    if (it != cache->end()) {
+      return it->second;
+    }
+  }
+  xla::StatusOr<std::unique_ptr<xla::TransposePlan>> plan =
+      xla::TransposePlan::Create(element_size, dims, permutation,
+                                 xla::TransposePlan::Tiling{},
+                                 xla::TransposePlan::Tiling{},
+                                 xla::TransposePlan::Transformation::kNone,
+                                 num_threads);
+  XLA_LIGHTWEIGHT_CHECK(plan.ok());
+  absl::MutexLock lock(&mu);
+  if (cache->size() >= kCapacity) {
+    cache->clear();
+  }
+  // Another thread may have created the same plan meanwhile; both are
+  // equivalent, and the cached one wins.
+  return cache->try_emplace(std::move(key), *std::move(plan)).first->second;
+}
+
+}  // namespace
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_Transpose(
+    const void* run_options_ptr, void* out, const void* in,
+    int64_t element_size, const int64_t* dims, const int64_t* permutation,
+    int64_t rank) {
+  const xla::ExecutableRunOptions* run_options =
+      static_cast<const xla::ExecutableRunOptions*>(run_options_ptr);
+  XLA_LIGHTWEIGHT_CHECK(run_options->intra_op_thread_pool() != nullptr);
+  const Eigen::ThreadPoolDevice& device = *run_options->intra_op_thread_pool();
+
+  // The plan blocks until all the work it schedules is done. Inside a pool
+  // thread, e.g. a task of a task graph, the work could wait behind the very
+  // threads blocked on it, so the transpose runs on the calling thread alone.
+  if (device.currentThreadId() != -1) {
+    GetTransposePlan(element_size, absl::MakeConstSpan(dims, rank),
+                     absl::MakeConstSpan(permutation, rank),
+                     /*num_threads=*/1)
+        ->Execute(in, out);
+    return;
+  }
+  std::shared_ptr<xla::TransposePlan> plan = GetTransposePlan(
+      element_size, absl::MakeConstSpan(dims, rank),
+      absl::MakeConstSpan(permutation, rank), device.numThreads());
+  plan->Execute(in, out, [&device](std::function<void()> work) {
+    device.enqueueNoNotification(std::move(work));
+  });
+}
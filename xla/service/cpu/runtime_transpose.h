@@ -0,0 +1,37 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_CPU_RUNTIME_TRANSPOSE_H_
+#define XLA_SERVICE_CPU_RUNTIME_TRANSPOSE_H_
+
+#include <stdint.h>
+
+extern "C" {
+
+// Transposes the dense row-major array 'in', of 'rank' dimensions 'dims', into
+// the dense row-major array 'out', whose dimension i is dimension
+// 'permutation[i]' of 'in'. The elements are 'element_size' bytes, one of 1,
+// 2, 4, 8 or 16.
+//
+// Uses a cached xla::TransposePlan, which copies cache-sized tiles with SIMD
+// kernels, and runs it on the intra-op thread pool.
+extern void __xla_cpu_runtime_Transpose(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr, void* out,
+    const void* in, int64_t element_size, const int64_t* dims,
+    const int64_t* permutation, int64_t rank);
+
+}  // extern "C"
+
+#endif  // XLA_SERVICE_CPU_RUNTIME_TRANSPOSE_H_
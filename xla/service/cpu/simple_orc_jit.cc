@@ -22,12 +22,16 @@ limitations under the License.
 #include <cstdio>
 #include <list>
 #include <memory>
+#include <string>
 #include <system_error>  // NOLINT
 #include <utility>
 
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/JITSymbol.h"
 #include "llvm/ExecutionEngine/Orc/ExecutorProcessControl.h"
+#include "llvm/ExecutionEngine/Orc/TaskDispatch.h"
 #include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
 #include "llvm/IR/Mangler.h"
@@ -40,6 +44,7 @@ limitations under the License.
 #include "mlir/ExecutionEngine/CRunnerUtils.h"  // from @llvm-project
 #include "xla/service/cpu/cpu_runtime.h"
 #include "xla/service/cpu/orc_jit_memory_mapper.h"
+#include "xla/service/cpu/runtime_bf16_matmul.h"
 #include "xla/service/cpu/runtime_conv2d.h"
 #include "xla/service/cpu/runtime_conv2d_acl.h"
 #include "xla/service/cpu/runtime_conv2d_mkl.h"
@@ -48,6 +53,7 @@ limitations under the License.
 #include "xla/service/cpu/runtime_fft.h"
 #include "xla/service/cpu/runtime_fork_join.h"
 #include "xla/service/cpu/runtime_fp16.h"
+#include "xla/service/cpu/runtime_int8_matmul.h"
 #include "xla/service/cpu/runtime_key_value_sort.h"
 #include "xla/service/cpu/runtime_matmul.h"
 #include "xla/service/cpu/runtime_matmul_acl.h"
@@ -56,12 +62,16 @@ limitations under the License.
 #include "xla/service/cpu/runtime_single_threaded_conv3d.h"
 #include "xla/service/cpu/runtime_single_threaded_fft.h"
 #include "xla/service/cpu/runtime_single_threaded_matmul.h"
+#include "xla/service/cpu/runtime_task_graph.h"
 #include "xla/service/cpu/runtime_topk.h"
+#include "xla/service/cpu/runtime_transpose.h"
 #include "xla/service/cpu/windows_compatibility.h"
 #include "xla/service/custom_call_target_registry.h"
 #include "xla/types.h"
 #include "xla/util.h"
+#include "tsl/platform/env.h"
 #include "tsl/platform/logging.h"
+#include "tsl/platform/threadpool.h"
 
 #if defined(INTEL_MKL) && defined(ENABLE_ONEDNN_V3)
 #include "xla/service/cpu/onednn_matmul.h"
@@ -283,6 +293,50 @@ bool ContiguousSectionMemoryManager::finalizeMemory(std::string* err_msg) {
   return false;
 }
 
+// Runs the tasks of an ExecutionSession, e.g. compiling a module, on a thread
+// pool. The threads are joined on shutdown, after which tasks run on the
+// dispatching thread.
+class ThreadPoolTaskDispatcher : public llvm::orc::TaskDispatcher {
+ public:
+  explicit ThreadPoolTaskDispatcher(int num_threads)
+      : thread_pool_(std::make_unique<tsl::thread::ThreadPool>(
+            tsl::Env::Default(), "xla_cpu_codegen", num_threads)) {}
+
+  void dispatch(std::unique_ptr<llvm::orc::Task> task) override {
+    {
+      absl::MutexLock lock(&mu_);
+      if (thread_pool_ != nullptr) {
+        ++num_pending_tasks_;
+        thread_pool_->Schedule(
+            [this, task = std::shared_ptr<llvm::orc::Task>(std::move(task))] {
+              task->run();
+              absl::MutexLock lock(&mu_);
+              --num_pending_tasks_;
+            });
+        return;
+      }
+    }
+    task->run();
+  }
+
+  void shutdown() override {
+    std::unique_ptr<tsl::thread::ThreadPool> thread_pool;
+    {
+      absl::MutexLock lock(&mu_);
+      auto done = [this]() ABSL_SHARED_LOCKS_REQUIRED(mu_) {
+        return num_pending_tasks_ == 0;
+      };
+      mu_.Await(absl::Condition(&done));
+      thread_pool = std::move(thread_pool_);
+    }
+  }
+
+ private:
+  absl::Mutex mu_;
+  std::unique_ptr<tsl::thread::ThreadPool> thread_pool_ ABSL_GUARDED_BY(mu_);
+  int64_t num_pending_tasks_ ABSL_GUARDED_BY(mu_) = 0;
+};
+
 }  // namespace
 
 /*static*/ std::unique_ptr<llvm::TargetMachine>
@@ -309,7 +363,8 @@ SimpleOrcJIT::SimpleOrcJIT(
     bool disable_slp_vectorizer, llvm::FastMathFlags fast_math_flags,
     LLVMCompiler::ModuleHook pre_optimization_hook,
     LLVMCompiler::ModuleHook post_optimization_hook,
-    std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook)
+    std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook,
+    int num_compile_threads)
     : target_machine_(InferTargetMachineForJIT(target_options, opt_level)),
       target_triple_(target_machine_->getTargetTriple()),
       data_layout_(target_machine_->createDataLayout()),
@@ -322,12 +377,26 @@ SimpleOrcJIT::SimpleOrcJIT(
                     }),
       compile_layer_(
           *execution_session_, object_layer_,
-          std::make_unique<CompilerFunctor>(
-              target_machine_.get(), static_cast<int>(opt_level),
-              optimize_for_size, disable_expensive_passes,
-              disable_slp_vectorizer, fast_math_flags,
-              std::move(pre_optimization_hook),
-              std::move(post_optimization_hook), std::move(post_codegen_hook))),
+          // The shared target machine must not be used concurrently, so
+          // every concurrently compiled module gets its own.
+          num_compile_threads > 1
+              ? std::make_unique<CompilerFunctor>(
+                    [target_options, opt_level]() {
+                      return InferTargetMachineForJIT(target_options,
+                                                      opt_level);
+                    },
+                    static_cast<int>(opt_level), optimize_for_size,
+                    disable_expensive_passes, disable_slp_vectorizer,
+                    fast_math_flags, std::move(pre_optimization_hook),
+                    std::move(post_optimization_hook),
+                    std::move(post_codegen_hook))
+              : std::make_unique<CompilerFunctor>(
+                    target_machine_.get(), static_cast<int>(opt_level),
+                    optimize_for_size, disable_expensive_passes,
+                    disable_slp_vectorizer, fast_math_flags,
+                    std::move(pre_optimization_hook),
+                    std::move(post_optimization_hook),
+                    std::move(post_codegen_hook))),
       main_jit_dylib_(&execution_session_->createBareJITDylib("<main>")),
       gdb_jit_event_listener_(
           llvm::JITEventListener::createGDBRegistrationListener()),
@@ -386,7 +455,8 @@ llvm::Expected<std::unique_ptr<SimpleOrcJIT>> SimpleOrcJIT::Create(
     bool disable_slp_vectorizer, llvm::FastMathFlags fast_math_flags,
     LLVMCompiler::ModuleHook pre_optimization_hook,
     LLVMCompiler::ModuleHook post_optimization_hook,
-    std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook) {
+    std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook,
+    int num_compile_threads) {
   auto SSP = std::make_shared<llvm::orc::SymbolStringPool>();
   auto target_process_control =
       llvm::orc::SelfExecutorProcessControl::Create(std::move(SSP));
@@ -394,13 +464,22 @@ llvm::Expected<std::unique_ptr<SimpleOrcJIT>> SimpleOrcJIT::Create(
     return target_process_control.takeError();
   }
 
+  std::unique_ptr<llvm::orc::TaskDispatcher> task_dispatcher;
+  if (num_compile_threads > 1) {
+    task_dispatcher =
+        std::make_unique<ThreadPoolTaskDispatcher>(num_compile_threads);
+  } else {
+    task_dispatcher = std::make_unique<llvm::orc::InPlaceTaskDispatcher>();
+  }
   auto execution_session = std::make_unique<llvm::orc::ExecutionSession>(
-      std::make_unique<llvm::orc::UnsupportedExecutorProcessControl>());
+      std::make_unique<llvm::orc::UnsupportedExecutorProcessControl>(
+          /*SSP=*/nullptr, std::move(task_dispatcher)));
   return std::make_unique<SimpleOrcJIT>(
       std::move(*target_process_control), std::move(execution_session),
       target_options, opt_level, optimize_for_size, disable_expensive_passes,
       disable_slp_vectorizer, fast_math_flags, std::move(pre_optimization_hook),
-      std::move(post_optimization_hook), std::move(post_codegen_hook));
+      std::move(post_optimization_hook), std::move(post_codegen_hook),
+      num_compile_threads);
 }
 
 llvm::orc::ExecutorSymbolDef SimpleOrcJIT::ResolveRuntimeSymbol(
@@ -445,10 +524,31 @@ llvm::Error SimpleOrcJIT::AddModule(llvm::orc::ThreadSafeModule module) {
   return compile_layer_.add(*main_jit_dylib_, std::move(module));
 }
 
+llvm::Error SimpleOrcJIT::AddObjFile(
+    std::unique_ptr<llvm::MemoryBuffer> obj_file) {
+  return object_layer_.add(*main_jit_dylib_, std::move(obj_file));
+}
+
+llvm::Error SimpleOrcJIT::CompileSymbols(llvm::ArrayRef<std::string> names) {
+  llvm::orc::SymbolLookupSet symbols;
+  for (const std::string& name : names) {
+    symbols.add(execution_session_->intern(name));
+  }
+  // A single lookup lets the execution session dispatch the compilation of
+  // all modules involved at once.
+  return execution_session_
+      ->lookup(llvm::orc::makeJITDylibSearchOrder(
+                   main_jit_dylib_,
+                   llvm::orc::JITDylibLookupFlags::MatchAllSymbols),
+               std::move(symbols))
+      .takeError();
+}
+
 void SimpleOrcJIT::DoneCompiling() {
   // The target machine takes a non-trivial amount of memory, so once we are
-  // done compiling throw it away.
+  // done compiling throw it away. Same for the compile threads, if any.
   target_machine_.reset();
+  execution_session_->getExecutorProcessControl().getDispatcher().shutdown();
 }
 
 llvm::Expected<llvm::orc::ExecutorSymbolDef> SimpleOrcJIT::FindCompiledSymbol(
@@ -485,6 +585,8 @@ bool RegisterKnownJITSymbols() {
   REGISTER_CPU_RUNTIME_SYMBOL(AllReduce);
   REGISTER_CPU_RUNTIME_SYMBOL(CollectivePermute);
   REGISTER_CPU_RUNTIME_SYMBOL(AllToAll);
+  REGISTER_CPU_RUNTIME_SYMBOL(AllGather);
+  REGISTER_CPU_RUNTIME_SYMBOL(ReduceScatter);
   REGISTER_CPU_RUNTIME_SYMBOL(PartitionId);
   REGISTER_CPU_RUNTIME_SYMBOL(ReplicaId);
   REGISTER_CPU_RUNTIME_SYMBOL(MKLConv2DF32);
@@ -500,6 +602,12 @@ bool RegisterKnownJITSymbols() {
   REGISTER_CPU_RUNTIME_SYMBOL(EigenMatMulC128);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenMatMulS32);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenBatchMatMulF32);
+  REGISTER_CPU_RUNTIME_SYMBOL(Int8MatMul);
+  REGISTER_CPU_RUNTIME_SYMBOL(Int8MatMulU8);
+  REGISTER_CPU_RUNTIME_SYMBOL(Int8Conv2D);
+  REGISTER_CPU_RUNTIME_SYMBOL(Int8Conv2DU8);
+  REGISTER_CPU_RUNTIME_SYMBOL(BF16MatMul);
+  REGISTER_CPU_RUNTIME_SYMBOL(BF16Conv2D);
   REGISTER_CPU_RUNTIME_SYMBOL(ACLMatMulF32);
   REGISTER_CPU_RUNTIME_SYMBOL(ACLBatchMatMulF32);
   REGISTER_CPU_RUNTIME_SYMBOL(ACLConv2DF32);
@@ -520,7 +628,15 @@ bool RegisterKnownJITSymbols() {
   REGISTER_CPU_RUNTIME_SYMBOL(ReleaseOutfeedBufferAfterPopulation);
   REGISTER_CPU_RUNTIME_SYMBOL(StatusIsSuccess);
   REGISTER_CPU_RUNTIME_SYMBOL(KeyValueSort);
+  REGISTER_CPU_RUNTIME_SYMBOL(SortPrimitive);
   REGISTER_CPU_RUNTIME_SYMBOL(TopKF32);
+  REGISTER_CPU_RUNTIME_SYMBOL(TopKF64);
+  REGISTER_CPU_RUNTIME_SYMBOL(TopKBF16);
+  REGISTER_CPU_RUNTIME_SYMBOL(TopKF16);
+  REGISTER_CPU_RUNTIME_SYMBOL(TopKS32);
+  REGISTER_CPU_RUNTIME_SYMBOL(TopKU32);
+  REGISTER_CPU_RUNTIME_SYMBOL(Transpose);
+  REGISTER_CPU_RUNTIME_SYMBOL(ExecuteTaskGraph);
   REGISTER_CPU_RUNTIME_SYMBOL(TracingStart);
   REGISTER_CPU_RUNTIME_SYMBOL(TracingEnd);
 #if defined(INTEL_MKL) && defined(ENABLE_ONEDNN_V3)
@@ -16,10 +16,13 @@ limitations under the License.
 #ifndef XLA_SERVICE_CPU_SIMPLE_ORC_JIT_H_
 #define XLA_SERVICE_CPU_SIMPLE_ORC_JIT_H_
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ExecutionEngine/JITEventListener.h"
 #include "llvm/ExecutionEngine/Orc/Core.h"
 #include "llvm/ExecutionEngine/Orc/ExecutorProcessControl.h"
@@ -27,6 +30,7 @@ limitations under the License.
 #include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
 #include "llvm/ExecutionEngine/Orc/SymbolStringPool.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/TargetParser/Triple.h"
 #include "xla/service/cpu/compiler_functor.h"
@@ -40,9 +44,9 @@ namespace cpu {
 // This class wraps Orc's functionality into a single interface that only
 // exposes what we need for XLA.
 //
-// Supports JIT-ing multiple modules but without cross-module linking.
-// Implements eager compilation - the module is lowered to binary as soon as
-// it's added to the JIT.
+// Supports JIT-ing multiple modules, which are linked together. Modules are
+// compiled when one of their symbols is first looked up; with more than one
+// compile thread, modules looked up together are compiled concurrently.
 class SimpleOrcJIT : public llvm::JITEventListener {
  public:
   using ObjLayerT = llvm::orc::RTDyldObjectLinkingLayer;
@@ -52,7 +56,9 @@ class SimpleOrcJIT : public llvm::JITEventListener {
   //
   // {pre,post}_optimization_hook is invoked on the module before/after all
   // LLVM IR-level optimizations.  post_codegen_hook is invoked after
-  // compiling to machine code.
+  // compiling to machine code. Modules are compiled on up to
+  // `num_compile_threads` threads, which requires an `execution_session`
+  // dispatching its tasks to as many threads.
   SimpleOrcJIT(
       std::unique_ptr<llvm::orc::ExecutorProcessControl> target_process_control,
       std::unique_ptr<llvm::orc::ExecutionSession> execution_session,
@@ -62,7 +68,8 @@ class SimpleOrcJIT : public llvm::JITEventListener {
       llvm::FastMathFlags fast_math_flags,
       LLVMCompiler::ModuleHook pre_optimization_hook,
       LLVMCompiler::ModuleHook post_optimization_hook,
-      std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook);
+      std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook,
+      int num_compile_threads);
 
   static llvm::Expected<std::unique_ptr<SimpleOrcJIT>> Create(
       const llvm::TargetOptions& target_options,
@@ -71,7 +78,8 @@ class SimpleOrcJIT : public llvm::JITEventListener {
       llvm::FastMathFlags fast_math_flags,
       LLVMCompiler::ModuleHook pre_optimization_hook,
       LLVMCompiler::ModuleHook post_optimization_hook,
-      std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook);
+      std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook,
+      int num_compile_threads = 1);
 
   ~SimpleOrcJIT() override;
 
@@ -81,6 +89,14 @@ class SimpleOrcJIT : public llvm::JITEventListener {
 
   llvm::Error AddModule(llvm::orc::ThreadSafeModule module);
 
+  // Adds a previously compiled object file, bypassing the compile layer and
+  // its hooks.
+  llvm::Error AddObjFile(std::unique_ptr<llvm::MemoryBuffer> obj_file);
+
+  // Compiles and links the modules defining any of the (mangled) symbols in
+  // `names`, concurrently if there are several compile threads.
+  llvm::Error CompileSymbols(llvm::ArrayRef<std::string> names);
+
   // Discards objects we no longer need once we are done compiling.
   void DoneCompiling();
 
@@ -118,7 +134,8 @@ class SimpleOrcJIT : public llvm::JITEventListener {
   ObjLayerT object_layer_;
   CompileLayerT compile_layer_;
   llvm::orc::JITDylib* main_jit_dylib_;
-  int64_t size_of_generated_code_in_bytes_ = 0;
+  // Objects may be loaded concurrently by the compile threads.
+  std::atomic<int64_t> size_of_generated_code_in_bytes_ = 0;
 
   // Non owning pointer to a JIT event listener that registers the JIT events
   // with an attached GDB.
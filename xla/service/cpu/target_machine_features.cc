@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <algorithm>
 
+#include "llvm/MC/MCSubtargetInfo.h"
 #include "xla/cpu_function_runtime.h"
 #include "tsl/platform/logging.h"
 
@@ -51,5 +52,17 @@ int64_t LLVMTargetMachineFeatures::minimum_alignment_for_allocation(
                            cpu_function_runtime::MinAlign());
 }
 
+bool LLVMTargetMachineFeatures::has_avx512_vnni() const {
+  return target_machine_->getTargetTriple().isX86() &&
+         target_machine_->getMCSubtargetInfo()->checkFeatures(
+             "+avx512f,+avx512bw,+avx512vnni");
+}
+
+bool LLVMTargetMachineFeatures::has_avx512_bf16() const {
+  return target_machine_->getTargetTriple().isX86() &&
+         target_machine_->getMCSubtargetInfo()->checkFeatures(
+             "+avx512f,+avx512bw,+avx512vl,+avx512bf16");
+}
+
 }  // namespace cpu
 }  // namespace xla
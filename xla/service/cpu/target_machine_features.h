@@ -62,6 +62,13 @@ class TargetMachineFeatures {
   virtual int64_t minimum_alignment_for_allocation(
       int64_t size_bytes) const = 0;
 
+  // Returns true if the target has the AVX512-VNNI int8 dot product
+  // instructions.
+  virtual bool has_avx512_vnni() const = 0;
+
+  // Returns true if the target has the AVX512-BF16 dot product instructions.
+  virtual bool has_avx512_bf16() const = 0;
+
   virtual ~TargetMachineFeatures() = default;
 };
 
@@ -101,6 +108,9 @@ class LLVMTargetMachineFeatures : public TargetMachineFeatures {
 
   int64_t minimum_alignment_for_allocation(int64_t size_bytes) const override;
 
+  bool has_avx512_vnni() const override;
+  bool has_avx512_bf16() const override;
+
  private:
   llvm::TargetTransformInfo* GetTargetTransformInfoFor(
       const llvm::Function& function) const;
@@ -52,6 +52,14 @@ class TargetMachineFeaturesWithFakeAlignmentLogic
     return fake_alignment_logic_(size_bytes);
   }
 
+  bool has_avx512_vnni() const override {
+    LOG(FATAL) << "Unexpected call to " << __func__;
+  }
+
+  bool has_avx512_bf16() const override {
+    LOG(FATAL) << "Unexpected call to " << __func__;
+  }
+
  private:
   std::function<int64_t(int64_t)> fake_alignment_logic_;
 };
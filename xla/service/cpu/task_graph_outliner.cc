@@ -0,0 +1,98 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/task_graph_outliner.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/statusor.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/logging.h"
+
+namespace xla {
+namespace cpu {
+
+bool IsTaskGraphPassThrough(const HloInstruction& instruction) {
+  switch (instruction.opcode()) {
+    case HloOpcode::kParameter:
+    case HloOpcode::kConstant:
+    case HloOpcode::kBitcast:
+    case HloOpcode::kGetTupleElement:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool IsTaskGraph(const HloComputation& computation) {
+  int64_t num_tasks = 0;
+  for (const HloInstruction* instruction : computation.instructions()) {
+    if (instruction->opcode() == HloOpcode::kCall) {
+      ++num_tasks;
+    } else if (!IsTaskGraphPassThrough(*instruction)) {
+      return false;
+    }
+  }
+  return num_tasks > 1;
+}
+
+StatusOr<bool> TaskGraphOutliner::Run(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  HloComputation* entry = module->entry_computation();
+  std::vector<HloInstruction*> tasks;
+  int64_t num_calls = 0;
+  for (HloInstruction* instruction : entry->MakeInstructionPostOrder()) {
+    if (instruction->HasSideEffect()) {
+      VLOG(2) << "Not outlining a task graph because of "
+              << instruction->ToString();
+      return false;
+    }
+    if (instruction->opcode() == HloOpcode::kCall) {
+      ++num_calls;
+    } else if (!IsTaskGraphPassThrough(*instruction)) {
+      tasks.push_back(instruction);
+    }
+  }
+  // A single task has nothing to run concurrently with.
+  if (tasks.empty() || tasks.size() + num_calls < 2) {
+    return false;
+  }
+
+  for (HloInstruction* instruction : tasks) {
+    // The outlined instruction is removed, so move its control dependencies
+    // over to the call that replaces it.
+    std::vector<HloInstruction*> predecessors =
+        instruction->control_predecessors();
+    std::vector<HloInstruction*> successors = instruction->control_successors();
+    TF_RETURN_IF_ERROR(instruction->DropAllControlDeps());
+    HloInstruction* call = module->OutlineExpressionFromComputation(
+        {instruction}, absl::StrCat("task_", instruction->name()), entry);
+    for (HloInstruction* predecessor : predecessors) {
+      TF_RETURN_IF_ERROR(predecessor->AddControlDependencyTo(call));
+    }
+    for (HloInstruction* successor : successors) {
+      TF_RETURN_IF_ERROR(call->AddControlDependencyTo(successor));
+    }
+  }
+  VLOG(2) << "Outlined " << tasks.size() << " tasks of " << entry->name();
+  return true;
+}
+
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,65 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_SERVICE_CPU_TASK_GRAPH_OUTLINER_H_
+#define XLA_SERVICE_CPU_TASK_GRAPH_OUTLINER_H_
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/hlo_pass_interface.h"
+#include "xla/statusor.h"
+
+namespace xla {
+namespace cpu {
+
+// Returns true if `instruction` doesn't read or write any buffer when the
+// computation runs: it only names a buffer of its operand, or one that exists
+// before the computation starts. Such instructions aren't tasks of a task
+// graph.
+bool IsTaskGraphPassThrough(const HloInstruction& instruction);
+
+// Returns true if `computation` is a task graph: all instructions that aren't
+// pass-through are calls, and there are at least two of them.
+bool IsTaskGraph(const HloComputation& computation);
+
+// TaskGraphOutliner outlines every instruction of the entry computation that
+// does any work into a call of its own, leaving a task graph whose tasks are
+// the calls and whose edges are their data and control dependencies. The
+// IrEmitter dispatches such tasks to the intra-op thread pool as soon as the
+// tasks they depend on have finished, which lets independent instructions run
+// concurrently.
+//
+// Modules whose entry computation has side effects are left alone, since
+// their ops must run in program order.
+//
+// This must run after copy insertion, so that the copies it adds become tasks
+// too.
+class TaskGraphOutliner : public HloModulePass {
+ public:
+  absl::string_view name() const override { return "cpu-task-graph-outliner"; }
+
+  using HloPassInterface::Run;
+  StatusOr<bool> Run(
+      HloModule* module,
+      const absl::flat_hash_set<absl::string_view>& execution_threads) override;
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // XLA_SERVICE_CPU_TASK_GRAPH_OUTLINER_H_
@@ -0,0 +1,123 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/task_graph_outliner.h"
+
+#include <memory>
+#include <string>
+
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/hlo/utils/hlo_matchers.h"
+#include "xla/test.h"
+#include "xla/tests/hlo_test_base.h"
+#include "tsl/platform/statusor.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+namespace op = xla::testing::opcode_matchers;
+
+using TaskGraphOutlinerTest = HloTestBase;
+
+TEST_F(TaskGraphOutlinerTest, OutlinesIndependentOps) {
+  const std::string hlo_string = R"(
+    HloModule TaskGraph
+    ENTRY e {
+      p0 = f32[64,64] parameter(0)
+      p1 = f32[64,64] parameter(1)
+      dot0 = f32[64,64] dot(p0, p1),
+        lhs_contracting_dims={1}, rhs_contracting_dims={0}
+      dot1 = f32[64,64] dot(p1, p0),
+        lhs_contracting_dims={1}, rhs_contracting_dims={0}
+      ROOT add = f32[64,64] add(dot0, dot1)
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, TaskGraphOutliner().Run(m.get()));
+  EXPECT_TRUE(changed);
+
+  HloComputation* entry = m->entry_computation();
+  EXPECT_TRUE(IsTaskGraph(*entry));
+  EXPECT_THAT(entry->root_instruction(),
+              op::Call(op::Call(op::Parameter(0), op::Parameter(1)),
+                       op::Call(op::Parameter(1), op::Parameter(0))));
+  EXPECT_THAT(entry->root_instruction()->to_apply()->root_instruction(),
+              op::Add(op::Parameter(0), op::Parameter(1)));
+}
+
+TEST_F(TaskGraphOutlinerTest, KeepsControlDependencies) {
+  const std::string hlo_string = R"(
+    HloModule TaskGraph
+    ENTRY e {
+      p0 = f32[16] parameter(0)
+      neg = f32[16] negate(p0)
+      exp = f32[16] exponential(p0), control-predecessors={neg}
+      ROOT tuple = (f32[16], f32[16]) tuple(neg, exp)
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, TaskGraphOutliner().Run(m.get()));
+  EXPECT_TRUE(changed);
+
+  const HloInstruction* root = m->entry_computation()->root_instruction();
+  ASSERT_THAT(root, op::Call(op::Call(), op::Call()));
+  EXPECT_THAT(root->operand(1)->control_predecessors(),
+              ::testing::ElementsAre(root->operand(0)));
+}
+
+TEST_F(TaskGraphOutlinerTest, SingleOpNotOutlined) {
+  const std::string hlo_string = R"(
+    HloModule TaskGraph
+    ENTRY e {
+      p0 = f32[16] parameter(0)
+      ROOT neg = f32[16] negate(p0)
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, TaskGraphOutliner().Run(m.get()));
+  EXPECT_FALSE(changed);
+  EXPECT_FALSE(IsTaskGraph(*m->entry_computation()));
+}
+
+TEST_F(TaskGraphOutlinerTest, SideEffectingOpsNotOutlined) {
+  const std::string hlo_string = R"(
+    HloModule TaskGraph
+    ENTRY e {
+      p0 = f32[16] parameter(0)
+      neg = f32[16] negate(p0)
+      exp = f32[16] exponential(p0)
+      custom = f32[16] custom-call(neg), custom_call_target="foo",
+        custom_call_has_side_effect=true
+      ROOT add = f32[16] add(custom, exp)
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, TaskGraphOutliner().Run(m.get()));
+  EXPECT_FALSE(changed);
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,109 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "xla/service/cpu/tests/cpu_codegen_test.h"
+#include "tsl/platform/cpu_info.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+bool HostHasAvx512BF16() {
+  using tsl::port::CPUFeature;
+  return tsl::port::TestCPUFeature(CPUFeature::AVX512F) &&
+         tsl::port::TestCPUFeature(CPUFeature::AVX512BW) &&
+         tsl::port::TestCPUFeature(CPUFeature::AVX512VL) &&
+         tsl::port::TestCPUFeature(CPUFeature::AVX512_BF16);
+}
+
+using CpuBF16Test = CpuCodegenTest;
+
+TEST_F(CpuBF16Test, BF16MatMul) {
+  constexpr absl::string_view kHlo = R"(
+HloModule matmul
+
+ENTRY e {
+  p0 = bf16[67,129] parameter(0)
+  p1 = bf16[129,45] parameter(1)
+  ROOT dot = bf16[67,45] dot(p0, p1),
+    lhs_contracting_dims={1}, rhs_contracting_dims={0}
+})";
+  EXPECT_TRUE(RunAndCompare(kHlo, ErrorSpec{2e-2, 2e-2}));
+  if (HostHasAvx512BF16()) {
+    CompileAndVerifyIr(std::string(kHlo), R"(
+CHECK: call void @__xla_cpu_runtime_BF16MatMul
+)");
+  }
+}
+
+TEST_F(CpuBF16Test, BF16MatMulWithTransposedOperands) {
+  constexpr absl::string_view kHlo = R"(
+HloModule matmul
+
+ENTRY e {
+  p0 = bf16[96,40] parameter(0)
+  p1 = bf16[24,96] parameter(1)
+  ROOT dot = bf16[40,24] dot(p0, p1),
+    lhs_contracting_dims={0}, rhs_contracting_dims={1}
+})";
+  EXPECT_TRUE(RunAndCompare(kHlo, ErrorSpec{2e-2, 2e-2}));
+}
+
+TEST_F(CpuBF16Test, BF16Convolution) {
+  constexpr absl::string_view kHlo = R"(
+HloModule convolution
+
+ENTRY e {
+  p0 = bf16[2,13,11,24] parameter(0)
+  p1 = bf16[3,2,24,20] parameter(1)
+  ROOT conv = bf16[2,7,11,20] convolution(p0, p1),
+    window={size=3x2 stride=2x1 pad=1_1x1_1 rhs_dilate=1x2},
+    dim_labels=b01f_01io->b01f
+})";
+  EXPECT_TRUE(RunAndCompare(kHlo, ErrorSpec{2e-2, 2e-2}));
+  if (HostHasAvx512BF16()) {
+    CompileAndVerifyIr(std::string(kHlo), R"(
+CHECK: call void @__xla_cpu_runtime_BF16Conv2D
+)");
+  }
+}
+
+TEST_F(CpuBF16Test, BF16ElementwiseAroundMatMul) {
+  // The elementwise ops are computed in f32 and fused with the converts
+  // around the dot.
+  constexpr absl::string_view kHlo = R"(
+HloModule matmul
+
+ENTRY e {
+  p0 = bf16[64,128] parameter(0)
+  p1 = bf16[128,32] parameter(1)
+  p2 = bf16[64,32] parameter(2)
+  dot = bf16[64,32] dot(p0, p1),
+    lhs_contracting_dims={1}, rhs_contracting_dims={0}
+  add = bf16[64,32] add(dot, p2)
+  zero = bf16[] constant(0)
+  zeros = bf16[64,32] broadcast(zero), dimensions={}
+  ROOT relu = bf16[64,32] maximum(add, zeros)
+})";
+  EXPECT_TRUE(RunAndCompare(kHlo, ErrorSpec{2e-2, 2e-2}));
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
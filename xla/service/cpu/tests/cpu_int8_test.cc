@@ -0,0 +1,228 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "xla/client/client_library.h"
+#include "xla/client/executable_build_options.h"
+#include "xla/client/local_client.h"
+#include "xla/client/xla_computation.h"
+#include "xla/executable_run_options.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/literal.h"
+#include "xla/service/cpu/tests/cpu_codegen_test.h"
+#include "xla/service/hlo_parser.h"
+#include "xla/service/platform_util.h"
+#include "xla/service/shaped_buffer.h"
+#include "xla/shape_util.h"
+#include "xla/tests/test_utils.h"
+#include "tsl/platform/cpu_info.h"
+#include "tsl/platform/statusor.h"
+#include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+bool HostHasAvx512Vnni() {
+  using tsl::port::CPUFeature;
+  return tsl::port::TestCPUFeature(CPUFeature::AVX512F) &&
+         tsl::port::TestCPUFeature(CPUFeature::AVX512BW) &&
+         tsl::port::TestCPUFeature(CPUFeature::AVX512_VNNI);
+}
+
+// Returns a module multiplying an [m,k] by a [k,n] matrix of `type`. s8
+// matrices are multiplied into s32, the way quantized models do.
+std::string MatMulHloModule(int64_t m, int64_t k, int64_t n,
+                            absl::string_view type) {
+  const bool quantized = type == "s8";
+  const std::string acc_type = quantized ? "s32" : std::string(type);
+  std::string hlo = absl::StrCat(R"(
+HloModule matmul
+
+ENTRY e {
+  p0 = )",
+                                 type, "[", m, ",", k, "] parameter(0)\n",
+                                 "  p1 = ", type, "[", k, ",", n,
+                                 "] parameter(1)\n");
+  if (quantized) {
+    absl::StrAppend(&hlo, "  lhs = s32[", m, ",", k, "] convert(p0)\n",
+                    "  rhs = s32[", k, ",", n, "] convert(p1)\n");
+  }
+  absl::StrAppend(&hlo, "  ROOT dot = ", acc_type, "[", m, ",", n, "] dot(",
+                  quantized ? "lhs, rhs" : "p0, p1",
+                  "), lhs_contracting_dims={1}, ",
+                  "rhs_contracting_dims={0}\n}\n");
+  return hlo;
+}
+
+using CpuInt8Test = CpuCodegenTest;
+
+TEST_F(CpuInt8Test, Int8MatMul) {
+  const std::string hlo =
+      MatMulHloModule(/*m=*/67, /*k=*/129, /*n=*/45, "s8");
+  EXPECT_TRUE(RunAndCompare(hlo, ErrorSpec{0, 0}));
+  if (HostHasAvx512Vnni()) {
+    CompileAndVerifyIr(hlo, R"(
+CHECK: call void @__xla_cpu_runtime_Int8MatMul
+)");
+  }
+}
+
+TEST_F(CpuInt8Test, Int8MatMulWithTransposedOperands) {
+  constexpr absl::string_view kHlo = R"(
+HloModule matmul
+
+ENTRY e {
+  p0 = s8[96,40] parameter(0)
+  p1 = s8[24,96] parameter(1)
+  lhs = s32[96,40] convert(p0)
+  rhs = s32[24,96] convert(p1)
+  ROOT dot = s32[40,24] dot(lhs, rhs),
+    lhs_contracting_dims={0}, rhs_contracting_dims={1}
+})";
+  EXPECT_TRUE(RunAndCompare(kHlo, ErrorSpec{0, 0}));
+}
+
+TEST_F(CpuInt8Test, Int8MatMulWithU8Lhs) {
+  // The u8 values above 127 would be wrong if they were biased like s8 values.
+  constexpr absl::string_view kHlo = R"(
+HloModule matmul
+
+ENTRY e {
+  p0 = u8[67,129] parameter(0)
+  p1 = s8[129,45] parameter(1)
+  lhs = s32[67,129] convert(p0)
+  rhs = s32[129,45] convert(p1)
+  ROOT dot = s32[67,45] dot(lhs, rhs),
+    lhs_contracting_dims={1}, rhs_contracting_dims={0}
+})";
+  EXPECT_TRUE(RunAndCompare(kHlo, ErrorSpec{0, 0}));
+  if (HostHasAvx512Vnni()) {
+    CompileAndVerifyIr(std::string(kHlo), R"(
+CHECK: call void @__xla_cpu_runtime_Int8MatMulU8
+)");
+  }
+}
+
+TEST_F(CpuInt8Test, Int8Convolution) {
+  constexpr absl::string_view kHlo = R"(
+HloModule convolution
+
+ENTRY e {
+  p0 = s8[2,13,11,24] parameter(0)
+  p1 = s8[3,2,24,20] parameter(1)
+  input = s32[2,13,11,24] convert(p0)
+  kernel = s32[3,2,24,20] convert(p1)
+  ROOT conv = s32[2,7,11,20] convolution(input, kernel),
+    window={size=3x2 stride=2x1 pad=1_1x1_1 rhs_dilate=1x2},
+    dim_labels=b01f_01io->b01f
+})";
+  EXPECT_TRUE(RunAndCompare(kHlo, ErrorSpec{0, 0}));
+  if (HostHasAvx512Vnni()) {
+    CompileAndVerifyIr(std::string(kHlo), R"(
+CHECK: call void @__xla_cpu_runtime_Int8Conv2D
+)");
+  }
+}
+
+TEST_F(CpuInt8Test, Int8ConvolutionWithU8Input) {
+  constexpr absl::string_view kHlo = R"(
+HloModule convolution
+
+ENTRY e {
+  p0 = u8[2,13,11,24] parameter(0)
+  p1 = s8[3,2,24,20] parameter(1)
+  input = s32[2,13,11,24] convert(p0)
+  kernel = s32[3,2,24,20] convert(p1)
+  ROOT conv = s32[2,7,11,20] convolution(input, kernel),
+    window={size=3x2 stride=2x1 pad=1_1x1_1 rhs_dilate=1x2},
+    dim_labels=b01f_01io->b01f
+})";
+  EXPECT_TRUE(RunAndCompare(kHlo, ErrorSpec{0, 0}));
+  if (HostHasAvx512Vnni()) {
+    CompileAndVerifyIr(std::string(kHlo), R"(
+CHECK: call void @__xla_cpu_runtime_Int8Conv2DU8
+)");
+  }
+}
+
+// Multiplies the activations of a BERT-large layer, of a batch of 512 tokens,
+// with its weights.
+void BM_BertMatMul(::testing::benchmark::State& state) {
+  const int64_t m = state.range(0);
+  const int64_t k = state.range(1);
+  const int64_t n = state.range(2);
+  const std::string type = state.range(3) ? "s8" : "f32";
+
+  se::Platform* platform = PlatformUtil::GetDefaultPlatform().value();
+  LocalClient* client = ClientLibrary::GetOrCreateLocalClient(platform).value();
+  std::unique_ptr<HloModule> module =
+      ParseAndReturnUnverifiedModule(MatMulHloModule(m, k, n, type)).value();
+  std::vector<Literal> args = MakeFakeArguments(module.get()).value();
+
+  std::vector<Shape> arg_shapes;
+  std::vector<ScopedShapedBuffer> arg_buffers;
+  for (const Literal& arg : args) {
+    arg_shapes.push_back(arg.shape());
+    arg_buffers.push_back(
+        client->LiteralToShapedBuffer(arg, /*device_ordinal=*/0).value());
+  }
+  std::vector<const Shape*> arg_shape_ptrs;
+  std::vector<const ShapedBuffer*> arg_ptrs;
+  for (size_t i = 0; i < args.size(); ++i) {
+    arg_shape_ptrs.push_back(&arg_shapes[i]);
+    arg_ptrs.push_back(&arg_buffers[i]);
+  }
+  auto executables = client
+                         ->Compile(XlaComputation(module->ToProto()),
+                                   arg_shape_ptrs, ExecutableBuildOptions())
+                         .value();
+  std::unique_ptr<LocalExecutable> executable = std::move(executables[0]);
+
+  ExecutableRunOptions options;
+  options.set_allocator(client->backend().memory_allocator());
+
+  // Warm up.
+  CHECK_OK(executable->Run(arg_ptrs, options).status());
+
+  for (auto s : state) {
+    CHECK_OK(executable->Run(arg_ptrs, options).status());
+  }
+  state.SetItemsProcessed(state.iterations() * 2 * m * k * n);
+}
+
+BENCHMARK(BM_BertMatMul)
+    ->ArgNames({"m", "k", "n", "int8"})
+    // Attention projections.
+    ->Args({512, 1024, 1024, 0})
+    ->Args({512, 1024, 1024, 1})
+    // Feed-forward layers.
+    ->Args({512, 1024, 4096, 0})
+    ->Args({512, 1024, 4096, 1})
+    ->Args({512, 4096, 1024, 0})
+    ->Args({512, 4096, 1024, 1})
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
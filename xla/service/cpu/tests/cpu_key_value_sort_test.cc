@@ -40,6 +40,45 @@ ENTRY main {
 
   ROOT result = f32[10] sort(f32[10] a), dimensions={0}, to_apply=compare
 }
+)";
+
+  // A single operand sorted with a plain less-than comparator doesn't need to
+  // call the comparator.
+  std::string filecheck_pattern = R"(
+CHECK: call void @__xla_cpu_runtime_SortPrimitive
+)";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnVerifiedModule(hlo_text));
+
+  CpuAotCompilationOptions options{
+      /*triple=*/kTargetTripleForHost, /*cpu_name=*/kTargetCpuForHost,
+      /*features=*/"",
+      /*entry_point_name=*/"entry",
+      /*relocation_model=*/CpuAotCompilationOptions::RelocationModel::Static};
+
+  CompileAheadOfTimeAndVerifyIr(std::move(module), options, filecheck_pattern,
+                                /*match_optimized_ir=*/true);
+}
+
+TEST_F(CpuKeyValueSortTest, SortR1WithValues) {
+  const std::string hlo_text = R"(
+HloModule KeyValueSort
+
+compare {
+  p.0.lhs = f32[] parameter(0)
+  p.0.rhs = f32[] parameter(1)
+  p.1.lhs = s32[] parameter(2)
+  p.1.rhs = s32[] parameter(3)
+  ROOT lt = pred[] compare(p.0.lhs, p.0.rhs), direction=LT
+}
+
+ENTRY main {
+  a = f32[10] parameter(0)
+  b = s32[10] parameter(1)
+
+  ROOT result = (f32[10], s32[10]) sort(f32[10] a, s32[10] b), dimensions={0},
+    to_apply=compare
+}
 )";
 
   std::string filecheck_pattern = R"(
@@ -0,0 +1,156 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "llvm/IR/Module.h"
+#include "xla/debug_options_flags.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/cpu/cpu_compiler.h"
+#include "xla/service/cpu/tests/cpu_codegen_test.h"
+#include "xla/service/hlo_parser.h"
+#include "xla/service/llvm_compiler.h"
+#include "tsl/platform/statusor.h"
+#include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Returns a module with `num_layers` layers of dot, elementwise and reduce
+// ops, which lower to many functions large enough to be parallel tasks.
+std::string LargeHloModule(int num_layers, int size) {
+  std::string shape = absl::StrCat("f32[", size, ",", size, "]");
+  std::string hlo = absl::StrCat(R"(
+HloModule large_module
+
+add {
+  lhs = f32[] parameter(0)
+  rhs = f32[] parameter(1)
+  ROOT sum = f32[] add(lhs, rhs)
+}
+
+ENTRY entry {
+  zero = f32[] constant(0)
+  scale = f32[] constant(0.001)
+  w = )",
+                                 shape, R"( parameter(1)
+  x0 = )",
+                                 shape, " parameter(0)\n", "  scales = f32[",
+                                 size, "] broadcast(scale), dimensions={}\n");
+  for (int i = 1; i <= num_layers; ++i) {
+    absl::StrAppend(
+        &hlo, "  dot", i, " = ", shape, " dot(x", i - 1,
+        ", w), lhs_contracting_dims={1}, rhs_contracting_dims={0}\n",
+        "  tanh", i, " = ", shape, " tanh(dot", i, ")\n",
+        "  rows", i, " = f32[", size, "] reduce(tanh", i,
+        ", zero), dimensions={1}, to_apply=add\n",
+        "  scaled", i, " = f32[", size, "] multiply(rows", i, ", scales)\n",
+        "  bias", i, " = ", shape, " broadcast(scaled", i,
+        "), dimensions={0}\n",
+        "  x", i, " = ", shape, " add(tanh", i, ", bias", i, ")\n");
+  }
+  absl::StrAppend(&hlo, "  ROOT out = ", shape, " copy(x", num_layers,
+                  ")\n}\n");
+  return hlo;
+}
+
+class CpuParallelCodegenTest : public CpuCodegenTest {
+ protected:
+  // Checks that `hlo_text` compiled in parts on four threads computes the same
+  // as compiled serially, with inter-op parallelism in both if
+  // `inter_op_parallelism`.
+  void MatchesSerialCompilation(const std::string& hlo_text,
+                                bool inter_op_parallelism) {
+    TF_ASSERT_OK_AND_ASSIGN(auto serial_module,
+                            ParseAndReturnVerifiedModule(hlo_text));
+    TF_ASSERT_OK_AND_ASSIGN(auto parallel_module,
+                            ParseAndReturnVerifiedModule(hlo_text));
+    DebugOptions debug_options = serial_module->config().debug_options();
+    debug_options.set_xla_cpu_enable_inter_op_parallelism(inter_op_parallelism);
+    serial_module->mutable_config().set_debug_options(debug_options);
+    debug_options.set_xla_cpu_parallel_codegen_threads(4);
+    parallel_module->mutable_config().set_debug_options(debug_options);
+
+  // Parts of a split module are named after the module with a part suffix.
+    absl::Mutex mu;
+    absl::flat_hash_set<std::string> parts;
+    auto* llvm_compiler = static_cast<LLVMCompiler*>(backend().compiler());
+    llvm_compiler->SetPostOptimizationHook([&](const llvm::Module& module) {
+      absl::MutexLock lock(&mu);
+      if (absl::StrContains(module.getModuleIdentifier(), ".part")) {
+        parts.insert(module.getModuleIdentifier());
+      }
+    });
+    EXPECT_TRUE(RunAndCompareTwoModules(std::move(serial_module),
+                                        std::move(parallel_module),
+                                        ErrorSpec{1e-5, 1e-5}));
+    llvm_compiler->RemovePostOptimizationHook();
+
+    // Otherwise the comparison above would not cover parallel compilation.
+    EXPECT_GT(parts.size(), 1);
+    EXPECT_LE(parts.size(), 4);
+  }
+};
+
+TEST_F(CpuParallelCodegenTest, MatchesSerialCompilation) {
+  MatchesSerialCompilation(LargeHloModule(/*num_layers=*/8, /*size=*/128),
+                           /*inter_op_parallelism=*/false);
+}
+
+// The task graph refers to the task functions from a constant array, which
+// must not be duplicated into the parts that only declare it.
+TEST_F(CpuParallelCodegenTest, MatchesSerialCompilationWithTaskGraph) {
+  MatchesSerialCompilation(LargeHloModule(/*num_layers=*/8, /*size=*/128),
+                           /*inter_op_parallelism=*/true);
+}
+
+void BM_CompileLargeModule(::testing::benchmark::State& state) {
+  const int num_compile_threads = state.range(0);
+  std::unique_ptr<HloModule> module =
+      ParseAndReturnUnverifiedModule(
+          LargeHloModule(/*num_layers=*/512, /*size=*/256))
+          .value();
+  DebugOptions debug_options = GetDebugOptionsFromFlags();
+  debug_options.set_xla_cpu_parallel_codegen_threads(num_compile_threads);
+  module->mutable_config().set_debug_options(debug_options);
+
+  CpuCompiler compiler;
+  std::unique_ptr<HloModule> optimized_module =
+      compiler
+          .RunHloPasses(std::move(module), /*stream_exec=*/nullptr,
+                        Compiler::CompileOptions{})
+          .value();
+  for (auto s : state) {
+    auto executable = compiler
+                          .RunBackend(optimized_module->Clone(),
+                                      /*stream_exec=*/nullptr,
+                                      Compiler::CompileOptions{})
+                          .value();
+  }
+}
+
+BENCHMARK(BM_CompileLargeModule)->Arg(1)->Arg(4)->Arg(16)->UseRealTime();
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,185 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <string>
+#include <utility>
+
+#include "absl/strings/string_view.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/cpu/tests/cpu_codegen_test.h"
+#include "tsl/platform/statusor.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+class CpuParallelTasksTest : public CpuCodegenTest {
+ protected:
+  // Checks that `hlo` computes the same as without any parallel tasks.
+  void MatchesSequentialExecution(absl::string_view hlo,
+                                  const ErrorSpec& error = ErrorSpec{0, 0}) {
+    TF_ASSERT_OK_AND_ASSIGN(auto parallel_module,
+                            ParseAndReturnVerifiedModule(hlo));
+    TF_ASSERT_OK_AND_ASSIGN(auto sequential_module,
+                            ParseAndReturnVerifiedModule(hlo));
+    sequential_module->mutable_config().set_intra_op_parallelism_threads(1);
+
+    EXPECT_TRUE(RunAndCompareTwoModules(std::move(sequential_module),
+                                        std::move(parallel_module), error));
+  }
+};
+
+// The parallel tasks below are outlined the way ParallelTaskAssigner does.
+
+TEST_F(CpuParallelTasksTest, ParallelDynamicUpdateSlice) {
+  constexpr absl::string_view kHlo = R"(
+HloModule dynamic_update_slice
+
+parallel_dus {
+  data = f32[64,128] parameter(0)
+  update = f32[24,32] parameter(1)
+  i = s32[] parameter(2)
+  j = s32[] parameter(3)
+  ROOT dus = f32[64,128] dynamic-update-slice(data, update, i, j),
+      backend_config={"outer_dimension_partitions":["4","2"]}
+}
+
+ENTRY e {
+  data = f32[64,128] parameter(0)
+  update = f32[24,32] parameter(1)
+  i = s32[] constant(50)
+  j = s32[] constant(7)
+  ROOT call = f32[64,128] call(data, update, i, j), to_apply=parallel_dus
+})";
+  // Start index 50 is clamped so that the update fits.
+  EXPECT_TRUE(RunAndCompare(kHlo, ErrorSpec{0, 0}));
+
+  CompileAndVerifyIr(std::string(kHlo), R"(
+CHECK: call {{.*}}@__xla_cpu_runtime_ParallelForkJoin
+)");
+}
+
+// The operand of the dynamic-update-slice is a constant, which can't share a
+// buffer with the output. Unless it gets copied first, the update can't be
+// written in place and the partitions are ignored.
+TEST_F(CpuParallelTasksTest, ParallelDynamicUpdateSliceOfConstant) {
+  constexpr absl::string_view kHlo = R"(
+HloModule dynamic_update_slice_of_constant
+
+parallel_dus {
+  data = f32[4,8] constant({{0, 1, 2, 3, 4, 5, 6, 7},
+                            {8, 9, 10, 11, 12, 13, 14, 15},
+                            {16, 17, 18, 19, 20, 21, 22, 23},
+                            {24, 25, 26, 27, 28, 29, 30, 31}})
+  update = f32[2,4] parameter(0)
+  i = s32[] parameter(1)
+  j = s32[] parameter(2)
+  ROOT dus = f32[4,8] dynamic-update-slice(data, update, i, j),
+      backend_config={"outer_dimension_partitions":["2","2"]}
+}
+
+ENTRY e {
+  update = f32[2,4] parameter(0)
+  i = s32[] constant(1)
+  j = s32[] constant(3)
+  call = f32[4,8] call(update, i, j), to_apply=parallel_dus
+  ROOT add = f32[4,8] add(call, call)
+})";
+  MatchesSequentialExecution(kHlo);
+}
+
+TEST_F(CpuParallelTasksTest, ParallelFusedDynamicUpdateSlice) {
+  constexpr absl::string_view kHlo = R"(
+HloModule fused_dynamic_update_slice
+
+fused_computation {
+  data = f32[256,64] parameter(0)
+  update = f32[100,64] parameter(1)
+  exp = f32[100,64] exponential(update)
+  i = s32[] parameter(2)
+  zero = s32[] constant(0)
+  ROOT dus = f32[256,64] dynamic-update-slice(data, exp, i, zero)
+}
+
+parallel_fusion {
+  data = f32[256,64] parameter(0)
+  update = f32[100,64] parameter(1)
+  i = s32[] parameter(2)
+  ROOT fusion = f32[256,64] fusion(data, update, i), kind=kLoop,
+      calls=fused_computation,
+      backend_config={"outer_dimension_partitions":["8"]}
+}
+
+ENTRY e {
+  data = f32[256,64] parameter(0)
+  update = f32[100,64] parameter(1)
+  i = s32[] constant(17)
+  ROOT call = f32[256,64] call(data, update, i), to_apply=parallel_fusion
+})";
+  EXPECT_TRUE(RunAndCompare(kHlo, ErrorSpec{1e-5, 1e-5}));
+}
+
+TEST_F(CpuParallelTasksTest, ParallelMultiOutputLoopFusion) {
+  constexpr absl::string_view kHlo = R"(
+HloModule multi_output_fusion
+
+fused_computation {
+  p0 = f32[128,96] parameter(0)
+  p1 = f32[128,96] parameter(1)
+  add = f32[128,96] add(p0, p1)
+  mul = f32[128,96] multiply(p0, p1)
+  cmp = pred[128,96] compare(p0, p1), direction=LT
+  ROOT tuple = (f32[128,96], f32[128,96], pred[128,96]) tuple(add, mul, cmp)
+}
+
+parallel_fusion {
+  p0 = f32[128,96] parameter(0)
+  p1 = f32[128,96] parameter(1)
+  ROOT fusion = (f32[128,96], f32[128,96], pred[128,96]) fusion(p0, p1),
+      kind=kLoop, calls=fused_computation,
+      backend_config={"outer_dimension_partitions":["3","2"]}
+}
+
+ENTRY e {
+  p0 = f32[128,96] parameter(0)
+  p1 = f32[128,96] parameter(1)
+  ROOT call = (f32[128,96], f32[128,96], pred[128,96]) call(p0, p1),
+      to_apply=parallel_fusion
+})";
+  EXPECT_TRUE(RunAndCompare(kHlo, ErrorSpec{1e-5, 1e-5}));
+
+  CompileAndVerifyIr(std::string(kHlo), R"(
+CHECK: call {{.*}}@__xla_cpu_runtime_ParallelForkJoin
+)");
+}
+
+TEST_F(CpuParallelTasksTest, RandomBitsAreIndependentOfPartitioning) {
+  // Random bits are generated by a counter-based generator, so each element
+  // only depends on its index and the state.
+  constexpr absl::string_view kHlo = R"(
+HloModule rng_bit_generator
+
+ENTRY e {
+  state = u64[2] parameter(0)
+  ROOT rng = (u64[2], u32[512,1024]) rng-bit-generator(state),
+      algorithm=rng_philox
+})";
+  MatchesSequentialExecution(kHlo);
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,205 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/string_view.h"
+#include "xla/client/client_library.h"
+#include "xla/client/executable_build_options.h"
+#include "xla/client/local_client.h"
+#include "xla/client/xla_computation.h"
+#include "xla/executable_run_options.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/literal.h"
+#include "xla/service/cpu/tests/cpu_codegen_test.h"
+#include "xla/service/hlo_parser.h"
+#include "xla/service/platform_util.h"
+#include "xla/service/shaped_buffer.h"
+#include "xla/tests/test_utils.h"
+#include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Returns a module summing an f32 array of `dims` over `reduced_dims`.
+std::string ReduceHloModule(const std::vector<int64_t>& dims,
+                            const std::vector<int64_t>& reduced_dims) {
+  std::vector<int64_t> result_dims;
+  for (int64_t i = 0; i < dims.size(); ++i) {
+    if (!absl::c_linear_search(reduced_dims, i)) {
+      result_dims.push_back(dims[i]);
+    }
+  }
+  return absl::StrCat(R"(
+HloModule reduce
+
+add {
+  lhs = f32[] parameter(0)
+  rhs = f32[] parameter(1)
+  ROOT add = f32[] add(lhs, rhs)
+}
+
+ENTRY e {
+  p0 = f32[)",
+                      absl::StrJoin(dims, ","), R"(] parameter(0)
+  zero = f32[] constant(0)
+  ROOT reduce = f32[)",
+                      absl::StrJoin(result_dims, ","),
+                      "] reduce(p0, zero), dimensions={",
+                      absl::StrJoin(reduced_dims, ","),
+                      "}, to_apply=add\n}\n");
+}
+
+using CpuReduceTest = CpuCodegenTest;
+
+// Large reductions are split into parallel tasks along the dimensions of their
+// result, which for column reductions is the vectorized minor dimension.
+TEST_F(CpuReduceTest, ColumnReduction) {
+  EXPECT_TRUE(
+      RunAndCompare(ReduceHloModule({2048, 1001}, {0}), ErrorSpec{1e-3, 1e-3}));
+}
+
+TEST_F(CpuReduceTest, NarrowColumnReduction) {
+  EXPECT_TRUE(
+      RunAndCompare(ReduceHloModule({4096, 37}, {0}), ErrorSpec{1e-3, 1e-3}));
+}
+
+TEST_F(CpuReduceTest, BatchReduction) {
+  EXPECT_TRUE(RunAndCompare(ReduceHloModule({16, 256, 130}, {0, 1}),
+                            ErrorSpec{1e-3, 1e-3}));
+}
+
+TEST_F(CpuReduceTest, MiddleDimensionReduction) {
+  EXPECT_TRUE(RunAndCompare(ReduceHloModule({64, 512, 67}, {1}),
+                            ErrorSpec{1e-3, 1e-3}));
+}
+
+TEST_F(CpuReduceTest, RowReduction) {
+  EXPECT_TRUE(
+      RunAndCompare(ReduceHloModule({1001, 2048}, {1}), ErrorSpec{1e-3, 1e-3}));
+}
+
+// The reduction is outlined into a parallel task the way ParallelTaskAssigner
+// does, with partitions along both dimensions of the result. Each task reduces
+// its part of the minor-most dimension in vector tiles up to the last full
+// tile, and the remainder one element at a time.
+TEST_F(CpuReduceTest, PartitionedColumnReduction) {
+  constexpr absl::string_view kHlo = R"(
+HloModule partitioned_reduce
+
+add {
+  lhs = f32[] parameter(0)
+  rhs = f32[] parameter(1)
+  ROOT add = f32[] add(lhs, rhs)
+}
+
+parallel_reduce {
+  p0 = f32[64,32,100] parameter(0)
+  zero = f32[] constant(0)
+  ROOT reduce = f32[64,100] reduce(p0, zero), dimensions={1}, to_apply=add,
+      backend_config={"outer_dimension_partitions":["2","3"]}
+}
+
+ENTRY e {
+  p0 = f32[64,32,100] parameter(0)
+  ROOT call = f32[64,100] call(p0), to_apply=parallel_reduce
+})";
+  EXPECT_TRUE(RunAndCompare(kHlo, ErrorSpec{1e-3, 1e-3}));
+
+  CompileAndVerifyIr(std::string(kHlo), R"(
+CHECK: %dynamic_loop_bound_0 = load i64
+CHECK: %dynamic_loop_bound_1 = load i64
+CHECK: %dynamic_loop_bound_2 = load i64
+CHECK: %dynamic_loop_bound_3 = load i64
+CHECK: icmp uge i64 %reduce.indvar.dim.0, %dynamic_loop_bound_1
+CHECK: icmp uge i64 %reduce.indvar.dim.1, %[[TILED_END:[^ ,]+]]
+CHECK: store i64 %[[TILED_END]], ptr %reduce.epilogue.invar_address.dim.1
+CHECK: icmp uge i64 %reduce.epilogue.indvar.dim.1, %dynamic_loop_bound_3
+)");
+}
+
+struct ReduceCase {
+  std::vector<int64_t> dims;
+  std::vector<int64_t> reduced_dims;
+};
+
+const std::vector<ReduceCase>& ReduceCases() {
+  static const auto* cases = new std::vector<ReduceCase>{
+      // Row reduction.
+      {{4096, 4096}, {1}},
+      // Column reduction.
+      {{4096, 4096}, {0}},
+      // Batch reduction, e.g. of the gradients of a bias.
+      {{64, 512, 1024}, {0, 1}},
+      // Reduction over a middle dimension.
+      {{64, 512, 1024}, {1}},
+  };
+  return *cases;
+}
+
+void BM_Reduce(::testing::benchmark::State& state) {
+  const ReduceCase& reduce_case = ReduceCases()[state.range(0)];
+  int64_t num_elements = 1;
+  for (int64_t dim : reduce_case.dims) {
+    num_elements *= dim;
+  }
+
+  se::Platform* platform = PlatformUtil::GetDefaultPlatform().value();
+  LocalClient* client = ClientLibrary::GetOrCreateLocalClient(platform).value();
+  std::unique_ptr<HloModule> module =
+      ParseAndReturnUnverifiedModule(
+          ReduceHloModule(reduce_case.dims, reduce_case.reduced_dims))
+          .value();
+  Literal arg = std::move(MakeFakeArguments(module.get()).value()[0]);
+  ScopedShapedBuffer arg_buffer =
+      client->LiteralToShapedBuffer(arg, /*device_ordinal=*/0).value();
+  auto executables = client
+                         ->Compile(XlaComputation(module->ToProto()),
+                                   {&arg.shape()}, ExecutableBuildOptions())
+                         .value();
+  std::unique_ptr<LocalExecutable> executable = std::move(executables[0]);
+
+  ExecutableRunOptions options;
+  options.set_allocator(client->backend().memory_allocator());
+
+  // Warm up.
+  CHECK_OK(executable->Run({&arg_buffer}, options).status());
+
+  for (auto s : state) {
+    CHECK_OK(executable->Run({&arg_buffer}, options).status());
+  }
+  state.SetBytesProcessed(state.iterations() * num_elements * sizeof(float));
+}
+
+BENCHMARK(BM_Reduce)
+    ->ArgName("case")
+    ->Arg(0)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(3)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,286 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "xla/client/client_library.h"
+#include "xla/client/executable_build_options.h"
+#include "xla/client/local_client.h"
+#include "xla/client/xla_computation.h"
+#include "xla/executable_run_options.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/literal.h"
+#include "xla/service/cpu/tests/cpu_codegen_test.h"
+#include "xla/service/hlo_parser.h"
+#include "xla/service/platform_util.h"
+#include "xla/service/shaped_buffer.h"
+#include "xla/tests/test_utils.h"
+#include "xla/xla.pb.h"
+#include "tsl/platform/statusor.h"
+#include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+class CpuScatterTest : public CpuCodegenTest {
+ protected:
+  // Checks that `hlo` computes the same as with scatters expanded into loops.
+  void MatchesExpandedScatter(absl::string_view hlo,
+                              const ErrorSpec& error = ErrorSpec{0, 0}) {
+    TF_ASSERT_OK_AND_ASSIGN(auto native_module,
+                            ParseAndReturnVerifiedModule(hlo));
+    TF_ASSERT_OK_AND_ASSIGN(auto expanded_module,
+                            ParseAndReturnVerifiedModule(hlo));
+    DebugOptions debug_options = expanded_module->config().debug_options();
+    debug_options.set_xla_cpu_use_native_scatter(false);
+    expanded_module->mutable_config().set_debug_options(debug_options);
+
+    EXPECT_TRUE(RunAndCompareTwoModules(std::move(expanded_module),
+                                        std::move(native_module), error));
+  }
+};
+
+TEST_F(CpuScatterTest, SerialScatter) {
+  constexpr absl::string_view kHlo = R"(
+HloModule scatter
+
+mul {
+  lhs = f32[] parameter(0)
+  rhs = f32[] parameter(1)
+  ROOT mul = f32[] multiply(lhs, rhs)
+}
+
+ENTRY e {
+  operand = f32[16,8,4] parameter(0)
+  indices = s32[5,2] parameter(1)
+  updates = f32[5,8,2] parameter(2)
+  ROOT scatter = f32[16,8,4] scatter(operand, indices, updates),
+      update_window_dims={1,2}, inserted_window_dims={0},
+      scatter_dims_to_operand_dims={0,2}, index_vector_dim=1, to_apply=mul
+})";
+  MatchesExpandedScatter(kHlo);
+}
+
+TEST_F(CpuScatterTest, ScalarIndicesWithoutIndexVectorDim) {
+  constexpr absl::string_view kHlo = R"(
+HloModule scatter
+
+add {
+  lhs = s32[] parameter(0)
+  rhs = s32[] parameter(1)
+  ROOT add = s32[] add(lhs, rhs)
+}
+
+ENTRY e {
+  operand = s32[32,3] parameter(0)
+  indices = s32[7] parameter(1)
+  updates = s32[7,3] parameter(2)
+  ROOT scatter = s32[32,3] scatter(operand, indices, updates),
+      update_window_dims={1}, inserted_window_dims={0},
+      scatter_dims_to_operand_dims={0}, index_vector_dim=1, to_apply=add
+})";
+  MatchesExpandedScatter(kHlo);
+}
+
+TEST_F(CpuScatterTest, ParallelScatterWithUniqueIndices) {
+  // Indices 64 and up are out of bounds, and their updates are dropped.
+  constexpr absl::string_view kHlo = R"(
+HloModule scatter
+
+overwrite {
+  lhs = f32[] parameter(0)
+  ROOT rhs = f32[] parameter(1)
+}
+
+ENTRY e {
+  operand = f32[64,16] parameter(0)
+  iota = s32[64,1] iota(), iota_dimension=0
+  offset = s32[] constant(8)
+  offsets = s32[64,1] broadcast(offset), dimensions={}
+  indices = s32[64,1] add(iota, offsets)
+  updates = f32[64,16] parameter(1)
+  ROOT scatter = f32[64,16] scatter(operand, indices, updates),
+      update_window_dims={1}, inserted_window_dims={0},
+      scatter_dims_to_operand_dims={0}, index_vector_dim=1,
+      unique_indices=true, to_apply=overwrite,
+      backend_config={"outer_dimension_partitions":["4"]}
+})";
+  MatchesExpandedScatter(kHlo);
+}
+
+TEST_F(CpuScatterTest, ParallelScatterWithAtomicCombiner) {
+  constexpr absl::string_view kHlo = R"(
+HloModule scatter
+
+add {
+  lhs = s32[] parameter(0)
+  rhs = s32[] parameter(1)
+  ROOT add = s32[] add(lhs, rhs)
+}
+
+ENTRY e {
+  operand = s32[16,8] parameter(0)
+  indices = s32[1024,1] parameter(1)
+  updates = s32[1024,8] parameter(2)
+  ROOT scatter = s32[16,8] scatter(operand, indices, updates),
+      update_window_dims={1}, inserted_window_dims={0},
+      scatter_dims_to_operand_dims={0}, index_vector_dim=1, to_apply=add,
+      backend_config={"outer_dimension_partitions":["8"]}
+})";
+  MatchesExpandedScatter(kHlo);
+
+  CompileAndVerifyIr(std::string(kHlo), R"(
+CHECK-DAG: call {{.*}}@__xla_cpu_runtime_ParallelForkJoin
+CHECK-DAG: atomicrmw add
+)");
+}
+
+constexpr absl::string_view kFloatScatterAddHlo = R"(
+HloModule scatter
+
+add {
+  lhs = f32[] parameter(0)
+  rhs = f32[] parameter(1)
+  ROOT add = f32[] add(lhs, rhs)
+}
+
+ENTRY e {
+  operand = f32[32] parameter(0)
+  indices = s32[4096,1] parameter(1)
+  updates = f32[4096] parameter(2)
+  ROOT scatter = f32[32] scatter(operand, indices, updates),
+      update_window_dims={}, inserted_window_dims={0},
+      scatter_dims_to_operand_dims={0}, index_vector_dim=1, to_apply=add,
+      backend_config={"outer_dimension_partitions":["8"]}
+})";
+
+// Float additions aren't applied atomically by default, so that results are
+// reproducible: the partitions are ignored and the updates added in order.
+TEST_F(CpuScatterTest, FloatScatterAddIsSequential) {
+  MatchesExpandedScatter(kFloatScatterAddHlo);
+
+  CompileAndVerifyIr(std::string(kFloatScatterAddHlo), R"(
+CHECK-NOT: atomicrmw
+CHECK-NOT: call {{.*}}@__xla_cpu_runtime_ParallelForkJoin
+)");
+}
+
+class CpuFloatScatterAtomicsTest : public CpuScatterTest {
+ protected:
+  DebugOptions GetDebugOptionsForTest() override {
+    DebugOptions debug_options = CpuScatterTest::GetDebugOptionsForTest();
+    debug_options.set_xla_cpu_enable_float_scatter_atomics(true);
+    return debug_options;
+  }
+};
+
+TEST_F(CpuFloatScatterAtomicsTest, ParallelFloatScatterAdd) {
+  // Partitions add their updates in a nondeterministic order.
+  MatchesExpandedScatter(kFloatScatterAddHlo, ErrorSpec{1e-3, 1e-3});
+
+  CompileAndVerifyIr(std::string(kFloatScatterAddHlo), R"(
+CHECK-DAG: call {{.*}}@__xla_cpu_runtime_ParallelForkJoin
+CHECK-DAG: atomicrmw fadd
+)");
+}
+
+// Scatter-adds `num_updates` rows of 64 floats into a 1024-row operand.
+std::string ScatterHloModule(int64_t num_updates) {
+  return absl::StrCat(R"(
+HloModule scatter
+
+add {
+  lhs = f32[] parameter(0)
+  rhs = f32[] parameter(1)
+  ROOT add = f32[] add(lhs, rhs)
+}
+
+ENTRY e {
+  operand = f32[1024,64] parameter(0)
+  indices = s32[)",
+                      num_updates, R"(,1] parameter(1)
+  updates = f32[)",
+                      num_updates, R"(,64] parameter(2)
+  ROOT scatter = f32[1024,64] scatter(operand, indices, updates),
+      update_window_dims={1}, inserted_window_dims={0},
+      scatter_dims_to_operand_dims={0}, index_vector_dim=1, to_apply=add
+})");
+}
+
+// Compares the native scatter emitter (native = 1) with the loops of the
+// scatter expander (native = 0).
+void BM_Scatter(::testing::benchmark::State& state) {
+  const bool native = state.range(0);
+  const int64_t num_updates = state.range(1);
+
+  se::Platform* platform = PlatformUtil::GetDefaultPlatform().value();
+  LocalClient* client = ClientLibrary::GetOrCreateLocalClient(platform).value();
+  std::unique_ptr<HloModule> module =
+      ParseAndReturnUnverifiedModule(ScatterHloModule(num_updates)).value();
+  std::vector<Literal> args = MakeFakeArguments(module.get()).value();
+  std::vector<ScopedShapedBuffer> arg_buffers;
+  std::vector<const ShapedBuffer*> arg_ptrs;
+  std::vector<const Shape*> arg_shapes;
+  for (const Literal& arg : args) {
+    arg_buffers.push_back(
+        client->LiteralToShapedBuffer(arg, /*device_ordinal=*/0).value());
+    arg_shapes.push_back(&arg.shape());
+  }
+  for (const ScopedShapedBuffer& arg_buffer : arg_buffers) {
+    arg_ptrs.push_back(&arg_buffer);
+  }
+
+  ExecutableBuildOptions build_options;
+  build_options.mutable_debug_options()->set_xla_cpu_use_native_scatter(
+      native);
+  auto executables =
+      client->Compile(XlaComputation(module->ToProto()), arg_shapes,
+                      build_options)
+          .value();
+  std::unique_ptr<LocalExecutable> executable = std::move(executables[0]);
+
+  ExecutableRunOptions options;
+  options.set_allocator(client->backend().memory_allocator());
+
+  // Warm up.
+  CHECK_OK(executable->Run(arg_ptrs, options).status());
+
+  for (auto s : state) {
+    CHECK_OK(executable->Run(arg_ptrs, options).status());
+  }
+  state.SetItemsProcessed(state.iterations() * num_updates * 64);
+}
+
+BENCHMARK(BM_Scatter)
+    ->ArgNames({"native", "updates"})
+    ->Args({0, 64})
+    ->Args({1, 64})
+    ->Args({0, 4096})
+    ->Args({1, 4096})
+    ->Args({0, 65536})
+    ->Args({1, 65536})
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,399 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#define EIGEN_USE_THREADS
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "xla/client/client_library.h"
+#include "xla/client/executable_build_options.h"
+#include "xla/client/local_client.h"
+#include "xla/client/xla_computation.h"
+#include "xla/executable_run_options.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/literal.h"
+#include "xla/literal_util.h"
+#include "xla/service/cpu/tests/cpu_codegen_test.h"
+#include "xla/service/hlo_parser.h"
+#include "xla/service/platform_util.h"
+#include "xla/service/shaped_buffer.h"
+#include "xla/shape_util.h"
+#include "xla/xla.pb.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/statusor.h"
+#include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
+#include "tsl/platform/threadpool.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Returns a module with `num_towers` independent chains of `depth` layers of
+// dot and elementwise ops over the same input, whose results are reduced and
+// returned as a tuple.
+std::string WideHloModule(int num_towers, int depth, int size) {
+  std::string shape = absl::StrCat("f32[", size, ",", size, "]");
+  std::string hlo = absl::StrCat(R"(
+HloModule wide_module
+
+add {
+  lhs = f32[] parameter(0)
+  rhs = f32[] parameter(1)
+  ROOT sum = f32[] add(lhs, rhs)
+}
+
+ENTRY entry {
+  zero = f32[] constant(0)
+  x = )",
+                                 shape, " parameter(0)\n");
+  std::vector<std::string> outputs;
+  for (int t = 0; t < num_towers; ++t) {
+    std::string prev = "x";
+    absl::StrAppend(&hlo, "  c", t, " = f32[] constant(", t + 1, ")\n",
+                    "  s", t, " = ", shape, " broadcast(c", t,
+                    "), dimensions={}\n");
+    for (int l = 0; l < depth; ++l) {
+      std::string name = absl::StrCat("t", t, "_", l);
+      absl::StrAppend(
+          &hlo, "  dot_", name, " = ", shape, " dot(", prev,
+          ", x), lhs_contracting_dims={1}, rhs_contracting_dims={0}\n",
+          "  mul_", name, " = ", shape, " multiply(dot_", name, ", s", t,
+          ")\n", "  ", name, " = ", shape, " tanh(mul_", name, ")\n");
+      prev = name;
+    }
+    absl::StrAppend(&hlo, "  out", t, " = f32[", size, "] reduce(", prev,
+                    ", zero), dimensions={1}, to_apply=add\n");
+    outputs.push_back(absl::StrCat("out", t));
+  }
+  absl::StrAppend(&hlo, "  ROOT tuple = (");
+  for (int t = 0; t < num_towers; ++t) {
+    absl::StrAppend(&hlo, t > 0 ? ", " : "", "f32[", size, "]");
+  }
+  absl::StrAppend(&hlo, ") tuple(", absl::StrJoin(outputs, ", "), ")\n}\n");
+  return hlo;
+}
+
+class CpuTaskGraphTest : public CpuCodegenTest {
+ protected:
+  DebugOptions GetDebugOptionsForTest() override {
+    DebugOptions debug_options = CpuCodegenTest::GetDebugOptionsForTest();
+    debug_options.set_xla_cpu_enable_inter_op_parallelism(true);
+    return debug_options;
+  }
+};
+
+TEST_F(CpuTaskGraphTest, EmitsTaskGraph) {
+  CompileAndVerifyIr(WideHloModule(/*num_towers=*/4, /*depth=*/2,
+                                   /*size=*/32),
+                     R"(
+CHECK: call void @__xla_cpu_runtime_ExecuteTaskGraph
+)");
+}
+
+TEST_F(CpuTaskGraphTest, MatchesSequentialExecution) {
+  std::string hlo_text =
+      WideHloModule(/*num_towers=*/8, /*depth=*/3, /*size=*/64);
+  TF_ASSERT_OK_AND_ASSIGN(auto sequential_module,
+                          ParseAndReturnVerifiedModule(hlo_text));
+  TF_ASSERT_OK_AND_ASSIGN(auto task_graph_module,
+                          ParseAndReturnVerifiedModule(hlo_text));
+  DebugOptions debug_options = sequential_module->config().debug_options();
+  debug_options.set_xla_cpu_enable_inter_op_parallelism(false);
+  sequential_module->mutable_config().set_debug_options(debug_options);
+
+  EXPECT_TRUE(RunAndCompareTwoModules(std::move(sequential_module),
+                                      std::move(task_graph_module),
+                                      ErrorSpec{1e-5, 1e-5}));
+}
+
+TEST_F(CpuTaskGraphTest, TupleParameter) {
+  constexpr absl::string_view kHlo = R"(
+HloModule tuple_parameter
+
+ENTRY e {
+  p = (f32[128], f32[128]) parameter(0)
+  a = f32[128] get-tuple-element(p), index=0
+  b = f32[128] get-tuple-element(p), index=1
+  exp = f32[128] exponential(a)
+  neg = f32[128] negate(b)
+  sum = f32[128] add(exp, neg)
+  ROOT tuple = (f32[128], f32[128], f32[128]) tuple(exp, neg, sum)
+})";
+  EXPECT_TRUE(RunAndCompare(kHlo, ErrorSpec{1e-5, 1e-5}));
+}
+
+// Task graphs of concurrent executions share the intra-op thread pool, whose
+// threads their dots also block on. They must not take all of its threads.
+TEST_F(CpuTaskGraphTest, ConcurrentExecutionsOnSmallPool) {
+  constexpr int kSize = 64;
+  constexpr int kNumExecutions = 8;
+
+  se::Platform* platform = PlatformUtil::GetDefaultPlatform().value();
+  TF_ASSERT_OK_AND_ASSIGN(LocalClient * client,
+                          ClientLibrary::GetOrCreateLocalClient(platform));
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto module, ParseAndReturnUnverifiedModule(WideHloModule(
+                       /*num_towers=*/8, /*depth=*/3, kSize)));
+  ExecutableBuildOptions build_options;
+  build_options.mutable_debug_options()
+      ->set_xla_cpu_enable_inter_op_parallelism(true);
+  Shape shape = ShapeUtil::MakeShapeWithDescendingLayout(F32, {kSize, kSize});
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto executables, client->Compile(XlaComputation(module->ToProto()),
+                                        {&shape}, build_options));
+  std::unique_ptr<LocalExecutable> executable = std::move(executables[0]);
+  TF_ASSERT_OK_AND_ASSIGN(
+      ScopedShapedBuffer arg,
+      client->LiteralToShapedBuffer(
+          LiteralUtil::CreateFullWithDescendingLayout<float>({kSize, kSize},
+                                                             0.01f),
+          /*device_ordinal=*/0));
+
+  tsl::thread::ThreadPool intra_op_pool(tsl::Env::Default(), "intra_op", 2);
+  Eigen::ThreadPoolDevice device(intra_op_pool.AsEigenThreadPool(),
+                                 intra_op_pool.NumThreads());
+  ExecutableRunOptions options;
+  options.set_allocator(client->backend().memory_allocator());
+  options.set_intra_op_thread_pool(&device);
+
+  TF_ASSERT_OK_AND_ASSIGN(ScopedShapedBuffer expected_buffer,
+                          executable->Run({&arg}, options));
+  TF_ASSERT_OK_AND_ASSIGN(Literal expected,
+                          client->ShapedBufferToLiteral(expected_buffer));
+
+  std::vector<Literal> results(kNumExecutions);
+  {
+    tsl::thread::ThreadPool launch_pool(tsl::Env::Default(), "launch",
+                                        kNumExecutions);
+    for (int i = 0; i < kNumExecutions; ++i) {
+      launch_pool.Schedule([&, i] {
+        TF_ASSERT_OK_AND_ASSIGN(ScopedShapedBuffer result,
+                                executable->Run({&arg}, options));
+        TF_ASSERT_OK_AND_ASSIGN(results[i],
+                                client->ShapedBufferToLiteral(result));
+      });
+    }
+  }
+  for (const Literal& result : results) {
+    EXPECT_EQ(result, expected);
+  }
+}
+
+// Runtime transposes block on the work they schedule on the intra-op thread
+// pool, so inside tasks running on that pool they must not schedule any.
+TEST_F(CpuTaskGraphTest, RuntimeTransposesOnSmallPool) {
+  constexpr absl::string_view kHlo = R"(
+HloModule transposes
+
+ENTRY entry {
+  x = f32[256,128] parameter(0)
+  c0 = f32[] constant(1)
+  c1 = f32[] constant(2)
+  c2 = f32[] constant(3)
+  c3 = f32[] constant(4)
+  b0 = f32[256,128] broadcast(c0), dimensions={}
+  b1 = f32[256,128] broadcast(c1), dimensions={}
+  b2 = f32[256,128] broadcast(c2), dimensions={}
+  b3 = f32[256,128] broadcast(c3), dimensions={}
+  a0 = f32[256,128] add(x, b0)
+  a1 = f32[256,128] multiply(x, b1)
+  a2 = f32[256,128] subtract(x, b2)
+  a3 = f32[256,128] divide(x, b3)
+  t0 = f32[128,256] transpose(a0), dimensions={1,0}
+  t1 = f32[128,256] transpose(a1), dimensions={1,0}
+  t2 = f32[128,256] transpose(a2), dimensions={1,0}
+  t3 = f32[128,256] transpose(a3), dimensions={1,0}
+  ROOT tuple = (f32[128,256], f32[128,256], f32[128,256], f32[128,256])
+      tuple(t0, t1, t2, t3)
+})";
+
+  se::Platform* platform = PlatformUtil::GetDefaultPlatform().value();
+  TF_ASSERT_OK_AND_ASSIGN(LocalClient * client,
+                          ClientLibrary::GetOrCreateLocalClient(platform));
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnUnverifiedModule(kHlo));
+  Shape shape = ShapeUtil::MakeShapeWithDescendingLayout(F32, {256, 128});
+  auto compile = [&](bool inter_op_parallelism) {
+    ExecutableBuildOptions build_options;
+    build_options.mutable_debug_options()
+        ->set_xla_cpu_enable_inter_op_parallelism(inter_op_parallelism);
+    auto executables = client->Compile(XlaComputation(module->ToProto()),
+                                       {&shape}, build_options);
+    TF_CHECK_OK(executables.status());
+    return std::move((*executables)[0]);
+  };
+  std::unique_ptr<LocalExecutable> sequential = compile(false);
+  std::unique_ptr<LocalExecutable> parallel = compile(true);
+  TF_ASSERT_OK_AND_ASSIGN(
+      ScopedShapedBuffer arg,
+      client->LiteralToShapedBuffer(
+          LiteralUtil::CreateFullWithDescendingLayout<float>({256, 128},
+                                                             0.5f),
+          /*device_ordinal=*/0));
+
+  tsl::thread::ThreadPool intra_op_pool(tsl::Env::Default(), "intra_op", 2);
+  Eigen::ThreadPoolDevice device(intra_op_pool.AsEigenThreadPool(),
+                                 intra_op_pool.NumThreads());
+  ExecutableRunOptions options;
+  options.set_allocator(client->backend().memory_allocator());
+  options.set_intra_op_thread_pool(&device);
+
+  TF_ASSERT_OK_AND_ASSIGN(ScopedShapedBuffer expected_buffer,
+                          sequential->Run({&arg}, options));
+  TF_ASSERT_OK_AND_ASSIGN(Literal expected,
+                          client->ShapedBufferToLiteral(expected_buffer));
+  TF_ASSERT_OK_AND_ASSIGN(ScopedShapedBuffer result_buffer,
+                          parallel->Run({&arg}, options));
+  TF_ASSERT_OK_AND_ASSIGN(Literal result,
+                          client->ShapedBufferToLiteral(result_buffer));
+  EXPECT_EQ(result, expected);
+}
+
+// Like runtime transposes, parallel runtime sorts must not block on work they
+// schedule on the intra-op thread pool from tasks running on it.
+TEST_F(CpuTaskGraphTest, RuntimeSortsOnSmallPool) {
+  constexpr absl::string_view kHlo = R"(
+HloModule sorts
+
+compare {
+  p0 = f32[] parameter(0)
+  p1 = f32[] parameter(1)
+  ROOT lt = pred[] compare(p0, p1), direction=LT
+}
+
+ENTRY entry {
+  x = f32[65536] parameter(0)
+  c0 = f32[] constant(1)
+  c1 = f32[] constant(-2)
+  c2 = f32[] constant(3)
+  c3 = f32[] constant(-4)
+  b0 = f32[65536] broadcast(c0), dimensions={}
+  b1 = f32[65536] broadcast(c1), dimensions={}
+  b2 = f32[65536] broadcast(c2), dimensions={}
+  b3 = f32[65536] broadcast(c3), dimensions={}
+  a0 = f32[65536] add(x, b0)
+  a1 = f32[65536] multiply(x, b1)
+  a2 = f32[65536] subtract(x, b2)
+  a3 = f32[65536] multiply(x, b3)
+  s0 = f32[65536] sort(a0), dimensions={0}, to_apply=compare
+  s1 = f32[65536] sort(a1), dimensions={0}, to_apply=compare
+  s2 = f32[65536] sort(a2), dimensions={0}, to_apply=compare
+  s3 = f32[65536] sort(a3), dimensions={0}, to_apply=compare
+  ROOT tuple = (f32[65536], f32[65536], f32[65536], f32[65536])
+      tuple(s0, s1, s2, s3)
+})";
+
+  se::Platform* platform = PlatformUtil::GetDefaultPlatform().value();
+  TF_ASSERT_OK_AND_ASSIGN(LocalClient * client,
+                          ClientLibrary::GetOrCreateLocalClient(platform));
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnUnverifiedModule(kHlo));
+  Shape shape = ShapeUtil::MakeShapeWithDescendingLayout(F32, {65536});
+  auto compile = [&](bool inter_op_parallelism) {
+    ExecutableBuildOptions build_options;
+    build_options.mutable_debug_options()
+        ->set_xla_cpu_enable_inter_op_parallelism(inter_op_parallelism);
+    auto executables = client->Compile(XlaComputation(module->ToProto()),
+                                       {&shape}, build_options);
+    TF_CHECK_OK(executables.status());
+    return std::move((*executables)[0]);
+  };
+  std::unique_ptr<LocalExecutable> sequential = compile(false);
+  std::unique_ptr<LocalExecutable> parallel = compile(true);
+  std::vector<float> values(65536);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = (i * 7919) % values.size();
+  }
+  TF_ASSERT_OK_AND_ASSIGN(
+      ScopedShapedBuffer arg,
+      client->LiteralToShapedBuffer(LiteralUtil::CreateR1<float>(values),
+                                    /*device_ordinal=*/0));
+
+  tsl::thread::ThreadPool intra_op_pool(tsl::Env::Default(), "intra_op", 2);
+  Eigen::ThreadPoolDevice device(intra_op_pool.AsEigenThreadPool(),
+                                 intra_op_pool.NumThreads());
+  ExecutableRunOptions options;
+  options.set_allocator(client->backend().memory_allocator());
+  options.set_intra_op_thread_pool(&device);
+
+  TF_ASSERT_OK_AND_ASSIGN(ScopedShapedBuffer expected_buffer,
+                          sequential->Run({&arg}, options));
+  TF_ASSERT_OK_AND_ASSIGN(Literal expected,
+                          client->ShapedBufferToLiteral(expected_buffer));
+  TF_ASSERT_OK_AND_ASSIGN(ScopedShapedBuffer result_buffer,
+                          parallel->Run({&arg}, options));
+  TF_ASSERT_OK_AND_ASSIGN(Literal result,
+                          client->ShapedBufferToLiteral(result_buffer));
+  EXPECT_EQ(result, expected);
+}
+
+void BM_ExecuteWideGraph(::testing::benchmark::State& state) {
+  const bool inter_op_parallelism = state.range(0);
+  const int num_towers = state.range(1);
+  constexpr int kSize = 256;
+
+  se::Platform* platform = PlatformUtil::GetDefaultPlatform().value();
+  LocalClient* client = ClientLibrary::GetOrCreateLocalClient(platform).value();
+  std::unique_ptr<HloModule> module =
+      ParseAndReturnUnverifiedModule(
+          WideHloModule(num_towers, /*depth=*/4, kSize))
+          .value();
+
+  ExecutableBuildOptions build_options;
+  build_options.mutable_debug_options()
+      ->set_xla_cpu_enable_inter_op_parallelism(inter_op_parallelism);
+  Shape shape = ShapeUtil::MakeShapeWithDescendingLayout(F32, {kSize, kSize});
+  auto executables = client
+                         ->Compile(XlaComputation(module->ToProto()),
+                                   {&shape}, build_options)
+                         .value();
+  std::unique_ptr<LocalExecutable> executable = std::move(executables[0]);
+
+  ScopedShapedBuffer arg =
+      client
+          ->LiteralToShapedBuffer(
+              LiteralUtil::CreateFullWithDescendingLayout<float>(
+                  {kSize, kSize}, 0.01f),
+              /*device_ordinal=*/0)
+          .value();
+  ExecutableRunOptions options;
+  options.set_allocator(client->backend().memory_allocator());
+
+  // Warm up.
+  CHECK_OK(executable->Run({&arg}, options).status());
+
+  for (auto s : state) {
+    CHECK_OK(executable->Run({&arg}, options).status());
+  }
+}
+
+BENCHMARK(BM_ExecuteWideGraph)
+    ->ArgPair(0, 4)
+    ->ArgPair(1, 4)
+    ->ArgPair(0, 16)
+    ->ArgPair(1, 16)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
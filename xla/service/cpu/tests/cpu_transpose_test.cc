@@ -0,0 +1,178 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/string_view.h"
+#include "xla/client/client_library.h"
+#include "xla/client/executable_build_options.h"
+#include "xla/client/local_client.h"
+#include "xla/client/xla_computation.h"
+#include "xla/executable_run_options.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/literal.h"
+#include "xla/service/cpu/tests/cpu_codegen_test.h"
+#include "xla/service/hlo_parser.h"
+#include "xla/service/platform_util.h"
+#include "xla/service/shaped_buffer.h"
+#include "xla/tests/test_utils.h"
+#include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+using CpuTransposeTest = CpuCodegenTest;
+
+TEST_F(CpuTransposeTest, LayoutChangingCopy) {
+  constexpr absl::string_view kHlo = R"(
+HloModule copy
+
+ENTRY e {
+  p0 = f32[300,200]{1,0} parameter(0)
+  ROOT copy = f32[300,200]{0,1} copy(p0)
+})";
+  EXPECT_TRUE(RunAndCompare(kHlo, ErrorSpec{0, 0}));
+  CompileAndVerifyIr(std::string(kHlo), R"(
+CHECK: call void @__xla_cpu_runtime_Transpose
+)");
+}
+
+TEST_F(CpuTransposeTest, Transpose3D) {
+  constexpr absl::string_view kHlo = R"(
+HloModule transpose
+
+ENTRY e {
+  p0 = bf16[16,33,70]{2,1,0} parameter(0)
+  ROOT transpose = bf16[70,16,33]{2,1,0} transpose(p0), dimensions={2,0,1}
+})";
+  EXPECT_TRUE(RunAndCompare(kHlo, ErrorSpec{0, 0}));
+  CompileAndVerifyIr(std::string(kHlo), R"(
+CHECK: call void @__xla_cpu_runtime_Transpose
+)");
+}
+
+TEST_F(CpuTransposeTest, TransposeWithDegenerateDimensions) {
+  constexpr absl::string_view kHlo = R"(
+HloModule transpose
+
+ENTRY e {
+  p0 = s8[1,129,1,257]{3,2,1,0} parameter(0)
+  ROOT transpose = s8[257,1,129,1]{3,2,1,0} transpose(p0),
+    dimensions={3,2,1,0}
+})";
+  EXPECT_TRUE(RunAndCompare(kHlo, ErrorSpec{0, 0}));
+}
+
+TEST_F(CpuTransposeTest, SmallTransposeIsEmittedAsLoop) {
+  constexpr absl::string_view kHlo = R"(
+HloModule transpose
+
+ENTRY e {
+  p0 = f32[16,24]{1,0} parameter(0)
+  ROOT transpose = f32[24,16]{1,0} transpose(p0), dimensions={1,0}
+})";
+  EXPECT_TRUE(RunAndCompare(kHlo, ErrorSpec{0, 0}));
+  CompileAndVerifyIr(std::string(kHlo), R"(
+CHECK-NOT: @__xla_cpu_runtime_Transpose
+)");
+}
+
+struct TransposeCase {
+  std::vector<int64_t> dims;
+  std::vector<int64_t> permutation;
+};
+
+const std::vector<TransposeCase>& TransposeCases() {
+  static const auto* cases = new std::vector<TransposeCase>{
+      {{1024, 1024}, {1, 0}},
+      {{4096, 4096}, {1, 0}},
+      {{64, 128, 256}, {2, 1, 0}},
+      // The head transpose of BERT-large attention, for 32 sequences.
+      {{32, 512, 16, 64}, {0, 2, 1, 3}},
+  };
+  return *cases;
+}
+
+// Transposes an f32 array with the runtime transpose or with elementwise
+// loops.
+void BM_Transpose(::testing::benchmark::State& state) {
+  const TransposeCase& transpose_case = TransposeCases()[state.range(0)];
+  const bool use_runtime_transpose = state.range(1);
+  std::vector<int64_t> result_dims;
+  int64_t num_elements = 1;
+  for (int64_t dim : transpose_case.permutation) {
+    result_dims.push_back(transpose_case.dims[dim]);
+    num_elements *= transpose_case.dims[dim];
+  }
+  const std::string hlo = absl::StrCat(
+      "HloModule transpose\n\nENTRY e {\n  p0 = f32[",
+      absl::StrJoin(transpose_case.dims, ","), "] parameter(0)\n",
+      "  ROOT transpose = f32[", absl::StrJoin(result_dims, ","),
+      "] transpose(p0), dimensions={",
+      absl::StrJoin(transpose_case.permutation, ","), "}\n}\n");
+
+  se::Platform* platform = PlatformUtil::GetDefaultPlatform().value();
+  LocalClient* client = ClientLibrary::GetOrCreateLocalClient(platform).value();
+  std::unique_ptr<HloModule> module =
+      ParseAndReturnUnverifiedModule(hlo).value();
+  Literal arg = std::move(MakeFakeArguments(module.get()).value()[0]);
+  ScopedShapedBuffer arg_buffer =
+      client->LiteralToShapedBuffer(arg, /*device_ordinal=*/0).value();
+
+  ExecutableBuildOptions build_options;
+  build_options.mutable_debug_options()->set_xla_cpu_use_runtime_transpose(
+      use_runtime_transpose);
+  auto executables = client
+                         ->Compile(XlaComputation(module->ToProto()),
+                                   {&arg.shape()}, build_options)
+                         .value();
+  std::unique_ptr<LocalExecutable> executable = std::move(executables[0]);
+
+  ExecutableRunOptions options;
+  options.set_allocator(client->backend().memory_allocator());
+
+  // Warm up.
+  CHECK_OK(executable->Run({&arg_buffer}, options).status());
+
+  for (auto s : state) {
+    CHECK_OK(executable->Run({&arg_buffer}, options).status());
+  }
+  state.SetBytesProcessed(state.iterations() * 2 * num_elements *
+                          sizeof(float));
+}
+
+BENCHMARK(BM_Transpose)
+    ->ArgNames({"case", "runtime"})
+    ->Args({0, 0})
+    ->Args({0, 1})
+    ->Args({1, 0})
+    ->Args({1, 1})
+    ->Args({2, 0})
+    ->Args({2, 1})
+    ->Args({3, 0})
+    ->Args({3, 1})
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -20,7 +20,6 @@ limitations under the License.
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_instruction.h"
 #include "xla/hlo/ir/hlo_opcode.h"
-#include "xla/service/cpu/backend_config.pb.h"
 #include "xla/service/gpu/launch_dimensions.h"
 #include "xla/service/gpu/parallel_loop_emitter.h"
 #include "xla/service/llvm_ir/llvm_util.h"
@@ -30,17 +29,6 @@ namespace xla {
 namespace llvm_ir {
 
 bool MayBeImplementedAsInPlaceDynamicUpdateSlice(const HloInstruction* instr) {
-  // Today we can't emit a dynamic-update-slice if the DUS node is parallelized;
-  // the emitter will not emit correct code.  It's possible to change this, but
-  // then ParallelTaskAssigner would have to somehow know whether a node *will*
-  // be emitted as an in-place DUS, and it can't, because it doesn't have a
-  // buffer assignment when it runs.
-  auto cpu_backend_config_or = instr->backend_config<xla::cpu::BackendConfig>();
-  if (cpu_backend_config_or.ok() &&
-      !cpu_backend_config_or->outer_dimension_partitions().empty()) {
-    return false;
-  }
-
   // Until we know the final buffer assignment, any unfused dynamic-update-slice
   // might be implementable as an in-place DUS.
   if (instr->opcode() == HloOpcode::kDynamicUpdateSlice) {
@@ -94,16 +82,22 @@ bool CanEmitFusedDynamicUpdateSliceInPlace(HloInstruction* fusion,
          assignment.SharesSliceAtIndex(fusion, {}, operand, index);
 }
 
+// Returns an UpdateLoopEmitter that emits a sequential loop.
+static UpdateLoopEmitter SequentialUpdateLoopEmitter(llvm::IRBuilder<>* b) {
+  return [b](const BodyEmitter& body_emitter, const Shape& update_shape,
+             absl::string_view name) {
+    return LoopEmitter(body_emitter, update_shape, b).EmitLoop(name);
+  };
+}
+
 // Shared implementation of EmitDynamicUpdateSliceInPlace and
 // EmitFusedDynamicUpdateSliceInPlace.
-//
-// Emits a sequential loop if launch_dimensions is null.
 using IndexGenerator = std::function<StatusOr<llvm::Value*>(int64_t)>;
 
 static Status EmitDynamicUpdateSliceInPlaceImpl(
     const Shape& update_shape, const IndexGenerator& start_indices_generator,
     bool is_signed, ElementGenerator update_array_generator,
-    const IrArray& output_array, const gpu::LaunchDimensions* launch_dimensions,
+    const IrArray& output_array, const UpdateLoopEmitter& emit_update_loop,
     absl::string_view name, llvm::IRBuilder<>* b) {
   const Shape& output_shape = output_array.GetShape();
 
@@ -157,17 +151,21 @@ static Status EmitDynamicUpdateSliceInPlaceImpl(
     return OkStatus();
   };
 
-  if (launch_dimensions != nullptr) {
-    return gpu::ParallelLoopEmitter(loop_body_emitter, update_shape,
-                                    *launch_dimensions, b)
-        .EmitLoop(name);
-  }
-  return LoopEmitter(loop_body_emitter, update_shape, b).EmitLoop(name);
+  return emit_update_loop(loop_body_emitter, update_shape, name);
+}
+
+Status EmitDynamicUpdateSliceInPlace(absl::Span<const IrArray> operand_arrays,
+                                     const IrArray& output_array,
+                                     absl::string_view name,
+                                     llvm::IRBuilder<>* b) {
+  return EmitDynamicUpdateSliceInPlace(operand_arrays, output_array, name,
+                                       SequentialUpdateLoopEmitter(b), b);
 }
 
 Status EmitDynamicUpdateSliceInPlace(absl::Span<const IrArray> operand_arrays,
                                      const IrArray& output_array,
                                      absl::string_view name,
+                                     const UpdateLoopEmitter& emit_update_loop,
                                      llvm::IRBuilder<>* b) {
   VLOG(2) << "EmitDynamicUpdateSliceInPlace for " << name;
 
@@ -189,19 +187,17 @@ Status EmitDynamicUpdateSliceInPlace(absl::Span<const IrArray> operand_arrays,
   bool is_signed = ShapeUtil::ElementIsSigned(start_indices_array.GetShape());
   return EmitDynamicUpdateSliceInPlaceImpl(
       update_shape, start_indices_generator, is_signed, update_array_generator,
-      output_array, /*launch_dimensions=*/nullptr, name, b);
+      output_array, emit_update_loop, name, b);
 }
 
 // Shared implementation for EmitFusedDynamicUpdateSliceInPlace and
 // EmitParallelFusedDynamicUpdateSliceInPlace.
-//
-// Emits a sequential loop if launch_dimensions is null.
 static Status EmitFusedDynamicUpdateSliceInPlaceImpl(
     const HloComputation* fusion,
     const std::vector<std::pair<const HloInstruction*, const IrArray>>&
         dus_and_output_array,
-    FusedIrEmitter* fused_emitter,
-    const gpu::LaunchDimensions* launch_dimensions, llvm::IRBuilder<>* b) {
+    FusedIrEmitter* fused_emitter, const UpdateLoopEmitter& emit_update_loop,
+    llvm::IRBuilder<>* b) {
   VLOG(2) << "EmitFusedDynamicUpdateSliceInPlace for " << fusion->ToString();
 
   CHECK_GE(dus_and_output_array.size(), 1);
@@ -245,7 +241,7 @@ static Status EmitFusedDynamicUpdateSliceInPlaceImpl(
 
     TF_RETURN_IF_ERROR(EmitDynamicUpdateSliceInPlaceImpl(
         update_shape, start_indices_generator, is_signed,
-        update_array_generator, fusion_output_array, launch_dimensions,
+        update_array_generator, fusion_output_array, emit_update_loop,
         IrName(dynamic_update_slice), b));
   }
 
@@ -256,6 +252,15 @@ Status EmitFusedDynamicUpdateSliceInPlace(HloInstruction* fusion,
                                           const IrArray& fusion_output_array,
                                           FusedIrEmitter* fused_emitter,
                                           llvm::IRBuilder<>* b) {
+  return EmitFusedDynamicUpdateSliceInPlace(fusion, fusion_output_array,
+                                            fused_emitter,
+                                            SequentialUpdateLoopEmitter(b), b);
+}
+
+Status EmitFusedDynamicUpdateSliceInPlace(
+    HloInstruction* fusion, const IrArray& fusion_output_array,
+    FusedIrEmitter* fused_emitter, const UpdateLoopEmitter& emit_update_loop,
+    llvm::IRBuilder<>* b) {
   HloInstruction* dus = fusion->called_computations()[0]->root_instruction();
   CHECK_EQ(dus->opcode(), HloOpcode::kDynamicUpdateSlice);
   std::vector<std::pair<const HloInstruction*, const IrArray>>
@@ -263,7 +268,7 @@ Status EmitFusedDynamicUpdateSliceInPlace(HloInstruction* fusion,
 
   return EmitFusedDynamicUpdateSliceInPlaceImpl(
       fusion->called_computations()[0], dus_and_output_array, fused_emitter,
-      /*launch_dimensions=*/nullptr, b);
+      emit_update_loop, b);
 }
 
 Status EmitParallelFusedDynamicUpdateSliceInPlace(
@@ -273,7 +278,14 @@ Status EmitParallelFusedDynamicUpdateSliceInPlace(
     FusedIrEmitter* fused_emitter,
     const gpu::LaunchDimensions& launch_dimensions, llvm::IRBuilder<>* b) {
   return EmitFusedDynamicUpdateSliceInPlaceImpl(
-      fusion, dus_and_output_array, fused_emitter, &launch_dimensions, b);
+      fusion, dus_and_output_array, fused_emitter,
+      [&](const BodyEmitter& body_emitter, const Shape& update_shape,
+          absl::string_view name) {
+        return gpu::ParallelLoopEmitter(body_emitter, update_shape,
+                                        launch_dimensions, b)
+            .EmitLoop(name);
+      },
+      b);
 }
 
 }  // namespace llvm_ir
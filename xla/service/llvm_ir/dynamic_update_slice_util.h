@@ -23,6 +23,7 @@ limitations under the License.
 #include "xla/service/gpu/launch_dimensions.h"
 #include "xla/service/llvm_ir/fused_ir_emitter.h"
 #include "xla/service/llvm_ir/ir_array.h"
+#include "xla/service/llvm_ir/loop_emitter.h"
 
 // Utilities related to emitting LLVM IR for various HLO ops.
 
@@ -32,6 +33,12 @@ namespace llvm_ir {
 using GeneratorForOperandIrArrays =
     std::function<std::vector<llvm_ir::IrArray>()>;
 
+// Emits a loop that calls `body_emitter` on every index of `update_shape`, the
+// shape of the update of an in-place dynamic-update-slice.
+using UpdateLoopEmitter =
+    std::function<Status(const BodyEmitter& body_emitter,
+                         const Shape& update_shape, absl::string_view name)>;
+
 // Determines whether the given instruction might be implemented as an
 // in-place dynamic-update-slice after we have a buffer assignment.
 //
@@ -69,6 +76,14 @@ Status EmitDynamicUpdateSliceInPlace(absl::Span<const IrArray> operand_arrays,
                                      absl::string_view name,
                                      llvm::IRBuilder<>* b);
 
+// Same as above, except the loop over the update is emitted by
+// `emit_update_loop`, e.g. as a parallel loop over part of the update.
+Status EmitDynamicUpdateSliceInPlace(absl::Span<const IrArray> operand_arrays,
+                                     const IrArray& output_array,
+                                     absl::string_view name,
+                                     const UpdateLoopEmitter& emit_update_loop,
+                                     llvm::IRBuilder<>* b);
+
 // Given a loop-fusion node whose root is a dynamic-update-slice op whose
 // array-to-be-updated and output share the same buffer slice, emits
 // (sequential) code for a fusion node that does the dynamic-update-slice in
@@ -78,6 +93,13 @@ Status EmitFusedDynamicUpdateSliceInPlace(HloInstruction* fusion,
                                           FusedIrEmitter* fused_emitter,
                                           llvm::IRBuilder<>* b);
 
+// Same as above, except the loop over the update is emitted by
+// `emit_update_loop`. The update is iterated over in the layout of the fusion.
+Status EmitFusedDynamicUpdateSliceInPlace(
+    HloInstruction* fusion, const IrArray& fusion_output_array,
+    FusedIrEmitter* fused_emitter, const UpdateLoopEmitter& emit_update_loop,
+    llvm::IRBuilder<>* b);
+
 // Same as EmitFusedDynamicUpdateSliceInPlace, except emits a parallel loop with
 // the given launch dimensions for arbitrarily many independent dynamic slice
 // updates.
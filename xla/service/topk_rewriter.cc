@@ -148,7 +148,7 @@ static bool IsNanSafeGt(HloComputation* comp) {
 
   auto match_all_types = [](HloInstruction* root, auto callback) {
     bool result = false;
-    for (auto type : {BF16, F32, S32, U32}) {
+    for (auto type : {BF16, F16, F32, F64, S32, U32}) {
       result = result || Match(root, callback(type));
     }
     return result;
@@ -344,7 +344,8 @@ StatusOr<HloInstruction*> TopkRewriter::TransformPatternToCustomCall(
   HloInstruction* data = sort->mutable_operand(0);
   const PrimitiveType element_type = data->shape().element_type();
 
-  if (element_type != F32 && element_type != BF16) {
+  if (element_type != F32 && element_type != BF16 && element_type != F16 &&
+      element_type != F64 && element_type != S32 && element_type != U32) {
     return nullptr;
   }
 
@@ -192,6 +192,44 @@ ENTRY cluster {
   }
 }
 
+TEST_F(TopkRewriterTest, RewriteNonF32Types) {
+  for (std::string type : {"bf16", "f16", "f64", "s32", "u32"}) {
+    const std::string hlo_string = R"(
+HloModule module
+
+%compare {
+  %p.0.lhs = )" + type + R"([] parameter(0)
+  %p.0.rhs = )" + type + R"([] parameter(1)
+  %p.1.lhs = s32[] parameter(2)
+  %p.1.rhs = s32[] parameter(3)
+  ROOT %compare = pred[] compare(%p.0.lhs, %p.0.rhs), direction=GT
+}
+
+ENTRY cluster {
+  %arg_tuple.1 = )" + type + R"([8,1234] parameter(0)
+  %iota.4 = s32[8,1234] iota(), iota_dimension=1
+  %sort.27 = ()" + type + R"([8,1234], s32[8,1234]) sort(%arg_tuple.1, %iota.4),
+    dimensions={1}, is_stable=true, to_apply=%compare
+  %get-tuple-element.28 = )" + type + R"([8,1234] get-tuple-element(%sort.27), index=0
+  %slice.29 = )" + type + R"([8,5] slice(%get-tuple-element.28), slice={[0:8], [0:5]}
+  %get-tuple-element.30 = s32[8,1234] get-tuple-element(%sort.27), index=1
+  %slice.31 = s32[8,5] slice(%get-tuple-element.30), slice={[0:8], [0:5]}
+  ROOT %tuple.32 = ()" + type + R"([8,5], s32[8,5]) tuple(%slice.29, %slice.31)
+})";
+    TF_ASSERT_OK_AND_ASSIGN(auto module,
+                            ParseAndReturnVerifiedModule(hlo_string));
+    TopkRewriter rewriter(
+        [](const HloSortInstruction*, int64_t) { return true; });
+    TF_ASSERT_OK_AND_ASSIGN(bool changed, rewriter.Run(module.get()));
+    TF_ASSERT_OK(HloDCE().Run(module.get()).status());
+    EXPECT_TRUE(changed) << type;
+    EXPECT_THAT(module->entry_computation()->root_instruction(),
+                GmockMatch(m::Tuple(
+                    m::GetTupleElement(m::CustomCall(m::Parameter(0)), 0),
+                    m::GetTupleElement(m::CustomCall(m::Parameter(0)), 1))));
+  }
+}
+
 TEST_F(TopkRewriterTest, RewriteWithBroadcast) {
   for (std::string comparator :
        {getComparator(), getCompareComparator(), getStableComparator()}) {
@@ -17,6 +17,7 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "xla/array2d.h"
 #include "xla/client/client_library.h"
 #include "xla/client/local_client.h"
 #include "xla/client/sharding_builder.h"
@@ -99,6 +100,34 @@ XLA_TEST_F(LocalClientExecuteTest, AddVectors) {
       {2.0f, 4.0f, 6.0f}, ShapedBufferToLiteral(result), error_spec_);
 }
 
+XLA_TEST_F(LocalClientExecuteTest, ReuseTempSlab) {
+  XlaBuilder builder(TestName());
+  auto x = Parameter(&builder, 0, ShapeUtil::MakeShape(F32, {2, 2}), "x");
+  auto y = x;
+  for (int i = 0; i < 4; ++i) {
+    y = Add(Dot(y, x), x);
+  }
+  auto computation = builder.Build().value();
+
+  ExecutableBuildOptions build_options = DefaultExecutableBuildOptions();
+  build_options.mutable_debug_options()->set_xla_cpu_use_temp_slab(true);
+  auto x_array = LiteralToShapedBuffer(
+      LiteralUtil::CreateR2<float>({{1.0f, 0.0f}, {0.0f, 1.0f}}));
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto executables,
+      local_client_->Compile(computation, {&x_array.on_host_shape()},
+                             build_options));
+  // The second execution reuses the temporaries of the first.
+  for (int i = 0; i < 2; ++i) {
+    TF_ASSERT_OK_AND_ASSIGN(
+        ScopedShapedBuffer result,
+        executables[0]->Run({&x_array}, DefaultExecutableRunOptions()));
+    LiteralTestUtil::ExpectR2Near<float>({{5.0f, 0.0f}, {0.0f, 5.0f}},
+                                         ShapedBufferToLiteral(result),
+                                         error_spec_);
+  }
+}
+
 XLA_TEST_F(LocalClientExecuteTest, AddVectorsWithProfile) {
   XlaBuilder builder(TestName());
   auto x = Parameter(&builder, 0, ShapeUtil::MakeShape(F32, {3}), "x");
@@ -968,6 +997,61 @@ void BM_LocalClientOverhead(::testing::benchmark::State& state) {
   }
 }
 
+// Measures the per-execution overhead of a computation with hundreds of
+// temporaries, with and without xla_cpu_use_temp_slab (the benchmark argument).
+void BM_LocalClientOverheadManyTemps(::testing::benchmark::State& state) {
+  se::Platform* platform = PlatformUtil::GetDefaultPlatform().value();
+  auto executors = PlatformUtil::GetStreamExecutors(platform).value();
+  se::StreamExecutorMemoryAllocator allocator(platform, executors);
+  LocalClient* client = ClientLibrary::GetOrCreateLocalClient(platform).value();
+  auto* transfer_manager = TransferManager::GetForPlatform(platform).value();
+  int device_ordinal = client->default_device_ordinal();
+
+  // A chain of small dots, which are not fused, so that every step produces
+  // temporaries.
+  constexpr int kNumSteps = 256;
+  XlaBuilder builder("ManyTemps");
+  auto shape = ShapeUtil::MakeShape(F32, {16, 16});
+  auto x = Parameter(&builder, 0, shape, "x");
+  auto y = x;
+  for (int i = 0; i < kNumSteps; ++i) {
+    y = Tanh(Dot(y, x));
+  }
+  auto computation = builder.Build().value();
+
+  auto buffer =
+      transfer_manager
+          ->AllocateScopedShapedBuffer(shape, &allocator, /*device_ordinal=*/0)
+          .value();
+  auto literal =
+      LiteralUtil::CreateR2FromArray2D<float>(Array2D<float>(16, 16, 0.5f));
+  auto stream = client->mutable_backend()->BorrowStream(device_ordinal).value();
+  ASSERT_IS_OK(
+      transfer_manager->TransferLiteralToDevice(stream.get(), literal, buffer));
+
+  ExecutableBuildOptions build_options;
+  build_options.mutable_debug_options()->set_xla_cpu_use_temp_slab(
+      state.range(0));
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto executables,
+      client->Compile(computation, {&buffer.on_host_shape()}, build_options));
+  std::unique_ptr<LocalExecutable> executable = std::move(executables[0]);
+
+  ExecutableRunOptions run_options;
+  run_options.set_allocator(&allocator).set_stream(stream.get());
+
+  const int kWarmups = 2;
+  for (int i = 0; i < kWarmups; ++i) {
+    auto result = executable->Run({&buffer}, run_options);
+    ASSERT_IS_OK(result);
+  }
+
+  for (auto s : state) {
+    auto result = executable->Run({&buffer}, run_options);
+    ASSERT_IS_OK(result);
+  }
+}
+
 XLA_TEST_F(LocalClientExecuteTest, ValidateFDOProfile) {
   XlaBuilder builder(TestName());
   auto x = Parameter(&builder, 0, ShapeUtil::MakeShape(F32, {3}), "x");
@@ -1017,6 +1101,7 @@ XLA_TEST_F(LocalClientExecuteTest, ValidateDeviceMemorySize) {
 }
 
 BENCHMARK(BM_LocalClientOverhead);
+BENCHMARK(BM_LocalClientOverheadManyTemps)->Arg(0)->Arg(1);
 
 }  // namespace
 }  // namespace xla
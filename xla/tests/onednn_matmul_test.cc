@@ -15,20 +15,43 @@ limitations under the License.
 
 #if defined(INTEL_MKL) && defined(ENABLE_ONEDNN_V3)
 
+#include <memory>
+#include <string>
 #include <utility>
+#include <vector>
 
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "xla/client/client_library.h"
+#include "xla/client/executable_build_options.h"
+#include "xla/client/local_client.h"
+#include "xla/client/xla_computation.h"
+#include "xla/executable_run_options.h"
+#include "xla/hlo/ir/hlo_module.h"
 #include "xla/literal.h"
+#include "xla/literal_util.h"
+#include "xla/service/hlo_parser.h"
+#include "xla/service/platform_util.h"
+#include "xla/service/shaped_buffer.h"
 #include "xla/shape_util.h"
 #include "xla/test.h"
 #include "xla/test_helpers.h"
 #include "xla/tests/hlo_test_base.h"
 #include "xla/tests/test_macros.h"
 #include "tsl/platform/cpu_info.h"
+#include "tsl/platform/test_benchmark.h"
 
 namespace xla {
 namespace cpu {
 
-class MatmulTest : public HloTestBase {};
+class MatmulTest : public HloTestBase {
+ protected:
+  DebugOptions GetDebugOptionsForTest() override {
+    DebugOptions debug_options = HloTestBase::GetDebugOptionsForTest();
+    debug_options.set_xla_cpu_enable_onednn_rewriter(true);
+    return debug_options;
+  }
+};
 
 TEST_F(MatmulTest, SimpleTestF32) {
   const char* matmul_module_str = R"(
@@ -77,6 +100,203 @@ TEST_F(MatmulTest, SimpleTestF32TransposeB) {
   EXPECT_TRUE(RunAndCompare(matmul_module_str, ErrorSpec{1e-4, 1e-4}));
 }
 
+TEST_F(MatmulTest, BiasAddGeluTanhFusion) {
+  // jax.nn.gelu(x @ w + b, approximate=True)
+  const char* matmul_module_str = R"(
+  HloModule matmul.bias.gelu
+
+  ENTRY matmul.bias.gelu {
+    x = f32[32,64] parameter(0)
+    w = f32[64,128] parameter(1)
+    b = f32[128] parameter(2)
+    dot = f32[32,128] dot(x, w), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+    bias = f32[32,128] broadcast(b), dimensions={1}
+    add = f32[32,128] add(dot, bias)
+    square = f32[32,128] multiply(add, add)
+    cube = f32[32,128] multiply(add, square)
+    coeff = f32[] constant(0.044715)
+    coeff.b = f32[32,128] broadcast(coeff), dimensions={}
+    scaled.cube = f32[32,128] multiply(coeff.b, cube)
+    inner = f32[32,128] add(add, scaled.cube)
+    sqrt.2.pi = f32[] constant(0.797884583)
+    sqrt.2.pi.b = f32[32,128] broadcast(sqrt.2.pi), dimensions={}
+    scaled = f32[32,128] multiply(sqrt.2.pi.b, inner)
+    tanh = f32[32,128] tanh(scaled)
+    one = f32[] constant(1)
+    one.b = f32[32,128] broadcast(one), dimensions={}
+    one.plus = f32[32,128] add(one.b, tanh)
+    half = f32[] constant(0.5)
+    half.b = f32[32,128] broadcast(half), dimensions={}
+    cdf = f32[32,128] multiply(half.b, one.plus)
+    ROOT gelu = f32[32,128] multiply(add, cdf)
+  })";
+
+  EXPECT_TRUE(RunAndCompare(matmul_module_str, ErrorSpec{1e-4, 1e-4}));
+  MatchOptimizedHlo(matmul_module_str, R"(
+  ; CHECK: custom_call_target="__onednn$matmul"
+  ; CHECK-SAME: "fused_ops":["BIAS","GELU_TANH"]
+  )");
+}
+
+TEST_F(MatmulTest, BiasAddReluResidualAddFusion) {
+  const char* matmul_module_str = R"(
+  HloModule matmul.bias.relu.residual
+
+  ENTRY matmul.bias.relu.residual {
+    x = f32[2,16,64] parameter(0)
+    w = f32[2,64,64] parameter(1)
+    b = f32[64] parameter(2)
+    dot = f32[2,16,64] dot(x, w), lhs_batch_dims={0}, lhs_contracting_dims={2}, rhs_batch_dims={0}, rhs_contracting_dims={1}
+    bias = f32[2,16,64] broadcast(b), dimensions={2}
+    add = f32[2,16,64] add(dot, bias)
+    zero = f32[] constant(0)
+    zeros = f32[2,16,64] broadcast(zero), dimensions={}
+    relu = f32[2,16,64] maximum(add, zeros)
+    ROOT residual = f32[2,16,64] add(x, relu)
+  })";
+
+  EXPECT_TRUE(RunAndCompare(matmul_module_str, ErrorSpec{1e-4, 1e-4}));
+  MatchOptimizedHlo(matmul_module_str, R"(
+  ; CHECK: custom_call_target="__onednn$matmul"
+  ; CHECK-SAME: "fused_ops":["BIAS","RELU","BINARY_ADD"]
+  )");
+}
+
+TEST_F(MatmulTest, MultiUseMatmulNotFused) {
+  const char* matmul_module_str = R"(
+  HloModule matmul.multi.use
+
+  ENTRY matmul.multi.use {
+    x = f32[32,64] parameter(0)
+    w = f32[64,32] parameter(1)
+    dot = f32[32,32] dot(x, w), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+    tanh = f32[32,32] tanh(dot)
+    ROOT tuple = (f32[32,32], f32[32,32]) tuple(dot, tanh)
+  })";
+
+  EXPECT_TRUE(RunAndCompare(matmul_module_str, ErrorSpec{1e-4, 1e-4}));
+  MatchOptimizedHlo(matmul_module_str, R"(
+  ; CHECK: custom_call_target="__onednn$matmul"
+  ; CHECK-NOT: fused_ops
+  ; CHECK: tanh
+  )");
+}
+
+// Compares Eigen and oneDNN on the GEMMs of a BERT-large layer with 512 tokens
+// (M, K, N), with the bias-add and GELU epilogue of the feed-forward layers.
+// Eigen runs the epilogue as a separate loop fusion.
+void BM_TransformerMatMul(::testing::benchmark::State& state) {
+  const bool use_onednn = state.range(0);
+  const int64_t m = state.range(1);
+  const int64_t k = state.range(2);
+  const int64_t n = state.range(3);
+  const bool gelu = state.range(4);
+
+  // Positional arguments: M, K, N.
+  std::string hlo = absl::StrFormat(R"(
+  HloModule transformer_matmul
+
+  ENTRY e {
+    x = f32[%1$d,%2$d] parameter(0)
+    w = f32[%2$d,%3$d] parameter(1)
+    b = f32[%3$d] parameter(2)
+    dot = f32[%1$d,%3$d] dot(x, w), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+    bias = f32[%1$d,%3$d] broadcast(b), dimensions={1}
+    %4$s = f32[%1$d,%3$d] add(dot, bias)
+)",
+                                    m, k, n, gelu ? "add" : "ROOT add");
+  if (gelu) {
+    absl::StrAppend(&hlo, absl::StrFormat(R"(
+    square = f32[%1$d,%2$d] multiply(add, add)
+    cube = f32[%1$d,%2$d] multiply(add, square)
+    coeff = f32[] constant(0.044715)
+    coeff.b = f32[%1$d,%2$d] broadcast(coeff), dimensions={}
+    scaled.cube = f32[%1$d,%2$d] multiply(coeff.b, cube)
+    inner = f32[%1$d,%2$d] add(add, scaled.cube)
+    sqrt.2.pi = f32[] constant(0.797884583)
+    sqrt.2.pi.b = f32[%1$d,%2$d] broadcast(sqrt.2.pi), dimensions={}
+    scaled = f32[%1$d,%2$d] multiply(sqrt.2.pi.b, inner)
+    tanh = f32[%1$d,%2$d] tanh(scaled)
+    one = f32[] constant(1)
+    one.b = f32[%1$d,%2$d] broadcast(one), dimensions={}
+    one.plus = f32[%1$d,%2$d] add(one.b, tanh)
+    half = f32[] constant(0.5)
+    half.b = f32[%1$d,%2$d] broadcast(half), dimensions={}
+    cdf = f32[%1$d,%2$d] multiply(half.b, one.plus)
+    ROOT gelu = f32[%1$d,%2$d] multiply(add, cdf)
+)",
+                                          m, n));
+  }
+  absl::StrAppend(&hlo, "  }");
+
+  se::Platform* platform = PlatformUtil::GetDefaultPlatform().value();
+  LocalClient* client = ClientLibrary::GetOrCreateLocalClient(platform).value();
+  std::unique_ptr<HloModule> module =
+      ParseAndReturnUnverifiedModule(hlo).value();
+
+  ExecutableBuildOptions build_options;
+  build_options.mutable_debug_options()->set_xla_cpu_enable_onednn_rewriter(
+      use_onednn);
+  Shape x_shape = ShapeUtil::MakeShapeWithDescendingLayout(F32, {m, k});
+  Shape w_shape = ShapeUtil::MakeShapeWithDescendingLayout(F32, {k, n});
+  Shape b_shape = ShapeUtil::MakeShapeWithDescendingLayout(F32, {n});
+  auto executables =
+      client
+          ->Compile(XlaComputation(module->ToProto()),
+                    {&x_shape, &w_shape, &b_shape}, build_options)
+          .value();
+  std::unique_ptr<LocalExecutable> executable = std::move(executables[0]);
+
+  std::vector<ScopedShapedBuffer> args;
+  args.push_back(
+      client
+          ->LiteralToShapedBuffer(
+              LiteralUtil::CreateFullWithDescendingLayout<float>({m, k}, 0.01f),
+              /*device_ordinal=*/0)
+          .value());
+  args.push_back(
+      client
+          ->LiteralToShapedBuffer(
+              LiteralUtil::CreateFullWithDescendingLayout<float>({k, n}, 0.01f),
+              /*device_ordinal=*/0)
+          .value());
+  args.push_back(
+      client
+          ->LiteralToShapedBuffer(
+              LiteralUtil::CreateFullWithDescendingLayout<float>({n}, 0.01f),
+              /*device_ordinal=*/0)
+          .value());
+  std::vector<const ShapedBuffer*> arg_ptrs = {&args[0], &args[1], &args[2]};
+  ExecutableRunOptions options;
+  options.set_allocator(client->backend().memory_allocator());
+  options.set_intra_op_thread_pool(
+      client->backend().eigen_intra_op_thread_pool_device());
+
+  // Warm up.
+  CHECK_OK(executable->Run(arg_ptrs, options).status());
+
+  for (auto s : state) {
+    CHECK_OK(executable->Run(arg_ptrs, options).status());
+  }
+  // One item is a floating point operation of the matmul.
+  state.SetItemsProcessed(state.iterations() * 2 * m * k * n);
+}
+
+void TransformerMatMulArgs(::benchmark::internal::Benchmark* b) {
+  // Attention projections, and the feed-forward layers with GELU.
+  for (bool use_onednn : {false, true}) {
+    b->Args({use_onednn, 512, 1024, 1024, false});
+    b->Args({use_onednn, 512, 1024, 3072, false});
+    b->Args({use_onednn, 512, 1024, 4096, true});
+    b->Args({use_onednn, 512, 4096, 1024, false});
+  }
+}
+
+BENCHMARK(BM_TransformerMatMul)
+    ->ArgNames({"onednn", "m", "k", "n", "gelu"})
+    ->Apply(TransformerMatMulArgs)
+    ->UseRealTime();
+
 }  // namespace cpu
 }  // namespace xla
 
@@ -0,0 +1,180 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// A tool for recording the profile that guides parallel task assignment on
+// CPU. See kUsage for details.
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "xla/debug_options_flags.h"
+#include "xla/executable_run_options.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/literal.h"
+#include "xla/service/backend.h"
+#include "xla/service/executable.h"
+#include "xla/service/hlo_execution_profile.h"
+#include "xla/service/hlo_module_config.h"
+#include "xla/service/hlo_runner.h"
+#include "xla/service/platform_util.h"
+#include "xla/service/service_executable_run_options.h"
+#include "xla/service/shaped_buffer.h"
+#include "xla/service/stream_pool.h"
+#include "xla/statusor.h"
+#include "xla/tests/test_utils.h"
+#include "xla/tools/hlo_module_loader.h"
+#include "xla/util.h"
+#include "xla/xla.pb.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/init_main.h"
+#include "tsl/platform/logging.h"
+#include "tsl/platform/statusor.h"
+#include "tsl/profiler/protobuf/profiled_instructions.pb.h"
+#include "tsl/util/command_line_flags.h"
+
+namespace {
+const char* const kUsage = R"(
+This tool runs an HLO module on the CPU with every instruction run as a single
+task, and records the average latency of each instruction of its entry
+computation as a ProfiledInstructionsProto. Passing the profile to
+--xla_cpu_parallel_task_profile_path makes the CPU compiler choose the number
+of parallel tasks of these instructions from their latency.
+
+The profile is written as a binary proto if the output path ends in .pb, and
+as a text proto otherwise. The module runs on fake arguments, so instructions
+whose latency depends on the values of their operands should be profiled with
+care.
+
+Usage:
+
+  bazel run cpu_parallel_task_profiler -- -input=path/to/hlo_module \
+    -format=[hlo|pb|pbtxt] -output=path/to/profile.pbtxt [-num_runs=10]
+)";
+
+// Runs 'module' 'num_runs' times after a warm-up run, and returns the average
+// latency of the instructions of its entry computation that took any time.
+xla::StatusOr<tensorflow::profiler::ProfiledInstructionsProto> RecordProfile(
+    std::unique_ptr<xla::HloModule> module, int num_runs) {
+  TF_ASSIGN_OR_RETURN(stream_executor::Platform * platform,
+                      xla::PlatformUtil::GetPlatform("cpu"));
+  xla::HloRunner runner(platform);
+  TF_ASSIGN_OR_RETURN(std::vector<xla::Literal> arguments,
+                      xla::MakeFakeArguments(module.get()));
+  TF_ASSIGN_OR_RETURN(std::vector<xla::ScopedShapedBuffer> argument_buffers,
+                      runner.TransferLiteralsToDevice(arguments));
+  std::vector<const xla::ShapedBuffer*> argument_ptrs;
+  for (const xla::ScopedShapedBuffer& buffer : argument_buffers) {
+    argument_ptrs.push_back(&buffer);
+  }
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<xla::Executable> executable,
+                      runner.CreateExecutable(std::move(module),
+                                              /*run_hlo_passes=*/true));
+  if (!executable->hlo_profiling_enabled()) {
+    return xla::FailedPrecondition("HLO profiling is not enabled.");
+  }
+
+  xla::Backend& backend = runner.backend();
+  TF_ASSIGN_OR_RETURN(
+      xla::StreamPool::Ptr stream,
+      backend.BorrowStream(backend.default_device_ordinal()));
+  xla::ExecutableRunOptions exec_run_options;
+  exec_run_options.set_stream(stream.get());
+  exec_run_options.set_allocator(backend.memory_allocator());
+  exec_run_options.set_intra_op_thread_pool(
+      backend.eigen_intra_op_thread_pool_device());
+  xla::ServiceExecutableRunOptions run_options(exec_run_options);
+
+  const xla::HloComputation* entry = executable->module().entry_computation();
+  absl::flat_hash_map<const xla::HloInstruction*, uint64_t> total_cycles;
+  for (int run = -1; run < num_runs; ++run) {
+    xla::HloExecutionProfile profile(&executable->hlo_profile_printer_data(),
+                                     &executable->hlo_profile_index_map());
+    TF_RETURN_IF_ERROR(
+        executable->ExecuteOnStream(&run_options, argument_ptrs, &profile)
+            .status());
+    // The first run warms up caches and the thread pool.
+    if (run < 0) continue;
+    for (const xla::HloInstruction* instruction : entry->instructions()) {
+      total_cycles[instruction] += profile.GetCyclesTakenBy(*instruction);
+    }
+  }
+
+  const double cycles_per_us = backend.default_stream_executor()
+                                   ->GetDeviceDescription()
+                                   .clock_rate_ghz() *
+                               1e3;
+  tensorflow::profiler::ProfiledInstructionsProto profile;
+  for (const xla::HloInstruction* instruction :
+       entry->MakeInstructionPostOrder()) {
+    const uint64_t cycles = total_cycles[instruction];
+    if (cycles == 0) continue;
+    auto* cost = profile.add_costs();
+    cost->set_name(instruction->name());
+    cost->set_cost_us(cycles / cycles_per_us / num_runs);
+  }
+  return profile;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string input, format, output;
+  int32_t num_runs = 10;
+  std::vector<tsl::Flag> flag_list = {
+      tsl::Flag("input", &input, "input file"),
+      tsl::Flag("format", &format, "hlo|pb|pbtxt"),
+      tsl::Flag("output", &output, "output profile"),
+      tsl::Flag("num_runs", &num_runs, "number of profiled runs")};
+  xla::AppendDebugOptionsFlags(&flag_list);
+  const std::string kUsageString =
+      absl::StrCat(kUsage, "\n\n", tsl::Flags::Usage(argv[0], flag_list));
+  bool parse_ok = tsl::Flags::Parse(&argc, argv, flag_list);
+  tsl::port::InitMain(kUsageString.c_str(), &argc, &argv);
+  if (!parse_ok || input.empty() || output.empty() || num_runs < 1) {
+    LOG(QFATAL) << kUsageString;
+  }
+
+  std::unique_ptr<xla::HloModule> module =
+      xla::LoadModuleFromFile(
+          input, {}, format, [](xla::HloModuleConfig* config) {
+            // Run every instruction as a single task, so that none of them is
+            // outlined into a parallel call under another name.
+            config->set_intra_op_parallelism_threads(1);
+            xla::DebugOptions debug_options = config->debug_options();
+            debug_options.set_xla_hlo_profile(true);
+            debug_options.clear_xla_cpu_parallel_task_profile_path();
+            config->set_debug_options(debug_options);
+          })
+          .value();
+
+  tensorflow::profiler::ProfiledInstructionsProto profile =
+      RecordProfile(std::move(module), num_runs).value();
+  if (absl::EndsWith(output, ".pb")) {
+    TF_CHECK_OK(tsl::WriteBinaryProto(tsl::Env::Default(), output, profile));
+  } else {
+    TF_CHECK_OK(tsl::WriteTextProto(tsl::Env::Default(), output, profile));
+  }
+  LOG(INFO) << "Recorded the latencies of " << profile.costs_size()
+            << " instructions to " << output;
+  return 0;
+}